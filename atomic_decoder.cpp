@@ -0,0 +1,129 @@
+// atomic_decoder.cpp
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#include <string>
+#include "atomic_decoder.h"
+
+/**
+ * Atomically replaces the word with op(word) using a compare-and-swap loop
+ * @param word  host word backing the guest word
+ * @param op    operation applied to the old value
+ * @return      old value of the word
+ */
+template <typename F>
+static unsigned int atomic_update (unsigned int *word, F op) {
+    unsigned int old = __atomic_load_n(word, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(word, &old, op(old), true, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED));
+    return old;
+}
+
+/**
+ * AtomicDecoder constructor
+ * @param hart  hart whose instructions are decoded
+ */
+AtomicDecoder::AtomicDecoder (Hart &hart) : InstructionDecoder(hart) {
+    reserved = false;
+    reservation = 0;
+    reserved_value = 0;
+}
+
+/**
+ * Function decoding atomic instructions. All of them are executed as sequentially
+ * consistent, which satisfies any combination of the aq and rl bits.
+ * @param pc    program counter
+ * @param inst  raw instruction
+ * @return      new program counter
+ */
+unsigned int AtomicDecoder::decode (unsigned int pc, unsigned int inst) {
+    r_inst_t decoder{};
+    decoder.inst = inst;
+    unsigned int data = 0;
+
+    if (decoder.f.funct3 != 0b010) {
+        term->terminate("Invalid funct3 while decoding atomic instruction: "
+                        + std::to_string(decoder.f.funct3) + "\n", 1);
+    }
+
+    rs1 = reg->read(decoder.f.rs1);
+    rs2 = reg->read(decoder.f.rs2);
+    if (rs1 & 0x3u) {
+        term->terminate("Misaligned atomic memory access: address = " + std::to_string(rs1) + "\n", 1);
+    }
+    unsigned int value = rs2;
+
+    // funct5, the aq and rl bits are ignored
+    unsigned int funct5 = decoder.f.funct7 >> 2u;
+    // LR.W and an SC.W without reservation only read the word, so they leave the page untouched
+    bool writes = funct5 != 0b00010 && (funct5 != 0b00011 || (reserved && reservation == rs1));
+    unsigned int *word = writes ? stack->atomicWord(rs1) : nullptr;
+    const unsigned int *source = writes ? word : stack->atomicRead(rs1);
+
+    switch (funct5) {
+        case 0b00010:
+            // LR.W
+            data = __atomic_load_n(source, __ATOMIC_SEQ_CST);
+            reserved = true;
+            reservation = rs1;
+            reserved_value = data;
+            break;
+        case 0b00011:
+            // SC.W
+            // the reservation holds while the word keeps the value loaded by LR.W,
+            // so a store of the same value by another hart does not break it
+            data = 1;
+            if (writes) {
+                unsigned int expected = reserved_value;
+                data = __atomic_compare_exchange_n(word, &expected, rs2, false, __ATOMIC_SEQ_CST,
+                                                   __ATOMIC_SEQ_CST) ? 0 : 1;
+                writes = data == 0;
+            }
+            reserved = false;
+            break;
+        case 0b00001:
+            // AMOSWAP.W
+            data = __atomic_exchange_n(word, rs2, __ATOMIC_SEQ_CST);
+            break;
+        case 0b00000:
+            // AMOADD.W
+            data = __atomic_fetch_add(word, rs2, __ATOMIC_SEQ_CST);
+            break;
+        case 0b00100:
+            // AMOXOR.W
+            data = __atomic_fetch_xor(word, rs2, __ATOMIC_SEQ_CST);
+            break;
+        case 0b01100:
+            // AMOAND.W
+            data = __atomic_fetch_and(word, rs2, __ATOMIC_SEQ_CST);
+            break;
+        case 0b01000:
+            // AMOOR.W
+            data = __atomic_fetch_or(word, rs2, __ATOMIC_SEQ_CST);
+            break;
+        case 0b10000:
+            // AMOMIN.W
+            data = atomic_update(word, [value](unsigned int old) { return int(old) < int(value) ? old : value; });
+            break;
+        case 0b10100:
+            // AMOMAX.W
+            data = atomic_update(word, [value](unsigned int old) { return int(old) > int(value) ? old : value; });
+            break;
+        case 0b11000:
+            // AMOMINU.W
+            data = atomic_update(word, [value](unsigned int old) { return old < value ? old : value; });
+            break;
+        case 0b11100:
+            // AMOMAXU.W
+            data = atomic_update(word, [value](unsigned int old) { return old > value ? old : value; });
+            break;
+        default:
+            term->terminate("Invalid funct5 while decoding atomic instruction: "
+                            + std::to_string(funct5) + "\n", 1);
+    }
+    if (writes) {
+        // the instruction is predecoded again from the memory after the write
+        stack->atomicWritten(rs1);
+    }
+    reg->write(decoder.f.rd, data);
+    return pc+4;
+}
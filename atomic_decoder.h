@@ -0,0 +1,24 @@
+// atomic_decoder.h
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#ifndef ISA_SIM_CPP_ATOMIC_DECODER_H
+#define ISA_SIM_CPP_ATOMIC_DECODER_H
+
+#include "instruction_decoder.h"
+
+/**
+ * Atomic (A extension) instruction decoder. The instructions are executed
+ * with host atomic instructions on the memory shared by all harts.
+ */
+class AtomicDecoder : public InstructionDecoder {
+private:
+    bool reserved;                  // reservation set by LR.W is valid
+    unsigned int reservation;       // reserved address
+    unsigned int reserved_value;    // value loaded by LR.W
+public:
+    explicit AtomicDecoder (Hart &hart);
+    unsigned int decode (unsigned int pc, unsigned int inst) override;
+};
+
+#endif //ISA_SIM_CPP_ATOMIC_DECODER_H
@@ -0,0 +1,79 @@
+# bitmanip_base.s
+# Hash mixing kernel of bitmanip_zbb.s written with RV32IM instructions only.
+# Computes the same result as bitmanip_zbb.s: a1 = hash, a2 = accumulator.
+
+        li      s0, 0x9E3779B9          # hash
+        li      s1, 0                   # accumulator
+        li      s2, 0                   # i
+        li      s3, 1000000             # iterations
+        li      s4, 0x55555555
+        li      s5, 0x33333333
+        li      s6, 0x0F0F0F0F
+        li      s7, 0x01010101
+        li      s8, 0x0000FF00
+loop:
+        xor     t0, s0, s2
+        slli    t5, t0, 5               # rotate left by 5
+        srli    t6, t0, 27
+        or      s0, t5, t6
+
+        mv      a3, s0                  # t1 = popcount(s0)
+        jal     ra, popcount
+        mv      t1, a4
+
+        mv      a3, s0                  # t2 = count leading zeros(s0)
+        srli    t5, a3, 1
+        or      a3, a3, t5
+        srli    t5, a3, 2
+        or      a3, a3, t5
+        srli    t5, a3, 4
+        or      a3, a3, t5
+        srli    t5, a3, 8
+        or      a3, a3, t5
+        srli    t5, a3, 16
+        or      a3, a3, t5
+        jal     ra, popcount
+        li      t2, 32
+        sub     t2, t2, a4
+
+        add     s1, s1, t1
+        slli    t5, t2, 2
+        add     s1, t5, s1
+        not     t5, s1
+        and     t3, s0, t5
+        bgeu    s1, t3, keep
+        mv      s1, t3
+keep:
+        slli    t4, s1, 24              # t4 = byte-reverse(s1)
+        srli    t5, s1, 24
+        or      t4, t4, t5
+        and     t5, s1, s8
+        slli    t5, t5, 8
+        or      t4, t4, t5
+        srli    t5, s1, 8
+        and     t5, t5, s8
+        or      t4, t4, t5
+        xor     s0, s0, t4
+        addi    s2, s2, 1
+        bne     s2, s3, loop
+
+        mv      a1, s0
+        mv      a2, s1
+        li      a0, 10
+        ecall
+
+# a4 = popcount(a3)
+popcount:
+        srli    t5, a3, 1
+        and     t5, t5, s4
+        sub     a4, a3, t5
+        and     t5, a4, s5
+        srli    a4, a4, 2
+        and     a4, a4, s5
+        add     a4, a4, t5
+        srli    t5, a4, 4
+        add     a4, a4, t5
+        and     a4, a4, s6
+        mul     a4, a4, s7
+        srli    a4, a4, 24
+        jalr    x0, 0(ra)
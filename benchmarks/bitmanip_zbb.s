@@ -0,0 +1,26 @@
+# bitmanip_zbb.s
+# Hash mixing kernel using the Zba/Zbb bit-manipulation instructions.
+# Computes the same result as bitmanip_base.s: a1 = hash, a2 = accumulator.
+
+        li      s0, 0x9E3779B9          # hash
+        li      s1, 0                   # accumulator
+        li      s2, 0                   # i
+        li      s3, 1000000             # iterations
+loop:
+        xor     t0, s0, s2
+        rori    s0, t0, 27              # rotate left by 5
+        cpop    t1, s0
+        clz     t2, s0
+        add     s1, s1, t1
+        sh2add  s1, t2, s1
+        andn    t3, s0, s1
+        maxu    s1, s1, t3
+        rev8    t4, s1
+        xor     s0, s0, t4
+        addi    s2, s2, 1
+        bne     s2, s3, loop
+
+        mv      a1, s0
+        mv      a2, s1
+        li      a0, 10
+        ecall
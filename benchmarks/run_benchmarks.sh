@@ -0,0 +1,30 @@
+#!/bin/sh
+# run_benchmarks.sh
+# Assembles every benchmark in this directory and runs it with --stats.
+# Usage: ./run_benchmarks.sh <path_to_isa_sim_cpp>
+# Requires llvm-mc and llvm-objcopy (or a riscv64-unknown-elf binutils toolchain).
+
+SIM=${1:-../build/isa_sim_cpp}
+DIR=$(cd "$(dirname "$0")" && pwd)
+OUT=$(mktemp -d)
+ATTRS=+m,+f,+d,+zba,+zbb,-c,-relax
+
+for src in "$DIR"/*.s; do
+    name=$(basename "$src" .s)
+    if command -v llvm-mc > /dev/null; then
+        llvm-mc -triple=riscv32 -mattr=$ATTRS -filetype=obj -o "$OUT/$name.o" "$src" || exit 1
+        llvm-objcopy -O binary -j .text "$OUT/$name.o" "$OUT/$name.bin" || exit 1
+    else
+        riscv64-unknown-elf-as -march=rv32imfd_zba_zbb -mabi=ilp32 -mno-relax -o "$OUT/$name.o" "$src" || exit 1
+        riscv64-unknown-elf-objcopy -O binary -j .text "$OUT/$name.o" "$OUT/$name.bin" || exit 1
+    fi
+
+    echo "== $name"
+    start=$(date +%s.%N)
+    (cd "$OUT" && "$SIM" --stats "$name.bin") > "$OUT/$name.log" 2>&1
+    end=$(date +%s.%N)
+    grep -E "^x1[12] |Executed instructions" "$OUT/$name.log"
+    awk "BEGIN { printf \"time: %.3f s\\n\", $end - $start }"
+done
+
+rm -rf "$OUT"
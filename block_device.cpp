@@ -0,0 +1,162 @@
+// block_device.cpp
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#include <fcntl.h>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "block_device.h"
+#include "replay_log.h"
+#include "snapshot.h"
+
+// sectors copied into the guest memory at once
+#define TRANSFER_SECTORS    128u
+
+/**
+ * Block device constructor
+ * @param memory    guest memory the sectors are copied into
+ */
+BlockDevice::BlockDevice (Stack &memory) : memory(memory) {
+    fd = -1;
+    capacity = 0;
+    for (unsigned int &reg : registers) {
+        reg = 0;
+    }
+}
+
+BlockDevice::~BlockDevice () {
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+/**
+ * Opens the image file, a partial sector at its end is not accessible
+ * @param path  the path to the image
+ * @return      true if successful otherwise false
+ */
+bool BlockDevice::open (const char *path) {
+    fd = ::open(path, O_RDONLY);
+    struct stat info{};
+    if (fd < 0 || fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+        std::cerr << "Not a valid disk image\n";
+        return false;
+    }
+    capacity = (unsigned int)(info.st_size / SECTOR_SIZE);
+    return true;
+}
+
+/**
+ * Copies the requested sectors from the image into the guest memory.
+ * The copied data and the status are recorded, a replay takes them from the log.
+ * @return  status of the command
+ */
+unsigned int BlockDevice::read_sectors () {
+    ReplayLog *log = ReplayLog::active();
+    if (log != nullptr && log->replaying()) {
+        log->replayMemory(&memory);
+        return log->replayValue(REPLAY_DEVICE);
+    }
+    unsigned int status = copy_sectors(log);
+    if (log != nullptr) {
+        log->recordValue(REPLAY_DEVICE, status);
+    }
+    return status;
+}
+
+/**
+ * Copies the requested sectors from the image file
+ * @param log   log the copied data is recorded into, may be nullptr
+ * @return      status of the command
+ */
+unsigned int BlockDevice::copy_sectors (ReplayLog *log) {
+    unsigned long long sector = registers[BLOCK_SECTOR / 4];
+    unsigned int address = registers[BLOCK_ADDRESS / 4];
+    unsigned long long count = registers[BLOCK_COUNT / 4];
+    if (sector + count > capacity) {
+        return BLOCK_STATUS_ERROR;
+    }
+
+    std::vector<unsigned char> buffer(TRANSFER_SECTORS * SECTOR_SIZE);
+    try {
+        while (count != 0) {
+            unsigned int sectors = count < TRANSFER_SECTORS ? (unsigned int)(count) : TRANSFER_SECTORS;
+            ssize_t length = pread(fd, buffer.data(), sectors * SECTOR_SIZE, off_t(sector * SECTOR_SIZE));
+            if (length != ssize_t(sectors * SECTOR_SIZE)) {
+                return BLOCK_STATUS_ERROR;
+            }
+            memory.writeBlock(address, buffer.data(), sectors * SECTOR_SIZE);
+            if (log != nullptr) {
+                log->recordMemory(address, buffer.data(), sectors * SECTOR_SIZE);
+            }
+            sector += sectors;
+            address += sectors * SECTOR_SIZE;
+            count -= sectors;
+        }
+    } catch (const std::out_of_range &e) {
+        // the buffer is not in the data memory
+        return BLOCK_STATUS_ERROR;
+    }
+    return BLOCK_STATUS_OK;
+}
+
+/**
+ * Loads from the block device
+ * @param offset    offset from the base address
+ * @param length    number of bytes
+ * @return          value read
+ */
+unsigned int BlockDevice::read (unsigned int offset, unsigned int length) {
+    unsigned int reg = offset & ~3u;
+    unsigned int value;
+    if (reg == BLOCK_CAPACITY) {
+        value = capacity;
+    } else if (reg < BLOCK_CAPACITY) {
+        value = registers[reg / 4];
+    } else {
+        return 0;
+    }
+    value >>= 8 * (offset - reg);
+    return length == 4 ? value : value & ((1u << (8 * length)) - 1);
+}
+
+/**
+ * Stores to the block device, only the written bytes of the register change
+ * @param offset    offset from the base address
+ * @param data      value to be written
+ * @param length    number of bytes
+ */
+void BlockDevice::write (unsigned int offset, unsigned int data, unsigned int length) {
+    unsigned int reg = offset & ~3u;
+    if (reg >= BLOCK_STATUS) {
+        // status and capacity are read-only
+        return;
+    }
+    unsigned int shift = 8 * (offset - reg);
+    unsigned int mask = (length == 4 ? 0xFFFFFFFFu : (1u << (8 * length)) - 1) << shift;
+    registers[reg / 4] = (registers[reg / 4] & ~mask) | (data << shift & mask);
+
+    if (reg == BLOCK_COMMAND) {
+        registers[BLOCK_STATUS / 4] = registers[BLOCK_COMMAND / 4] == BLOCK_CMD_READ ? read_sectors()
+                                                                                     : BLOCK_STATUS_ERROR;
+    }
+}
+
+/**
+ * Writes the registers into a snapshot
+ * @param out   snapshot stream
+ */
+void BlockDevice::save (std::ostream &out) const {
+    save_value(out, registers);
+}
+
+/**
+ * Reads the registers from a snapshot
+ * @param in    snapshot stream
+ */
+void BlockDevice::restore (std::istream &in) {
+    restore_value(in, registers);
+}
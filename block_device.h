@@ -0,0 +1,53 @@
+// block_device.h
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#ifndef ISA_SIM_CPP_BLOCK_DEVICE_H
+#define ISA_SIM_CPP_BLOCK_DEVICE_H
+
+#include "device.h"
+#include "stack.h"
+
+class ReplayLog;
+
+#define BLOCK_DEVICE_BASE   0x10001000u
+#define BLOCK_DEVICE_SIZE   0x1000u
+#define SECTOR_SIZE         512u
+
+// registers, 4 bytes each
+#define BLOCK_SECTOR    0x00u   // first sector of the transfer
+#define BLOCK_ADDRESS   0x04u   // guest address of the buffer
+#define BLOCK_COUNT     0x08u   // number of sectors
+#define BLOCK_COMMAND   0x0Cu   // writing BLOCK_CMD_READ starts the transfer
+#define BLOCK_STATUS    0x10u   // BLOCK_STATUS_OK or BLOCK_STATUS_ERROR of the last command
+#define BLOCK_CAPACITY  0x14u   // number of sectors of the image
+
+#define BLOCK_CMD_READ      1u
+#define BLOCK_STATUS_OK     0u
+#define BLOCK_STATUS_ERROR  1u
+
+/**
+ * Read-only block device backed by an image file of the host. A command copies
+ * whole sectors from the image into the guest memory before the store completes.
+ */
+class BlockDevice : public Device {
+public:
+    explicit BlockDevice (Stack &memory);
+    ~BlockDevice () override;
+    bool open (const char *path);
+    unsigned int read (unsigned int offset, unsigned int length) override;
+    void write (unsigned int offset, unsigned int data, unsigned int length) override;
+    void save (std::ostream &out) const override;
+    void restore (std::istream &in) override;
+private:
+    unsigned int read_sectors ();
+    unsigned int copy_sectors (ReplayLog *log);
+
+    Stack &memory;
+    int fd;
+    unsigned int capacity;
+    unsigned int registers[BLOCK_CAPACITY / 4];
+};
+
+
+#endif //ISA_SIM_CPP_BLOCK_DEVICE_H
@@ -0,0 +1,215 @@
+// cache_analyzer.cpp
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#include <algorithm>
+#include <atomic>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include "cache_analyzer.h"
+#include "instrumentation.h"
+#include "stack_distance.h"
+#include "hart.h"
+
+unsigned int CacheAnalyzer::s_threads = 1;
+std::mutex CacheAnalyzer::s_lock;
+std::vector<std::unique_ptr<CacheTrace>> CacheAnalyzer::s_traces;
+std::array<std::vector<std::array<uint64_t, CACHE_WAYS_MAX + 1>>, CACHE_STREAM_COUNT> CacheAnalyzer::s_set_distances;
+std::array<std::vector<uint64_t>, CACHE_STREAM_COUNT> CacheAnalyzer::s_full_distances;
+
+/**
+ * Cache trace constructor
+ */
+CacheTrace::CacheTrace () {
+    m_repeats.fill(0);
+    m_last.fill(~0u);
+}
+
+/**
+ * Enables capturing of the reference streams, the miss rates are printed at the end of simulation
+ * @param threads   number of host threads of the analysis
+ */
+void CacheAnalyzer::enable (unsigned int threads) {
+    s_threads = threads;
+    Instrumentation::select(INSTRUMENT_CACHE);
+}
+
+/**
+ * Captures an access
+ * @param hart      hart accessing the memory
+ * @param stream    reference stream
+ * @param address   accessed address
+ */
+void CacheAnalyzer::access (Hart &hart, cache_stream_t stream, unsigned int address) {
+    if (address >= STACK_SIZE) {
+        return;
+    }
+    trace(hart).access(stream, address >> CACHE_LINE_BITS);
+}
+
+/**
+ * @param hart  hart accessing the memory
+ * @return      trace of the hart, created on its first access
+ */
+CacheTrace &CacheAnalyzer::trace (Hart &hart) {
+    if (hart.cacheTrace() == nullptr) {
+        std::lock_guard<std::mutex> guard(s_lock);
+        s_traces.push_back(std::make_unique<CacheTrace>());
+        hart.setCacheTrace(s_traces.back().get());
+    }
+    return *hart.cacheTrace();
+}
+
+/**
+ * Analyses the captured streams on the thread pool and prints the miss rates.
+ * Called once all harts stopped.
+ */
+void CacheAnalyzer::finish () {
+    if (!(Instrumentation::selected() & INSTRUMENT_CACHE)) {
+        return;
+    }
+    std::vector<cache_task_t> tasks;
+    for (unsigned int stream = 0; stream < CACHE_STREAM_COUNT; stream++) {
+        s_set_distances[stream].assign(__builtin_ctz(CACHE_SETS_MAX) + 1, {});
+        s_full_distances[stream].assign(CACHE_LINES + 1, 0);
+        // the fully associative caches take longest, they start first
+        tasks.push_back(cache_task_t{cache_stream_t(stream), 0, 0});
+    }
+    for (unsigned int stream = 0; stream < CACHE_STREAM_COUNT; stream++) {
+        for (unsigned int sets = 1; sets <= CACHE_SETS_MAX; sets *= 2) {
+            for (unsigned int partition = 0; partition < std::min(sets, (unsigned int)CACHE_PARTITIONS); partition++) {
+                tasks.push_back(cache_task_t{cache_stream_t(stream), sets, partition});
+            }
+        }
+    }
+
+    std::atomic<unsigned long> next{0};
+    std::vector<std::thread> threads;
+    for (unsigned int i = 0; i < std::min<unsigned long>(s_threads, tasks.size()); i++) {
+        threads.emplace_back([&tasks, &next] {
+            for (unsigned long task = next++; task < tasks.size(); task = next++) {
+                analyze(tasks[task]);
+            }
+        });
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+
+    std::cout << std::setfill(' ') << "\n\033[1mCache miss rates:\033[0m " << CACHE_LINE_SIZE << "-byte lines, LRU, private caches of "
+              << s_traces.size() << (s_traces.size() == 1 ? " hart\n" : " harts\n");
+    print_stream(CACHE_STREAM_FETCH);
+    print_stream(CACHE_STREAM_DATA);
+}
+
+/**
+ * Runs one task of the analysis
+ * @param task  the task
+ */
+void CacheAnalyzer::analyze (const cache_task_t &task) {
+    if (task.sets == 0) {
+        analyze_full(task);
+    } else {
+        analyze_sets(task);
+    }
+}
+
+/**
+ * Computes the stack distances in the sets of a partition, up to CACHE_WAYS_MAX
+ * @param task  stream, number of sets and the partition
+ */
+void CacheAnalyzer::analyze_sets (const cache_task_t &task) {
+    unsigned int partitions = std::min(task.sets, (unsigned int)CACHE_PARTITIONS);
+    unsigned int sets = task.sets / partitions;
+    std::array<uint64_t, CACHE_WAYS_MAX + 1> distances{};
+    // the most recent lines of every set of the partition, the most recent first
+    std::vector<uint32_t> ways(sets * CACHE_WAYS_MAX);
+    std::vector<unsigned int> used(sets);
+    for (const auto &trace : s_traces) {
+        std::fill(used.begin(), used.end(), 0);
+        for (uint32_t line : trace->m_lines[task.stream]) {
+            unsigned int set = line & (task.sets - 1);
+            if (set % partitions != task.partition) {
+                continue;
+            }
+            uint32_t *stack = &ways[set / partitions * CACHE_WAYS_MAX];
+            unsigned int &count = used[set / partitions];
+            unsigned int distance = 0;
+            while (distance < count && stack[distance] != line) {
+                distance++;
+            }
+            distances[distance < count ? distance : CACHE_WAYS_MAX]++;
+            if (distance == count && count < CACHE_WAYS_MAX) {
+                count++;
+            }
+            std::copy_backward(stack, stack + std::min(distance, count - 1), stack + std::min(distance, count - 1) + 1);
+            stack[0] = line;
+        }
+    }
+    std::lock_guard<std::mutex> guard(s_lock);
+    auto &total = s_set_distances[task.stream][__builtin_ctz(task.sets)];
+    for (unsigned int i = 0; i <= CACHE_WAYS_MAX; i++) {
+        total[i] += distances[i];
+    }
+}
+
+/**
+ * Computes the stack distances of the fully associative cache
+ * @param task  stream
+ */
+void CacheAnalyzer::analyze_full (const cache_task_t &task) {
+    std::vector<uint64_t> distances(CACHE_LINES + 1, 0);
+    StackDistance stack(CACHE_LINES);
+    for (const auto &trace : s_traces) {
+        stack.clear();
+        for (uint32_t line : trace->m_lines[task.stream]) {
+            unsigned int distance = stack.access(line);
+            distances[distance == STACK_DISTANCE_COLD ? CACHE_LINES : distance]++;
+        }
+    }
+    std::lock_guard<std::mutex> guard(s_lock);
+    for (unsigned int i = 0; i <= CACHE_LINES; i++) {
+        s_full_distances[task.stream][i] += distances[i];
+    }
+}
+
+/**
+ * Prints the miss rates of a stream, one row per cache size and one column per associativity
+ * @param stream    reference stream
+ */
+void CacheAnalyzer::print_stream (cache_stream_t stream) {
+    uint64_t accesses = 0;
+    for (const auto &trace : s_traces) {
+        accesses += trace->m_lines[stream].size() + trace->m_repeats[stream];
+    }
+    std::cout << (stream == CACHE_STREAM_FETCH ? "Instruction fetch: " : "Data:              ") << std::dec
+              << accesses << " accesses\n";
+    if (accesses == 0) {
+        return;
+    }
+    std::cout << "  size      ";
+    for (unsigned int ways = 1; ways <= CACHE_WAYS_MAX; ways *= 2) {
+        std::cout << std::setw(9) << (ways == 1 ? std::string("direct") : std::to_string(ways) + "-way");
+    }
+    std::cout << std::setw(9) << "full" << "\n";
+
+    for (unsigned int size = CACHE_SIZE_MIN; size <= CACHE_SIZE_MAX; size *= 2) {
+        unsigned int lines = size / CACHE_LINE_SIZE;
+        std::cout << "  " << std::left << std::setw(10) << (std::to_string(size / 1024) + " KiB") << std::right;
+        for (unsigned int ways = 1; ways <= CACHE_WAYS_MAX; ways *= 2) {
+            const auto &distances = s_set_distances[stream][__builtin_ctz(lines / ways)];
+            uint64_t misses = 0;
+            for (unsigned int distance = ways; distance <= CACHE_WAYS_MAX; distance++) {
+                misses += distances[distance];
+            }
+            std::cout << std::setw(8) << std::fixed << std::setprecision(2)
+                      << 100.0 * double(misses) / double(accesses) << "%";
+        }
+        uint64_t misses = 0;
+        for (unsigned int distance = lines; distance <= CACHE_LINES; distance++) {
+            misses += s_full_distances[stream][distance];
+        }
+        std::cout << std::setw(8) << 100.0 * double(misses) / double(accesses) << "%\n";
+    }
+}
@@ -0,0 +1,102 @@
+// cache_analyzer.h
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#ifndef ISA_SIM_CPP_CACHE_ANALYZER_H
+#define ISA_SIM_CPP_CACHE_ANALYZER_H
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "stack.h"
+
+class Hart;
+
+#define CACHE_LINE_BITS     6
+#define CACHE_LINE_SIZE     (1u << CACHE_LINE_BITS)
+#define CACHE_LINES         (STACK_SIZE >> CACHE_LINE_BITS)
+#define CACHE_WAYS_MAX      16                  // highest associativity of the grid
+#define CACHE_SIZE_MIN      1024u
+#define CACHE_SIZE_MAX      (256u * 1024u)
+#define CACHE_SETS_MAX      (CACHE_SIZE_MAX / CACHE_LINE_SIZE)
+#define CACHE_PARTITIONS    8                   // set-index partitions analysed by separate tasks
+
+/**
+ * Reference streams of the caches
+ */
+typedef enum {
+    CACHE_STREAM_FETCH,         // instruction fetch
+    CACHE_STREAM_DATA,          // loads, stores and atomic instructions
+    CACHE_STREAM_COUNT
+} cache_stream_t;
+
+/**
+ * Task of the analysis: the sets of one partition of a set-associative cache
+ * with a given number of sets, or a fully associative cache
+ */
+typedef struct {
+    cache_stream_t stream;
+    unsigned int sets;                  // 0 for the fully associative cache
+    unsigned int partition;
+} cache_task_t;
+
+/**
+ * Reference stream of one hart: accessed lines without immediate repeats,
+ * which hit in every cache and are only counted
+ */
+class CacheTrace {
+public:
+    CacheTrace ();
+    void access (cache_stream_t stream, unsigned int line) {
+        if (line == m_last[stream]) {
+            m_repeats[stream]++;
+            return;
+        }
+        m_last[stream] = line;
+        m_lines[stream].push_back(line);
+    }
+private:
+    friend class CacheAnalyzer;
+
+    std::array<std::vector<uint32_t>, CACHE_STREAM_COUNT> m_lines;
+    std::array<uint64_t, CACHE_STREAM_COUNT> m_repeats;
+    std::array<uint32_t, CACHE_STREAM_COUNT> m_last;
+};
+
+/**
+ * Evaluation of a grid of LRU cache configurations in one run. The instruction
+ * fetch and data reference streams of every hart are captured while the program
+ * runs and analysed at exit by Mattson's stack algorithm: an access hits in an
+ * LRU cache of A ways if fewer than A distinct lines of its set were accessed since
+ * the last access of the line, so one pass over the stream per number of sets gives
+ * the miss rates of all associativities. A set keeps the most recent CACHE_WAYS_MAX
+ * lines, the fully associative cache uses the tree-based StackDistance. The number
+ * of sets and the set-index partitions are analysed by tasks on a pool of host threads.
+ * Every hart has private caches, their misses are summed up.
+ */
+class CacheAnalyzer {
+public:
+    static void enable (unsigned int threads);
+    static void access (Hart &hart, cache_stream_t stream, unsigned int address);
+    static void finish ();
+private:
+    static CacheTrace &trace (Hart &hart);
+    static void analyze (const cache_task_t &task);
+    static void analyze_sets (const cache_task_t &task);
+    static void analyze_full (const cache_task_t &task);
+    static void print_stream (cache_stream_t stream);
+
+    static unsigned int s_threads;
+    static std::mutex s_lock;
+    static std::vector<std::unique_ptr<CacheTrace>> s_traces;
+    // histograms of the stack distances, of the sets by log2 of their number (distance CACHE_WAYS_MAX
+    // counts the longer ones and the first accesses) and of the fully associative cache (CACHE_LINES
+    // counts the first accesses)
+    static std::array<std::vector<std::array<uint64_t, CACHE_WAYS_MAX + 1>>, CACHE_STREAM_COUNT> s_set_distances;
+    static std::array<std::vector<uint64_t>, CACHE_STREAM_COUNT> s_full_distances;
+};
+
+
+#endif //ISA_SIM_CPP_CACHE_ANALYZER_H
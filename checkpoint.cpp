@@ -0,0 +1,100 @@
+// checkpoint.cpp
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#include <algorithm>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "checkpoint.h"
+
+/**
+ * Writes a checkpoint file
+ * @param path      path of the file
+ * @param header    configuration of the machine, the layout is filled in here
+ * @param state     state of the machine without its memory
+ * @param memory    data memory, its touched pages are written
+ * @return          true if successful otherwise false
+ */
+bool Checkpoint::write (const char *path, checkpoint_header_t header, const std::string &state, const Stack &memory) {
+    std::vector<uint32_t> indices;
+    for (unsigned int index = 0; index < PAGE_COUNT; index++) {
+        if (memory.touchedPage(index) != nullptr) {
+            indices.push_back(index);
+        }
+    }
+    header.magic = CHECKPOINT_MAGIC;
+    header.version = CHECKPOINT_VERSION;
+    header.page_size = PAGE_SIZE;
+    header.pages = indices.size();
+    header.state_size = state.size();
+    uint64_t end = sizeof(header) + state.size() + indices.size() * sizeof(uint32_t);
+    header.pages_offset = (end + PAGE_MASK) & ~uint64_t(PAGE_MASK);
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        return false;
+    }
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(state.data(), std::streamsize(state.size()));
+    file.write(reinterpret_cast<const char *>(indices.data()), std::streamsize(indices.size() * sizeof(uint32_t)));
+    // the pages are aligned in the file, so they can be mapped in place
+    std::vector<char> padding(header.pages_offset - end, 0);
+    file.write(padding.data(), std::streamsize(padding.size()));
+    for (uint32_t index : indices) {
+        file.write(reinterpret_cast<const char *>(memory.touchedPage(index)), PAGE_SIZE);
+    }
+    return file.good();
+}
+
+/**
+ * Maps a checkpoint file and replaces the contents of the data memory by its pages
+ * @param path      path of the file
+ * @param header    header of the file
+ * @param state     state of the machine without its memory
+ * @param memory    data memory, owns the mapping afterwards
+ * @return          false if the file is not a valid checkpoint
+ */
+bool Checkpoint::map (const char *path, checkpoint_header_t &header, std::string &state, Stack &memory) {
+    int fd = ::open(path, O_RDONLY);
+    struct stat info{};
+    if (fd < 0 || fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || size_t(info.st_size) < sizeof(header)) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return false;
+    }
+    auto length = size_t(info.st_size);
+    // a private mapping: pages written by the program are copied, the file stays unchanged
+    void *mapping = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+    auto *base = static_cast<unsigned char *>(mapping);
+    header = *reinterpret_cast<const checkpoint_header_t *>(base);
+    // the offsets come from the file, every bound is checked without overflow
+    uint64_t indices_offset = sizeof(header) + std::min<uint64_t>(header.state_size, length);
+    if (header.magic != CHECKPOINT_MAGIC || header.version != CHECKPOINT_VERSION || header.page_size != PAGE_SIZE
+        || header.pages > PAGE_COUNT || header.state_size > length || indices_offset > length
+        || header.pages_offset > length || (header.pages_offset & PAGE_MASK) != 0
+        || header.pages > (length - header.pages_offset) / PAGE_SIZE
+        || indices_offset + uint64_t(header.pages) * sizeof(uint32_t) > header.pages_offset) {
+        munmap(mapping, length);
+        return false;
+    }
+    const auto *indices = reinterpret_cast<const uint32_t *>(base + indices_offset);
+    for (unsigned int i = 0; i < header.pages; i++) {
+        if (indices[i] >= PAGE_COUNT) {
+            munmap(mapping, length);
+            return false;
+        }
+    }
+    state.assign(reinterpret_cast<const char *>(base + sizeof(header)), header.state_size);
+    memory.mapPages(mapping, length, indices, header.pages, base + header.pages_offset);
+    return true;
+}
@@ -0,0 +1,48 @@
+// checkpoint.h
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#ifndef ISA_SIM_CPP_CHECKPOINT_H
+#define ISA_SIM_CPP_CHECKPOINT_H
+
+#include <cstdint>
+#include <string>
+#include "stack.h"
+
+#define CHECKPOINT_MAGIC    0x4B435652u     // "RVCK"
+#define CHECKPOINT_VERSION  1u
+
+/**
+ * Header of a checkpoint file. It is followed by the state of the machine
+ * without its memory (snapshot stream of the harts, the devices and the system
+ * calls, state_size bytes) and the page numbers of the touched pages (uint32_t
+ * each). The pages themselves start at pages_offset, which is a multiple of
+ * the page size, in the order of their numbers. All values are little-endian.
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t page_size;
+    uint32_t harts;
+    uint32_t vlen;
+    uint32_t pages;
+    uint64_t image_hash;                // hash of the program the checkpoint was taken from
+    uint64_t instructions;              // retired instructions of hart 0
+    uint64_t state_size;
+    uint64_t pages_offset;
+} checkpoint_header_t;
+
+/**
+ * On-disk checkpoint of a whole machine. Loading maps the file privately, the
+ * touched pages of the data memory point into the mapping and are copied by the
+ * host kernel only when the program writes them, so a start from a checkpoint
+ * costs the same whatever the size of the memory of the program.
+ */
+class Checkpoint {
+public:
+    static bool write (const char *path, checkpoint_header_t header, const std::string &state, const Stack &memory);
+    static bool map (const char *path, checkpoint_header_t &header, std::string &state, Stack &memory);
+};
+
+
+#endif //ISA_SIM_CPP_CHECKPOINT_H
@@ -0,0 +1,93 @@
+// clint.cpp
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#include "clint.h"
+#include "hart.h"
+
+/**
+ * CLINT constructor
+ * @param harts     harts whose interrupts are controlled
+ */
+Clint::Clint (const std::vector<Hart*> &harts) : harts(harts) {
+}
+
+/**
+ * Reads the register containing the offset. The registers of the timer
+ * are 64 bits wide, every 8 byte aligned block is one register.
+ * @param offset    offset from the base address
+ * @param value     value of the whole register
+ * @return          false if there is no register at the offset
+ */
+bool Clint::read_register (unsigned int offset, unsigned long long &value) {
+    if (offset < CLINT_MTIMECMP) {
+        unsigned int hart = offset / 4;
+        if (hart >= harts.size()) {
+            return false;
+        }
+        value = harts[hart]->interruptPending(IRQ_MSI);
+        return true;
+    }
+    if (offset == CLINT_MTIME) {
+        value = Hart::current()->time();
+        return true;
+    }
+    unsigned int hart = (offset - CLINT_MTIMECMP) / 8;
+    if (hart >= harts.size()) {
+        return false;
+    }
+    value = harts[hart]->timerCompare();
+    return true;
+}
+
+/**
+ * Writes the register at the offset
+ * @param offset    offset of the register from the base address
+ * @param value     value of the whole register
+ */
+void Clint::write_register (unsigned int offset, unsigned long long value) {
+    if (offset < CLINT_MTIMECMP) {
+        harts[offset / 4]->setInterruptPending(IRQ_MSI, value & 1u);
+    } else if (offset == CLINT_MTIME) {
+        Hart::current()->setTime(value);
+    } else {
+        harts[(offset - CLINT_MTIMECMP) / 8]->setTimerCompare(value);
+    }
+}
+
+/**
+ * Loads from the CLINT, unimplemented registers read as zero
+ * @param offset    offset from the base address
+ * @param length    number of bytes
+ * @return          value read
+ */
+unsigned int Clint::read (unsigned int offset, unsigned int length) {
+    // msip registers are 4 bytes wide, the timer ones 8 bytes
+    unsigned int width = offset < CLINT_MTIMECMP ? 4 : 8;
+    unsigned int base = offset & ~(width - 1);
+    unsigned long long value = 0;
+    if (!read_register(base, value)) {
+        return 0;
+    }
+    value >>= 8 * (offset - base);
+    return length == 4 ? (unsigned int)(value) : (unsigned int)(value) & ((1u << (8 * length)) - 1);
+}
+
+/**
+ * Stores to the CLINT, only the written bytes of the register change.
+ * Writes to unimplemented registers are ignored.
+ * @param offset    offset from the base address
+ * @param data      value to be written
+ * @param length    number of bytes
+ */
+void Clint::write (unsigned int offset, unsigned int data, unsigned int length) {
+    unsigned int width = offset < CLINT_MTIMECMP ? 4 : 8;
+    unsigned int base = offset & ~(width - 1);
+    unsigned long long value = 0;
+    if (!read_register(base, value)) {
+        return;
+    }
+    unsigned int shift = 8 * (offset - base);
+    unsigned long long mask = (length == 4 ? 0xFFFFFFFFull : (1ull << (8 * length)) - 1) << shift;
+    write_register(base, (value & ~mask) | ((unsigned long long)(data) << shift & mask));
+}
@@ -0,0 +1,37 @@
+// clint.h
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#ifndef ISA_SIM_CPP_CLINT_H
+#define ISA_SIM_CPP_CLINT_H
+
+#include <vector>
+#include "device.h"
+
+class Hart;
+
+// SiFive compatible register layout
+#define CLINT_BASE      0x02000000u
+#define CLINT_SIZE      0x10000u
+#define CLINT_MSIP      0x0000u     // 4 bytes per hart
+#define CLINT_MTIMECMP  0x4000u     // 8 bytes per hart
+#define CLINT_MTIME     0xBFF8u
+
+/**
+ * Core-local interruptor: software interrupts and the timer of every hart.
+ * mtime reads the time of the hart performing the access.
+ */
+class Clint : public Device {
+public:
+    explicit Clint (const std::vector<Hart*> &harts);
+    unsigned int read (unsigned int offset, unsigned int length) override;
+    void write (unsigned int offset, unsigned int data, unsigned int length) override;
+private:
+    bool read_register (unsigned int offset, unsigned long long &value);
+    void write_register (unsigned int offset, unsigned long long value);
+
+    const std::vector<Hart*> &harts;
+};
+
+
+#endif //ISA_SIM_CPP_CLINT_H
@@ -0,0 +1,174 @@
+// co_simulator.cpp
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <memory>
+#include "co_simulator.h"
+#include "program_image.h"
+#include "program_generator.h"
+#include "isa_simulator.h"
+
+/**
+ * Co-simulator constructor, both harts run without system calls
+ */
+CoSimulator::CoSimulator () : m_ref(0, m_ref_memory), m_fast(0, m_fast_memory) {
+    m_ref_result = EXEC_OK;
+    m_fast_result = EXEC_OK;
+    m_block = 0;
+    m_instructions = 0;
+    m_blocks = 0;
+}
+
+/**
+ * Runs one program on both engines and compares them after every basic block
+ * of the fast engine
+ * @param words     the program
+ * @return          true if the engines did not diverge
+ */
+bool CoSimulator::check (const std::vector<unsigned int> &words) {
+    // the reference image keeps the pairs unfused
+    m_ref_memory.loadImage(std::make_shared<const ProgramImage>(words, false));
+    m_fast_memory.loadImage(std::make_shared<const ProgramImage>(words));
+    m_ref.reset(0);
+    m_fast.reset(0);
+    m_ref_result = EXEC_OK;
+    m_fast_result = EXEC_OK;
+
+    while (m_fast_result == EXEC_OK && m_fast.statistics()->instructions() < COSIM_STEP_LIMIT) {
+        m_block = m_fast.programCounter();
+        // the memories are compared in the pages written by the block
+        m_ref_memory.trackWrites();
+        m_fast_memory.trackWrites();
+        unsigned long long start = m_fast.statistics()->instructions();
+        // a fused pair retires two instructions at once, a compressed instruction is two bytes long
+        m_fast.floatRegisters()->attachHost();
+        unsigned int last;
+        unsigned long long retired;
+        do {
+            last = m_fast.programCounter();
+            retired = m_fast.statistics()->instructions();
+            m_fast_result = m_fast.run(1);
+            retired = m_fast.statistics()->instructions() - retired;
+        } while (m_fast_result == EXEC_OK
+                 && (m_fast.programCounter() == last + 4 * retired || m_fast.programCounter() == last + 2));
+        m_fast.floatRegisters()->detachHost();
+        unsigned long long count = m_fast.statistics()->instructions() - start;
+        // both harts share the host thread, so the host FPU is switched between them
+        m_ref.floatRegisters()->attachHost();
+        // a fetch outside of the program halts without retiring the instruction
+        m_ref_result = m_ref.run(m_fast_result == EXEC_OK ? count : count + 1);
+        m_ref.floatRegisters()->detachHost();
+        m_instructions += count;
+        m_blocks++;
+
+        std::string difference = compare();
+        if (!difference.empty()) {
+            report(difference, words);
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Compares the state of the engines
+ * @return  description of the first difference, empty if they agree
+ */
+std::string CoSimulator::compare () {
+    std::ostringstream out;
+    if (m_ref_result != m_fast_result || m_ref.halt().exit_code != m_fast.halt().exit_code
+        || m_ref.halt().msg != m_fast.halt().msg) {
+        out << "halted differently: \"" << m_ref.halt().msg << "\" and \"" << m_fast.halt().msg << "\"";
+    } else if (m_ref.statistics()->instructions() != m_fast.statistics()->instructions()) {
+        out << "retired " << m_ref.statistics()->instructions() << " and "
+            << m_fast.statistics()->instructions() << " instructions";
+    } else if (m_ref.programCounter() != m_fast.programCounter()) {
+        out << "pc = 0x" << std::hex << m_ref.programCounter() << " and 0x" << m_fast.programCounter();
+    } else {
+        for (unsigned int i = 0; i < 32; i++) {
+            auto reg = RegisterFile::Register(i);
+            if (m_ref.registers()->read(reg) != m_fast.registers()->read(reg)) {
+                out << "x" << std::dec << i << " = 0x" << std::hex << m_ref.registers()->read(reg)
+                    << " and 0x" << m_fast.registers()->read(reg);
+                return out.str();
+            }
+        }
+        unsigned int sp = m_ref_memory.compare(m_fast_memory);
+        if (sp != STACK_END) {
+            out << "memory at 0x" << std::hex << sp << " = 0x" << (unsigned int)m_ref_memory.readByte(sp)
+                << " and 0x" << (unsigned int)m_fast_memory.readByte(sp);
+        }
+    }
+    return out.str();
+}
+
+/**
+ * Prints both states, dumps the register files and the failing program
+ * @param difference    description of the difference
+ * @param words         the program
+ */
+void CoSimulator::report (const std::string &difference, const std::vector<unsigned int> &words) {
+    std::cout << "\x1B[1;31mEngines diverged in the block at pc = 0x" << std::hex << m_block << std::dec
+              << " after " << m_fast.statistics()->instructions() << " instructions: " << difference
+              << "\x1B[0m\r\n";
+    std::cout << "\n\033[1mReference engine:\033[0m pc = 0x" << std::hex << m_ref.programCounter() << std::dec
+              << ", " << m_ref.statistics()->instructions() << " instructions\n";
+    m_ref.registers()->print_registers();
+    std::cout << "\n\033[1mFast engine:\033[0m pc = 0x" << std::hex << m_fast.programCounter() << std::dec
+              << ", " << m_fast.statistics()->instructions() << " instructions\n";
+    m_fast.registers()->print_registers();
+    m_ref.registers()->dump_registers("./output_reference.res");
+    m_fast.registers()->dump_registers("./output_fast.res");
+
+    std::ofstream file(COSIM_FAILURE_FILE, std::ios::binary);
+    file.write(reinterpret_cast<const char *>(words.data()), std::streamsize(words.size() * 4));
+    std::cout << "Program written to " << COSIM_FAILURE_FILE << "\n";
+}
+
+/**
+ * Compares the engines on a binary
+ * @param filepath  the path to the binary file
+ * @return          true if the engines did not diverge
+ */
+bool CoSimulator::runFile (const char *filepath) {
+    std::vector<unsigned int> words;
+    if (!ISA_Simulator::readBinary(filepath, words)) {
+        return false;
+    }
+    if (!check(words)) {
+        return false;
+    }
+    std::string end = m_fast_result == EXEC_OK ? "stopped at the step limit" : m_fast.halt().msg;
+    std::cout << "\x1B[1;32mEngines agree after " << m_instructions << " instructions in " << m_blocks
+              << " blocks: " << end << "\x1B[0m\r\n";
+    return true;
+}
+
+/**
+ * Compares the engines on random programs
+ * @param count     number of programs
+ * @param seed      seed of the program generator
+ * @return          true if the engines did not diverge
+ */
+bool CoSimulator::runRandom (unsigned long count, uint64_t seed) {
+    ProgramGenerator generator(seed);
+    for (unsigned long i = 0; i < count; i++) {
+        std::vector<unsigned int> words = generator.generate();
+        bool agree = check(words);
+        // generated programs always halt
+        if (agree && m_fast_result == EXEC_OK) {
+            report("no halt within the step limit", words);
+            agree = false;
+        }
+        if (!agree) {
+            std::cout << "Random program " << i << " of seed " << seed << "\n";
+            return false;
+        }
+    }
+    std::cout << "\x1B[1;32mEngines agree on " << count << " random programs (seed " << seed << "), "
+              << m_instructions << " instructions in " << m_blocks << " blocks\x1B[0m\r\n";
+    return true;
+}
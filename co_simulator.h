@@ -0,0 +1,47 @@
+// co_simulator.h
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#ifndef ISA_SIM_CPP_CO_SIMULATOR_H
+#define ISA_SIM_CPP_CO_SIMULATOR_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "hart.h"
+#include "stack.h"
+
+#define COSIM_STEP_LIMIT    1000000     // instructions of a program compared at most
+#define COSIM_FAILURE_FILE  "./lockstep_failure.bin"
+
+/**
+ * Lockstep differential co-simulation of two execution engines on their own
+ * memories. The reference engine executes every instruction by its decoder,
+ * the fast engine runs the predecoded image with macro fusion. The fast engine
+ * runs up to the end of a basic block, the reference engine executes the same
+ * number of instructions, then pc, registers, memory and the way they halted
+ * are compared. The first divergence stops the comparison with both states dumped.
+ */
+class CoSimulator {
+public:
+    CoSimulator ();
+    bool check (const std::vector<unsigned int> &words);
+    bool runFile (const char *filepath);
+    bool runRandom (unsigned long count, uint64_t seed);
+private:
+    std::string compare ();
+    void report (const std::string &difference, const std::vector<unsigned int> &words);
+
+    Stack m_ref_memory;
+    Stack m_fast_memory;
+    Hart m_ref;
+    Hart m_fast;
+    exec_result_t m_ref_result;
+    exec_result_t m_fast_result;
+    unsigned int m_block;                       // pc of the last compared block
+    unsigned long long m_instructions;
+    unsigned long long m_blocks;
+};
+
+
+#endif //ISA_SIM_CPP_CO_SIMULATOR_H
@@ -0,0 +1,148 @@
+// code_memory.cpp
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#include <algorithm>
+#include <utility>
+#include <sys/mman.h>
+#include "code_memory.h"
+#include "stack.h"
+
+/**
+ * Code memory constructor
+ * @param image     program image shared with the other instances
+ * @param memory    data memory of the guest, the image is mapped into it
+ */
+CodeMemory::CodeMemory (std::shared_ptr<const ProgramImage> image, Stack &memory)
+        : m_image(std::move(image)), m_memory(memory) {
+    m_mapping = nullptr;
+    m_private_words = nullptr;
+    m_private_decoded = nullptr;
+    m_words = m_image->instructions().data();
+    m_decoded = m_image->decoded().data();
+}
+
+CodeMemory::~CodeMemory () {
+    if (m_mapping != nullptr) {
+        munmap(m_mapping, m_image->codeLength());
+    }
+}
+
+/**
+ * Replaces the shared image by a private mapping of it, which can be modified.
+ * Only its written pages are copied. The mapping is never moved, harts running
+ * on other host threads may keep using it.
+ */
+void CodeMemory::make_private () {
+    if (m_mapping != nullptr || m_image->instructions().empty()) {
+        return;
+    }
+    m_mapping = m_image->mapCode(m_private_words, m_private_decoded);
+    // instructions beyond the data memory cannot be written
+    m_valid = m_image->codeEntries();
+    __atomic_store_n(&m_decoded, m_private_decoded, __ATOMIC_RELEASE);
+    __atomic_store_n(&m_words, m_private_words, __ATOMIC_RELEASE);
+}
+
+/**
+ * Invalidates the predecoded entries of the instructions overlapping bytes
+ * written into the data memory, including those starting at the halfword
+ * before them. A fused pair ending in an invalidated instruction is split,
+ * so the first instruction executes on its own. Entries of unknown opcodes
+ * (data) are not counted and stay, the hart predecodes them again when it
+ * reaches one. Pages without valid entries lose their code tag.
+ * @param sp        guest address of the first written byte
+ * @param length    number of bytes
+ * @return          number of invalidated entries
+ */
+unsigned int CodeMemory::invalidate (unsigned int sp, unsigned int length) {
+    std::lock_guard<std::mutex> guard(m_lock);
+    unsigned long first = sp < 2 ? 0 : (sp - 2) / 2;
+    unsigned long last = std::min<unsigned long>((sp + (unsigned long)length + 1) / 2, size());
+    // a store overwriting only data and stale entries leaves the code as it is
+    auto valid = [] (const predecoded_t &entry) {
+        return entry.decoder != DECODER_STALE && entry.decoder != DECODER_NONE;
+    };
+    if (std::none_of(m_decoded + std::min(first, last), m_decoded + last, valid)) {
+        return 0;
+    }
+    make_private();
+    unsigned int count = 0;
+    for (unsigned long i = first; i < last; i++) {
+        predecoded_t &entry = m_private_decoded[i];
+        if (!valid(entry)) {
+            continue;
+        }
+        entry.fusion = FUSE_NONE;
+        entry.decoder = DECODER_STALE;
+        entry.compressed = false;
+        count++;
+        unsigned int page = (unsigned int)(i * 2 >> PAGE_BITS);
+        if (--m_valid[page] == 0) {
+            m_memory.tagCode(page, false);
+        }
+    }
+    // the first instruction of a pair is two halfwords before the second one
+    for (unsigned long i = std::max(first, 2ul) - 2; i < first && i < size(); i++) {
+        if (m_private_decoded[i].fusion != FUSE_NONE) {
+            m_private_decoded[i].fusion = FUSE_NONE;
+        }
+    }
+    return count;
+}
+
+/**
+ * Predecodes an invalidated instruction or an unknown opcode again from the data
+ * memory, stores do not invalidate unknown opcodes. The entry is fused with the
+ * following instruction and the preceding one with it, if possible.
+ * @param index     index of the instruction, its address divided by two
+ * @return          the entry, DECODER_NONE if it is still not an instruction
+ */
+const predecoded_t &CodeMemory::refresh (unsigned int index) {
+    std::lock_guard<std::mutex> guard(m_lock);
+    const predecoded_t &current = m_decoded[index];
+    if (current.decoder != DECODER_STALE && current.decoder != DECODER_NONE) {
+        return current;
+    }
+    unsigned int address = index * 2;
+    if ((address >> PAGE_BITS) >= m_image->pageCount()) {
+        // instructions beyond the data memory cannot be written
+        return current;
+    }
+    unsigned int high = address + 2 < STACK_SIZE ? m_memory.readHalf(address + 2) : 0;
+    bool compressed;
+    unsigned int inst = ProgramImage::fetch(m_memory.readHalf(address), high, compressed);
+    if (current.decoder == DECODER_NONE && ProgramImage::decoder(inst) == DECODER_NONE) {
+        return current;
+    }
+    make_private();
+    predecoded_t &entry = m_private_decoded[index];
+    m_private_words[index] = inst;
+    entry.compressed = compressed;
+    entry.decoder = ProgramImage::decoder(inst);
+    if (m_image->fused()) {
+        entry.fusion = ProgramImage::fusion(m_private_words, m_private_decoded, size(), index);
+        fusion_t previous = index >= 2 ? ProgramImage::fusion(m_private_words, m_private_decoded, size(), index - 2)
+                                       : FUSE_NONE;
+        if (index >= 2 && m_private_decoded[index - 2].fusion != previous) {
+            m_private_decoded[index - 2].fusion = previous;
+        }
+    }
+    unsigned int page = address >> PAGE_BITS;
+    if (entry.decoder != DECODER_NONE && m_valid[page]++ == 0) {
+        m_memory.tagCode(page, true);
+    }
+    return entry;
+}
+
+/**
+ * Drops the copied pages of the private mapping, which reads as the image again,
+ * so a reset instance copies only the pages its next run writes
+ */
+void CodeMemory::reset () {
+    if (m_mapping == nullptr) {
+        return;
+    }
+    madvise(m_mapping, m_image->codeLength(), MADV_DONTNEED);
+    m_valid = m_image->codeEntries();
+}
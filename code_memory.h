@@ -0,0 +1,52 @@
+// code_memory.h
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#ifndef ISA_SIM_CPP_CODE_MEMORY_H
+#define ISA_SIM_CPP_CODE_MEMORY_H
+
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "program_image.h"
+
+class Stack;
+
+/**
+ * Instruction memory of a guest as seen by its harts. It starts as the shared
+ * program image, the first store into the code maps a private copy of it, of
+ * which the host kernel copies only the written pages. Predecoded entries of
+ * the copy are invalidated by stores. Invalidated entries dispatch to
+ * DECODER_STALE, which predecodes the instruction again from the data memory
+ * on its next execution. The data memory tags the pages holding valid entries,
+ * stores to other pages stay on the fast path.
+ */
+class CodeMemory {
+public:
+    CodeMemory (std::shared_ptr<const ProgramImage> image, Stack &memory);
+    ~CodeMemory ();
+    CodeMemory (const CodeMemory &) = delete;
+    CodeMemory &operator= (const CodeMemory &) = delete;
+
+    const unsigned int *instructions () const { return __atomic_load_n(&m_words, __ATOMIC_ACQUIRE); }
+    const predecoded_t *decoded () const { return __atomic_load_n(&m_decoded, __ATOMIC_ACQUIRE); }
+    unsigned long size () const { return m_image->decoded().size(); }
+    unsigned int invalidate (unsigned int sp, unsigned int length);
+    const predecoded_t &refresh (unsigned int index);
+    void reset ();
+private:
+    void make_private ();
+
+    std::shared_ptr<const ProgramImage> m_image;
+    Stack &m_memory;
+    std::mutex m_lock;
+    unsigned char *m_mapping;                       // private mapping of the code, made by the first store
+    unsigned int *m_private_words;
+    predecoded_t *m_private_decoded;
+    std::vector<unsigned int> m_valid;              // valid predecoded entries of every page of the copy
+    const unsigned int *m_words;                    // the image or the private copy
+    const predecoded_t *m_decoded;
+};
+
+
+#endif //ISA_SIM_CPP_CODE_MEMORY_H
@@ -0,0 +1,295 @@
+// compressed_expander.cpp
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#include "compressed_expander.h"
+
+#define OPCODE_LOAD         0b0000011u
+#define OPCODE_FLOAT_LOAD   0b0000111u
+#define OPCODE_IMM          0b0010011u
+#define OPCODE_STORE        0b0100011u
+#define OPCODE_FLOAT_STORE  0b0100111u
+#define OPCODE_REG          0b0110011u
+#define OPCODE_LUI          0b0110111u
+#define OPCODE_BRANCH       0b1100011u
+#define OPCODE_JALR         0b1100111u
+#define OPCODE_JAL          0b1101111u
+#define OPCODE_SYSTEM       0b1110011u
+
+#define REG_RA  1u
+#define REG_SP  2u
+
+#define ILLEGAL 0u      // decodes to no decoder
+
+/**
+ * Extracts a field of an instruction
+ * @param half  compressed instruction
+ * @param high  highest bit of the field
+ * @param low   lowest bit of the field
+ * @return      the field shifted to bit 0
+ */
+static unsigned int bits (unsigned int half, unsigned int high, unsigned int low) {
+    return half >> low & ((1u << (high - low + 1)) - 1);
+}
+
+/**
+ * Sign-extends an immediate
+ * @param value immediate
+ * @param width number of its bits
+ * @return      sign-extended immediate
+ */
+static unsigned int sign_extend (unsigned int value, unsigned int width) {
+    unsigned int sign = 1u << (width - 1);
+    return (value ^ sign) - sign;
+}
+
+/**
+ * @param field 3-bit register field of the CIW, CL, CS, CA and CB formats
+ * @return      register x8 to x15 it encodes
+ */
+static unsigned int short_reg (unsigned int field) {
+    return 8 + field;
+}
+
+static unsigned int encode_r (unsigned int funct7, unsigned int rs2, unsigned int rs1, unsigned int funct3,
+                              unsigned int rd, unsigned int opcode) {
+    return funct7 << 25u | rs2 << 20u | rs1 << 15u | funct3 << 12u | rd << 7u | opcode;
+}
+
+static unsigned int encode_i (unsigned int imm, unsigned int rs1, unsigned int funct3, unsigned int rd,
+                              unsigned int opcode) {
+    return (imm & 0xFFFu) << 20u | rs1 << 15u | funct3 << 12u | rd << 7u | opcode;
+}
+
+static unsigned int encode_s (unsigned int imm, unsigned int rs2, unsigned int rs1, unsigned int funct3,
+                              unsigned int opcode) {
+    return (imm >> 5u & 0x7Fu) << 25u | rs2 << 20u | rs1 << 15u | funct3 << 12u | (imm & 0x1Fu) << 7u | opcode;
+}
+
+static unsigned int encode_b (unsigned int imm, unsigned int rs2, unsigned int rs1, unsigned int funct3) {
+    return (imm >> 12u & 1u) << 31u | (imm >> 5u & 0x3Fu) << 25u | rs2 << 20u | rs1 << 15u | funct3 << 12u
+           | (imm >> 1u & 0xFu) << 8u | (imm >> 11u & 1u) << 7u | OPCODE_BRANCH;
+}
+
+static unsigned int encode_j (unsigned int imm, unsigned int rd) {
+    return (imm >> 20u & 1u) << 31u | (imm >> 1u & 0x3FFu) << 21u | (imm >> 11u & 1u) << 20u
+           | (imm >> 12u & 0xFFu) << 12u | rd << 7u | OPCODE_JAL;
+}
+
+/**
+ * @param half  CJ-format instruction
+ * @return      sign-extended jump offset
+ */
+static unsigned int cj_offset (unsigned int half) {
+    unsigned int offset = bits(half, 12, 12) << 11u | bits(half, 11, 11) << 4u | bits(half, 10, 9) << 8u
+                          | bits(half, 8, 8) << 10u | bits(half, 7, 7) << 6u | bits(half, 6, 6) << 7u
+                          | bits(half, 5, 3) << 1u | bits(half, 2, 2) << 5u;
+    return sign_extend(offset, 12);
+}
+
+/**
+ * @param half  CB-format branch
+ * @return      sign-extended branch offset
+ */
+static unsigned int cb_offset (unsigned int half) {
+    unsigned int offset = bits(half, 12, 12) << 8u | bits(half, 11, 10) << 3u | bits(half, 6, 5) << 6u
+                          | bits(half, 4, 3) << 1u | bits(half, 2, 2) << 5u;
+    return sign_extend(offset, 9);
+}
+
+/**
+ * @param half  CI-format instruction
+ * @return      sign-extended 6-bit immediate
+ */
+static unsigned int ci_imm (unsigned int half) {
+    return sign_extend(bits(half, 12, 12) << 5u | bits(half, 6, 2), 6);
+}
+
+/**
+ * Expands quadrant 0: loads and stores relative to x8 to x15 and c.addi4spn
+ * @param half  compressed instruction
+ * @return      equivalent 32-bit instruction
+ */
+static unsigned int expand_quadrant0 (unsigned int half) {
+    unsigned int rd = short_reg(bits(half, 4, 2));
+    unsigned int rs1 = short_reg(bits(half, 9, 7));
+    // offsets of word and doubleword accesses
+    unsigned int word = bits(half, 12, 10) << 3u | bits(half, 6, 6) << 2u | bits(half, 5, 5) << 6u;
+    unsigned int doubleword = bits(half, 12, 10) << 3u | bits(half, 6, 5) << 6u;
+    switch (bits(half, 15, 13)) {
+        case 0b000: {
+            // C.ADDI4SPN, the all-zero instruction is illegal
+            unsigned int imm = bits(half, 12, 11) << 4u | bits(half, 10, 7) << 6u
+                               | bits(half, 6, 6) << 2u | bits(half, 5, 5) << 3u;
+            return imm != 0 ? encode_i(imm, REG_SP, 0b000, rd, OPCODE_IMM) : ILLEGAL;
+        }
+        case 0b001:
+            // C.FLD
+            return encode_i(doubleword, rs1, 0b011, rd, OPCODE_FLOAT_LOAD);
+        case 0b010:
+            // C.LW
+            return encode_i(word, rs1, 0b010, rd, OPCODE_LOAD);
+        case 0b011:
+            // C.FLW
+            return encode_i(word, rs1, 0b010, rd, OPCODE_FLOAT_LOAD);
+        case 0b101:
+            // C.FSD
+            return encode_s(doubleword, rd, rs1, 0b011, OPCODE_FLOAT_STORE);
+        case 0b110:
+            // C.SW
+            return encode_s(word, rd, rs1, 0b010, OPCODE_STORE);
+        case 0b111:
+            // C.FSW
+            return encode_s(word, rd, rs1, 0b010, OPCODE_FLOAT_STORE);
+        default:
+            return ILLEGAL;
+    }
+}
+
+/**
+ * Expands quadrant 1: immediates, arithmetic on x8 to x15, jumps and branches
+ * @param half  compressed instruction
+ * @param bias  added to the offsets of jumps and branches
+ * @return      equivalent 32-bit instruction
+ */
+static unsigned int expand_quadrant1 (unsigned int half, unsigned int bias) {
+    unsigned int rd = bits(half, 11, 7);
+    unsigned int rd_short = short_reg(bits(half, 9, 7));
+    unsigned int rs2_short = short_reg(bits(half, 4, 2));
+    switch (bits(half, 15, 13)) {
+        case 0b000:
+            // C.ADDI, C.NOP
+            return encode_i(ci_imm(half), rd, 0b000, rd, OPCODE_IMM);
+        case 0b001:
+            // C.JAL
+            return encode_j(cj_offset(half) + bias, REG_RA);
+        case 0b010:
+            // C.LI
+            return encode_i(ci_imm(half), 0, 0b000, rd, OPCODE_IMM);
+        case 0b011:
+            if (rd == REG_SP) {
+                // C.ADDI16SP
+                unsigned int imm = bits(half, 12, 12) << 9u | bits(half, 6, 6) << 4u | bits(half, 5, 5) << 6u
+                                   | bits(half, 4, 3) << 7u | bits(half, 2, 2) << 5u;
+                return imm != 0 ? encode_i(sign_extend(imm, 10), REG_SP, 0b000, REG_SP, OPCODE_IMM) : ILLEGAL;
+            } else {
+                // C.LUI
+                unsigned int imm = ci_imm(half);
+                return imm != 0 ? (imm << 12u) | rd << 7u | OPCODE_LUI : ILLEGAL;
+            }
+        case 0b100:
+            switch (bits(half, 11, 10)) {
+                case 0b00:
+                    // C.SRLI, shift amounts above 31 are reserved in RV32C
+                    return bits(half, 12, 12) == 0 ? encode_i(bits(half, 6, 2), rd_short, 0b101, rd_short, OPCODE_IMM)
+                                                   : ILLEGAL;
+                case 0b01:
+                    // C.SRAI
+                    return bits(half, 12, 12) == 0
+                           ? encode_i(0x400u | bits(half, 6, 2), rd_short, 0b101, rd_short, OPCODE_IMM) : ILLEGAL;
+                case 0b10:
+                    // C.ANDI
+                    return encode_i(ci_imm(half), rd_short, 0b111, rd_short, OPCODE_IMM);
+                default:
+                    if (bits(half, 12, 12) != 0) {
+                        // C.SUBW and C.ADDW are RV64C only
+                        return ILLEGAL;
+                    }
+                    switch (bits(half, 6, 5)) {
+                        case 0b00:
+                            // C.SUB
+                            return encode_r(0b0100000, rs2_short, rd_short, 0b000, rd_short, OPCODE_REG);
+                        case 0b01:
+                            // C.XOR
+                            return encode_r(0, rs2_short, rd_short, 0b100, rd_short, OPCODE_REG);
+                        case 0b10:
+                            // C.OR
+                            return encode_r(0, rs2_short, rd_short, 0b110, rd_short, OPCODE_REG);
+                        default:
+                            // C.AND
+                            return encode_r(0, rs2_short, rd_short, 0b111, rd_short, OPCODE_REG);
+                    }
+            }
+        case 0b101:
+            // C.J
+            return encode_j(cj_offset(half) + bias, 0);
+        case 0b110:
+            // C.BEQZ
+            return encode_b(cb_offset(half) + bias, 0, rd_short, 0b000);
+        default:
+            // C.BNEZ
+            return encode_b(cb_offset(half) + bias, 0, rd_short, 0b001);
+    }
+}
+
+/**
+ * Expands quadrant 2: accesses relative to the stack pointer, register moves and jumps
+ * @param half  compressed instruction
+ * @return      equivalent 32-bit instruction
+ */
+static unsigned int expand_quadrant2 (unsigned int half) {
+    unsigned int rd = bits(half, 11, 7);
+    unsigned int rs2 = bits(half, 6, 2);
+    switch (bits(half, 15, 13)) {
+        case 0b000:
+            // C.SLLI
+            return bits(half, 12, 12) == 0 ? encode_i(rs2, rd, 0b001, rd, OPCODE_IMM) : ILLEGAL;
+        case 0b001:
+            // C.FLDSP
+            return encode_i(bits(half, 12, 12) << 5u | bits(half, 6, 5) << 3u | bits(half, 4, 2) << 6u,
+                            REG_SP, 0b011, rd, OPCODE_FLOAT_LOAD);
+        case 0b010:
+            // C.LWSP, loading into x0 is reserved
+            return rd != 0 ? encode_i(bits(half, 12, 12) << 5u | bits(half, 6, 4) << 2u | bits(half, 3, 2) << 6u,
+                                      REG_SP, 0b010, rd, OPCODE_LOAD) : ILLEGAL;
+        case 0b011:
+            // C.FLWSP
+            return encode_i(bits(half, 12, 12) << 5u | bits(half, 6, 4) << 2u | bits(half, 3, 2) << 6u,
+                            REG_SP, 0b010, rd, OPCODE_FLOAT_LOAD);
+        case 0b100:
+            if (bits(half, 12, 12) == 0) {
+                if (rs2 == 0) {
+                    // C.JR
+                    return rd != 0 ? encode_i(0, rd, 0b000, 0, OPCODE_JALR) : ILLEGAL;
+                }
+                // C.MV
+                return encode_r(0, rs2, 0, 0b000, rd, OPCODE_REG);
+            }
+            if (rs2 == 0) {
+                // C.EBREAK and C.JALR
+                return rd == 0 ? encode_i(1, 0, 0b000, 0, OPCODE_SYSTEM) : encode_i(0, rd, 0b000, REG_RA, OPCODE_JALR);
+            }
+            // C.ADD
+            return encode_r(0, rs2, rd, 0b000, rd, OPCODE_REG);
+        case 0b101:
+            // C.FSDSP
+            return encode_s(bits(half, 12, 10) << 3u | bits(half, 9, 7) << 6u, rs2, REG_SP, 0b011, OPCODE_FLOAT_STORE);
+        case 0b110:
+            // C.SWSP
+            return encode_s(bits(half, 12, 9) << 2u | bits(half, 8, 7) << 6u, rs2, REG_SP, 0b010, OPCODE_STORE);
+        default:
+            // C.FSWSP
+            return encode_s(bits(half, 12, 9) << 2u | bits(half, 8, 7) << 6u, rs2, REG_SP, 0b010, OPCODE_FLOAT_STORE);
+    }
+}
+
+/**
+ * Expands a compressed instruction into the 32-bit instruction it stands for
+ * @param half  compressed instruction in the lower 16 bits
+ * @param bias  added to the offsets of jumps and branches, for an expansion
+ *              executed at a lower address than the compressed instruction
+ * @return      equivalent 32-bit instruction, 0 for illegal and reserved encodings
+ */
+unsigned int CompressedExpander::expand (unsigned int half, unsigned int bias) {
+    half &= 0xFFFFu;
+    switch (half & 0b11u) {
+        case 0b00:
+            return expand_quadrant0(half);
+        case 0b01:
+            return expand_quadrant1(half, bias);
+        case 0b10:
+            return expand_quadrant2(half);
+        default:
+            return ILLEGAL;
+    }
+}
@@ -0,0 +1,25 @@
+// compressed_expander.h
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#ifndef ISA_SIM_CPP_COMPRESSED_EXPANDER_H
+#define ISA_SIM_CPP_COMPRESSED_EXPANDER_H
+
+/**
+ * Expansion of 16-bit instructions of the C extension (RV32C with the RV32FC
+ * and RV32DC loads and stores) into the 32-bit instructions they stand for.
+ * The instruction memory holds the expansions, so the decoders execute
+ * compressed code by the same paths as uncompressed one.
+ */
+class CompressedExpander {
+public:
+    /**
+     * @param half  lowest halfword of an instruction
+     * @return      true if the instruction is 16 bits long
+     */
+    static bool compressed (unsigned int half) { return (half & 0b11u) != 0b11u; }
+    static unsigned int expand (unsigned int half, unsigned int bias = 0);
+};
+
+
+#endif //ISA_SIM_CPP_COMPRESSED_EXPANDER_H
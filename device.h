@@ -0,0 +1,35 @@
+// device.h
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#ifndef ISA_SIM_CPP_DEVICE_H
+#define ISA_SIM_CPP_DEVICE_H
+
+#include <istream>
+#include <ostream>
+
+/**
+ * Interface for memory-mapped devices. Loads and stores to the pages of a device
+ * are passed to it with the offset from its base address.
+ */
+class Device {
+public:
+    virtual ~Device () = default;
+    virtual unsigned int read (unsigned int offset, unsigned int length) = 0;
+    virtual void write (unsigned int offset, unsigned int data, unsigned int length) = 0;
+    /**
+     * Passes buffered output to the host, called at the end of simulation
+     */
+    virtual void flush () {}
+    /**
+     * Writes the registers of the device into a snapshot of the machine
+     */
+    virtual void save (std::ostream &) const {}
+    /**
+     * Reads the registers of the device from a snapshot of the machine
+     */
+    virtual void restore (std::istream &) {}
+};
+
+
+#endif //ISA_SIM_CPP_DEVICE_H
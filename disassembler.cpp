@@ -0,0 +1,481 @@
+// disassembler.cpp
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#include <cstring>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include "disassembler.h"
+#include "instruction_decoder.h"
+#include "compressed_expander.h"
+
+#define MASK_OPCODE     0x0000007Fu
+#define MASK_FUNCT3     0x0000707Fu
+#define MASK_FUNCT7     0xFE00707Fu
+#define MASK_UNARY      0xFFF0707Fu
+#define MASK_ALL        0xFFFFFFFFu
+#define MASK_FMA        0x0600007Fu
+#define MASK_FP         0xFE00007Fu
+#define MASK_FP_RS2     0xFFF0007Fu
+#define MASK_FP_FUNCT3  0xFE00707Fu
+#define MASK_FP_ALL     0xFFF0707Fu
+#define MASK_AMO        0xF800707Fu
+#define MASK_LR         0xF9F0707Fu
+#define MASK_OPV        0xFC00707Fu
+#define MASK_VSETVLI    0x8000707Fu
+#define MASK_VSETIVLI   0xC000707Fu
+#define MASK_V_UNIT     0xFDF0707Fu
+#define MASK_V_VS1      0xFC0FF07Fu
+
+static const disasm_entry_t disasm_table[] = {
+        // RV32I register-register
+        {MASK_FUNCT7, 0x00000033, "add",    FMT_R},
+        {MASK_FUNCT7, 0x40000033, "sub",    FMT_R},
+        {MASK_FUNCT7, 0x00001033, "sll",    FMT_R},
+        {MASK_FUNCT7, 0x00002033, "slt",    FMT_R},
+        {MASK_FUNCT7, 0x00003033, "sltu",   FMT_R},
+        {MASK_FUNCT7, 0x00004033, "xor",    FMT_R},
+        {MASK_FUNCT7, 0x00005033, "srl",    FMT_R},
+        {MASK_FUNCT7, 0x40005033, "sra",    FMT_R},
+        {MASK_FUNCT7, 0x00006033, "or",     FMT_R},
+        {MASK_FUNCT7, 0x00007033, "and",    FMT_R},
+        // RV32M
+        {MASK_FUNCT7, 0x02000033, "mul",    FMT_R},
+        {MASK_FUNCT7, 0x02001033, "mulh",   FMT_R},
+        {MASK_FUNCT7, 0x02002033, "mulhsu", FMT_R},
+        {MASK_FUNCT7, 0x02003033, "mulhu",  FMT_R},
+        {MASK_FUNCT7, 0x02004033, "div",    FMT_R},
+        {MASK_FUNCT7, 0x02005033, "divu",   FMT_R},
+        {MASK_FUNCT7, 0x02006033, "rem",    FMT_R},
+        {MASK_FUNCT7, 0x02007033, "remu",   FMT_R},
+        // Zba and Zbb register-register
+        {MASK_FUNCT7, 0x20002033, "sh1add", FMT_R},
+        {MASK_FUNCT7, 0x20004033, "sh2add", FMT_R},
+        {MASK_FUNCT7, 0x20006033, "sh3add", FMT_R},
+        {MASK_FUNCT7, 0x40007033, "andn",   FMT_R},
+        {MASK_FUNCT7, 0x40006033, "orn",    FMT_R},
+        {MASK_FUNCT7, 0x40004033, "xnor",   FMT_R},
+        {MASK_FUNCT7, 0x0A004033, "min",    FMT_R},
+        {MASK_FUNCT7, 0x0A005033, "minu",   FMT_R},
+        {MASK_FUNCT7, 0x0A006033, "max",    FMT_R},
+        {MASK_FUNCT7, 0x0A007033, "maxu",   FMT_R},
+        {MASK_FUNCT7, 0x60001033, "rol",    FMT_R},
+        {MASK_FUNCT7, 0x60005033, "ror",    FMT_R},
+        {MASK_UNARY,  0x08004033, "zext.h", FMT_UNARY},
+        // RV32I register-immediate
+        {MASK_FUNCT3, 0x00000013, "addi",   FMT_I},
+        {MASK_FUNCT3, 0x00002013, "slti",   FMT_I},
+        {MASK_FUNCT3, 0x00003013, "sltiu",  FMT_I},
+        {MASK_FUNCT3, 0x00004013, "xori",   FMT_I},
+        {MASK_FUNCT3, 0x00006013, "ori",    FMT_I},
+        {MASK_FUNCT3, 0x00007013, "andi",   FMT_I},
+        {MASK_FUNCT7, 0x00001013, "slli",   FMT_SHIFT},
+        {MASK_FUNCT7, 0x00005013, "srli",   FMT_SHIFT},
+        {MASK_FUNCT7, 0x40005013, "srai",   FMT_SHIFT},
+        // Zbb register-immediate
+        {MASK_UNARY,  0x60001013, "clz",    FMT_UNARY},
+        {MASK_UNARY,  0x60101013, "ctz",    FMT_UNARY},
+        {MASK_UNARY,  0x60201013, "cpop",   FMT_UNARY},
+        {MASK_UNARY,  0x60401013, "sext.b", FMT_UNARY},
+        {MASK_UNARY,  0x60501013, "sext.h", FMT_UNARY},
+        {MASK_FUNCT7, 0x60005013, "rori",   FMT_SHIFT},
+        {MASK_UNARY,  0x28705013, "orc.b",  FMT_UNARY},
+        {MASK_UNARY,  0x69805013, "rev8",   FMT_UNARY},
+        // loads and stores
+        {MASK_FUNCT3, 0x00000003, "lb",     FMT_LOAD},
+        {MASK_FUNCT3, 0x00001003, "lh",     FMT_LOAD},
+        {MASK_FUNCT3, 0x00002003, "lw",     FMT_LOAD},
+        {MASK_FUNCT3, 0x00004003, "lbu",    FMT_LOAD},
+        {MASK_FUNCT3, 0x00005003, "lhu",    FMT_LOAD},
+        {MASK_FUNCT3, 0x00000023, "sb",     FMT_STORE},
+        {MASK_FUNCT3, 0x00001023, "sh",     FMT_STORE},
+        {MASK_FUNCT3, 0x00002023, "sw",     FMT_STORE},
+        // control transfer
+        {MASK_FUNCT3, 0x00000063, "beq",    FMT_BRANCH},
+        {MASK_FUNCT3, 0x00001063, "bne",    FMT_BRANCH},
+        {MASK_FUNCT3, 0x00004063, "blt",    FMT_BRANCH},
+        {MASK_FUNCT3, 0x00005063, "bge",    FMT_BRANCH},
+        {MASK_FUNCT3, 0x00006063, "bltu",   FMT_BRANCH},
+        {MASK_FUNCT3, 0x00007063, "bgeu",   FMT_BRANCH},
+        {MASK_OPCODE, 0x00000037, "lui",    FMT_U},
+        {MASK_OPCODE, 0x00000017, "auipc",  FMT_U},
+        {MASK_OPCODE, 0x0000006F, "jal",    FMT_J},
+        {MASK_FUNCT3, 0x00000067, "jalr",   FMT_I},
+        // system
+        {MASK_ALL,    0x00000073, "ecall",  FMT_NONE},
+        {MASK_ALL,    0x30200073, "mret",   FMT_NONE},
+        {MASK_ALL,    0x10500073, "wfi",    FMT_NONE},
+        {MASK_FUNCT3, 0x00001073, "csrrw",  FMT_CSR},
+        {MASK_FUNCT3, 0x00002073, "csrrs",  FMT_CSR},
+        {MASK_FUNCT3, 0x00003073, "csrrc",  FMT_CSR},
+        {MASK_FUNCT3, 0x00005073, "csrrwi", FMT_CSRI},
+        {MASK_FUNCT3, 0x00006073, "csrrsi", FMT_CSRI},
+        {MASK_FUNCT3, 0x00007073, "csrrci", FMT_CSRI},
+        {MASK_FUNCT3, 0x0000000F, "fence",  FMT_FENCE},
+        {MASK_FUNCT3, 0x0000100F, "fence.i", FMT_NONE},
+        // RV32A
+        {MASK_LR,     0x1000202F, "lr.w",      FMT_LR},
+        {MASK_AMO,    0x1800202F, "sc.w",      FMT_AMO},
+        {MASK_AMO,    0x0800202F, "amoswap.w", FMT_AMO},
+        {MASK_AMO,    0x0000202F, "amoadd.w",  FMT_AMO},
+        {MASK_AMO,    0x2000202F, "amoxor.w",  FMT_AMO},
+        {MASK_AMO,    0x6000202F, "amoand.w",  FMT_AMO},
+        {MASK_AMO,    0x4000202F, "amoor.w",   FMT_AMO},
+        {MASK_AMO,    0x8000202F, "amomin.w",  FMT_AMO},
+        {MASK_AMO,    0xA000202F, "amomax.w",  FMT_AMO},
+        {MASK_AMO,    0xC000202F, "amominu.w", FMT_AMO},
+        {MASK_AMO,    0xE000202F, "amomaxu.w", FMT_AMO},
+        // RV32F and RV32D
+        {MASK_FUNCT3,    0x00002007, "flw",       FMT_FLOAD},
+        {MASK_FUNCT3,    0x00003007, "fld",       FMT_FLOAD},
+        {MASK_FUNCT3,    0x00002027, "fsw",       FMT_FSTORE},
+        {MASK_FUNCT3,    0x00003027, "fsd",       FMT_FSTORE},
+        {MASK_FMA,       0x00000043, "fmadd.s",   FMT_FR4},
+        {MASK_FMA,       0x02000043, "fmadd.d",   FMT_FR4},
+        {MASK_FMA,       0x00000047, "fmsub.s",   FMT_FR4},
+        {MASK_FMA,       0x02000047, "fmsub.d",   FMT_FR4},
+        {MASK_FMA,       0x0000004B, "fnmsub.s",  FMT_FR4},
+        {MASK_FMA,       0x0200004B, "fnmsub.d",  FMT_FR4},
+        {MASK_FMA,       0x0000004F, "fnmadd.s",  FMT_FR4},
+        {MASK_FMA,       0x0200004F, "fnmadd.d",  FMT_FR4},
+        {MASK_FP,        0x00000053, "fadd.s",    FMT_FR},
+        {MASK_FP,        0x02000053, "fadd.d",    FMT_FR},
+        {MASK_FP,        0x08000053, "fsub.s",    FMT_FR},
+        {MASK_FP,        0x0A000053, "fsub.d",    FMT_FR},
+        {MASK_FP,        0x10000053, "fmul.s",    FMT_FR},
+        {MASK_FP,        0x12000053, "fmul.d",    FMT_FR},
+        {MASK_FP,        0x18000053, "fdiv.s",    FMT_FR},
+        {MASK_FP,        0x1A000053, "fdiv.d",    FMT_FR},
+        {MASK_FP_RS2,    0x58000053, "fsqrt.s",   FMT_FR1},
+        {MASK_FP_RS2,    0x5A000053, "fsqrt.d",   FMT_FR1},
+        {MASK_FP_FUNCT3, 0x20000053, "fsgnj.s",   FMT_FR},
+        {MASK_FP_FUNCT3, 0x20001053, "fsgnjn.s",  FMT_FR},
+        {MASK_FP_FUNCT3, 0x20002053, "fsgnjx.s",  FMT_FR},
+        {MASK_FP_FUNCT3, 0x22000053, "fsgnj.d",   FMT_FR},
+        {MASK_FP_FUNCT3, 0x22001053, "fsgnjn.d",  FMT_FR},
+        {MASK_FP_FUNCT3, 0x22002053, "fsgnjx.d",  FMT_FR},
+        {MASK_FP_FUNCT3, 0x28000053, "fmin.s",    FMT_FR},
+        {MASK_FP_FUNCT3, 0x28001053, "fmax.s",    FMT_FR},
+        {MASK_FP_FUNCT3, 0x2A000053, "fmin.d",    FMT_FR},
+        {MASK_FP_FUNCT3, 0x2A001053, "fmax.d",    FMT_FR},
+        {MASK_FP_RS2,    0x40100053, "fcvt.s.d",  FMT_FR1},
+        {MASK_FP_RS2,    0x42000053, "fcvt.d.s",  FMT_FR1},
+        {MASK_FP_FUNCT3, 0xA0002053, "feq.s",     FMT_FCMP},
+        {MASK_FP_FUNCT3, 0xA0001053, "flt.s",     FMT_FCMP},
+        {MASK_FP_FUNCT3, 0xA0000053, "fle.s",     FMT_FCMP},
+        {MASK_FP_FUNCT3, 0xA2002053, "feq.d",     FMT_FCMP},
+        {MASK_FP_FUNCT3, 0xA2001053, "flt.d",     FMT_FCMP},
+        {MASK_FP_FUNCT3, 0xA2000053, "fle.d",     FMT_FCMP},
+        {MASK_FP_RS2,    0xC0000053, "fcvt.w.s",  FMT_F2X},
+        {MASK_FP_RS2,    0xC0100053, "fcvt.wu.s", FMT_F2X},
+        {MASK_FP_RS2,    0xC2000053, "fcvt.w.d",  FMT_F2X},
+        {MASK_FP_RS2,    0xC2100053, "fcvt.wu.d", FMT_F2X},
+        {MASK_FP_RS2,    0xD0000053, "fcvt.s.w",  FMT_X2F},
+        {MASK_FP_RS2,    0xD0100053, "fcvt.s.wu", FMT_X2F},
+        {MASK_FP_RS2,    0xD2000053, "fcvt.d.w",  FMT_X2F},
+        {MASK_FP_RS2,    0xD2100053, "fcvt.d.wu", FMT_X2F},
+        {MASK_FP_ALL,    0xE0000053, "fmv.x.w",   FMT_F2X},
+        {MASK_FP_ALL,    0xE0001053, "fclass.s",  FMT_F2X},
+        {MASK_FP_ALL,    0xE2001053, "fclass.d",  FMT_F2X},
+        {MASK_FP_ALL,    0xF0000053, "fmv.w.x",   FMT_X2F},
+        // V extension configuration
+        {MASK_VSETVLI,   0x00007057, "vsetvli",     FMT_VSETVLI},
+        {MASK_VSETIVLI,  0xC0007057, "vsetivli",    FMT_VSETIVLI},
+        {MASK_FUNCT7,    0x80007057, "vsetvl",      FMT_R},
+        // V extension loads and stores
+        {MASK_V_UNIT,    0x00000007, "vle8.v",      FMT_VLOAD},
+        {MASK_V_UNIT,    0x00005007, "vle16.v",     FMT_VLOAD},
+        {MASK_V_UNIT,    0x00006007, "vle32.v",     FMT_VLOAD},
+        {MASK_OPV,       0x08000007, "vlse8.v",     FMT_VLOAD_STRIDE},
+        {MASK_OPV,       0x08005007, "vlse16.v",    FMT_VLOAD_STRIDE},
+        {MASK_OPV,       0x08006007, "vlse32.v",    FMT_VLOAD_STRIDE},
+        {MASK_UNARY,     0x02B00007, "vlm.v",       FMT_VLOAD},
+        {MASK_V_UNIT,    0x00000027, "vse8.v",      FMT_VLOAD},
+        {MASK_V_UNIT,    0x00005027, "vse16.v",     FMT_VLOAD},
+        {MASK_V_UNIT,    0x00006027, "vse32.v",     FMT_VLOAD},
+        {MASK_OPV,       0x08000027, "vsse8.v",     FMT_VLOAD_STRIDE},
+        {MASK_OPV,       0x08005027, "vsse16.v",    FMT_VLOAD_STRIDE},
+        {MASK_OPV,       0x08006027, "vsse32.v",    FMT_VLOAD_STRIDE},
+        {MASK_UNARY,     0x02B00027, "vsm.v",       FMT_VLOAD},
+        // V extension integer arithmetic
+        {MASK_UNARY,     0x5E000057, "vmv.v.v",     FMT_VMV_V},
+        {MASK_UNARY,     0x5E004057, "vmv.v.x",     FMT_VMV_X},
+        {MASK_UNARY,     0x5E003057, "vmv.v.i",     FMT_VMV_I},
+        {MASK_FUNCT7,    0x5C000057, "vmerge.vvm",  FMT_VV},
+        {MASK_FUNCT7,    0x5C004057, "vmerge.vxm",  FMT_VX},
+        {MASK_FUNCT7,    0x5C003057, "vmerge.vim",  FMT_VI},
+        {MASK_OPV,       0x00000057, "vadd.vv",     FMT_VV},
+        {MASK_OPV,       0x00004057, "vadd.vx",     FMT_VX},
+        {MASK_OPV,       0x00003057, "vadd.vi",     FMT_VI},
+        {MASK_OPV,       0x08000057, "vsub.vv",     FMT_VV},
+        {MASK_OPV,       0x08004057, "vsub.vx",     FMT_VX},
+        {MASK_OPV,       0x0C004057, "vrsub.vx",    FMT_VX},
+        {MASK_OPV,       0x0C003057, "vrsub.vi",    FMT_VI},
+        {MASK_OPV,       0x10000057, "vminu.vv",    FMT_VV},
+        {MASK_OPV,       0x10004057, "vminu.vx",    FMT_VX},
+        {MASK_OPV,       0x14000057, "vmin.vv",     FMT_VV},
+        {MASK_OPV,       0x14004057, "vmin.vx",     FMT_VX},
+        {MASK_OPV,       0x18000057, "vmaxu.vv",    FMT_VV},
+        {MASK_OPV,       0x18004057, "vmaxu.vx",    FMT_VX},
+        {MASK_OPV,       0x1C000057, "vmax.vv",     FMT_VV},
+        {MASK_OPV,       0x1C004057, "vmax.vx",     FMT_VX},
+        {MASK_OPV,       0x24000057, "vand.vv",     FMT_VV},
+        {MASK_OPV,       0x24004057, "vand.vx",     FMT_VX},
+        {MASK_OPV,       0x24003057, "vand.vi",     FMT_VI},
+        {MASK_OPV,       0x28000057, "vor.vv",      FMT_VV},
+        {MASK_OPV,       0x28004057, "vor.vx",      FMT_VX},
+        {MASK_OPV,       0x28003057, "vor.vi",      FMT_VI},
+        {MASK_OPV,       0x2C000057, "vxor.vv",     FMT_VV},
+        {MASK_OPV,       0x2C004057, "vxor.vx",     FMT_VX},
+        {MASK_OPV,       0x2C003057, "vxor.vi",     FMT_VI},
+        {MASK_OPV,       0x60000057, "vmseq.vv",    FMT_VV},
+        {MASK_OPV,       0x60004057, "vmseq.vx",    FMT_VX},
+        {MASK_OPV,       0x60003057, "vmseq.vi",    FMT_VI},
+        {MASK_OPV,       0x64000057, "vmsne.vv",    FMT_VV},
+        {MASK_OPV,       0x64004057, "vmsne.vx",    FMT_VX},
+        {MASK_OPV,       0x64003057, "vmsne.vi",    FMT_VI},
+        {MASK_OPV,       0x68000057, "vmsltu.vv",   FMT_VV},
+        {MASK_OPV,       0x68004057, "vmsltu.vx",   FMT_VX},
+        {MASK_OPV,       0x6C000057, "vmslt.vv",    FMT_VV},
+        {MASK_OPV,       0x6C004057, "vmslt.vx",    FMT_VX},
+        {MASK_OPV,       0x70000057, "vmsleu.vv",   FMT_VV},
+        {MASK_OPV,       0x70004057, "vmsleu.vx",   FMT_VX},
+        {MASK_OPV,       0x70003057, "vmsleu.vi",   FMT_VI},
+        {MASK_OPV,       0x74000057, "vmsle.vv",    FMT_VV},
+        {MASK_OPV,       0x74004057, "vmsle.vx",    FMT_VX},
+        {MASK_OPV,       0x74003057, "vmsle.vi",    FMT_VI},
+        {MASK_OPV,       0x78004057, "vmsgtu.vx",   FMT_VX},
+        {MASK_OPV,       0x78003057, "vmsgtu.vi",   FMT_VI},
+        {MASK_OPV,       0x7C004057, "vmsgt.vx",    FMT_VX},
+        {MASK_OPV,       0x7C003057, "vmsgt.vi",    FMT_VI},
+        {MASK_OPV,       0x94000057, "vsll.vv",     FMT_VV},
+        {MASK_OPV,       0x94004057, "vsll.vx",     FMT_VX},
+        {MASK_OPV,       0x94003057, "vsll.vi",     FMT_VUI},
+        {MASK_OPV,       0xA0000057, "vsrl.vv",     FMT_VV},
+        {MASK_OPV,       0xA0004057, "vsrl.vx",     FMT_VX},
+        {MASK_OPV,       0xA0003057, "vsrl.vi",     FMT_VUI},
+        {MASK_OPV,       0xA4000057, "vsra.vv",     FMT_VV},
+        {MASK_OPV,       0xA4004057, "vsra.vx",     FMT_VX},
+        {MASK_OPV,       0xA4003057, "vsra.vi",     FMT_VUI},
+        // V extension multiply, reduction, mask and move
+        {MASK_OPV,       0x90002057, "vmulhu.vv",   FMT_VV},
+        {MASK_OPV,       0x90006057, "vmulhu.vx",   FMT_VX},
+        {MASK_OPV,       0x94002057, "vmul.vv",     FMT_VV},
+        {MASK_OPV,       0x94006057, "vmul.vx",     FMT_VX},
+        {MASK_OPV,       0x98002057, "vmulhsu.vv",  FMT_VV},
+        {MASK_OPV,       0x98006057, "vmulhsu.vx",  FMT_VX},
+        {MASK_OPV,       0x9C002057, "vmulh.vv",    FMT_VV},
+        {MASK_OPV,       0x9C006057, "vmulh.vx",    FMT_VX},
+        {MASK_OPV,       0x00002057, "vredsum.vs",  FMT_VV},
+        {MASK_OPV,       0x04002057, "vredand.vs",  FMT_VV},
+        {MASK_OPV,       0x08002057, "vredor.vs",   FMT_VV},
+        {MASK_OPV,       0x0C002057, "vredxor.vs",  FMT_VV},
+        {MASK_OPV,       0x10002057, "vredminu.vs", FMT_VV},
+        {MASK_OPV,       0x14002057, "vredmin.vs",  FMT_VV},
+        {MASK_OPV,       0x18002057, "vredmaxu.vs", FMT_VV},
+        {MASK_OPV,       0x1C002057, "vredmax.vs",  FMT_VV},
+        {MASK_OPV,       0x60002057, "vmandn.mm",   FMT_VV},
+        {MASK_OPV,       0x64002057, "vmand.mm",    FMT_VV},
+        {MASK_OPV,       0x68002057, "vmor.mm",     FMT_VV},
+        {MASK_OPV,       0x6C002057, "vmxor.mm",    FMT_VV},
+        {MASK_OPV,       0x70002057, "vmorn.mm",    FMT_VV},
+        {MASK_OPV,       0x74002057, "vmnand.mm",   FMT_VV},
+        {MASK_OPV,       0x78002057, "vmnor.mm",    FMT_VV},
+        {MASK_OPV,       0x7C002057, "vmxnor.mm",   FMT_VV},
+        {MASK_V_VS1,     0x40002057, "vmv.x.s",     FMT_VMV_XS},
+        {MASK_V_VS1,     0x40082057, "vcpop.m",     FMT_VMV_XS},
+        {MASK_V_UNIT,    0x40006057, "vmv.s.x",     FMT_VMV_X},
+};
+
+/**
+ * Finds the table entry describing the instruction
+ * @param inst  raw instruction
+ * @return      table entry or nullptr if the instruction is unknown
+ */
+const disasm_entry_t *Disassembler::lookup (unsigned int inst) {
+    for (const disasm_entry_t &entry : disasm_table) {
+        if ((inst & entry.mask) == entry.match) {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * Formats predecessor or successor set of fence instruction
+ * @param bits  set in the lowest 4 bits
+ * @return      set as combination of i, o, r and w
+ */
+std::string Disassembler::fence_set (unsigned int bits) {
+    std::string set;
+    const char *names = "iorw";
+    for (unsigned int i = 0; i < 4; i++) {
+        if (bits & (0x8u >> i)) {
+            set += names[i];
+        }
+    }
+    return set.empty() ? "0" : set;
+}
+
+/**
+ * Formats vtype immediate of vsetvli and vsetivli
+ * @param zimm  vtype immediate
+ * @return      vtype as e<sew>, m<lmul>, ta/tu, ma/mu
+ */
+std::string Disassembler::vtype (unsigned int zimm) {
+    static const char *lmul[] = {"m1", "m2", "m4", "m8", "reserved", "mf8", "mf4", "mf2"};
+    return "e" + std::to_string(8u << ((zimm >> 3u) & 0x7u)) + ", " + lmul[zimm & 0x7u] +
+           ((zimm & 0x40u) ? ", ta" : ", tu") + ((zimm & 0x80u) ? ", ma" : ", mu");
+}
+
+/**
+ * Converts raw instruction into its assembly representation
+ * @param inst  raw instruction
+ * @return      assembly representation of the instruction
+ */
+std::string Disassembler::disassemble (unsigned int inst) {
+    const disasm_entry_t *entry = lookup(inst);
+    if (entry == nullptr) {
+        std::stringstream ss;
+        ss << "unknown 0x" << std::setfill('0') << std::setw(8) << std::hex << inst;
+        return ss.str();
+    }
+
+    r_inst_t r{};
+    s_inst_t s{};
+    b_inst_t b{};
+    u_inst_t u{};
+    j_inst_t j{};
+    r.inst = s.inst = b.inst = u.inst = j.inst = inst;
+
+    std::string rd = "x" + std::to_string(r.f.rd);
+    std::string rs1 = "x" + std::to_string(r.f.rs1);
+    std::string rs2 = "x" + std::to_string(r.f.rs2);
+    std::string fd = "f" + std::to_string(r.f.rd);
+    std::string fs1 = "f" + std::to_string(r.f.rs1);
+    std::string fs2 = "f" + std::to_string(r.f.rs2);
+    std::string fs3 = "f" + std::to_string(inst >> 27u);
+    std::string vd = "v" + std::to_string(r.f.rd);
+    std::string vs1 = "v" + std::to_string(r.f.rs1);
+    std::string vs2 = "v" + std::to_string(r.f.rs2);
+    // vm = 0 selects v0 as mask, merges (.vvm, .vxm, .vim) name it as a plain operand
+    std::string vm;
+    if (!(inst & 0x02000000u)) {
+        size_t length = strlen(entry->name);
+        vm = entry->name[length - 1] == 'm' && entry->name[length - 2] != '.' ? ", v0" : ", v0.t";
+    }
+    // acquire and release bits of atomic instructions
+    std::string aq_rl = (inst & 0x04000000u) ? ((inst & 0x02000000u) ? ".aqrl" : ".aq")
+                                             : ((inst & 0x02000000u) ? ".rl" : "");
+    // 5-bit vector immediate is sign-extended
+    int v_imm = int(r.f.rs1 << 27u) >> 27;
+    // I-type immediate is sign-extended by the arithmetic shift
+    int i_imm = int(inst) >> 20;
+    int s_imm = int(s.f.imm4_0 | (s.f.imm5_11 << 5u) | (s.f.imm5_11 & 0x40u ? 0xFFFFF000u : 0u));
+    int b_imm = int((b.f.imm4_1 << 1u) | (b.f.imm5_10 << 5u) | (b.f.imm11 << 11u) |
+                    (b.f.imm12 ? 0xFFFFF000u : 0u));
+    int u_imm = int(u.f.imm31_12 << 12u);
+    int j_imm = int((j.f.imm10_1 << 1u) | (j.f.imm11 << 11u) | (j.f.imm19_12 << 12u) |
+                    (j.f.imm20 ? 0xFFF00000u : 0u));
+
+    std::string name = entry->name;
+    switch (entry->format) {
+        case FMT_R:
+            return name + " " + rd + ", " + rs1 + ", " + rs2;
+        case FMT_I:
+            return name + " " + rd + ", " + rs1 + ", " + std::to_string(i_imm);
+        case FMT_SHIFT:
+            return name + " " + rd + ", " + rs1 + ", " + std::to_string(r.f.rs2);
+        case FMT_UNARY:
+            return name + " " + rd + ", " + rs1;
+        case FMT_LOAD:
+            return name + " " + rd + ", " + std::to_string(i_imm) + "(" + rs1 + ")";
+        case FMT_STORE:
+            return name + " " + rs2 + ", " + std::to_string(s_imm) + "(" + rs1 + ")";
+        case FMT_BRANCH:
+            return name + " " + rs1 + ", " + rs2 + ", " + std::to_string(b_imm);
+        case FMT_U:
+            return name + " " + rd + ", " + std::to_string(u_imm);
+        case FMT_J:
+            return name + " " + rd + ", " + std::to_string(j_imm);
+        case FMT_FLOAD:
+            return name + " " + fd + ", " + std::to_string(i_imm) + "(" + rs1 + ")";
+        case FMT_FSTORE:
+            return name + " " + fs2 + ", " + std::to_string(s_imm) + "(" + rs1 + ")";
+        case FMT_FR:
+            return name + " " + fd + ", " + fs1 + ", " + fs2;
+        case FMT_FR4:
+            return name + " " + fd + ", " + fs1 + ", " + fs2 + ", " + fs3;
+        case FMT_FR1:
+            return name + " " + fd + ", " + fs1;
+        case FMT_FCMP:
+            return name + " " + rd + ", " + fs1 + ", " + fs2;
+        case FMT_F2X:
+            return name + " " + rd + ", " + fs1;
+        case FMT_X2F:
+            return name + " " + fd + ", " + rs1;
+        case FMT_CSR:
+            return name + " " + rd + ", " + std::to_string(inst >> 20u) + ", " + rs1;
+        case FMT_CSRI:
+            return name + " " + rd + ", " + std::to_string(inst >> 20u) + ", " + std::to_string(r.f.rs1);
+        case FMT_FENCE:
+            return name + " " + fence_set(inst >> 24u) + ", " + fence_set(inst >> 20u);
+        case FMT_LR:
+            return name + aq_rl + " " + rd + ", (" + rs1 + ")";
+        case FMT_AMO:
+            return name + aq_rl + " " + rd + ", " + rs2 + ", (" + rs1 + ")";
+        case FMT_VSETVLI:
+            return name + " " + rd + ", " + rs1 + ", " + vtype((inst >> 20u) & 0x7FFu);
+        case FMT_VSETIVLI:
+            return name + " " + rd + ", " + std::to_string(r.f.rs1) + ", " + vtype((inst >> 20u) & 0x3FFu);
+        case FMT_VLOAD:
+            return name + " " + vd + ", (" + rs1 + ")" + vm;
+        case FMT_VLOAD_STRIDE:
+            return name + " " + vd + ", (" + rs1 + "), " + rs2 + vm;
+        case FMT_VV:
+            return name + " " + vd + ", " + vs2 + ", " + vs1 + vm;
+        case FMT_VX:
+            return name + " " + vd + ", " + vs2 + ", " + rs1 + vm;
+        case FMT_VI:
+            return name + " " + vd + ", " + vs2 + ", " + std::to_string(v_imm) + vm;
+        case FMT_VUI:
+            return name + " " + vd + ", " + vs2 + ", " + std::to_string(r.f.rs1) + vm;
+        case FMT_VMV_V:
+            return name + " " + vd + ", " + vs1;
+        case FMT_VMV_X:
+            return name + " " + vd + ", " + rs1;
+        case FMT_VMV_I:
+            return name + " " + vd + ", " + std::to_string(v_imm);
+        case FMT_VMV_XS:
+            return name + " " + rd + ", " + vs2 + vm;
+        default:
+            return name;
+    }
+}
+
+/**
+ * Prints disassembly of the whole instruction memory in objdump-like format,
+ * compressed instructions are shown by their 32-bit expansion
+ * @param inst_mem  instruction memory
+ */
+void Disassembler::dump (const std::vector<unsigned int> &inst_mem) {
+    unsigned long end = inst_mem.size() * 4;
+    auto half = [&](unsigned long address) {
+        return address < end ? inst_mem[address / 4] >> (address % 4 * 8) & 0xFFFFu : 0u;
+    };
+    unsigned long address = 0;
+    while (address < end) {
+        unsigned int low = half(address);
+        std::cout << std::setfill(' ') << std::setw(8) << std::hex << address << ":\t";
+        if (CompressedExpander::compressed(low)) {
+            std::cout << std::setfill('0') << std::setw(4) << low << "    \t"
+                      << disassemble(CompressedExpander::expand(low)) << "\n";
+            address += 2;
+        } else {
+            unsigned int inst = low | half(address + 2) << 16u;
+            std::cout << std::setfill('0') << std::setw(8) << inst << "\t" << disassemble(inst) << "\n";
+            address += 4;
+        }
+    }
+}
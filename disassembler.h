@@ -0,0 +1,77 @@
+// disassembler.h
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#ifndef ISA_SIM_CPP_DISASSEMBLER_H
+#define ISA_SIM_CPP_DISASSEMBLER_H
+
+#include <string>
+#include <vector>
+
+/**
+ * Operand layout of the disassembled instruction
+ */
+typedef enum {
+    FMT_R,          // name rd, rs1, rs2
+    FMT_I,          // name rd, rs1, imm
+    FMT_SHIFT,      // name rd, rs1, shamt
+    FMT_UNARY,      // name rd, rs1
+    FMT_LOAD,       // name rd, imm(rs1)
+    FMT_STORE,      // name rs2, imm(rs1)
+    FMT_BRANCH,     // name rs1, rs2, imm
+    FMT_U,          // name rd, imm
+    FMT_J,          // name rd, imm
+    FMT_FLOAD,      // name fd, imm(rs1)
+    FMT_FSTORE,     // name fs2, imm(rs1)
+    FMT_FR,         // name fd, fs1, fs2
+    FMT_FR4,        // name fd, fs1, fs2, fs3
+    FMT_FR1,        // name fd, fs1
+    FMT_FCMP,       // name rd, fs1, fs2
+    FMT_F2X,        // name rd, fs1
+    FMT_X2F,        // name fd, rs1
+    FMT_CSR,        // name rd, csr, rs1
+    FMT_CSRI,       // name rd, csr, uimm
+    FMT_FENCE,      // name pred, succ
+    FMT_LR,         // name rd, (rs1)
+    FMT_AMO,        // name rd, rs2, (rs1)
+    FMT_VSETVLI,    // name rd, rs1, vtype
+    FMT_VSETIVLI,   // name rd, uimm, vtype
+    FMT_VLOAD,      // name vd, (rs1)
+    FMT_VLOAD_STRIDE, // name vd, (rs1), rs2
+    FMT_VV,         // name vd, vs2, vs1
+    FMT_VX,         // name vd, vs2, rs1
+    FMT_VI,         // name vd, vs2, simm
+    FMT_VUI,        // name vd, vs2, uimm
+    FMT_VMV_V,      // name vd, vs1
+    FMT_VMV_X,      // name vd, rs1
+    FMT_VMV_I,      // name vd, simm
+    FMT_VMV_XS,     // name rd, vs2
+    FMT_NONE        // name
+} inst_format_t;
+
+/**
+ * Disassembler table entry, instruction matches if (inst & mask) == match
+ */
+typedef struct {
+    unsigned int mask;
+    unsigned int match;
+    const char *name;
+    inst_format_t format;
+} disasm_entry_t;
+
+/**
+ * Table-driven disassembler used for tracing and the --disasm mode.
+ * It is kept out of the decoders so that execution does no string work.
+ */
+class Disassembler {
+private:
+    static const disasm_entry_t *lookup (unsigned int inst);
+    static std::string vtype (unsigned int zimm);
+    static std::string fence_set (unsigned int bits);
+public:
+    static std::string disassemble (unsigned int inst);
+    static void dump (const std::vector<unsigned int> &inst_mem);
+};
+
+
+#endif //ISA_SIM_CPP_DISASSEMBLER_H
@@ -0,0 +1,59 @@
+// event_queue.cpp
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#include <algorithm>
+#include "event_queue.h"
+#include "snapshot.h"
+
+/**
+ * Orders the heap so that the earliest deadline is at the front
+ */
+static bool later (const event_t &a, const event_t &b) {
+    return a.deadline > b.deadline;
+}
+
+/**
+ * Inserts an event
+ * @param deadline  value of mtime at which the event happens
+ * @param kind      kind of event
+ */
+void EventQueue::schedule (unsigned long long deadline, event_kind_t kind) {
+    events.push_back(event_t{deadline, kind});
+    std::push_heap(events.begin(), events.end(), later);
+}
+
+/**
+ * Removes the earliest event
+ * @return  the event
+ */
+event_t EventQueue::pop () {
+    std::pop_heap(events.begin(), events.end(), later);
+    event_t event = events.back();
+    events.pop_back();
+    return event;
+}
+
+/**
+ * Writes the events into a snapshot
+ * @param out   snapshot stream
+ */
+void EventQueue::save (std::ostream &out) const {
+    save_value(out, events.size());
+    for (const event_t &event : events) {
+        save_value(out, event);
+    }
+}
+
+/**
+ * Replaces the events by those of a snapshot
+ * @param in    snapshot stream
+ */
+void EventQueue::restore (std::istream &in) {
+    size_t count = 0;
+    restore_value(in, count);
+    events.resize(count);
+    for (event_t &event : events) {
+        restore_value(in, event);
+    }
+}
@@ -0,0 +1,43 @@
+// event_queue.h
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#ifndef ISA_SIM_CPP_EVENT_QUEUE_H
+#define ISA_SIM_CPP_EVENT_QUEUE_H
+
+#include <istream>
+#include <ostream>
+#include <vector>
+
+#define EVENT_NEVER     (~0ull)
+
+/**
+ * Kinds of events a hart handles when their deadline arrives
+ */
+typedef enum {
+    EVENT_TIMER                 // mtime reaches mtimecmp
+} event_kind_t;
+
+typedef struct {
+    unsigned long long deadline;    // value of mtime
+    event_kind_t kind;
+} event_t;
+
+/**
+ * Time-ordered queue of the events of one hart. The hart executes instructions
+ * without checking for events until the deadline of the first one arrives.
+ */
+class EventQueue {
+public:
+    void schedule (unsigned long long deadline, event_kind_t kind);
+    unsigned long long next () const { return events.empty() ? EVENT_NEVER : events.front().deadline; }
+    bool due (unsigned long long now) const { return !events.empty() && events.front().deadline <= now; }
+    event_t pop ();
+    void save (std::ostream &out) const;
+    void restore (std::istream &in);
+private:
+    std::vector<event_t> events;    // binary min-heap by deadline
+};
+
+
+#endif //ISA_SIM_CPP_EVENT_QUEUE_H
@@ -0,0 +1,437 @@
+// float_decoder.cpp
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include "float_decoder.h"
+#include "hart.h"
+
+// This file must be compiled with -frounding-math, so that the compiler
+// does not move or fold the arithmetic across the changes of host rounding mode.
+
+/**
+ * Helpers shared by single and double precision instructions
+ */
+
+template <typename T>
+using bits_t = typename std::conditional<sizeof(T) == 4, uint32_t, uint64_t>::type;
+
+template <typename T>
+static bits_t<T> to_bits (T value) {
+    bits_t<T> bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+template <typename T>
+static T from_bits (bits_t<T> bits) {
+    T value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+template <typename T>
+static constexpr bits_t<T> sign_mask () {
+    return bits_t<T>(1) << (sizeof(T) * 8 - 1);
+}
+
+template <typename T>
+static constexpr bits_t<T> quiet_mask () {
+    return bits_t<T>(1) << (std::numeric_limits<T>::digits - 2);
+}
+
+/**
+ * NaN checks on the bit pattern, so that they never raise host exceptions
+ */
+template <typename T>
+static bool is_nan (T value) {
+    bits_t<T> exp = to_bits(std::numeric_limits<T>::infinity());
+    return (to_bits(value) & ~sign_mask<T>()) > exp;
+}
+
+template <typename T>
+static bool is_snan (T value) {
+    return is_nan(value) && !(to_bits(value) & quiet_mask<T>());
+}
+
+/**
+ * Replaces any NaN result with the canonical NaN required by RISC-V
+ */
+template <typename T>
+static T canonical (T value) {
+    return is_nan(value) ? std::numeric_limits<T>::quiet_NaN() : value;
+}
+
+static float  read_fp (FloatRegisterFile *freg, RegisterFile::Register reg, float)  { return freg->readSingle(reg); }
+static double read_fp (FloatRegisterFile *freg, RegisterFile::Register reg, double) { return freg->readDouble(reg); }
+static void write_fp (FloatRegisterFile *freg, RegisterFile::Register reg, float data)  { freg->writeSingle(reg, data); }
+static void write_fp (FloatRegisterFile *freg, RegisterFile::Register reg, double data) { freg->writeDouble(reg, data); }
+
+/**
+ * Minimum/maximum as defined by IEEE 754-2019 minimumNumber/maximumNumber
+ */
+template <typename T>
+static T min_max (FloatRegisterFile *freg, T a, T b, bool max) {
+    if (is_snan(a) || is_snan(b)) {
+        freg->raiseFlags(FFLAG_NV);
+    }
+    if (is_nan(a) && is_nan(b)) {
+        return std::numeric_limits<T>::quiet_NaN();
+    } else if (is_nan(a)) {
+        return b;
+    } else if (is_nan(b)) {
+        return a;
+    } else if (a == b) {
+        // -0.0 is considered smaller than +0.0
+        return (std::signbit(a) != max) ? a : b;
+    }
+    return (max ? a > b : a < b) ? a : b;
+}
+
+/**
+ * Classifies floating-point number
+ * @return  one-hot mask of the class as defined for fclass
+ */
+template <typename T>
+static unsigned int classify (T value) {
+    bool neg = std::signbit(value);
+    if (is_nan(value)) {
+        return is_snan(value) ? 1u << 8u : 1u << 9u;
+    }
+    switch (std::fpclassify(value)) {
+        case FP_INFINITE:
+            return neg ? 1u << 0u : 1u << 7u;
+        case FP_NORMAL:
+            return neg ? 1u << 1u : 1u << 6u;
+        case FP_SUBNORMAL:
+            return neg ? 1u << 2u : 1u << 5u;
+        default:
+            return neg ? 1u << 3u : 1u << 4u;
+    }
+}
+
+/**
+ * Converts floating-point number to 32-bit integer with the RISC-V saturation rules
+ * @param rm    resolved rounding mode
+ * @return      converted integer
+ */
+template <typename T>
+static unsigned int to_integer (FloatRegisterFile *freg, T value, unsigned int rm, bool is_unsigned) {
+    if (is_nan(value)) {
+        freg->raiseFlags(FFLAG_NV);
+        return is_unsigned ? 0xFFFFFFFFu : 0x7FFFFFFFu;
+    }
+    // every 32-bit integer and float is exactly representable as double
+    double exact = value;
+    double rounded = rm == RM_RMM ? std::round(exact) : std::nearbyint(exact);
+    double low = is_unsigned ? 0.0 : -2147483648.0;
+    double high = is_unsigned ? 4294967295.0 : 2147483647.0;
+    if (rounded < low) {
+        freg->raiseFlags(FFLAG_NV);
+        return is_unsigned ? 0u : 0x80000000u;
+    } else if (rounded > high) {
+        freg->raiseFlags(FFLAG_NV);
+        return is_unsigned ? 0xFFFFFFFFu : 0x7FFFFFFFu;
+    }
+    if (rounded != exact) {
+        freg->raiseFlags(FFLAG_NX);
+    }
+    return (unsigned int)(int64_t(rounded));
+}
+
+/**
+ * FloatDecoder base constructor
+ * @param hart  hart whose instructions are decoded
+ */
+FloatDecoder::FloatDecoder (Hart &hart) : InstructionDecoder(hart) {
+    freg = hart.floatRegisters();
+}
+
+/**
+ * Resolves the rounding mode of the instruction and applies it to the host FPU
+ * @param rm    rounding mode field of the instruction
+ * @return      resolved rounding mode
+ */
+unsigned int FloatDecoder::rounding_mode (unsigned int rm) {
+    if (rm == RM_DYN) {
+        rm = freg->readRoundingMode();
+    }
+    if (!freg->setHostRounding(rm)) {
+        term->terminate("Invalid rounding mode: " + std::to_string(rm) + "\n", 1);
+    }
+    return rm;
+}
+
+/**
+ * Function decoding floating-point load instructions
+ * @param pc    program counter
+ * @param inst  raw instruction
+ * @return      new program counter
+ */
+unsigned int FloatLoadDecoder::decode (unsigned int pc, unsigned int inst) {
+    i_inst_t decoder{};
+    decoder.inst = inst;
+
+    rs1 = reg->read(decoder.f.rs1);
+    imm = decoder.f.imm;
+    // sign-extend if negative
+    if (imm & 0x800) {
+        imm |= 0xFFFFF000;
+    }
+    unsigned int sp = int(rs1) + int(imm);
+
+    switch (decoder.f.funct3) {
+        case 0b010:
+            // FLW
+            freg->writeRaw(decoder.f.rd, 0xFFFFFFFF00000000ull | stack->readWord(sp));
+            break;
+        case 0b011:
+            // FLD
+            freg->writeRaw(decoder.f.rd, stack->readWord(sp) | uint64_t(stack->readWord(sp + 4)) << 32u);
+            break;
+        default:
+            term->terminate("Invalid funct3 while decoding floating-point load instruction: "
+                            + std::to_string(decoder.f.funct3) + "\n", 1);
+    }
+    return pc+4;
+}
+
+/**
+ * Function decoding floating-point store instructions
+ * @param pc    program counter
+ * @param inst  raw instruction
+ * @return      new program counter
+ */
+unsigned int FloatStoreDecoder::decode (unsigned int pc, unsigned int inst) {
+    s_inst_t decoder{};
+    decoder.inst = inst;
+
+    rs1 = reg->read(decoder.f.rs1);
+    imm = decoder.f.imm4_0 | (decoder.f.imm5_11 << 5u);
+    // sign-extend if negative
+    if (imm & 0x800) {
+        imm |= 0xFFFFF000;
+    }
+    unsigned int sp = int(rs1) + int(imm);
+    uint64_t data = freg->readRaw(decoder.f.rs2);
+
+    switch (decoder.f.funct3) {
+        case 0b010:
+            // FSW
+            stack->writeWord(sp, uint32_t(data));
+            break;
+        case 0b011:
+            // FSD
+            stack->writeWord(sp, uint32_t(data));
+            stack->writeWord(sp + 4, uint32_t(data >> 32u));
+            break;
+        default:
+            term->terminate("Invalid funct3 while decoding floating-point store instruction: "
+                            + std::to_string(decoder.f.funct3) + "\n", 1);
+    }
+    return pc+4;
+}
+
+/**
+ * Executes fused multiply-add on the host FPU
+ * @param opcode    opcode selecting the negation of product and addend
+ */
+template <typename T>
+static T fused_mul_add (unsigned int opcode, T a, T b, T c) {
+    switch (opcode) {
+        case 0b1000011:
+            // FMADD: a * b + c
+            return std::fma(a, b, c);
+        case 0b1000111:
+            // FMSUB: a * b - c
+            return std::fma(a, b, -c);
+        case 0b1001011:
+            // FNMSUB: -(a * b) + c
+            return std::fma(-a, b, c);
+        default:
+            // FNMADD: -(a * b) - c
+            return std::fma(-a, b, -c);
+    }
+}
+
+/**
+ * Function decoding floating-point fused multiply-add instructions
+ * @param pc    program counter
+ * @param inst  raw instruction
+ * @return      new program counter
+ */
+unsigned int FloatFusedMulAddDecoder::decode (unsigned int pc, unsigned int inst) {
+    r4_inst_t decoder{};
+    decoder.inst = inst;
+
+    rounding_mode(decoder.f.funct3);
+
+    switch (decoder.f.fmt) {
+        case 0b00:
+            freg->writeSingle(decoder.f.rd, canonical(fused_mul_add(decoder.f.opcode,
+                    freg->readSingle(decoder.f.rs1), freg->readSingle(decoder.f.rs2), freg->readSingle(decoder.f.rs3))));
+            break;
+        case 0b01:
+            freg->writeDouble(decoder.f.rd, canonical(fused_mul_add(decoder.f.opcode,
+                    freg->readDouble(decoder.f.rs1), freg->readDouble(decoder.f.rs2), freg->readDouble(decoder.f.rs3))));
+            break;
+        default:
+            term->terminate("Invalid format while decoding fused multiply-add instruction: "
+                            + std::to_string(decoder.f.fmt) + "\n", 1);
+    }
+    return pc+4;
+}
+
+/**
+ * Function decoding floating-point arithmetic, conversion, compare and move instructions
+ * @param pc    program counter
+ * @param inst  raw instruction
+ * @return      new program counter
+ */
+unsigned int FloatArithDecoder::decode (unsigned int pc, unsigned int inst) {
+    r_inst_t decoder{};
+    decoder.inst = inst;
+
+    // funct7 = funct5 + fmt
+    if ((decoder.f.funct7 >> 2u) == 0b01000) {
+        rounding_mode(decoder.f.funct3);
+        if (decoder.f.funct7 == 0b0100000 && decoder.f.rs2 == 1) {
+            // FCVT.S.D
+            freg->writeSingle(decoder.f.rd, canonical(float(freg->readDouble(decoder.f.rs1))));
+        } else if (decoder.f.funct7 == 0b0100001 && decoder.f.rs2 == 0) {
+            // FCVT.D.S
+            freg->writeDouble(decoder.f.rd, canonical(double(freg->readSingle(decoder.f.rs1))));
+        } else {
+            term->terminate("Invalid floating-point conversion instruction: "
+                            + std::to_string(decoder.f.funct7) + "\n", 1);
+        }
+        return pc+4;
+    }
+
+    switch (decoder.f.funct7 & 0b11u) {
+        case 0b00:
+            return fp_decode<float>(pc, decoder);
+        case 0b01:
+            return fp_decode<double>(pc, decoder);
+        default:
+            term->terminate("Invalid format while decoding floating-point instruction: "
+                            + std::to_string(decoder.f.funct7 & 0b11u) + "\n", 1);
+    }
+    return pc+4;
+}
+
+/**
+ * Function decoding floating-point instructions of one precision
+ * @param pc        program counter
+ * @param decoder   decoder union
+ * @return          new program counter
+ */
+template <typename T>
+unsigned int FloatArithDecoder::fp_decode (unsigned int pc, r_inst_t decoder) {
+    T a = read_fp(freg, decoder.f.rs1, T());
+    T b = read_fp(freg, decoder.f.rs2, T());
+    unsigned int rm;
+
+    switch (decoder.f.funct7 >> 2u) {
+        case 0b00000:
+            // FADD
+            rounding_mode(decoder.f.funct3);
+            write_fp(freg, decoder.f.rd, canonical(T(a + b)));
+            break;
+        case 0b00001:
+            // FSUB
+            rounding_mode(decoder.f.funct3);
+            write_fp(freg, decoder.f.rd, canonical(T(a - b)));
+            break;
+        case 0b00010:
+            // FMUL
+            rounding_mode(decoder.f.funct3);
+            write_fp(freg, decoder.f.rd, canonical(T(a * b)));
+            break;
+        case 0b00011:
+            // FDIV
+            rounding_mode(decoder.f.funct3);
+            write_fp(freg, decoder.f.rd, canonical(T(a / b)));
+            break;
+        case 0b01011:
+            // FSQRT
+            rounding_mode(decoder.f.funct3);
+            write_fp(freg, decoder.f.rd, canonical(T(std::sqrt(a))));
+            break;
+        case 0b00100: {
+            // FSGNJ, FSGNJN, FSGNJX
+            bits_t<T> sign;
+            if (decoder.f.funct3 == 0b000) {
+                sign = to_bits(b);
+            } else if (decoder.f.funct3 == 0b001) {
+                sign = ~to_bits(b);
+            } else {
+                sign = to_bits(a) ^ to_bits(b);
+            }
+            write_fp(freg, decoder.f.rd, from_bits<T>((to_bits(a) & ~sign_mask<T>()) | (sign & sign_mask<T>())));
+            break;
+        }
+        case 0b00101:
+            // FMIN, FMAX
+            write_fp(freg, decoder.f.rd, min_max(freg, a, b, decoder.f.funct3 == 0b001));
+            break;
+        case 0b10100:
+            // FLE, FLT, FEQ
+            if (is_nan(a) || is_nan(b)) {
+                // only FEQ is a quiet comparison
+                if (decoder.f.funct3 != 0b010 || is_snan(a) || is_snan(b)) {
+                    freg->raiseFlags(FFLAG_NV);
+                }
+                reg->write(decoder.f.rd, 0);
+            } else if (decoder.f.funct3 == 0b000) {
+                reg->write(decoder.f.rd, a <= b);
+            } else if (decoder.f.funct3 == 0b001) {
+                reg->write(decoder.f.rd, a < b);
+            } else {
+                reg->write(decoder.f.rd, a == b);
+            }
+            break;
+        case 0b11000:
+            // FCVT.W, FCVT.WU
+            rm = rounding_mode(decoder.f.funct3);
+            reg->write(decoder.f.rd, to_integer(freg, a, rm, decoder.f.rs2 == 1));
+            break;
+        case 0b11010:
+            // FCVT from W, WU
+            rounding_mode(decoder.f.funct3);
+            rs1 = reg->read(decoder.f.rs1);
+            if (decoder.f.rs2 == 1) {
+                write_fp(freg, decoder.f.rd, T(double(rs1)));
+            } else {
+                write_fp(freg, decoder.f.rd, T(double(int(rs1))));
+            }
+            break;
+        case 0b11100:
+            if (decoder.f.funct3 == 0b001) {
+                // FCLASS
+                reg->write(decoder.f.rd, classify(a));
+            } else if (std::is_same<T, float>::value) {
+                // FMV.X.W moves the raw lower bits without NaN-box check
+                reg->write(decoder.f.rd, uint32_t(freg->readRaw(decoder.f.rs1)));
+            } else {
+                term->terminate("FMV.X.D is not available in RV32\n", 1);
+            }
+            break;
+        case 0b11110:
+            if (std::is_same<T, float>::value) {
+                // FMV.W.X
+                freg->writeRaw(decoder.f.rd, 0xFFFFFFFF00000000ull | reg->read(decoder.f.rs1));
+            } else {
+                term->terminate("FMV.D.X is not available in RV32\n", 1);
+            }
+            break;
+        default:
+            term->terminate("Invalid funct7 while decoding floating-point instruction: "
+                            + std::to_string(decoder.f.funct7) + "\n", 1);
+    }
+    return pc+4;
+}
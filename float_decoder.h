@@ -0,0 +1,65 @@
+// float_decoder.h
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#ifndef ISA_SIM_CPP_FLOAT_DECODER_H
+#define ISA_SIM_CPP_FLOAT_DECODER_H
+
+#include "instruction_decoder.h"
+#include "float_register_file.h"
+
+/**
+ * Floating-point (F and D extension) instruction decoders
+ */
+
+/**
+ * Base of the floating-point instruction decoders
+ */
+class FloatDecoder : public InstructionDecoder {
+protected:
+    FloatRegisterFile *freg;
+    unsigned int rounding_mode (unsigned int rm);
+public:
+    explicit FloatDecoder (Hart &hart);
+};
+
+/**
+ * Floating-point load instruction decoder
+ */
+class FloatLoadDecoder : public FloatDecoder {
+public:
+    using FloatDecoder::FloatDecoder;
+    unsigned int decode (unsigned int pc, unsigned int inst) override;
+};
+
+/**
+ * Floating-point store instruction decoder
+ */
+class FloatStoreDecoder : public FloatDecoder {
+public:
+    using FloatDecoder::FloatDecoder;
+    unsigned int decode (unsigned int pc, unsigned int inst) override;
+};
+
+/**
+ * Floating-point fused multiply-add instruction decoder
+ */
+class FloatFusedMulAddDecoder : public FloatDecoder {
+public:
+    using FloatDecoder::FloatDecoder;
+    unsigned int decode (unsigned int pc, unsigned int inst) override;
+};
+
+/**
+ * Floating-point arithmetic, conversion, compare and move instruction decoder
+ */
+class FloatArithDecoder : public FloatDecoder {
+private:
+    template <typename T>
+    unsigned int fp_decode (unsigned int pc, r_inst_t decoder);
+public:
+    using FloatDecoder::FloatDecoder;
+    unsigned int decode (unsigned int pc, unsigned int inst) override;
+};
+
+#endif //ISA_SIM_CPP_FLOAT_DECODER_H
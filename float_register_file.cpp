@@ -0,0 +1,173 @@
+// float_register_file.cpp
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#include <cfenv>
+#include <cstring>
+#include "float_register_file.h"
+#include "snapshot.h"
+
+#define NAN_BOX     0xFFFFFFFF00000000ull
+#define CANON_NAN_S 0x7FC00000u
+
+/**
+ * Floating-point register file constructor
+ */
+FloatRegisterFile::FloatRegisterFile () {
+    m_reg_file.fill(0);
+    m_fflags = 0;
+    m_frm = RM_RNE;
+    m_host_rm = RM_RNE;
+    std::fesetround(FE_TONEAREST);
+    std::feclearexcept(FE_ALL_EXCEPT);
+}
+
+/**
+ * Read single precision value from register. A value which is not
+ * properly NaN-boxed is read as the canonical NaN.
+ * @param reg   Register number
+ * @return      Single precision value
+ */
+float FloatRegisterFile::readSingle (RegisterFile::Register reg) {
+    uint64_t raw = m_reg_file[reg];
+    uint32_t bits = (raw & NAN_BOX) == NAN_BOX ? uint32_t(raw) : CANON_NAN_S;
+    float data;
+    std::memcpy(&data, &bits, sizeof(data));
+    return data;
+}
+
+/**
+ * Read double precision value from register
+ * @param reg   Register number
+ * @return      Double precision value
+ */
+double FloatRegisterFile::readDouble (RegisterFile::Register reg) {
+    double data;
+    std::memcpy(&data, &m_reg_file[reg], sizeof(data));
+    return data;
+}
+
+/**
+ * Write NaN-boxed single precision value to register
+ * @param reg   Register number
+ * @param data  Single precision value
+ */
+void FloatRegisterFile::writeSingle (RegisterFile::Register reg, float data) {
+    uint32_t bits;
+    std::memcpy(&bits, &data, sizeof(bits));
+    m_reg_file[reg] = NAN_BOX | bits;
+}
+
+/**
+ * Write double precision value to register
+ * @param reg   Register number
+ * @param data  Double precision value
+ */
+void FloatRegisterFile::writeDouble (RegisterFile::Register reg, double data) {
+    std::memcpy(&m_reg_file[reg], &data, sizeof(data));
+}
+
+/**
+ * Read accrued exception flags. Exceptions raised by the host FPU are sticky
+ * just like fflags, so they are only collected here instead of after every operation.
+ * @return  fflags register
+ */
+unsigned int FloatRegisterFile::readFlags () {
+    int host = std::fetestexcept(FE_ALL_EXCEPT);
+    if (host) {
+        m_fflags |= (host & FE_INEXACT ? FFLAG_NX : 0u) |
+                    (host & FE_UNDERFLOW ? FFLAG_UF : 0u) |
+                    (host & FE_OVERFLOW ? FFLAG_OF : 0u) |
+                    (host & FE_DIVBYZERO ? FFLAG_DZ : 0u) |
+                    (host & FE_INVALID ? FFLAG_NV : 0u);
+        std::feclearexcept(FE_ALL_EXCEPT);
+    }
+    return m_fflags;
+}
+
+/**
+ * Write accrued exception flags
+ * @param flags new value of fflags
+ */
+void FloatRegisterFile::writeFlags (unsigned int flags) {
+    std::feclearexcept(FE_ALL_EXCEPT);
+    m_fflags = flags & 0x1Fu;
+}
+
+/**
+ * Switches the host FPU to the rounding mode of the instruction. The host mode
+ * is only changed when it differs from the last one used.
+ * RMM has no host equivalent and is executed as round to nearest, ties to even.
+ * @param rm    rounding mode field of the instruction
+ * @return      false if the rounding mode is invalid
+ */
+bool FloatRegisterFile::setHostRounding (unsigned int rm) {
+    if (rm == RM_DYN) {
+        rm = m_frm;
+    }
+    if (rm == m_host_rm) {
+        return true;
+    }
+    switch (rm) {
+        case RM_RNE:
+        case RM_RMM:
+            std::fesetround(FE_TONEAREST);
+            break;
+        case RM_RTZ:
+            std::fesetround(FE_TOWARDZERO);
+            break;
+        case RM_RDN:
+            std::fesetround(FE_DOWNWARD);
+            break;
+        case RM_RUP:
+            std::fesetround(FE_UPWARD);
+            break;
+        default:
+            return false;
+    }
+    m_host_rm = rm;
+    return true;
+}
+
+/**
+ * Loads the rounding mode of this register file into the host FPU. Called when
+ * the hart starts running on a host thread that may have been used by another hart.
+ */
+void FloatRegisterFile::attachHost () {
+    unsigned int rm = m_host_rm;
+    std::feclearexcept(FE_ALL_EXCEPT);
+    // force the switch, the host mode is unknown at this point
+    m_host_rm = RM_DYN;
+    setHostRounding(rm);
+}
+
+/**
+ * Collects the exceptions raised by the host FPU before another hart uses the thread
+ */
+void FloatRegisterFile::detachHost () {
+    readFlags();
+}
+
+/**
+ * Writes the registers and fcsr into a snapshot, the flags raised
+ * by the host FPU must be collected before
+ * @param out   snapshot stream
+ */
+void FloatRegisterFile::save (std::ostream &out) const {
+    save_value(out, m_reg_file);
+    save_value(out, m_fflags);
+    save_value(out, m_frm);
+    save_value(out, m_host_rm);
+}
+
+/**
+ * Reads the registers and fcsr from a snapshot and sets the host rounding mode
+ * @param in    snapshot stream
+ */
+void FloatRegisterFile::restore (std::istream &in) {
+    restore_value(in, m_reg_file);
+    restore_value(in, m_fflags);
+    restore_value(in, m_frm);
+    restore_value(in, m_host_rm);
+    attachHost();
+}
@@ -0,0 +1,64 @@
+// float_register_file.h
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#ifndef ISA_SIM_CPP_FLOAT_REGISTER_FILE_H
+#define ISA_SIM_CPP_FLOAT_REGISTER_FILE_H
+
+#include <array>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include "register_file.h"
+
+// fflags bits
+#define FFLAG_NX 0x01u  // inexact
+#define FFLAG_UF 0x02u  // underflow
+#define FFLAG_OF 0x04u  // overflow
+#define FFLAG_DZ 0x08u  // divide by zero
+#define FFLAG_NV 0x10u  // invalid operation
+
+// rounding modes
+#define RM_RNE 0b000u
+#define RM_RTZ 0b001u
+#define RM_RDN 0b010u
+#define RM_RUP 0b011u
+#define RM_RMM 0b100u
+#define RM_DYN 0b111u
+
+/**
+ * Floating-point register file (F and D extension) with the fcsr register.
+ * Registers are 64 bits wide, single precision values are NaN-boxed.
+ * Every hart has its own register file, the host FPU state is per thread.
+ */
+class FloatRegisterFile {
+public:
+    FloatRegisterFile();
+
+    float  readSingle (RegisterFile::Register reg);
+    double readDouble (RegisterFile::Register reg);
+    void writeSingle (RegisterFile::Register reg, float data);
+    void writeDouble (RegisterFile::Register reg, double data);
+    uint64_t readRaw (RegisterFile::Register reg) { return m_reg_file[reg]; }
+    void writeRaw (RegisterFile::Register reg, uint64_t data) { m_reg_file[reg] = data; }
+
+    unsigned int readFlags ();
+    void writeFlags (unsigned int flags);
+    void raiseFlags (unsigned int flags) { m_fflags |= flags; }
+    unsigned int readRoundingMode () { return m_frm; }
+    void writeRoundingMode (unsigned int rm) { m_frm = rm & 0x7u; }
+    bool setHostRounding (unsigned int rm);
+    void attachHost ();
+    void detachHost ();
+    void save (std::ostream &out) const;
+    void restore (std::istream &in);
+
+private:
+
+    std::array<uint64_t, 32> m_reg_file;
+    unsigned int m_fflags;
+    unsigned int m_frm;
+    unsigned int m_host_rm;
+};
+
+#endif //ISA_SIM_CPP_FLOAT_REGISTER_FILE_H
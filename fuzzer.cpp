@@ -0,0 +1,384 @@
+// fuzzer.cpp
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <new>
+#include <sstream>
+#include <thread>
+#include "fuzzer.h"
+#include "isa_simulator.h"
+#include "instrumentation.h"
+
+CoverageMap::CoverageMap () {
+    m_map.fill(0);
+    m_hit.reserve(FUZZ_MAP_SIZE);
+    clear();
+}
+
+/**
+ * Clears the counters before an execution, its entry starts a block
+ */
+void CoverageMap::clear () {
+    for (uint32_t index : m_hit) {
+        m_map[index] = 0;
+    }
+    m_hit.clear();
+    m_previous = 0;
+    m_edge = true;
+}
+
+/**
+ * Fuzz target constructor: creates the machine and the buffer of the inputs
+ * @param image     program under test
+ */
+FuzzTarget::FuzzTarget (std::shared_ptr<const ProgramImage> image) : m_guest(0, std::move(image), QUANTUM_DEFAULT) {
+    m_input = static_cast<unsigned char *>(std::aligned_alloc(PAGE_SIZE, FUZZ_INPUT_MAX));
+    if (m_input == nullptr) {
+        throw std::bad_alloc();
+    }
+    std::memset(m_input, 0, FUZZ_INPUT_MAX);
+    m_length = 0;
+    m_guest.hart()->setCoverage(&m_coverage);
+}
+
+FuzzTarget::~FuzzTarget () {
+    std::free(m_input);
+}
+
+/**
+ * Runs the program on an input from its initial state
+ * @param input     the input, at most FUZZ_INPUT_MAX bytes
+ * @param steps     number of instructions after which the run is stopped
+ * @return          EXEC_OK if the run was stopped, the result of the terminated hart otherwise
+ */
+exec_result_t FuzzTarget::execute (const std::vector<unsigned char> &input, unsigned long long steps) {
+    std::memcpy(m_input, input.data(), input.size());
+    if (input.size() < m_length) {
+        std::memset(m_input + input.size(), 0, m_length - input.size());
+    }
+    m_length = input.size();
+
+    m_guest.reset(0);
+    m_guest.memory()->mapReadOnly(FUZZ_INPUT_BASE, m_input, FUZZ_INPUT_MAX);
+    Hart *hart = m_guest.hart();
+    hart->registers()->write(RegisterFile::x10, FUZZ_INPUT_BASE);
+    hart->registers()->write(RegisterFile::x11, m_length);
+    m_coverage.clear();
+    hart->floatRegisters()->attachHost();
+    exec_result_t result = hart->run(steps);
+    hart->floatRegisters()->detachHost();
+    return result;
+}
+
+/**
+ * @param input     the input
+ * @return          name of the file of the input: its 64-bit hash in hexadecimal
+ */
+static std::string input_name (const std::vector<unsigned char> &input) {
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (unsigned char byte : input) {
+        hash = (hash ^ byte) * 0x100000001B3ull;
+    }
+    std::ostringstream name;
+    name << std::hex << std::setfill('0') << std::setw(16) << hash;
+    return name.str();
+}
+
+/**
+ * Fuzzer constructor
+ * @param threads   number of worker threads
+ * @param seed      seed of the mutations
+ */
+Fuzzer::Fuzzer (unsigned int threads, unsigned long long seed) {
+    m_threads = threads;
+    m_seed = seed;
+    m_runs = FUZZ_RUNS_DEFAULT;
+    m_steps = FUZZ_STEPS_DEFAULT;
+    m_virgin.fill(0xFF);
+    m_executions = 0;
+    m_crash_count = 0;
+    m_hangs = 0;
+    Instrumentation::select(INSTRUMENT_COVERAGE);
+}
+
+/**
+ * Loads the program under test
+ * @param filepath  the path to the binary file
+ * @return          true if successful otherwise false
+ */
+bool Fuzzer::loadFile (const char *filepath) {
+    std::vector<unsigned int> words;
+    if (!ISA_Simulator::readBinary(filepath, words)) {
+        return false;
+    }
+    m_image = std::make_shared<const ProgramImage>(std::move(words));
+    return true;
+}
+
+/**
+ * Loads the initial corpus from the files of a directory, the inputs found
+ * later are added to it. An empty directory starts with an empty input.
+ * @param directory the corpus directory
+ * @return          true if successful otherwise false
+ */
+bool Fuzzer::loadCorpus (const char *directory) {
+    if (!std::filesystem::is_directory(directory)) {
+        std::cerr << "Not a valid corpus directory\n";
+        return false;
+    }
+    m_directory = directory;
+    std::vector<std::filesystem::path> paths;
+    for (const auto &entry : std::filesystem::directory_iterator(directory)) {
+        if (entry.is_regular_file()) {
+            paths.push_back(entry.path());
+        }
+    }
+    // the same corpus and seed give the same run on one thread
+    std::sort(paths.begin(), paths.end());
+    for (const auto &path : paths) {
+        std::ifstream file(path, std::ios::binary);
+        std::vector<unsigned char> input((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        input.resize(std::min<size_t>(input.size(), FUZZ_INPUT_MAX));
+        m_corpus.push_back(std::move(input));
+    }
+    if (m_corpus.empty()) {
+        m_corpus.emplace_back();
+    }
+    return true;
+}
+
+/**
+ * Runs the initial corpus, then mutates it on the worker threads until the
+ * number of executions is reached and prints a summary
+ * @return  false if a crash was found
+ */
+bool Fuzzer::run () {
+    auto start = std::chrono::steady_clock::now();
+    // the corpus grows while the seeds run, only the seeds are run here
+    size_t seeds = m_corpus.size();
+    {
+        auto target = std::make_unique<FuzzTarget>(m_image);
+        auto virgin = std::make_unique<std::array<uint8_t, FUZZ_MAP_SIZE>>(m_virgin);
+        for (size_t i = 0; i < seeds; i++) {
+            std::vector<unsigned char> input = m_corpus[i];
+            m_executions++;
+            evaluate(*target, target->execute(input, m_steps), input, *virgin, false);
+        }
+    }
+
+    std::vector<std::thread> threads;
+    for (unsigned int i = 0; i < m_threads; i++) {
+        threads.emplace_back(&Fuzzer::work, this, i);
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    // the workers stop at the number of runs, the seeds run in any case
+    unsigned long long executions = std::max<unsigned long long>(m_runs, seeds);
+    std::cout << "\n\033[1mFuzzing:\033[0m " << executions << " executions in " << seconds << " s ("
+              << (unsigned long long)(double(executions) / seconds) << " per second, " << m_threads << " threads)\n"
+              << "Corpus:  " << m_corpus.size() << " inputs, " << edges() << " edges\n"
+              << "Crashes: " << m_crash_count << " (" << m_crashes.size() << " unique), hangs: " << m_hangs << "\n";
+    return m_crashes.empty();
+}
+
+/**
+ * Body of a worker thread: picks corpus entries, mutates them and runs the program on them
+ * @param worker    index of the worker
+ */
+void Fuzzer::work (unsigned int worker) {
+    auto target = std::make_unique<FuzzTarget>(m_image);
+    // local copy of the virgin map, the shared one is only checked when the local one sees something new
+    auto virgin = std::make_unique<std::array<uint8_t, FUZZ_MAP_SIZE>>();
+    std::mt19937_64 random(m_seed + worker * 0x9E3779B97F4A7C15ull);
+    std::vector<unsigned char> base;
+    std::vector<unsigned char> input;
+    unsigned int left = 0;
+    while (m_executions++ < m_runs) {
+        if (left == 0) {
+            std::lock_guard<std::mutex> guard(m_lock);
+            base = m_corpus[random() % m_corpus.size()];
+            *virgin = m_virgin;
+            left = FUZZ_MUTATIONS;
+        }
+        left--;
+        input = base;
+        mutate(input, random);
+        evaluate(*target, target->execute(input, m_steps), input, *virgin, true);
+    }
+}
+
+/**
+ * Records the outcome of an execution: saves a crash with a new reason and
+ * adds an input reaching new coverage to the corpus
+ * @param target    target which ran the input
+ * @param result    result of the execution
+ * @param input     the input
+ * @param virgin    virgin map of the calling thread
+ * @param keep      true if a new input is added to the corpus
+ */
+void Fuzzer::evaluate (FuzzTarget &target, exec_result_t result, const std::vector<unsigned char> &input,
+                       std::array<uint8_t, FUZZ_MAP_SIZE> &virgin, bool keep) {
+    classify(target.coverage());
+    if (result == EXEC_OK) {
+        m_hangs++;
+        return;
+    }
+    if (result == EXEC_ERROR) {
+        m_crash_count++;
+        std::string reason = target.hart()->halt().msg + " (pc = " + std::to_string(target.hart()->programCounter()) + ")";
+        std::lock_guard<std::mutex> guard(m_lock);
+        if (m_crashes.insert(reason).second) {
+            std::string path = "crash_" + input_name(input) + ".bin";
+            save(path, input);
+            std::cout << "Crash: " << reason << ", input saved into " << path << "\n";
+        }
+        return;
+    }
+    if (!merge(target.coverage(), virgin)) {
+        return;
+    }
+    std::lock_guard<std::mutex> guard(m_lock);
+    if (merge(target.coverage(), m_virgin) && keep) {
+        m_corpus.push_back(input);
+        save((std::filesystem::path(m_directory) / input_name(input)).string(), input);
+    }
+    virgin = m_virgin;
+}
+
+/**
+ * Replaces the hit counts by their classes as in AFL: 1, 2, 3, 4-7, 8-15, 16-31, 32-127, 128+,
+ * one bit each, so a change of the class of an edge counts as new coverage
+ * @param coverage  coverage of an execution
+ */
+void Fuzzer::classify (CoverageMap &coverage) {
+    static const std::array<uint8_t, 256> classes = [] {
+        std::array<uint8_t, 256> table{};
+        for (unsigned int count = 1; count < 256; count++) {
+            unsigned int bit = count <= 3 ? count - 1 : count < 8 ? 3 : count < 16 ? 4 : count < 32 ? 5 : count < 128 ? 6 : 7;
+            table[count] = uint8_t(1u << bit);
+        }
+        return table;
+    }();
+    for (uint32_t index : coverage.m_hit) {
+        coverage.m_map[index] = classes[coverage.m_map[index]];
+    }
+}
+
+/**
+ * Removes the classes of the edges of an execution from a virgin map
+ * @param coverage  classified coverage of an execution
+ * @param virgin    virgin map
+ * @return          true if the execution reached a class not seen before
+ */
+bool Fuzzer::merge (const CoverageMap &coverage, std::array<uint8_t, FUZZ_MAP_SIZE> &virgin) {
+    bool found = false;
+    for (uint32_t index : coverage.m_hit) {
+        if (coverage.m_map[index] & virgin[index]) {
+            virgin[index] &= ~coverage.m_map[index];
+            found = true;
+        }
+    }
+    return found;
+}
+
+/**
+ * Applies a random stack of mutations of AFL's havoc stage to an input
+ * @param input     the input, it stays at most FUZZ_INPUT_MAX bytes long
+ * @param random    random generator of the calling thread
+ */
+void Fuzzer::mutate (std::vector<unsigned char> &input, std::mt19937_64 &random) {
+    static const int8_t interesting8[] = {-128, -1, 0, 1, 16, 32, 64, 100, 127};
+    static const int16_t interesting16[] = {-32768, -129, 128, 255, 256, 512, 1000, 1024, 4096, 32767};
+    static const int32_t interesting32[] = {-2147483647 - 1, -100663046, -32769, 32768, 65535, 65536, 100663045,
+                                            2147483647};
+    unsigned int count = 1 + random() % FUZZ_STACKING;
+    for (unsigned int i = 0; i < count; i++) {
+        size_t size = input.size();
+        // an empty input can only grow
+        unsigned int operation = size == 0 ? 7 : random() % 9;
+        switch (operation) {
+            case 0:
+                input[random() % size] ^= 1u << (random() % 8);
+                break;
+            case 1:
+                input[random() % size] = interesting8[random() % std::size(interesting8)];
+                break;
+            case 2:
+                if (size >= 2) {
+                    int16_t value = interesting16[random() % std::size(interesting16)];
+                    std::memcpy(&input[random() % (size - 1)], &value, sizeof(value));
+                }
+                break;
+            case 3:
+                if (size >= 4) {
+                    int32_t value = interesting32[random() % std::size(interesting32)];
+                    std::memcpy(&input[random() % (size - 3)], &value, sizeof(value));
+                }
+                break;
+            case 4: {
+                unsigned int delta = 1 + random() % 35;
+                input[random() % size] += random() & 1 ? delta : -delta;
+                break;
+            }
+            case 5:
+                input[random() % size] = (unsigned char)(random());
+                break;
+            case 6:
+                if (size >= 2) {
+                    size_t length = 1 + random() % std::min<size_t>(size - 1, 64);
+                    size_t from = random() % (size - length + 1);
+                    input.erase(input.begin() + long(from), input.begin() + long(from + length));
+                }
+                break;
+            case 7:
+                if (size < FUZZ_INPUT_MAX) {
+                    size_t length = 1 + random() % std::min<size_t>(FUZZ_INPUT_MAX - size, 64);
+                    std::vector<unsigned char> block(length, (unsigned char)(random()));
+                    if (size != 0 && (random() & 1)) {
+                        // clone a part of the input
+                        size_t from = random() % size;
+                        block.assign(input.begin() + long(from), input.begin() + long(std::min(size, from + length)));
+                    }
+                    input.insert(input.begin() + long(random() % (size + 1)), block.begin(), block.end());
+                }
+                break;
+            default:
+                if (size >= 2) {
+                    size_t length = 1 + random() % std::min<size_t>(size / 2, 64);
+                    size_t from = random() % (size - length + 1);
+                    size_t to = random() % (size - length + 1);
+                    std::memmove(&input[to], &input[from], length);
+                }
+                break;
+        }
+    }
+}
+
+/**
+ * Writes an input into a file
+ * @param path  path of the file
+ * @param input the input
+ */
+void Fuzzer::save (const std::string &path, const std::vector<unsigned char> &input) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char *>(input.data()), std::streamsize(input.size()));
+}
+
+/**
+ * @return  number of bitmap entries reached by the corpus
+ */
+unsigned int Fuzzer::edges () {
+    return std::count_if(m_virgin.begin(), m_virgin.end(), [](uint8_t bits) { return bits != 0xFF; });
+}
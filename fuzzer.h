@@ -0,0 +1,126 @@
+// fuzzer.h
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#ifndef ISA_SIM_CPP_FUZZER_H
+#define ISA_SIM_CPP_FUZZER_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+#include "guest_scheduler.h"
+#include "program_image.h"
+
+#define FUZZ_MAP_BITS       16
+#define FUZZ_MAP_SIZE       (1u << FUZZ_MAP_BITS)   // bytes of the coverage bitmap, as in AFL
+#define FUZZ_INPUT_BASE     0x70000u                // guest address of the input, below the heap
+#define FUZZ_INPUT_MAX      0x10000u
+#define FUZZ_RUNS_DEFAULT   1000000ull
+#define FUZZ_STEPS_DEFAULT  1000000ull              // instructions per input before it counts as a hang
+#define FUZZ_MUTATIONS      32                      // inputs derived from a corpus entry before the next one is picked
+#define FUZZ_STACKING       16                      // highest number of mutations applied to one input
+
+/**
+ * Edge coverage of one execution in the layout of AFL: every control transfer
+ * from block A to block B increments the counter at hash(B) ^ (hash(A) >> 1).
+ * A block starts at every instruction following a branch or a jump, taken or not.
+ * The counters saturate at 255. The entries hit by the execution are listed, so
+ * evaluating and clearing the map costs as much as the edges it reached.
+ */
+class CoverageMap {
+public:
+    CoverageMap ();
+    void fetch (unsigned int pc, unsigned int inst) {
+        if (m_edge) {
+            unsigned int location = (pc >> 1) * 0x9E3779B1u >> (32 - FUZZ_MAP_BITS);
+            uint8_t &counter = m_map[location ^ m_previous];
+            if (counter == 0) {
+                m_hit.push_back(location ^ m_previous);
+            }
+            counter += counter != 255;
+            m_previous = location >> 1;
+        }
+        unsigned int opcode = inst & 0x7Fu;
+        m_edge = opcode == 0x63 || opcode == 0x6F || opcode == 0x67;
+    }
+    void clear ();
+private:
+    friend class Fuzzer;
+
+    alignas(64) std::array<uint8_t, FUZZ_MAP_SIZE> m_map;
+    std::vector<uint32_t> m_hit;    // entries of the map which are not zero
+    unsigned int m_previous;
+    bool m_edge;                    // the last instruction was a branch or a jump
+};
+
+/**
+ * Instance of the program under test reused for every input: the machine is
+ * reset between the inputs instead of being created again
+ */
+class FuzzTarget {
+public:
+    explicit FuzzTarget (std::shared_ptr<const ProgramImage> image);
+    ~FuzzTarget ();
+    FuzzTarget (const FuzzTarget &) = delete;
+    FuzzTarget &operator= (const FuzzTarget &) = delete;
+    exec_result_t execute (const std::vector<unsigned char> &input, unsigned long long steps);
+    Hart *hart () { return m_guest.hart(); }
+    CoverageMap &coverage () { return m_coverage; }
+private:
+    Guest m_guest;
+    CoverageMap m_coverage;
+    unsigned char *m_input;         // FUZZ_INPUT_MAX bytes mapped into the guest, zero after the input
+    unsigned int m_length;          // length of the last input
+};
+
+/**
+ * Coverage-guided fuzzer of a guest program in the style of AFL. The program
+ * gets the address of the input in a0 and its length in a1, the input is mapped
+ * read-only into its memory at FUZZ_INPUT_BASE and copied on write. Worker
+ * threads pick entries of the corpus, mutate them, run the program on the
+ * results and keep the inputs which reach new edges or new hit counts of
+ * edges. An exit of the program is a normal completion whatever its exit
+ * code; a fault, an illegal or unsupported instruction or a jump to a wrong
+ * address is a crash, its input is saved once per distinct reason.
+ */
+class Fuzzer {
+public:
+    Fuzzer (unsigned int threads, unsigned long long seed);
+    void setRuns (unsigned long long runs) { m_runs = runs; }
+    void setSteps (unsigned long long steps) { m_steps = steps; }
+    bool loadFile (const char *filepath);
+    bool loadCorpus (const char *directory);
+    bool run ();
+private:
+    void work (unsigned int worker);
+    void evaluate (FuzzTarget &target, exec_result_t result, const std::vector<unsigned char> &input,
+                   std::array<uint8_t, FUZZ_MAP_SIZE> &virgin, bool keep);
+    static void classify (CoverageMap &coverage);
+    static bool merge (const CoverageMap &coverage, std::array<uint8_t, FUZZ_MAP_SIZE> &virgin);
+    static void mutate (std::vector<unsigned char> &input, std::mt19937_64 &random);
+    static void save (const std::string &path, const std::vector<unsigned char> &input);
+    unsigned int edges ();
+
+    unsigned int m_threads;
+    unsigned long long m_seed;
+    unsigned long long m_runs;
+    unsigned long long m_steps;
+    std::shared_ptr<const ProgramImage> m_image;
+    std::string m_directory;
+    std::mutex m_lock;                              // corpus, virgin map and crashes
+    std::vector<std::vector<unsigned char>> m_corpus;
+    std::array<uint8_t, FUZZ_MAP_SIZE> m_virgin;    // bits of the hit count classes not seen yet
+    std::set<std::string> m_crashes;                // reasons of the saved crashes
+    std::atomic<unsigned long long> m_executions;
+    std::atomic<unsigned long long> m_crash_count;
+    std::atomic<unsigned long long> m_hangs;
+};
+
+
+#endif //ISA_SIM_CPP_FUZZER_H
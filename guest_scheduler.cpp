@@ -0,0 +1,221 @@
+// guest_scheduler.cpp
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#include <thread>
+#include "guest_scheduler.h"
+
+GuestTask &GuestTask::operator= (GuestTask &&other) noexcept {
+    if (this != &other) {
+        if (m_handle) {
+            m_handle.destroy();
+        }
+        m_handle = other.m_handle;
+        other.m_handle = nullptr;
+    }
+    return *this;
+}
+
+GuestTask::~GuestTask () {
+    if (m_handle) {
+        m_handle.destroy();
+    }
+}
+
+/**
+ * Guest constructor: creates the hart and its coroutine, which starts suspended
+ * @param id        guest id, placed into a0
+ * @param image     program image shared with the other guests
+ * @param quantum   number of instructions executed before the guest yields
+ */
+Guest::Guest (unsigned int id, std::shared_ptr<const ProgramImage> image, unsigned long long quantum)
+        : m_image(std::move(image)), m_quantum(quantum), m_syscalls(m_image->size()),
+          m_hart(id, m_memory) {
+    m_memory.loadImage(m_image);
+    m_hart.setSyscalls(&m_syscalls);
+    m_task = execute(quantum);
+}
+
+/**
+ * Puts the guest into the state it was created in, so it can run its program
+ * again without allocating a new hart and memory
+ * @param id        new guest id, placed into a0
+ */
+void Guest::reset (unsigned int id) {
+    m_memory.clear();
+    m_syscalls.reset();
+    m_hart.reset(id);
+    m_task = execute(m_quantum);
+}
+
+/**
+ * Body of the guest coroutine, the guest yields after every quantum and after every
+ * system call, so a guest waiting for the host does not hold its thread for a quantum
+ * @param quantum   number of instructions executed before the guest yields
+ */
+GuestTask Guest::execute (unsigned long long quantum) {
+    exec_result_t result;
+    while ((result = m_hart.run(quantum, true)) == EXEC_OK || result == EXEC_YIELD) {
+        co_await std::suspend_always{};
+    }
+}
+
+/**
+ * Runs the guest until it yields or terminates on the calling host thread
+ */
+void Guest::resume () {
+    // the host FPU state belongs to the guest which is running on the thread
+    m_hart.floatRegisters()->attachHost();
+    m_task.resume();
+    m_hart.floatRegisters()->detachHost();
+}
+
+/**
+ * Guest scheduler constructor
+ * @param threads   number of host threads
+ */
+GuestScheduler::GuestScheduler (unsigned int threads) : workers(new worker_t[threads]) {
+    thread_count = threads;
+    remaining = 0;
+    queued = 0;
+    sleeping = 0;
+    for (unsigned int i = 0; i < thread_count; i++) {
+        workers[i].switches = 0;
+        workers[i].steals = 0;
+    }
+}
+
+/**
+ * Runs all guests until every one of them terminates. The guests are dealt
+ * to the host threads in round-robin order at start.
+ * @param guests    guests to be executed
+ */
+void GuestScheduler::run (const std::vector<Guest*> &guests) {
+    for (unsigned long i = 0; i < guests.size(); i++) {
+        workers[i % thread_count].ready.push_back(guests[i]);
+    }
+    remaining = guests.size();
+    queued = guests.size();
+
+    std::vector<std::thread> threads;
+    for (unsigned int i = 1; i < thread_count; i++) {
+        threads.emplace_back(&GuestScheduler::work, this, i);
+    }
+    work(0);
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+}
+
+/**
+ * Scheduling loop of one host thread
+ * @param self  index of the thread
+ */
+void GuestScheduler::work (unsigned int self) {
+    worker_t &worker = workers[self];
+    while (remaining.load(std::memory_order_acquire) != 0) {
+        Guest *guest = next(self);
+        if (guest == nullptr) {
+            // the remaining guests are running on the other threads
+            park();
+            continue;
+        }
+        guest->resume();
+        worker.switches++;
+        if (guest->done()) {
+            if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                wake(true);
+            }
+        } else {
+            {
+                std::lock_guard<std::mutex> guard(worker.lock);
+                worker.ready.push_back(guest);
+            }
+            queued.fetch_add(1);
+            wake(false);
+        }
+    }
+}
+
+/**
+ * Sleeps until a guest is queued or all guests terminated
+ */
+void GuestScheduler::park () {
+    std::unique_lock<std::mutex> guard(idle_lock);
+    sleeping.fetch_add(1);
+    idle.wait(guard, [this] { return queued.load() != 0 || remaining.load() == 0; });
+    sleeping.fetch_sub(1);
+}
+
+/**
+ * Wakes sleeping threads after a guest was queued or the last guest terminated.
+ * The queue or the counter is updated before, so a thread going to sleep at
+ * the same time either sees the change or is already counted as sleeping.
+ * @param all   true to wake all threads, one otherwise
+ */
+void GuestScheduler::wake (bool all) {
+    if (sleeping.load() == 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> guard(idle_lock);
+    if (all) {
+        idle.notify_all();
+    } else {
+        idle.notify_one();
+    }
+}
+
+/**
+ * Takes the next guest from the front of the own queue or steals one
+ * from the back of the queue of another thread
+ * @param self  index of the thread
+ * @return      guest to be resumed or nullptr if there is none
+ */
+Guest *GuestScheduler::next (unsigned int self) {
+    {
+        worker_t &worker = workers[self];
+        std::lock_guard<std::mutex> guard(worker.lock);
+        if (!worker.ready.empty()) {
+            Guest *guest = worker.ready.front();
+            worker.ready.pop_front();
+            queued.fetch_sub(1);
+            return guest;
+        }
+    }
+    for (unsigned int i = 1; i < thread_count; i++) {
+        worker_t &victim = workers[(self + i) % thread_count];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if (!victim.ready.empty()) {
+            Guest *guest = victim.ready.back();
+            victim.ready.pop_back();
+            queued.fetch_sub(1);
+            workers[self].steals++;
+            return guest;
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * Counts the guest resumptions of all threads
+ * @return  number of resumptions
+ */
+unsigned long long GuestScheduler::switches () const {
+    unsigned long long count = 0;
+    for (unsigned int i = 0; i < thread_count; i++) {
+        count += workers[i].switches;
+    }
+    return count;
+}
+
+/**
+ * Counts the guests stolen by all threads
+ * @return  number of steals
+ */
+unsigned long long GuestScheduler::steals () const {
+    unsigned long long count = 0;
+    for (unsigned int i = 0; i < thread_count; i++) {
+        count += workers[i].steals;
+    }
+    return count;
+}
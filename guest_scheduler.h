@@ -0,0 +1,109 @@
+// guest_scheduler.h
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#ifndef ISA_SIM_CPP_GUEST_SCHEDULER_H
+#define ISA_SIM_CPP_GUEST_SCHEDULER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "hart.h"
+#include "program_image.h"
+#include "stack.h"
+#include "syscall_handler.h"
+
+/**
+ * Coroutine executing a guest, it is suspended after every quantum of instructions
+ * and every system call and finishes when the guest terminates
+ */
+class GuestTask {
+public:
+    struct promise_type {
+        GuestTask get_return_object () { return GuestTask(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_always initial_suspend () noexcept { return {}; }
+        std::suspend_always final_suspend () noexcept { return {}; }
+        void return_void () {}
+        void unhandled_exception () { std::terminate(); }
+    };
+
+    GuestTask () = default;
+    explicit GuestTask (std::coroutine_handle<promise_type> handle) : m_handle(handle) {}
+    GuestTask (GuestTask &&other) noexcept : m_handle(other.m_handle) { other.m_handle = nullptr; }
+    GuestTask &operator= (GuestTask &&other) noexcept;
+    ~GuestTask ();
+
+    void resume () { m_handle.resume(); }
+    bool done () const { return m_handle.done(); }
+private:
+    std::coroutine_handle<promise_type> m_handle;
+};
+
+/**
+ * Independent machine running one program: a single hart with its own
+ * sparse data memory and system calls. Its id is placed into a0 at start.
+ * The program image is shared with the other guests running the same binary.
+ */
+class Guest {
+public:
+    Guest (unsigned int id, std::shared_ptr<const ProgramImage> image, unsigned long long quantum);
+    void resume ();
+    void reset (unsigned int id);
+    bool done () const { return m_task.done(); }
+    Hart *hart () { return &m_hart; }
+    Stack *memory () { return &m_memory; }
+private:
+    GuestTask execute (unsigned long long quantum);
+
+    std::shared_ptr<const ProgramImage> m_image;
+    unsigned long long m_quantum;
+    Stack m_memory;
+    SyscallHandler m_syscalls;
+    Hart m_hart;
+    GuestTask m_task;
+};
+
+/**
+ * Multiplexes guests on a few host threads. Every thread has its own queue of
+ * ready guests and resumes them one quantum at a time in round-robin order,
+ * a thread whose queue is empty steals a guest from the back of another queue.
+ * A thread which finds no guest in any queue sleeps until a guest is queued.
+ */
+class GuestScheduler {
+public:
+    explicit GuestScheduler (unsigned int threads);
+    void run (const std::vector<Guest*> &guests);
+    unsigned long long switches () const;
+    unsigned long long steals () const;
+private:
+    /**
+     * Ready queue of one host thread, aligned so the queues do not share cache lines
+     */
+    struct alignas(64) worker_t {
+        std::mutex lock;
+        std::deque<Guest*> ready;
+        unsigned long long switches;
+        unsigned long long steals;
+    };
+
+    void work (unsigned int self);
+    Guest *next (unsigned int self);
+    void park ();
+    void wake (bool all);
+
+    unsigned int thread_count;
+    std::unique_ptr<worker_t[]> workers;
+    std::atomic<unsigned long> remaining;
+    std::atomic<unsigned long> queued;          // guests in the ready queues
+    std::atomic<unsigned int> sleeping;         // threads waiting in park
+    std::mutex idle_lock;
+    std::condition_variable idle;
+};
+
+
+#endif //ISA_SIM_CPP_GUEST_SCHEDULER_H
@@ -0,0 +1,528 @@
+// hart.cpp
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include "hart.h"
+#include "code_memory.h"
+#include "snapshot.h"
+#include "float_decoder.h"
+#include "vector_decoder.h"
+#include "atomic_decoder.h"
+#include "disassembler.h"
+#include "compressed_expander.h"
+
+/**
+ * Hart constructor: creates the decoders working on the register files of the hart
+ * @param id            hart id, also placed into a0 and readable as mhartid
+ * @param memory        data memory, the program image is loaded into it before the hart runs
+ */
+Hart::Hart (unsigned int id, Stack &memory) : fusion(&m_reg, &memory) {
+    m_id = id;
+    m_memory = &memory;
+    inst_mem = nullptr;
+    decoded_mem = nullptr;
+    code_size = 0;
+    m_syscalls = nullptr;
+    m_profile = nullptr;
+    m_cache_trace = nullptr;
+    m_coverage = nullptr;
+    m_loop_profile = nullptr;
+    term = new Termination();
+    reset(id);
+
+    decoders[DECODER_NONE] = nullptr;
+    decoders[DECODER_REG_ARITH] = new RegArithLogDecoder(*this);
+    decoders[DECODER_IMM_ARITH] = new ImmArithLogDecoder(*this);
+    decoders[DECODER_LOAD] = new LoadDecoder(*this);
+    decoders[DECODER_STORE] = new StoreDecoder(*this);
+    decoders[DECODER_BRANCH] = new BranchDecoder(*this);
+    decoders[DECODER_UPPER_IMM] = new UpperImmDecoder(*this);
+    decoders[DECODER_JUMP_LINK] = new JumpLinkDecoder(*this);
+    decoders[DECODER_JUMP_LINK_REG] = new JumpLinkRegDecoder(*this);
+    decoders[DECODER_ECALL] = new EcallDecoder(*this);
+    decoders[DECODER_FENCE] = new FenceDecoder(*this);
+    decoders[DECODER_ATOMIC] = new AtomicDecoder(*this);
+    decoders[DECODER_FLOAT_LOAD] = new FloatLoadDecoder(*this);
+    decoders[DECODER_FLOAT_STORE] = new FloatStoreDecoder(*this);
+    decoders[DECODER_FLOAT_FMA] = new FloatFusedMulAddDecoder(*this);
+    decoders[DECODER_FLOAT_ARITH] = new FloatArithDecoder(*this);
+    decoders[DECODER_VECTOR_LOAD] = new VectorLoadDecoder(*this);
+    decoders[DECODER_VECTOR_STORE] = new VectorStoreDecoder(*this);
+    decoders[DECODER_VECTOR_ARITH] = new VectorArithDecoder(*this);
+    decoders[DECODER_STALE] = new StaleCodeDecoder(*this);
+}
+
+/**
+ * Puts the hart into its initial state: pc and all registers are zero except
+ * a0 holding the hart id, no interrupts are enabled and no events are pending.
+ * The decoders are kept, so a hart can run the same program again without being rebuilt.
+ * @param id    hart id, placed into a0
+ */
+void Hart::reset (unsigned int id) {
+    m_id = id;
+    pc = 0;
+    m_halt = halt_t{"", 0, false};
+    m_reg = RegisterFile();
+    m_reg.write(RegisterFile::x10, id);
+    m_freg = FloatRegisterFile();
+    m_vreg.clear();
+    m_stats = Statistics();
+
+    m_mstatus = MSTATUS_MPP;
+    m_mie = 0;
+    m_mip = 0;
+    m_mtvec = 0;
+    m_mscratch = 0;
+    m_mepc = 0;
+    m_mcause = 0;
+    m_mtval = 0;
+    m_mtimecmp = EVENT_NEVER;
+    m_idle = 0;
+    m_timer_event = EVENT_NEVER;
+    m_deadline = 0;
+    m_marker = false;
+    m_syscall_yield = false;
+    m_yielded = false;
+    m_events = EventQueue();
+}
+
+thread_local Hart *Hart::s_current = nullptr;
+
+/**
+ * Executes instructions until count of them is reached or the hart terminates.
+ * Instructions are executed in runs which end at the deadline of the first event,
+ * events and interrupts are handled between the runs. The marker ecall ends the run early,
+ * so does a system call if syscall_yield is set.
+ * @param count         number of instructions
+ * @param syscall_yield true to end the run after an ecall handled by the system calls
+ * @return              EXEC_OK or EXEC_YIELD if the hart can continue, the reason is in halt() otherwise
+ */
+exec_result_t Hart::run (unsigned long long count, bool syscall_yield) {
+    s_current = this;
+    unsigned long long end = m_stats.instructions() + count;
+    m_marker = false;
+    m_syscall_yield = syscall_yield;
+    m_yielded = false;
+    try {
+        while (m_stats.instructions() < end && !m_marker && !m_yielded) {
+            refreshCode();
+            service_events();
+            unsigned long long next = m_events.next() - time();
+            __atomic_store_n(&m_deadline, m_stats.instructions() + std::min(next, end - m_stats.instructions()),
+                             __ATOMIC_RELAXED);
+            (this->*s_run_loops[Instrumentation::selected()])();
+        }
+    } catch (const halt_t &halt) {
+        m_halt = halt;
+        return halt.exit_code == 0 || halt.guest_exit ? EXEC_ECALL : EXEC_ERROR;
+    } catch (const fetch_fault_t &fault) {
+        if (fault.pc == code_size * 2 + 4) {
+            // one further than the size => EOF
+            m_halt = halt_t{"End of file reached", 0, false};
+            return EXEC_EOF;
+        }
+        //wrong address (pc)
+        m_halt = halt_t{"Wrong instruction address: pc = " + std::to_string(fault.pc), 2, false};
+        return EXEC_ERROR;
+    } catch (const std::out_of_range& e) {
+        // other error
+        std::string msg = "Unknown error occurred: ";
+        msg += e.what();
+        m_halt = halt_t{msg, -1, false};
+        return EXEC_ERROR;
+    }
+    return m_yielded ? EXEC_YIELD : EXEC_OK;
+}
+
+/**
+ * @return  run loops of all instrumentation variants, in the order of their index
+ */
+template<unsigned int... Variants>
+std::array<Hart::run_loop_t, sizeof...(Variants)> Hart::run_loops (std::integer_sequence<unsigned int, Variants...>) {
+    return {&Hart::run_instructions<InstrumentationVariant<Variants>>...};
+}
+
+const std::array<Hart::run_loop_t, INSTRUMENT_VARIANTS> Hart::s_run_loops =
+        Hart::run_loops(std::make_integer_sequence<unsigned int, INSTRUMENT_VARIANTS>());
+
+/**
+ * Executes instructions until the deadline of the current run
+ * @tparam Policy   instrumentation policy, its hooks are inlined into the loop
+ */
+template<typename Policy>
+void Hart::run_instructions () {
+    while (m_stats.instructions() < __atomic_load_n(&m_deadline, __ATOMIC_RELAXED)) {
+        executeInstruction<Policy>();
+    }
+}
+
+/**
+ * Fetch and execute next instruction from the instruction memory
+ * @tparam Policy   instrumentation policy
+ */
+template<typename Policy>
+void Hart::executeInstruction () {
+    // fetch predecoded instruction
+    if (pc / 2 >= code_size) {
+        throw fetch_fault_t{pc};
+    }
+    const predecoded_t &entry = decoded_mem[pc / 2];
+    unsigned int inst = inst_mem[pc / 2];
+    if constexpr (Policy::active) {
+        // the hooks see a compressed instruction at its own pc, so expanded without the bias
+        Policy::fetch(*this, pc, entry.compressed ? CompressedExpander::expand(m_memory->readHalf(pc)) : inst);
+    }
+
+#ifdef DEBUG
+    std::cout << Disassembler::disassemble(inst) << "\r\n";
+    if (entry.fusion != FUSE_NONE) {
+        std::cout << Disassembler::disassemble(inst_mem[pc / 2 + 2]) << "\r\n";
+    }
+#endif
+
+    // execute instruction (or fused pair) and update pc, instrumented runs do not fuse and
+    // a pair is split when only one instruction is left before the deadline
+    if (!Policy::active && entry.fusion != FUSE_NONE
+        && m_stats.instructions() + 2 <= __atomic_load_n(&m_deadline, __ATOMIC_RELAXED)) {
+        m_stats.countFusion(entry.fusion);
+        pc = fusion.execute(entry.fusion, pc, inst, inst_mem[pc / 2 + 2]);
+    } else if (entry.decoder != DECODER_NONE) {
+        m_stats.countInstruction();
+        if constexpr (Policy::active) {
+            pc = execute_instrumented<Policy>(entry, inst);
+        } else {
+            // compressed instructions execute two bytes early, see ProgramImage::fetch
+            pc = decoders[entry.decoder]->decode(pc - 2 * entry.compressed, inst);
+        }
+    } else {
+        // stores do not invalidate unknown opcodes, the stale decoder predecodes the
+        // instruction again from the memory and terminates if the opcode is still unknown
+        m_stats.countInstruction();
+        if constexpr (Policy::active) {
+            pc = execute_instrumented<Policy>(entry, inst);
+        } else {
+            pc = decoders[DECODER_STALE]->decode(pc, inst);
+        }
+    }
+
+#ifdef DEBUG
+    std::cout << "\nProgram counter: " << std::dec << pc << "\n";
+    m_reg.print_registers();
+#endif
+}
+
+/**
+ * Executes an instruction and calls the memory access and register write hooks
+ * @tparam Policy   instrumentation policy
+ * @param entry     predecoded instruction
+ * @param inst      instruction, compressed ones expanded
+ * @return          new program counter
+ */
+template<typename Policy>
+unsigned int Hart::execute_instrumented (const predecoded_t &entry, unsigned int inst) {
+    decoder_t kind = entry.decoder;
+    bool compressed = entry.compressed;
+    if (kind == DECODER_STALE || kind == DECODER_NONE) {
+        // refreshed before the stale decoder does it, so the hooks see the new instruction
+        m_memory->code()->refresh(pc / 2);
+        inst = m_memory->code()->instructions()[pc / 2];
+        kind = DECODER_STALE;
+        compressed = false;
+    }
+    unsigned int address = 0;
+    bool store = false;
+    if (Instrumentation::memoryAddress(inst, m_reg.read(RegisterFile::Register(inst >> 15u & 0x1Fu)), address, store)) {
+        Policy::memoryAccess(*this, address, store);
+    }
+    unsigned int next = decoders[kind]->decode(pc - 2 * compressed, inst);
+    auto rd = RegisterFile::Register(inst >> 7u & 0x1Fu);
+    if (rd != RegisterFile::x0 && Instrumentation::writesRegister(inst)) {
+        Policy::registerWrite(*this, rd, m_reg.read(rd));
+    }
+    return next;
+}
+
+/**
+ * Switches to the current instructions of the guest, which become a private
+ * copy once a hart stores into the code
+ */
+void Hart::refreshCode () {
+    inst_mem = m_memory->code()->instructions();
+    decoded_mem = m_memory->code()->decoded();
+    code_size = m_memory->code()->size();
+}
+
+/**
+ * Handles the events whose deadline has arrived and takes a pending interrupt
+ */
+void Hart::service_events () {
+    unsigned long long now = time();
+    while (m_events.due(now)) {
+        event_t event = m_events.pop();
+        switch (event.kind) {
+            case EVENT_TIMER:
+                if (event.deadline == m_timer_event) {
+                    m_timer_event = EVENT_NEVER;
+                }
+                break;
+        }
+    }
+    // mtimecmp may have been written by another hart since the last boundary
+    update_timer(now);
+    take_interrupt();
+}
+
+/**
+ * Sets the timer interrupt pending if mtime reached mtimecmp,
+ * otherwise clears it and schedules the event of reaching it
+ * @param now   current value of mtime
+ */
+void Hart::update_timer (unsigned long long now) {
+    unsigned long long compare = timerCompare();
+    if (now >= compare) {
+        __atomic_fetch_or(&m_mip, 1u << IRQ_MTI, __ATOMIC_ACQ_REL);
+        return;
+    }
+    __atomic_fetch_and(&m_mip, ~(1u << IRQ_MTI), __ATOMIC_ACQ_REL);
+    if (compare != m_timer_event && compare != EVENT_NEVER) {
+        // the event of an older mtimecmp stays in the queue and is ignored when it arrives
+        m_events.schedule(compare, EVENT_TIMER);
+        m_timer_event = compare;
+    }
+}
+
+/**
+ * Enters the trap handler if an enabled interrupt is pending.
+ * External interrupts have the highest priority, then software and timer ones.
+ */
+void Hart::take_interrupt () {
+    unsigned int pending = __atomic_load_n(&m_mip, __ATOMIC_ACQUIRE) & m_mie;
+    if (!(m_mstatus & MSTATUS_MIE) || pending == 0) {
+        return;
+    }
+    unsigned int irq = IRQ_MTI;
+    if (pending & (1u << IRQ_MEI)) {
+        irq = IRQ_MEI;
+    } else if (pending & (1u << IRQ_MSI)) {
+        irq = IRQ_MSI;
+    }
+
+    m_mepc = pc;
+    m_mcause = MCAUSE_INTERRUPT | irq;
+    m_mtval = 0;
+    // MPIE = MIE, MIE = 0, MPP = machine mode
+    m_mstatus = (m_mstatus & ~(MSTATUS_MIE | MSTATUS_MPIE)) | MSTATUS_MPIE | MSTATUS_MPP;
+    // vectored mode jumps to base + 4 * cause
+    pc = (m_mtvec & ~3u) + ((m_mtvec & 3u) == 1 ? 4 * irq : 0);
+    m_stats.countInterrupt();
+
+#ifdef DEBUG
+    std::cout << "Interrupt " << std::dec << irq << " taken, mepc = " << m_mepc << "\n";
+#endif
+}
+
+/**
+ * Sets mtime of the hart, the time of the hart advances from this value
+ * @param value     new value of mtime
+ */
+void Hart::setTime (unsigned long long value) {
+    m_idle = value - m_stats.instructions();
+    kick();
+}
+
+/**
+ * Writes mtimecmp of the hart, may be called from other threads
+ * @param value     new value of mtimecmp
+ */
+void Hart::setTimerCompare (unsigned long long value) {
+    __atomic_store_n(&m_mtimecmp, value, __ATOMIC_RELEASE);
+    kick();
+}
+
+/**
+ * Sets or clears a pending interrupt, may be called from other threads and devices
+ * @param irq       interrupt number
+ * @param pending   true to set the interrupt pending
+ */
+void Hart::setInterruptPending (unsigned int irq, bool pending) {
+    if (pending) {
+        __atomic_fetch_or(&m_mip, 1u << irq, __ATOMIC_ACQ_REL);
+    } else {
+        __atomic_fetch_and(&m_mip, ~(1u << irq), __ATOMIC_ACQ_REL);
+    }
+    kick();
+}
+
+/**
+ * Reads machine-mode trap handling and counter registers
+ * @param csr   register number
+ * @param data  read value
+ * @return      false if the register is not implemented
+ */
+bool Hart::readCsr (unsigned int csr, unsigned int &data) {
+    switch (csr) {
+        case CSR_MSTATUS:
+            data = m_mstatus;
+            return true;
+        case CSR_MIE:
+            data = m_mie;
+            return true;
+        case CSR_MTVEC:
+            data = m_mtvec;
+            return true;
+        case CSR_MSCRATCH:
+            data = m_mscratch;
+            return true;
+        case CSR_MEPC:
+            data = m_mepc;
+            return true;
+        case CSR_MCAUSE:
+            data = m_mcause;
+            return true;
+        case CSR_MTVAL:
+            data = m_mtval;
+            return true;
+        case CSR_MIP:
+            data = __atomic_load_n(&m_mip, __ATOMIC_ACQUIRE);
+            return true;
+        case CSR_CYCLE:
+        case CSR_INSTRET:
+            data = (unsigned int)(m_stats.instructions());
+            return true;
+        case CSR_CYCLEH:
+        case CSR_INSTRETH:
+            data = (unsigned int)(m_stats.instructions() >> 32u);
+            return true;
+        case CSR_TIME:
+            data = (unsigned int)(time());
+            return true;
+        case CSR_TIMEH:
+            data = (unsigned int)(time() >> 32u);
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * Writes machine-mode trap handling registers. Enabling interrupts ends
+ * the current run, so an interrupt which is already pending is taken at once.
+ * @param csr   register number
+ * @param data  value to be written
+ */
+void Hart::writeCsr (unsigned int csr, unsigned int data) {
+    switch (csr) {
+        case CSR_MSTATUS:
+            m_mstatus = (data & (MSTATUS_MIE | MSTATUS_MPIE)) | MSTATUS_MPP;
+            kick();
+            break;
+        case CSR_MIE:
+            m_mie = data & ((1u << IRQ_MSI) | (1u << IRQ_MTI) | (1u << IRQ_MEI));
+            kick();
+            break;
+        case CSR_MTVEC:
+            // only direct (0) and vectored (1) modes
+            m_mtvec = data & ~2u;
+            break;
+        case CSR_MSCRATCH:
+            m_mscratch = data;
+            break;
+        case CSR_MEPC:
+            m_mepc = data & ~1u;
+            break;
+        case CSR_MCAUSE:
+            m_mcause = data;
+            break;
+        case CSR_MTVAL:
+            m_mtval = data;
+            break;
+        default:
+            // mip and the counters are read-only
+            break;
+    }
+}
+
+/**
+ * Returns from the trap handler
+ * @return  address of the interrupted instruction
+ */
+unsigned int Hart::mret () {
+    // MIE = MPIE, MPIE = 1
+    m_mstatus = (m_mstatus & ~MSTATUS_MIE) | (m_mstatus & MSTATUS_MPIE ? MSTATUS_MIE : 0) | MSTATUS_MPIE;
+    kick();
+    return m_mepc;
+}
+
+/**
+ * Waits for an interrupt. Instead of executing the idle time, mtime jumps
+ * to the deadline of the first event. Without any event nothing can wake
+ * the hart up, so the instruction does nothing.
+ */
+void Hart::waitForInterrupt () {
+    if (__atomic_load_n(&m_mip, __ATOMIC_ACQUIRE) & m_mie) {
+        return;
+    }
+    update_timer(time());
+    unsigned long long next = m_events.next();
+    if (next == EVENT_NEVER) {
+        return;
+    }
+    if (next > time()) {
+        m_idle += next - time();
+    }
+    kick();
+}
+
+/**
+ * Writes the architectural state of the hart and its pending events into a snapshot.
+ * Must be called between runs.
+ * @param out   snapshot stream
+ */
+void Hart::save (std::ostream &out) {
+    save_value(out, pc);
+    m_reg.save(out);
+    // collect the flags raised by the host FPU so far
+    m_freg.readFlags();
+    m_freg.save(out);
+    m_vreg.save(out);
+    m_stats.save(out);
+    save_value(out, m_mstatus);
+    save_value(out, m_mie);
+    save_value(out, m_mip);
+    save_value(out, m_mtvec);
+    save_value(out, m_mscratch);
+    save_value(out, m_mepc);
+    save_value(out, m_mcause);
+    save_value(out, m_mtval);
+    save_value(out, m_mtimecmp);
+    save_value(out, m_idle);
+    save_value(out, m_timer_event);
+    m_events.save(out);
+}
+
+/**
+ * Reads the architectural state of the hart and its pending events from a snapshot
+ * @param in    snapshot stream
+ */
+void Hart::restore (std::istream &in) {
+    restore_value(in, pc);
+    m_reg.restore(in);
+    m_freg.restore(in);
+    m_vreg.restore(in);
+    m_stats.restore(in);
+    restore_value(in, m_mstatus);
+    restore_value(in, m_mie);
+    restore_value(in, m_mip);
+    restore_value(in, m_mtvec);
+    restore_value(in, m_mscratch);
+    restore_value(in, m_mepc);
+    restore_value(in, m_mcause);
+    restore_value(in, m_mtval);
+    restore_value(in, m_mtimecmp);
+    restore_value(in, m_idle);
+    restore_value(in, m_timer_event);
+    m_events.restore(in);
+}
@@ -0,0 +1,217 @@
+// hart.h
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#ifndef ISA_SIM_CPP_HART_H
+#define ISA_SIM_CPP_HART_H
+
+#include <array>
+#include <istream>
+#include <ostream>
+#include <utility>
+#include <vector>
+#include "instruction_decoder.h"
+#include "register_file.h"
+#include "float_register_file.h"
+#include "vector_register_file.h"
+#include "termination.h"
+#include "macro_fusion.h"
+#include "statistics.h"
+#include "event_queue.h"
+#include "instrumentation.h"
+
+class SyscallHandler;
+class CodeMemory;
+class MemoryProfile;
+class CacheTrace;
+class CoverageMap;
+class LoopProfile;
+
+// mstatus fields, only machine mode is implemented
+#define MSTATUS_MIE         (1u << 3u)
+#define MSTATUS_MPIE        (1u << 7u)
+#define MSTATUS_MPP         (3u << 11u)
+
+// interrupt numbers, bits of mip and mie
+#define IRQ_MSI             3
+#define IRQ_MTI             7
+#define IRQ_MEI             11
+#define MCAUSE_INTERRUPT    0x80000000u
+
+// a0 of the marker ecall, which ends the current run of the hart (a checkpoint can be taken there)
+#define ECALL_MARKER        0x100
+
+/**
+ * Thrown by the fetch of an instruction outside of the instruction memory
+ */
+typedef struct {
+    unsigned int pc;
+} fetch_fault_t;
+
+typedef enum {
+    EXEC_OK,
+    EXEC_ERROR,
+    EXEC_EOF,
+    EXEC_ECALL,
+    EXEC_YIELD      // the run ended after a system call, the hart can continue
+} exec_result_t;
+
+/**
+ * Decoders of the instruction groups, every hart has its own instance of each
+ */
+typedef enum {
+    DECODER_NONE,               // unknown opcode
+    DECODER_REG_ARITH,
+    DECODER_IMM_ARITH,
+    DECODER_LOAD,
+    DECODER_STORE,
+    DECODER_BRANCH,
+    DECODER_UPPER_IMM,
+    DECODER_JUMP_LINK,
+    DECODER_JUMP_LINK_REG,
+    DECODER_ECALL,
+    DECODER_FENCE,
+    DECODER_ATOMIC,
+    DECODER_FLOAT_LOAD,
+    DECODER_FLOAT_STORE,
+    DECODER_FLOAT_FMA,
+    DECODER_FLOAT_ARITH,
+    DECODER_VECTOR_LOAD,
+    DECODER_VECTOR_STORE,
+    DECODER_VECTOR_ARITH,
+    DECODER_STALE,              // invalidated by a store, predecoded again when executed
+    DECODER_COUNT
+} decoder_t;
+
+/**
+ * Predecoded instruction memory entry, shared by all harts. There is one for
+ * every halfword, the fields are bytes to keep the table small.
+ */
+typedef struct {
+    decoder_t decoder : 8;
+    fusion_t fusion : 8;            // fusion with the following instruction
+    bool compressed;                // 16-bit instruction, expanded in the instruction memory
+} predecoded_t;
+
+/**
+ * Hardware thread: program counter, register files and decoders working on them.
+ * The instruction memory and the data memory are shared by all harts of a guest.
+ * The hart executes instructions without checking for interrupts until the end
+ * of the run or the deadline of its first event, pending interrupts are taken
+ * only at these boundaries. mtime advances by one with every retired instruction.
+ */
+class Hart {
+public:
+    Hart (unsigned int id, Stack &memory);
+    void reset (unsigned int id);
+    exec_result_t run (unsigned long long count, bool syscall_yield = false);
+
+    unsigned int id () const { return m_id; }
+    unsigned int programCounter () const { return pc; }
+    RegisterFile *registers () { return &m_reg; }
+    FloatRegisterFile *floatRegisters () { return &m_freg; }
+    VectorRegisterFile *vectorRegisters () { return &m_vreg; }
+    Statistics *statistics () { return &m_stats; }
+    Stack *memory () { return m_memory; }
+    InstructionDecoder *decoder (decoder_t kind) { return decoders[kind]; }
+    void refreshCode ();
+    SyscallHandler *syscalls () { return m_syscalls; }
+    void setSyscalls (SyscallHandler *handler) { m_syscalls = handler; }
+    MemoryProfile *memoryProfile () { return m_profile; }
+    void setMemoryProfile (MemoryProfile *profile) { m_profile = profile; }
+    CacheTrace *cacheTrace () { return m_cache_trace; }
+    void setCacheTrace (CacheTrace *trace) { m_cache_trace = trace; }
+    CoverageMap *coverage () { return m_coverage; }
+    void setCoverage (CoverageMap *coverage) { m_coverage = coverage; }
+    LoopProfile *loopProfile () { return m_loop_profile; }
+    void setLoopProfile (LoopProfile *profile) { m_loop_profile = profile; }
+    bool markerReached () const { return m_marker; }
+    void reachMarker () { m_marker = true; kick(); }
+    /**
+     * Ends the current run after a system call if the run was asked to yield on them
+     */
+    void returnFromSyscall () {
+        if (m_syscall_yield) {
+            m_yielded = true;
+            kick();
+        }
+    }
+    const halt_t &halt () const { return m_halt; }
+    void stop (const halt_t &reason) { m_halt = reason; }
+
+    static Hart *current () { return s_current; }
+    unsigned long long time () const { return m_stats.instructions() + m_idle; }
+    void setTime (unsigned long long value);
+    unsigned long long timerCompare () const { return __atomic_load_n(&m_mtimecmp, __ATOMIC_ACQUIRE); }
+    void setTimerCompare (unsigned long long value);
+    bool interruptPending (unsigned int irq) const { return (__atomic_load_n(&m_mip, __ATOMIC_ACQUIRE) >> irq) & 1u; }
+    void setInterruptPending (unsigned int irq, bool pending);
+    bool readCsr (unsigned int csr, unsigned int &data);
+    void writeCsr (unsigned int csr, unsigned int data);
+    unsigned int mret ();
+    void waitForInterrupt ();
+    void save (std::ostream &out);
+    void restore (std::istream &in);
+private:
+    typedef void (Hart::*run_loop_t) ();
+
+    template<unsigned int... Variants>
+    static std::array<run_loop_t, sizeof...(Variants)> run_loops (std::integer_sequence<unsigned int, Variants...>);
+    template<typename Policy> void run_instructions ();
+    template<typename Policy> void executeInstruction ();
+    template<typename Policy> unsigned int execute_instrumented (const predecoded_t &entry, unsigned int inst);
+    void service_events ();
+    void update_timer (unsigned long long now);
+    void take_interrupt ();
+    /**
+     * Ends the current run of instructions at the next boundary, may be called from other threads
+     */
+    void kick () { __atomic_store_n(&m_deadline, 0, __ATOMIC_RELAXED); }
+
+    static thread_local Hart *s_current;        // hart running on the host thread
+    // run loop of every combination of instrumentation policies, indexed by INSTRUMENT_* bits
+    static const std::array<run_loop_t, INSTRUMENT_VARIANTS> s_run_loops;
+
+    unsigned int m_id;
+    unsigned int pc;
+    RegisterFile m_reg;
+    FloatRegisterFile m_freg;
+    VectorRegisterFile m_vreg;
+    Statistics m_stats;
+    MacroFusion fusion;
+    Termination *term;
+    Stack *m_memory;
+    SyscallHandler *m_syscalls;                 // shared by the harts of a guest, may be nullptr
+    MemoryProfile *m_profile;                   // owned by the memory profiler, created on the first access
+    CacheTrace *m_cache_trace;                  // owned by the cache analyzer, created on the first access
+    CoverageMap *m_coverage;                    // owned by the fuzzer, may be nullptr
+    LoopProfile *m_loop_profile;                // owned by the loop profiler, created on the first instruction
+    halt_t m_halt;
+    std::array<InstructionDecoder*, DECODER_COUNT> decoders;
+    // instruction memory of the guest, taken from the data memory at every boundary,
+    // after fence.i and after the hart stored into the code
+    const unsigned int *inst_mem;
+    const predecoded_t *decoded_mem;
+    unsigned long code_size;                    // entries of both, one per halfword
+
+    // machine-mode trap handling
+    unsigned int m_mstatus;
+    unsigned int m_mie;
+    unsigned int m_mip;                         // set by other harts and devices as well
+    unsigned int m_mtvec;
+    unsigned int m_mscratch;
+    unsigned int m_mepc;
+    unsigned int m_mcause;
+    unsigned int m_mtval;
+    unsigned long long m_mtimecmp;              // written through the CLINT
+    unsigned long long m_idle;                  // time skipped by wfi
+    unsigned long long m_timer_event;           // deadline of the scheduled timer event
+    unsigned long long m_deadline;              // retired instructions at the next boundary
+    bool m_marker;                              // the last run ended at the marker ecall
+    bool m_syscall_yield;                       // the current run ends after a system call
+    bool m_yielded;                             // the last run ended after a system call
+    EventQueue m_events;
+};
+
+
+#endif //ISA_SIM_CPP_HART_H
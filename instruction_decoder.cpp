@@ -2,17 +2,44 @@
 // Matej Majtan (s184457) & Søren Tønnesen (s180381)
 // 02-12-2019
 
-#include <iostream>
+#include <bitset>
 #include <string>
 #include "instruction_decoder.h"
+#include "code_memory.h"
+#include "integer_alu.h"
+#include "hart.h"
+#include "syscall_handler.h"
+
+/**
+ * Rotations written so that the compiler emits the host rotate instruction
+ */
+static inline unsigned int rotate_left (unsigned int value, unsigned int shamt) {
+    shamt &= 0x1Fu;
+    return (value << shamt) | (value >> ((32u - shamt) & 0x1Fu));
+}
+
+static inline unsigned int rotate_right (unsigned int value, unsigned int shamt) {
+    shamt &= 0x1Fu;
+    return (value >> shamt) | (value << ((32u - shamt) & 0x1Fu));
+}
+
+/**
+ * Bitwise OR-combine of every byte: 0xFF for each non-zero byte, 0x00 otherwise
+ */
+static inline unsigned int or_combine_bytes (unsigned int value) {
+    // the top bit of every byte is set if any bit of the byte is set
+    unsigned int high = (((value & 0x7F7F7F7Fu) + 0x7F7F7F7Fu) | value) & 0x80808080u;
+    return (high >> 7u) * 0xFFu;
+}
 
 /**
  * InstructionDecoder base constructor
+ * @param hart  hart whose instructions are decoded
  */
-InstructionDecoder::InstructionDecoder () {
+InstructionDecoder::InstructionDecoder (Hart &hart) {
     term = new Termination();
-    reg = RegisterFile::getInstance();
-    stack = Stack::getInstance();
+    reg = hart.registers();
+    stack = hart.memory();
     rs1 = 0;
     rs2 = 0;
     imm = 0;
@@ -28,185 +55,90 @@ unsigned int RegArithLogDecoder::decode (unsigned int pc, unsigned int inst) {
     r_inst_t decoder{};
     decoder.inst = inst;
 
-    // if bit 0 in funct7 is 0 execute basic arithmetic and logic instructions,
-    // otherwise execute instructions from M extension.
-    if (!(decoder.f.funct7 & 0x01u)) {
-        // I extension
-        return i_extension_decode(pc, decoder);
-    } else {
-        // M extension
-        return m_extension_decode(pc, decoder);
+    rs1 = reg->read(decoder.f.rs1);
+    rs2 = reg->read(decoder.f.rs2);
+
+    // the base instructions and the M extension, shared with the lane-parallel engine
+    unsigned int result;
+    if (IntegerAlu::registerOp<unsigned int, int>(decoder.f.funct7 << 3u | decoder.f.funct3, rs1, rs2, result)) {
+        reg->write(decoder.f.rd, result);
+        return pc+4;
     }
+    // Zba and Zbb extension
+    return b_extension_decode(pc, decoder);
 }
 
 /**
- * Function decoding register-register arithmetic and logic instructions
- * for the base instructions in RISCV32I
+ * Function decoding register-register instructions of the Zba and Zbb
+ * bit-manipulation extensions
  * @param pc        program counter
  * @param decoder   decoder union
  * @return          new program counter
  */
-unsigned int RegArithLogDecoder::i_extension_decode (unsigned int pc, r_inst_t decoder) {
+unsigned int RegArithLogDecoder::b_extension_decode (unsigned int pc, r_inst_t decoder) {
     rs1 = reg->read(decoder.f.rs1);
     rs2 = reg->read(decoder.f.rs2);
 
-    std::string i_name;
-
-    switch (decoder.f.funct3) {
-        case 0b000:
-            // check the bit 6 in funct7
-            if (!(decoder.f.funct7 & 0x20u)) {
-                // ADD
-                i_name = "add";
-                reg->write(decoder.f.rd, int(rs1) + int(rs2));
-            } else {
-                // SUB
-                i_name = "sub";
-                reg->write(decoder.f.rd, int(rs1) - int(rs2));
-            }
+    switch (decoder.f.funct7 << 3u | decoder.f.funct3) {
+        case 0b0010000010:
+            // SH1ADD
+            reg->write(decoder.f.rd, (rs1 << 1u) + rs2);
             break;
-        case 0b001:
-            // SLL
-            i_name = "sll";
-            reg->write(decoder.f.rd, rs1 << rs2);
+        case 0b0010000100:
+            // SH2ADD
+            reg->write(decoder.f.rd, (rs1 << 2u) + rs2);
             break;
-        case 0b010:
-            // SLT
-            i_name = "slt";
-            reg->write(decoder.f.rd, int(rs1) < int(rs2));
+        case 0b0010000110:
+            // SH3ADD
+            reg->write(decoder.f.rd, (rs1 << 3u) + rs2);
             break;
-        case 0b011:
-            // SLTU
-            i_name = "sltu";
-            reg->write(decoder.f.rd, rs1 < rs2);
+        case 0b0100000111:
+            // ANDN
+            reg->write(decoder.f.rd, rs1 & ~rs2);
             break;
-        case 0b100:
-            // XOR
-            i_name = "xor";
-            reg->write(decoder.f.rd, rs1 ^ rs2);
+        case 0b0100000110:
+            // ORN
+            reg->write(decoder.f.rd, rs1 | ~rs2);
             break;
-        case 0b101:
-            // check the bit 6 in funct7
-            if (!(decoder.f.funct7 & 0x20u)) {
-                // SRL
-                i_name = "srl";
-                reg->write(decoder.f.rd, rs1 >> rs2);
-            } else {
-                // SRA
-                i_name = "sra";
-                reg->write(decoder.f.rd, int(rs1) >> rs2);
-            }
+        case 0b0100000100:
+            // XNOR
+            reg->write(decoder.f.rd, ~(rs1 ^ rs2));
             break;
-        case 0b110:
-            // OR
-            i_name = "or";
-            reg->write(decoder.f.rd, rs1 | rs2);
+        case 0b0000101100:
+            // MIN
+            reg->write(decoder.f.rd, int(rs1) < int(rs2) ? rs1 : rs2);
             break;
-        case 0b111:
-            // AND
-            i_name = "and";
-            reg->write(decoder.f.rd, rs1 & rs2);
+        case 0b0000101101:
+            // MINU
+            reg->write(decoder.f.rd, rs1 < rs2 ? rs1 : rs2);
             break;
-        default:
-            term->terminate("Invalid funct3 while decoding register-register arithemtic or logical instruction (I): "
-                            + std::to_string(decoder.f.funct3) + "\n", 1);
-
-    }
-#ifdef DEBUG
-    std::cout << i_name + " x" + std::to_string(decoder.f.rd) + ", x" + std::to_string(decoder.f.rs1) + ", x" + std::to_string(decoder.f.rs2) + "\r\n";
-#endif
-    return pc+4;
-}
-
-/**
- * Function decoding register-register arithmetic and logic instructions
- * for the base instructions in RISCV32M
- * @param pc        program counter
- * @param decoder   decoder union
- * @return          new program counter
- */
-unsigned int RegArithLogDecoder::m_extension_decode (unsigned int pc, r_inst_t decoder) {
-    int32_t s_rd, s_rs1, s_rs2;
-    uint64_t u_rd, u_rs1, u_rs2;
-
-    rs1 = reg->read(decoder.f.rs1);
-    rs2 = reg->read(decoder.f.rs2);
-
-    std::string i_name;
-
-    switch (decoder.f.funct3) {
-        case 0b000:
-            // MUL
-            i_name = "mul";
-            reg->write(decoder.f.rd, rs1 * rs2);
+        case 0b0000101110:
+            // MAX
+            reg->write(decoder.f.rd, int(rs1) > int(rs2) ? rs1 : rs2);
             break;
-        case 0b001:
-            // MULH - not tested yet
-            i_name = "mulh";
-            s_rd = int32_t((int64_t(rs1) * int64_t(rs2)) >> 32);
-            reg->write(decoder.f.rd, s_rd);
+        case 0b0000101111:
+            // MAXU
+            reg->write(decoder.f.rd, rs1 > rs2 ? rs1 : rs2);
             break;
-        case 0b010:
-            // MULHSU - not tested yet
-            i_name = "mulhsu";
-            u_rd = uint32_t((int64_t(rs1) * uint64_t(rs2)) >> 32);
-            reg->write(decoder.f.rd, u_rd >> 32);
-            break;
-        case 0b011:
-            // MLHU
-            i_name = "mlhu";
-            u_rs1 = rs1;
-            u_rs2 = rs2;
-            u_rd = u_rs1 * u_rs2;
-            reg->write(decoder.f.rd, u_rd >> 32);
+        case 0b0110000001:
+            // ROL
+            reg->write(decoder.f.rd, rotate_left(rs1, rs2));
             break;
-        case 0b100:
-            // DIV
-            i_name = "div";
-            if (rs2 == 0) {
-                reg->write(decoder.f.rd, -1);
-            } else if (rs1 == 0x80000000 && rs2 == 0xFFFFFFFF) {
-                reg->write(decoder.f.rd, 0x80000000);
-            } else {
-                reg->write(decoder.f.rd, int(rs1) / int(rs2));
-            }
-            break;
-        case 0b101:
-            // DIVU
-            i_name = "divu";
-            if (rs2 == 0) {
-                reg->write(decoder.f.rd, rs1); // doesn't make sense
-            } else {
-                reg->write(decoder.f.rd, rs1 / rs2);
-            }
-            break;
-        case 0b110:
-            // REM
-            i_name = "rem";
-            if (rs2 == 0) {
-                reg->write(decoder.f.rd, rs1);
-            } else if (rs1 == 0x80000000 && rs2 == 0xFFFFFFFF) {
-                reg->write(decoder.f.rd, 0);
-            } else {
-                reg->write(decoder.f.rd, int(rs1) % int(rs2));
-            }
+        case 0b0110000101:
+            // ROR
+            reg->write(decoder.f.rd, rotate_right(rs1, rs2));
             break;
-        case 0b111:
-            // REMU
-            i_name = "remu";
-            if (rs2 == 0) {
-                reg->write(decoder.f.rd, rs1);
-            } else {
-                reg->write(decoder.f.rd, rs1 % rs2);
+        case 0b0000100100:
+            // ZEXT.H, only encoded with rs2 = x0 (PACK of Zbkb otherwise)
+            if (decoder.f.rs2 != RegisterFile::x0) {
+                term->terminate("Invalid rs2 while decoding ZEXT.H: " + std::to_string(decoder.f.rs2) + "\n", 1);
             }
+            reg->write(decoder.f.rd, rs1 & 0x0000FFFFu);
             break;
         default:
-            term->terminate("Invalid funct3 while decoding register-register arithemtic or logical instruction (M): "
-                            + std::to_string(decoder.f.funct3) + "\n", 1);
+            term->terminate("Invalid funct7 while decoding register-register arithemtic or logical instruction (B): "
+                            + std::to_string(decoder.f.funct7) + "\n", 1);
     }
-#ifdef DEBUG
-    std::cout << i_name + " x" + std::to_string(decoder.f.rd) + ", x" + std::to_string(decoder.f.rs1) + ", x" + std::to_string(decoder.f.rs2) + "\r\n";
-#endif
     return pc+4;
 }
 
@@ -220,8 +152,6 @@ unsigned int ImmArithLogDecoder::decode (unsigned int pc, unsigned int inst) {
     i_inst_t decoder{};
     decoder.inst = inst;
 
-    std::string i_name;
-
     rs1 = reg->read(decoder.f.rs1);
     imm = decoder.f.imm;
     // sign-extend if negative
@@ -229,62 +159,71 @@ unsigned int ImmArithLogDecoder::decode (unsigned int pc, unsigned int inst) {
         imm |= 0xFFFFF000;
     }
 
-    switch (decoder.f.funct3) {
-        case 0b000:
-            // ADDI
-            i_name = "addi";
-            reg->write(decoder.f.rd, int(rs1) + int(imm));
-            break;
-        case 0b001:
-            // SLLI
-            i_name = "slli";
-            reg->write(decoder.f.rd, rs1 << imm);
-            break;
-        case 0b010:
-            // SLTI
-            i_name = "slti";
-            reg->write(decoder.f.rd, int(rs1) < int(imm));
-            break;
-        case 0b011:
-            // SLTIU
-            i_name = "sltiu";
-            reg->write(decoder.f.rd, rs1 < imm);
+    if ((decoder.f.funct3 == 0b001 && (decoder.f.imm >> 5u) == 0b0110000) ||
+        (decoder.f.funct3 == 0b101 && ((decoder.f.imm >> 5u) == 0b0110000 || decoder.f.imm == 0x287 || decoder.f.imm == 0x698))) {
+        // CLZ, CTZ, CPOP, SEXT.B, SEXT.H, RORI, ORC.B, REV8
+        return b_extension_decode(pc, decoder);
+    }
+
+    unsigned int result;
+    if (!IntegerAlu::immediateOp<unsigned int, int>(decoder.f.funct3, imm, rs1, result)) {
+        term->terminate("Invalid funct7 while decoding register-immediate shift instruction: "
+                        + std::to_string(decoder.f.imm >> 5u) + "\n", 1);
+    }
+    reg->write(decoder.f.rd, result);
+    return pc+4;
+}
+
+/**
+ * Function decoding register-immediate instructions of the Zbb
+ * bit-manipulation extension
+ * @param pc        program counter
+ * @param decoder   decoder union
+ * @return          new program counter
+ */
+unsigned int ImmArithLogDecoder::b_extension_decode (unsigned int pc, i_inst_t decoder) {
+    rs1 = reg->read(decoder.f.rs1);
+
+    if (decoder.f.funct3 == 0b101) {
+        if (decoder.f.imm == 0x287) {
+            // ORC.B
+            reg->write(decoder.f.rd, or_combine_bytes(rs1));
+        } else if (decoder.f.imm == 0x698) {
+            // REV8
+            reg->write(decoder.f.rd, __builtin_bswap32(rs1));
+        } else {
+            // RORI
+            reg->write(decoder.f.rd, rotate_right(rs1, decoder.f.imm));
+        }
+        return pc+4;
+    }
+
+    // the rs2 field selects the unary operation
+    switch (decoder.f.imm & 0x1Fu) {
+        case 0b00000:
+            // CLZ
+            reg->write(decoder.f.rd, rs1 ? __builtin_clz(rs1) : 32);
             break;
-        case 0b100:
-            // XORI
-            i_name = "xori";
-            reg->write(decoder.f.rd, rs1 ^ imm);
+        case 0b00001:
+            // CTZ
+            reg->write(decoder.f.rd, rs1 ? __builtin_ctz(rs1) : 32);
             break;
-        case 0b101:
-            // check the bit 10 in imm
-            if (!(decoder.f.imm & 0x0400u)) {
-                // SRLI
-                i_name = "srli";
-                reg->write(decoder.f.rd, rs1 >> imm);
-            } else {
-                // SRAI
-                i_name = "srai";
-                imm &= 0x1F;
-                reg->write(decoder.f.rd, int(rs1) >> imm);
-            }
+        case 0b00010:
+            // CPOP
+            reg->write(decoder.f.rd, __builtin_popcount(rs1));
             break;
-        case 0b110:
-            // ORI
-            i_name = "ori";
-            reg->write(decoder.f.rd, rs1 | imm);
+        case 0b00100:
+            // SEXT.B
+            reg->write(decoder.f.rd, int(int8_t(rs1)));
             break;
-        case 0b111:
-            // ANDI
-            i_name = "andi";
-            reg->write(decoder.f.rd, rs1 & imm);
+        case 0b00101:
+            // SEXT.H
+            reg->write(decoder.f.rd, int(int16_t(rs1)));
             break;
         default:
-            term->terminate("Invalid funct3 while decoding register-immediate arithemtic or logical instruction: "
-                            + std::to_string(decoder.f.funct3) + "\n", 1);
+            term->terminate("Invalid immediate while decoding register-immediate arithemtic or logical instruction (B): "
+                            + std::to_string(decoder.f.imm) + "\n", 1);
     }
-#ifdef DEBUG
-    std::cout << i_name + " x" + std::to_string(decoder.f.rd) + ", x" + std::to_string(decoder.f.rs1) + ", " + std::to_string(int(imm)) + "\r\n";
-#endif
     return pc+4;
 }
 
@@ -299,8 +238,6 @@ unsigned int LoadDecoder::decode (unsigned int pc, unsigned int inst) {
     decoder.inst = inst;
     unsigned int data;
 
-    std::string i_name;
-
     rs1 = reg->read(decoder.f.rs1);
     imm = decoder.f.imm;
     // sign-extend if negative
@@ -312,7 +249,6 @@ unsigned int LoadDecoder::decode (unsigned int pc, unsigned int inst) {
     switch (decoder.f.funct3) {
         case 0b000:
             // LB
-            i_name = "lb";
             data = stack->readByte(sp);
             // sign-extend if negative
             if (data & 0x80) {
@@ -322,7 +258,6 @@ unsigned int LoadDecoder::decode (unsigned int pc, unsigned int inst) {
             break;
         case 0b001:
             // LH
-            i_name = "lh";
             data = stack->readHalf(sp);
             // sign-extend if negative
             if (data & 0x8000) {
@@ -332,19 +267,16 @@ unsigned int LoadDecoder::decode (unsigned int pc, unsigned int inst) {
             break;
         case 0b010:
             // LW
-            i_name = "lw";
             data = stack->readWord(sp);
             reg->write(decoder.f.rd, data);
             break;
         case 0b100:
             // LBU
-            i_name = "lbu";
             data = stack->readByte(sp);
             reg->write(decoder.f.rd, data);
             break;
         case 0b101:
             // LHU
-            i_name = "lhu";
             data = stack->readHalf(sp);
             reg->write(decoder.f.rd, data);
             break;
@@ -352,9 +284,6 @@ unsigned int LoadDecoder::decode (unsigned int pc, unsigned int inst) {
             term->terminate("Invalid funct3 while decoding load instruction: "
                             + std::to_string(decoder.f.funct3) + "\n", 1);
     }
-#ifdef DEBUG
-    std::cout << i_name + " x" + std::to_string(decoder.f.rd) + ", " + std::to_string(int(imm)) + "(x" + std::to_string(decoder.f.rs1) + ")\r\n";
-#endif
     return pc+4;
 }
 
@@ -368,8 +297,6 @@ unsigned int StoreDecoder::decode (unsigned int pc, unsigned int inst) {
     s_inst_t decoder{};
     decoder.inst = inst;
 
-    std::string i_name;
-
     rs1 = reg->read(decoder.f.rs1);
     rs2 = reg->read(decoder.f.rs2);
     imm = decoder.f.imm4_0 | (decoder.f.imm5_11 << 5u);
@@ -382,26 +309,20 @@ unsigned int StoreDecoder::decode (unsigned int pc, unsigned int inst) {
     switch (decoder.f.funct3) {
         case 0b000:
             // SB
-            i_name = "sb";
             stack->writeByte(sp, rs2);
             break;
         case 0b001:
             // SH
-            i_name = "sh";
             stack->writeHalf(sp, rs2);
             break;
         case 0b010:
             // SW
-            i_name = "sw";
             stack->writeWord(sp, rs2);
             break;
         default:
             term->terminate("Invalid funct3 while decoding store instruction: "
                             + std::to_string(decoder.f.funct3) + "\n", 1);
     }
-#ifdef DEBUG
-    std::cout << i_name + " x" + std::to_string(decoder.f.rs2) + ", " + std::to_string(int(imm)) + "(x" + std::to_string(decoder.f.rs1) + ")\r\n";
-#endif
     return pc+4;
 }
 
@@ -415,8 +336,6 @@ unsigned int BranchDecoder::decode (unsigned int pc, unsigned int inst) {
     b_inst_t decoder{};
     decoder.inst = inst;
 
-    std::string i_name;
-
     rs1 = reg->read(decoder.f.rs1);
     rs2 = reg->read(decoder.f.rs2);
     imm = (decoder.f.imm4_1 << 1u) | (decoder.f.imm5_10 << 5u) |
@@ -426,57 +345,12 @@ unsigned int BranchDecoder::decode (unsigned int pc, unsigned int inst) {
         imm |= 0xFFFFE000;
     }
 
-    switch (decoder.f.funct3) {
-        case 0b000:
-            // BEQ
-            i_name = "beq";
-            if (rs1 == rs2) {
-                return pc + int(imm);
-            }
-            break;
-        case 0b001:
-            // BNE
-            i_name = "bne";
-            if (rs1 != rs2) {
-                return pc + int(imm);
-            }
-            break;
-        case 0b100:
-            // BLT
-            i_name = "blt";
-            if (int(rs1) < int(rs2)) {
-                return pc + int(imm);
-            }
-            break;
-        case 0b101:
-            // BGE
-            i_name = "bge";
-            if (int(rs1) >= int(rs2)) {
-                return pc + int(imm);
-            }
-            break;
-        case 0b110:
-            // BLTU
-            i_name = "bltu";
-            if (rs1 < rs2) {
-                return pc + int(imm);
-            }
-            break;
-        case 0b111:
-            // BGEU
-            i_name = "bgeu";
-            if (rs1 >= rs2) {
-                return pc + int(imm);
-            }
-            break;
-        default:
-            term->terminate("Invalid funct3 while decoding branch instruction: "
-                            + std::to_string(decoder.f.funct3) + "\n", 1);
+    unsigned int taken;
+    if (!IntegerAlu::branchTaken<unsigned int, int>(decoder.f.funct3, rs1, rs2, taken)) {
+        term->terminate("Invalid funct3 while decoding branch instruction: "
+                        + std::to_string(decoder.f.funct3) + "\n", 1);
     }
-#ifdef DEBUG
-    std::cout << i_name + " x" + std::to_string(decoder.f.rs1) + ", x" + std::to_string(decoder.f.rs2) + ", " + std::to_string(int(imm)) + "\r\n";
-#endif
-    return pc+4;
+    return taken ? pc + int(imm) : pc+4;
 }
 
 /**
@@ -489,22 +363,15 @@ unsigned int UpperImmDecoder::decode (unsigned int pc, unsigned int inst) {
     u_inst_t decoder{};
     decoder.inst = inst;
 
-    std::string i_name;
-
     imm = int(decoder.f.imm31_12) << 12u & 0xFFFFF000u;
 
     if (decoder.f.opcode == 0b0110111) {
         // LUI
-        i_name = "lui";
         reg->write(decoder.f.rd, imm);
     } else if (decoder.f.opcode == 0b0010111) {
         // AUIPC
-        i_name = "auipc";
         reg->write(decoder.f.rd, pc + imm);
     }
-#ifdef DEBUG
-    std::cout << i_name + " x" + std::to_string(decoder.f.rd) + ", " + std::to_string(int(imm)) + "\r\n";
-#endif
     return pc+4;
 }
 
@@ -529,9 +396,6 @@ unsigned int JumpLinkDecoder::decode (unsigned int pc, unsigned int inst) {
     reg->write(decoder.f.rd, pc+4);
 
     // JAL
-#ifdef DEBUG
-    std::cout << "jal x" + std::to_string(decoder.f.rd) + ", " + std::to_string(int(imm)) + "\r\n";
-#endif
     return pc + imm;
 }
 
@@ -560,12 +424,54 @@ unsigned int JumpLinkRegDecoder::decode (unsigned int pc, unsigned int inst) {
     reg->write(decoder.f.rd, pc+4);
 
     //JALR
-#ifdef DEBUG
-    std::cout << "jalr x" + std::to_string(decoder.f.rd) + ", x" + std::to_string(decoder.f.rs1) + ", " + std::to_string(int(imm)) + "\r\n";
-#endif
     return offset;
 }
 
+/**
+ * FenceDecoder constructor
+ * @param hart  hart whose instructions are decoded
+ */
+FenceDecoder::FenceDecoder (Hart &hart) : InstructionDecoder(hart) {
+    this->hart = &hart;
+}
+
+/**
+ * Function decoding memory ordering instructions
+ * @param pc    program counter
+ * @param inst  raw instruction
+ * @return      new program counter
+ */
+unsigned int FenceDecoder::decode (unsigned int pc, unsigned int inst) {
+    i_inst_t decoder{};
+    decoder.inst = inst;
+
+    switch (decoder.f.funct3) {
+        case 0b000:
+            // FENCE orders the memory accesses of this hart as seen by the other harts
+            __atomic_thread_fence(__ATOMIC_SEQ_CST);
+            break;
+        case 0b001:
+            // FENCE.I, stores to the code already invalidated the predecoded instructions,
+            // the hart switches to them if another hart made the private copy
+            hart->refreshCode();
+            break;
+        default:
+            term->terminate("Invalid funct3 while decoding fence instruction: "
+                            + std::to_string(decoder.f.funct3) + "\n", 1);
+    }
+    return pc+4;
+}
+
+/**
+ * EcallDecoder constructor
+ * @param hart  hart whose instructions are decoded
+ */
+EcallDecoder::EcallDecoder (Hart &hart) : InstructionDecoder(hart) {
+    freg = hart.floatRegisters();
+    vreg = hart.vectorRegisters();
+    this->hart = &hart;
+}
+
 /**
  * Function decoding environmental call instructions
  * @param pc    program counter
@@ -576,9 +482,9 @@ unsigned int EcallDecoder::decode(unsigned int pc, unsigned int inst) {
     i_inst_t decoder{};
     decoder.inst = inst;
 
-#ifdef DEBUG
-    std::cout << "ecall\r\n";
-#endif
+    if (decoder.f.funct3 != 0) {
+        return csr_decode(pc, decoder);
+    }
 
     //temp
     rs1 = reg->read(decoder.f.rs1);
@@ -586,20 +492,164 @@ unsigned int EcallDecoder::decode(unsigned int pc, unsigned int inst) {
 
     //We need only check immediate that it is 0b000000000000 (rather than 0b000000000001), in order to find ecall
     if (imm == 0 && decoder.f.funct3 == 0) {
+        // a7 selects the system calls of newlib and Linux, other values fall back to a0
+        if (hart->syscalls() != nullptr && hart->syscalls()->call(reg, stack, term)) {
+            hart->returnFromSyscall();
+            return pc+4;
+        }
         switch (reg->read(RegisterFile::x10)) {
             case 10: // exit
-                term->terminate("Ecall 10 reached", 0);
+                term->guestExit("Ecall 10 reached", 0);
                 break;
             case 17: // exit2
-                term->terminate("Ecall 12 reached - exit code: "
+                term->guestExit("Ecall 12 reached - exit code: "
                                 + std::to_string(reg->read(RegisterFile::x11)) , 0);
                 break;
+            case ECALL_MARKER:
+                hart->reachMarker();
+                return pc+4;
             default:
                 term->terminate("Unsupported instruction", 1);
         }
+    } else if (imm == SYSTEM_MRET && decoder.f.rs1 == RegisterFile::x0 && decoder.f.rd == RegisterFile::x0) {
+        return hart->mret();
+    } else if (imm == SYSTEM_WFI && decoder.f.rs1 == RegisterFile::x0 && decoder.f.rd == RegisterFile::x0) {
+        hart->waitForInterrupt();
+        return pc+4;
     } else {
         term->terminate("Unsupported instruction", 1);
     }
 
     return -1;
 }
+
+/**
+ * Function decoding control and status register instructions
+ * @param pc        program counter
+ * @param decoder   decoder union
+ * @return          new program counter
+ */
+unsigned int EcallDecoder::csr_decode (unsigned int pc, i_inst_t decoder) {
+    unsigned int csr = decoder.f.imm;
+    unsigned int data = 0;
+    // immediate variants use the rs1 field as 5-bit unsigned immediate
+    rs1 = decoder.f.funct3 & 0b100u ? (unsigned int)(decoder.f.rs1) : reg->read(decoder.f.rs1);
+
+    if (!read_csr(csr, data)) {
+        term->terminate("Unsupported control and status register: " + std::to_string(csr) + "\n", 1);
+    }
+
+    switch (decoder.f.funct3 & 0b011u) {
+        case 0b01:
+            // CSRRW, CSRRWI
+            write_csr(csr, rs1);
+            break;
+        case 0b10:
+            // CSRRS, CSRRSI
+            if (decoder.f.rs1 != RegisterFile::x0) {
+                write_csr(csr, data | rs1);
+            }
+            break;
+        case 0b11:
+            // CSRRC, CSRRCI
+            if (decoder.f.rs1 != RegisterFile::x0) {
+                write_csr(csr, data & ~rs1);
+            }
+            break;
+        default:
+            term->terminate("Invalid funct3 while decoding control and status register instruction: "
+                            + std::to_string(decoder.f.funct3) + "\n", 1);
+    }
+    reg->write(decoder.f.rd, data);
+    return pc+4;
+}
+
+/**
+ * Reads control and status register
+ * @param csr   register number
+ * @param data  read value
+ * @return      false if the register is not implemented
+ */
+bool EcallDecoder::read_csr (unsigned int csr, unsigned int &data) {
+    switch (csr) {
+        case CSR_FFLAGS:
+            data = freg->readFlags();
+            return true;
+        case CSR_FRM:
+            data = freg->readRoundingMode();
+            return true;
+        case CSR_FCSR:
+            data = freg->readRoundingMode() << 5u | freg->readFlags();
+            return true;
+        case CSR_MHARTID:
+            data = hart->id();
+            return true;
+        case CSR_VSTART:
+            // vector instructions are never interrupted, so vstart is always 0
+            data = 0;
+            return true;
+        case CSR_VL:
+            data = vreg->vl();
+            return true;
+        case CSR_VTYPE:
+            data = vreg->vtype();
+            return true;
+        case CSR_VLENB:
+            data = vreg->vlenb();
+            return true;
+        default:
+            // machine-mode trap handling and counters
+            return hart->readCsr(csr, data);
+    }
+}
+
+/**
+ * Writes control and status register
+ * @param csr   register number
+ * @param data  value to be written
+ */
+void EcallDecoder::write_csr (unsigned int csr, unsigned int data) {
+    switch (csr) {
+        case CSR_FFLAGS:
+            freg->writeFlags(data);
+            break;
+        case CSR_FRM:
+            freg->writeRoundingMode(data);
+            break;
+        case CSR_FCSR:
+            freg->writeRoundingMode(data >> 5u);
+            freg->writeFlags(data);
+            break;
+        default:
+            hart->writeCsr(csr, data);
+            break;
+    }
+}
+
+/**
+ * StaleCodeDecoder constructor
+ * @param hart  hart whose instructions are decoded
+ */
+StaleCodeDecoder::StaleCodeDecoder (Hart &hart) : InstructionDecoder(hart) {
+    this->hart = &hart;
+}
+
+/**
+* Function predecoding an invalidated instruction again and executing it
+* @param pc    program counter
+* @param inst  raw instruction as it was before the store, ignored
+* @return      updated program counter
+*/
+unsigned int StaleCodeDecoder::decode (unsigned int pc, unsigned int inst) {
+    CodeMemory *code = stack->code();
+    const predecoded_t &entry = code->refresh(pc / 2);
+    // an unknown opcode made the private copy of the code only now
+    hart->refreshCode();
+    inst = code->instructions()[pc / 2];
+    if (entry.decoder == DECODER_NONE) {
+        unsigned char opcode = inst & 0x0000007Fu;
+        term->terminate("Wrong opcode or not implemented instruction: opcode="
+                        + std::bitset<7>(opcode).to_string(), 1);
+    }
+    return hart->decoder(entry.decoder)->decode(pc - 2 * entry.compressed, inst);
+}
@@ -8,6 +8,38 @@
 #include "register_file.h"
 #include "stack.h"
 #include "termination.h"
+#include "float_register_file.h"
+#include "vector_register_file.h"
+
+class Hart;
+
+// control and status registers
+#define CSR_FFLAGS   0x001
+#define CSR_FRM      0x002
+#define CSR_FCSR     0x003
+#define CSR_VSTART   0x008
+#define CSR_VL       0xC20
+#define CSR_VTYPE    0xC21
+#define CSR_VLENB    0xC22
+#define CSR_MSTATUS  0x300
+#define CSR_MIE      0x304
+#define CSR_MTVEC    0x305
+#define CSR_MSCRATCH 0x340
+#define CSR_MEPC     0x341
+#define CSR_MCAUSE   0x342
+#define CSR_MTVAL    0x343
+#define CSR_MIP      0x344
+#define CSR_CYCLE    0xC00
+#define CSR_TIME     0xC01
+#define CSR_INSTRET  0xC02
+#define CSR_CYCLEH   0xC80
+#define CSR_TIMEH    0xC81
+#define CSR_INSTRETH 0xC82
+#define CSR_MHARTID  0xF14
+
+// privileged instructions encoded in the immediate of the system opcode
+#define SYSTEM_MRET  0x302
+#define SYSTEM_WFI   0x105
 
 /**
  * Instruction type decoders
@@ -83,6 +115,32 @@ union j_inst_t {
     } f; // fields
 };
 
+union r4_inst_t {
+    unsigned int inst;
+    struct {
+        unsigned int opcode: 7;
+        RegisterFile::Register rd: 5;
+        unsigned int funct3: 3;
+        RegisterFile::Register rs1: 5;
+        RegisterFile::Register rs2: 5;
+        unsigned int fmt: 2;
+        RegisterFile::Register rs3: 5;
+    } f; // fields
+};
+
+union v_inst_t {
+    unsigned int inst;
+    struct {
+        unsigned int opcode: 7;
+        unsigned int vd: 5;
+        unsigned int funct3: 3;
+        unsigned int vs1: 5;    // rs1 or 5-bit immediate
+        unsigned int vs2: 5;    // rs2 or lumop of unit-stride memory access
+        unsigned int vm: 1;
+        unsigned int funct6: 6; // nf, mew and mop of memory access
+    } f; // fields
+};
+
 /**
  * Interface for instruction decoder
  */
@@ -95,7 +153,7 @@ protected:
     unsigned int imm;
     Termination *term;
 public:
-    InstructionDecoder ();
+    explicit InstructionDecoder (Hart &hart);
     virtual unsigned int decode (unsigned int pc, unsigned int inst) = 0;
 };
 
@@ -104,9 +162,9 @@ public:
  */
 class RegArithLogDecoder : public InstructionDecoder {
 private:
-    unsigned int i_extension_decode (unsigned int pc, r_inst_t decoder);
-    unsigned int m_extension_decode (unsigned int pc, r_inst_t decoder);
+    unsigned int b_extension_decode (unsigned int pc, r_inst_t decoder);
 public:
+    using InstructionDecoder::InstructionDecoder;
     unsigned int decode (unsigned int pc, unsigned int inst) override;
 };
 
@@ -114,7 +172,10 @@ public:
  * Register-immediate Arithmetic and Logic instruction decoder
  */
 class ImmArithLogDecoder : public InstructionDecoder {
+private:
+    unsigned int b_extension_decode (unsigned int pc, i_inst_t decoder);
 public:
+    using InstructionDecoder::InstructionDecoder;
     unsigned int decode (unsigned int pc, unsigned int inst) override;
 };
 
@@ -123,6 +184,7 @@ public:
  */
 class LoadDecoder : public InstructionDecoder {
 public:
+    using InstructionDecoder::InstructionDecoder;
     unsigned int decode (unsigned int pc, unsigned int inst) override;
 };
 
@@ -131,6 +193,7 @@ public:
  */
 class StoreDecoder : public InstructionDecoder {
 public:
+    using InstructionDecoder::InstructionDecoder;
     unsigned int decode (unsigned int pc, unsigned int inst) override;
 };
 
@@ -139,6 +202,7 @@ public:
  */
 class BranchDecoder : public InstructionDecoder {
 public:
+    using InstructionDecoder::InstructionDecoder;
     unsigned int decode (unsigned int pc, unsigned int inst) override;
 };
 
@@ -147,6 +211,7 @@ public:
  */
 class UpperImmDecoder : public InstructionDecoder {
 public:
+    using InstructionDecoder::InstructionDecoder;
     unsigned int decode (unsigned int pc, unsigned int inst) override;
 };
 
@@ -155,6 +220,7 @@ public:
  */
 class JumpLinkDecoder : public InstructionDecoder {
 public:
+    using InstructionDecoder::InstructionDecoder;
     unsigned int decode (unsigned int pc, unsigned int inst) override;
 };
 
@@ -163,14 +229,46 @@ public:
  */
 class JumpLinkRegDecoder : public InstructionDecoder {
 public:
+    using InstructionDecoder::InstructionDecoder;
+    unsigned int decode (unsigned int pc, unsigned int inst) override;
+};
+
+/**
+ * Memory ordering instruction decoder
+ */
+class FenceDecoder : public InstructionDecoder {
+private:
+    Hart *hart;
+public:
+    explicit FenceDecoder (Hart &hart);
     unsigned int decode (unsigned int pc, unsigned int inst) override;
 };
 
 /**
- * Ecall instruction decoder
+ * Ecall and control and status register instruction decoder
  */
 class EcallDecoder : public InstructionDecoder {
+private:
+    FloatRegisterFile *freg;
+    VectorRegisterFile *vreg;
+    Hart *hart;
+    unsigned int csr_decode (unsigned int pc, i_inst_t decoder);
+    bool read_csr (unsigned int csr, unsigned int &data);
+    void write_csr (unsigned int csr, unsigned int data);
+public:
+    explicit EcallDecoder (Hart &hart);
+    unsigned int decode (unsigned int pc, unsigned int inst) override;
+};
+
+/**
+ * Decoder of instructions invalidated by stores to the code: predecodes
+ * the instruction again from the data memory and executes it
+ */
+class StaleCodeDecoder : public InstructionDecoder {
+private:
+    Hart *hart;
 public:
+    explicit StaleCodeDecoder (Hart &hart);
     unsigned int decode (unsigned int pc, unsigned int inst) override;
 };
 
@@ -0,0 +1,210 @@
+// instrumentation.cpp
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#include <iomanip>
+#include <string>
+#include "instrumentation.h"
+#include "disassembler.h"
+#include "termination.h"
+#include "hart.h"
+#include "memory_profiler.h"
+#include "loop_profiler.h"
+#include "cache_analyzer.h"
+#include "fuzzer.h"
+
+unsigned int Instrumentation::s_selected = 0;
+std::ofstream Instrumentation::s_trace;
+std::mutex Instrumentation::s_trace_lock;
+std::unordered_set<unsigned int> Instrumentation::s_breakpoints;
+
+/**
+ * Enables tracing of the executed instructions
+ * @param path  path of the trace file
+ * @return      false if the file cannot be created
+ */
+bool Instrumentation::setTrace (const char *path) {
+    s_trace.open(path);
+    if (!s_trace.is_open()) {
+        return false;
+    }
+    s_selected |= INSTRUMENT_TRACE;
+    return true;
+}
+
+/**
+ * Adds a breakpoint, harts stop before executing the instruction at it
+ * @param pc    address of the instruction
+ */
+void Instrumentation::addBreakpoint (unsigned int pc) {
+    s_breakpoints.insert(pc);
+    s_selected |= INSTRUMENT_BREAKPOINT;
+}
+
+/**
+ * Finds the address accessed by a load, store or atomic instruction. Vector
+ * accesses report their base address.
+ * @param inst      raw instruction
+ * @param rs1       value of the base register
+ * @param address   accessed address
+ * @param store     true if the instruction writes the memory
+ * @return          false if the instruction does not access the memory
+ */
+bool Instrumentation::memoryAddress (unsigned int inst, unsigned int rs1, unsigned int &address, bool &store) {
+    unsigned int funct3 = inst >> 12u & 0x7u;
+    unsigned int load_imm = unsigned(int(inst) >> 20);
+    unsigned int store_imm = unsigned(int(inst) >> 25 << 5) | (inst >> 7u & 0x1Fu);
+    // widths 2 and 3 of the floating-point opcodes are flw/fsw and fld/fsd, the others are vector accesses
+    bool scalar_float = funct3 == 0b010 || funct3 == 0b011;
+    switch (inst & 0x7Fu) {
+        case 0x03:
+            address = rs1 + load_imm;
+            store = false;
+            return true;
+        case 0x07:
+            address = rs1 + (scalar_float ? load_imm : 0);
+            store = false;
+            return true;
+        case 0x23:
+            address = rs1 + store_imm;
+            store = true;
+            return true;
+        case 0x27:
+            address = rs1 + (scalar_float ? store_imm : 0);
+            store = true;
+            return true;
+        case 0x2F:
+            // lr.w is the only atomic instruction which does not write
+            address = rs1;
+            store = (inst >> 27u) != 0b00010;
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * @param inst  raw instruction
+ * @return      true if the instruction writes the integer register in its rd field
+ */
+bool Instrumentation::writesRegister (unsigned int inst) {
+    unsigned int funct3 = inst >> 12u & 0x7u;
+    switch (inst & 0x7Fu) {
+        case 0x03:
+        case 0x13:
+        case 0x17:
+        case 0x2F:
+        case 0x33:
+        case 0x37:
+        case 0x67:
+        case 0x6F:
+            return true;
+        case 0x53:
+            // comparisons, conversions to integer, fmv.x.w and fclass
+            return (inst >> 27u) == 0x14 || (inst >> 27u) == 0x18 || (inst >> 27u) == 0x1C;
+        case 0x57:
+            // vsetvli, vsetivli, vsetvl and vmv.x.s
+            return funct3 == 0b111 || (funct3 == 0b010 && (inst >> 26u) == 0b010000);
+        case 0x73:
+            // control and status register instructions
+            return funct3 != 0;
+        default:
+            return false;
+    }
+}
+
+/**
+ * Traces an instruction before it executes
+ * @param hart  hart executing it
+ * @param pc    program counter
+ * @param inst  raw instruction
+ */
+void TracePolicy::fetch (Hart &hart, unsigned int pc, unsigned int inst) {
+    std::lock_guard<std::mutex> guard(Instrumentation::s_trace_lock);
+    Instrumentation::s_trace << std::dec << hart.id() << " " << std::hex << std::setfill('0') << std::setw(8) << pc
+                             << " " << std::setw(8) << inst << "  " << Disassembler::disassemble(inst) << "\n";
+}
+
+/**
+ * Traces a memory access of the last traced instruction
+ * @param hart      hart executing it
+ * @param address   accessed address
+ * @param store     true if the memory is written
+ */
+void TracePolicy::memoryAccess (Hart &hart, unsigned int address, bool store) {
+    std::lock_guard<std::mutex> guard(Instrumentation::s_trace_lock);
+    Instrumentation::s_trace << std::dec << hart.id() << "   " << (store ? "store" : "load") << " 0x" << std::hex
+                             << std::setfill('0') << std::setw(8) << address << "\n";
+}
+
+/**
+ * Traces a register written by the last traced instruction
+ * @param hart  hart executing it
+ * @param reg   register number
+ * @param value new value
+ */
+void TracePolicy::registerWrite (Hart &hart, unsigned int reg, unsigned int value) {
+    std::lock_guard<std::mutex> guard(Instrumentation::s_trace_lock);
+    Instrumentation::s_trace << std::dec << hart.id() << "   x" << reg << " = 0x" << std::hex << std::setfill('0')
+                             << std::setw(8) << value << "\n";
+}
+
+/**
+ * Stops the hart at a breakpoint
+ * @param pc    program counter of the next instruction
+ */
+void BreakpointPolicy::fetch (Hart &, unsigned int pc, unsigned int) {
+    if (Instrumentation::s_breakpoints.count(pc) != 0) {
+        throw halt_t{"Breakpoint reached: pc = " + std::to_string(pc), 0, false};
+    }
+}
+
+/**
+ * Counts a memory access
+ * @param hart      hart accessing the memory
+ * @param address   accessed address
+ * @param store     true if the memory is written
+ */
+void MemoryProfilePolicy::memoryAccess (Hart &hart, unsigned int address, bool store) {
+    MemoryProfiler::access(hart, address, store);
+}
+
+/**
+ * Captures an instruction fetch
+ * @param hart  hart fetching the instruction
+ * @param pc    program counter
+ */
+void CacheSweepPolicy::fetch (Hart &hart, unsigned int pc, unsigned int) {
+    CacheAnalyzer::access(hart, CACHE_STREAM_FETCH, pc);
+}
+
+/**
+ * Captures a data access
+ * @param hart      hart accessing the memory
+ * @param address   accessed address
+ */
+void CacheSweepPolicy::memoryAccess (Hart &hart, unsigned int address, bool) {
+    CacheAnalyzer::access(hart, CACHE_STREAM_DATA, address);
+}
+
+/**
+ * Counts the edge ending at an instruction if it follows a branch or a jump
+ * @param hart  hart executing it
+ * @param pc    program counter
+ * @param inst  raw instruction
+ */
+void CoveragePolicy::fetch (Hart &hart, unsigned int pc, unsigned int inst) {
+    if (hart.coverage() != nullptr) {
+        hart.coverage()->fetch(pc, inst);
+    }
+}
+
+/**
+ * Follows the control flow of the hart
+ * @param hart  hart executing it
+ * @param pc    program counter
+ * @param inst  raw instruction
+ */
+void LoopProfilePolicy::fetch (Hart &hart, unsigned int pc, unsigned int inst) {
+    LoopProfiler::fetch(hart, pc, inst);
+}
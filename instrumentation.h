@@ -0,0 +1,165 @@
+// instrumentation.h
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#ifndef ISA_SIM_CPP_INSTRUMENTATION_H
+#define ISA_SIM_CPP_INSTRUMENTATION_H
+
+#include <fstream>
+#include <mutex>
+#include <type_traits>
+#include <unordered_set>
+
+class Hart;
+
+// instrumentation policies selected on the command line, bits of the variant index
+#define INSTRUMENT_TRACE        0x1u
+#define INSTRUMENT_BREAKPOINT   0x2u
+#define INSTRUMENT_PROFILE      0x4u
+#define INSTRUMENT_CACHE        0x8u
+#define INSTRUMENT_COVERAGE     0x10u
+#define INSTRUMENT_LOOPS        0x20u
+#define INSTRUMENT_VARIANTS     64
+
+/**
+ * Instrumentation policy of the run loop of the harts. A policy is a class with
+ * static hooks called by the run loop, which is instantiated once per combination
+ * of policies, so a hook costs nothing in the variants without it:
+ *  - fetch before an instruction executes,
+ *  - memoryAccess before a load, store or atomic accesses the memory,
+ *  - registerWrite after an instruction wrote an integer register other than x0.
+ * Instrumented variants execute fused pairs one instruction at a time.
+ */
+class NoInstrumentation {
+public:
+    static constexpr bool active = false;
+    static void fetch (Hart &, unsigned int, unsigned int) {}
+    static void memoryAccess (Hart &, unsigned int, bool) {}
+    static void registerWrite (Hart &, unsigned int, unsigned int) {}
+};
+
+/**
+ * Writes every instruction, its memory access and its register write into the trace file
+ */
+class TracePolicy {
+public:
+    static constexpr bool active = true;
+    static void fetch (Hart &hart, unsigned int pc, unsigned int inst);
+    static void memoryAccess (Hart &hart, unsigned int address, bool store);
+    static void registerWrite (Hart &hart, unsigned int reg, unsigned int value);
+};
+
+/**
+ * Stops the hart before it executes an instruction at a breakpoint
+ */
+class BreakpointPolicy {
+public:
+    static constexpr bool active = true;
+    static void fetch (Hart &hart, unsigned int pc, unsigned int inst);
+    static void memoryAccess (Hart &, unsigned int, bool) {}
+    static void registerWrite (Hart &, unsigned int, unsigned int) {}
+};
+
+/**
+ * Counts the memory accesses in the memory profiler
+ */
+class MemoryProfilePolicy {
+public:
+    static constexpr bool active = true;
+    static void fetch (Hart &, unsigned int, unsigned int) {}
+    static void memoryAccess (Hart &hart, unsigned int address, bool store);
+    static void registerWrite (Hart &, unsigned int, unsigned int) {}
+};
+
+/**
+ * Captures the instruction fetch and data reference streams for the cache analysis
+ */
+class CacheSweepPolicy {
+public:
+    static constexpr bool active = true;
+    static void fetch (Hart &hart, unsigned int pc, unsigned int inst);
+    static void memoryAccess (Hart &hart, unsigned int address, bool store);
+    static void registerWrite (Hart &, unsigned int, unsigned int) {}
+};
+
+/**
+ * Collects the edge coverage of the fuzzer after every branch and jump
+ */
+class CoveragePolicy {
+public:
+    static constexpr bool active = true;
+    static void fetch (Hart &hart, unsigned int pc, unsigned int inst);
+    static void memoryAccess (Hart &, unsigned int, bool) {}
+    static void registerWrite (Hart &, unsigned int, unsigned int) {}
+};
+
+/**
+ * Follows the control flow in the loop profiler
+ */
+class LoopProfilePolicy {
+public:
+    static constexpr bool active = true;
+    static void fetch (Hart &hart, unsigned int pc, unsigned int inst);
+    static void memoryAccess (Hart &, unsigned int, bool) {}
+    static void registerWrite (Hart &, unsigned int, unsigned int) {}
+};
+
+/**
+ * Combination of policies, every hook calls the hooks of all of them in order
+ */
+template<typename... Policies>
+class Instrumented {
+public:
+    static constexpr bool active = (Policies::active || ...);
+    static void fetch (Hart &hart, unsigned int pc, unsigned int inst) {
+        (Policies::fetch(hart, pc, inst), ...);
+    }
+    static void memoryAccess (Hart &hart, unsigned int address, bool store) {
+        (Policies::memoryAccess(hart, address, store), ...);
+    }
+    static void registerWrite (Hart &hart, unsigned int reg, unsigned int value) {
+        (Policies::registerWrite(hart, reg, value), ...);
+    }
+};
+
+/**
+ * Policy of a bit of the variant index, the no-op policy if the bit is clear
+ */
+template<unsigned int Variant, unsigned int Bit, typename Policy>
+using PolicyIf = std::conditional_t<(Variant & Bit) != 0, Policy, NoInstrumentation>;
+
+/**
+ * Combination of the policies selected by the INSTRUMENT_* bits of the variant index.
+ * Breakpoints are checked first, so a hart stopping at one does not trace the instruction.
+ */
+template<unsigned int Variant>
+using InstrumentationVariant = Instrumented<PolicyIf<Variant, INSTRUMENT_BREAKPOINT, BreakpointPolicy>,
+                                            PolicyIf<Variant, INSTRUMENT_TRACE, TracePolicy>,
+                                            PolicyIf<Variant, INSTRUMENT_PROFILE, MemoryProfilePolicy>,
+                                            PolicyIf<Variant, INSTRUMENT_CACHE, CacheSweepPolicy>,
+                                            PolicyIf<Variant, INSTRUMENT_COVERAGE, CoveragePolicy>,
+                                            PolicyIf<Variant, INSTRUMENT_LOOPS, LoopProfilePolicy>>;
+
+/**
+ * Configuration of the instrumentation given on the command line
+ */
+class Instrumentation {
+public:
+    static bool setTrace (const char *path);
+    static void addBreakpoint (unsigned int pc);
+    static void select (unsigned int policy) { s_selected |= policy; }
+    static unsigned int selected () { return s_selected; }
+    static bool memoryAddress (unsigned int inst, unsigned int rs1, unsigned int &address, bool &store);
+    static bool writesRegister (unsigned int inst);
+private:
+    friend class TracePolicy;
+    friend class BreakpointPolicy;
+
+    static unsigned int s_selected;                 // INSTRUMENT_* bits
+    static std::ofstream s_trace;
+    static std::mutex s_trace_lock;                 // harts on different host threads share the trace
+    static std::unordered_set<unsigned int> s_breakpoints;
+};
+
+
+#endif //ISA_SIM_CPP_INSTRUMENTATION_H
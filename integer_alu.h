@@ -0,0 +1,263 @@
+// integer_alu.h
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#ifndef ISA_SIM_CPP_INTEGER_ALU_H
+#define ISA_SIM_CPP_INTEGER_ALU_H
+
+#include <cstdint>
+#include <type_traits>
+
+/**
+ * Integer arithmetic, logic and branch conditions of RV32IM, shared by the
+ * scalar decoders and the lane-parallel (SIMT) engine. T is unsigned int or a
+ * host vector of them (one lane per element), S the signed type of the same
+ * shape. Comparisons give 1 for a scalar and all bits set for a lane, so a
+ * branch condition is also the mask of the lanes taking the branch.
+ */
+class IntegerAlu {
+public:
+    /**
+     * Register-register instructions of the base ISA and the M extension
+     * @param funct     funct7 << 3 | funct3
+     * @param a         value of rs1
+     * @param b         value of rs2
+     * @param result    value of rd
+     * @return          false if funct is not one of these instructions
+     */
+    template<typename T, typename S>
+    static bool registerOp (unsigned int funct, const T &a, const T &b, T &result) {
+        switch (funct) {
+            case 0b0000000000:
+                // ADD
+                result = a + b;
+                return true;
+            case 0b0100000000:
+                // SUB
+                result = a - b;
+                return true;
+            case 0b0000000001:
+                // SLL
+                result = a << (b & 0x1Fu);
+                return true;
+            case 0b0000000010:
+                // SLT
+                result = (T)((S)a < (S)b) & 1u;
+                return true;
+            case 0b0000000011:
+                // SLTU
+                result = (T)(a < b) & 1u;
+                return true;
+            case 0b0000000100:
+                // XOR
+                result = a ^ b;
+                return true;
+            case 0b0000000101:
+                // SRL
+                result = a >> (b & 0x1Fu);
+                return true;
+            case 0b0100000101:
+                // SRA
+                result = (T)((S)a >> (S)(b & 0x1Fu));
+                return true;
+            case 0b0000000110:
+                // OR
+                result = a | b;
+                return true;
+            case 0b0000000111:
+                // AND
+                result = a & b;
+                return true;
+            case 0b0000001000:
+                // MUL
+                result = a * b;
+                return true;
+            case 0b0000001001:
+                // MULH
+                lanewise(a, b, result, mulh);
+                return true;
+            case 0b0000001010:
+                // MULHSU, signed rs1 times unsigned rs2
+                lanewise(a, b, result, mulhsu);
+                return true;
+            case 0b0000001011:
+                // MULHU
+                lanewise(a, b, result, mulhu);
+                return true;
+            case 0b0000001100:
+                // DIV
+                lanewise(a, b, result, div);
+                return true;
+            case 0b0000001101:
+                // DIVU
+                lanewise(a, b, result, divu);
+                return true;
+            case 0b0000001110:
+                // REM
+                lanewise(a, b, result, rem);
+                return true;
+            case 0b0000001111:
+                // REMU
+                lanewise(a, b, result, remu);
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    /**
+     * Register-immediate instructions of the base ISA
+     * @param funct3    funct3 of the instruction
+     * @param imm       sign-extended immediate, funct7 and shamt for the shifts
+     * @param a         value of rs1
+     * @param result    value of rd
+     * @return          false if a shift has an unknown funct7
+     */
+    template<typename T, typename S>
+    static bool immediateOp (unsigned int funct3, unsigned int imm, const T &a, T &result) {
+        const T b = T{} + imm;
+        const unsigned int shamt = imm & 0x1Fu;
+        const unsigned int funct7 = (imm >> 5u) & 0x7Fu;
+
+        switch (funct3) {
+            case 0b000:
+                // ADDI
+                result = a + b;
+                return true;
+            case 0b010:
+                // SLTI
+                result = (T)((S)a < (S)b) & 1u;
+                return true;
+            case 0b011:
+                // SLTIU
+                result = (T)(a < b) & 1u;
+                return true;
+            case 0b100:
+                // XORI
+                result = a ^ b;
+                return true;
+            case 0b110:
+                // ORI
+                result = a | b;
+                return true;
+            case 0b111:
+                // ANDI
+                result = a & b;
+                return true;
+            case 0b001:
+                // SLLI
+                result = a << shamt;
+                return funct7 == 0b0000000;
+            default:
+                if (funct7 == 0b0000000) {
+                    // SRLI
+                    result = a >> shamt;
+                    return true;
+                }
+                if (funct7 == 0b0100000) {
+                    // SRAI
+                    result = (T)((S)a >> int(shamt));
+                    return true;
+                }
+                return false;
+        }
+    }
+
+    /**
+     * Condition of the branch instructions
+     * @param funct3    funct3 of the instruction
+     * @param a         value of rs1
+     * @param b         value of rs2
+     * @param taken     non-zero if the branch is taken
+     * @return          false if funct3 is not a branch
+     */
+    template<typename T, typename S>
+    static bool branchTaken (unsigned int funct3, const T &a, const T &b, T &taken) {
+        switch (funct3) {
+            case 0b000:
+                // BEQ
+                taken = (T)(a == b);
+                return true;
+            case 0b001:
+                // BNE
+                taken = (T)(a != b);
+                return true;
+            case 0b100:
+                // BLT
+                taken = (T)((S)a < (S)b);
+                return true;
+            case 0b101:
+                // BGE
+                taken = (T)((S)a >= (S)b);
+                return true;
+            case 0b110:
+                // BLTU
+                taken = (T)(a < b);
+                return true;
+            case 0b111:
+                // BGEU
+                taken = (T)(a >= b);
+                return true;
+            default:
+                return false;
+        }
+    }
+private:
+    /**
+     * Applies a scalar operation to a scalar or to every lane
+     */
+    template<typename T>
+    static void lanewise (const T &a, const T &b, T &result, unsigned int (*op) (unsigned int, unsigned int)) {
+        if constexpr (std::is_same<T, unsigned int>::value) {
+            result = op(a, b);
+        } else {
+            for (unsigned int l = 0; l < sizeof(T) / sizeof(unsigned int); l++) {
+                result[l] = op(a[l], b[l]);
+            }
+        }
+    }
+
+    static unsigned int mulh (unsigned int a, unsigned int b) {
+        return uint32_t((int64_t(int32_t(a)) * int64_t(int32_t(b))) >> 32);
+    }
+
+    static unsigned int mulhsu (unsigned int a, unsigned int b) {
+        return uint32_t((int64_t(int32_t(a)) * int64_t(uint64_t(b))) >> 32);
+    }
+
+    static unsigned int mulhu (unsigned int a, unsigned int b) {
+        return uint32_t((uint64_t(a) * uint64_t(b)) >> 32);
+    }
+
+    // division by zero and the overflow of DIV and REM give the results of the ISA, not a trap
+    static unsigned int div (unsigned int a, unsigned int b) {
+        if (b == 0) {
+            return 0xFFFFFFFFu;
+        }
+        if (a == 0x80000000u && b == 0xFFFFFFFFu) {
+            return 0x80000000u;
+        }
+        return unsigned(int(a) / int(b));
+    }
+
+    static unsigned int divu (unsigned int a, unsigned int b) {
+        return b == 0 ? 0xFFFFFFFFu : a / b;
+    }
+
+    static unsigned int rem (unsigned int a, unsigned int b) {
+        if (b == 0) {
+            return a;
+        }
+        if (a == 0x80000000u && b == 0xFFFFFFFFu) {
+            return 0;
+        }
+        return unsigned(int(a) % int(b));
+    }
+
+    static unsigned int remu (unsigned int a, unsigned int b) {
+        return b == 0 ? a : a % b;
+    }
+};
+
+
+#endif //ISA_SIM_CPP_INTEGER_ALU_H
@@ -2,40 +2,224 @@
 // Matej Majtan (s184457) & Søren Tønnesen (s180381)
 // 02-12-2019
 
+#include <algorithm>
+#include <cstdlib>
 #include <filesystem>
 #include <iostream>
 #include <fstream>
-#include <bitset>
+#include <sstream>
 #include <string>
+#include <thread>
+#include <atomic>
+#include <unordered_map>
 #include "isa_simulator.h"
+#include "quantum_barrier.h"
+#include "disassembler.h"
+#include "clint.h"
+#include "uart.h"
+#include "block_device.h"
+#include "checkpoint.h"
+#include "vector_register_file.h"
 
 /**
- * ISA Simulator constructor: initializes the objects and the opcode map
+ * ISA Simulator constructor: initializes the shared memory
+ * @param harts     number of harts sharing the memory
  */
-ISA_Simulator::ISA_Simulator () {
-    pc = 0;
-    registerFile = RegisterFile::getInstance();
-    term = new Termination();
-    // setup the opcode lookup map
-    opcode_map.insert({0b0110011, new RegArithLogDecoder});
-    opcode_map.insert({0b0010011, new ImmArithLogDecoder});
-    opcode_map.insert({0b0000011, new LoadDecoder});
-    opcode_map.insert({0b0100011, new StoreDecoder});
-    opcode_map.insert({0b1100011, new BranchDecoder});
-    opcode_map.insert({0b0110111, new UpperImmDecoder});
-    opcode_map.insert({0b0010111, new UpperImmDecoder});
-    opcode_map.insert({0b1101111, new JumpLinkDecoder});
-    opcode_map.insert({0b1100111, new JumpLinkRegDecoder});
-    opcode_map.insert({0b1110011, new EcallDecoder});
+ISA_Simulator::ISA_Simulator (unsigned int harts) {
+    hart_count = harts;
+    quantum = QUANTUM_DEFAULT;
+    deterministic = false;
+    thread_count = std::max(1u, std::thread::hardware_concurrency());
+    clint = nullptr;
+    uart = nullptr;
+    disk_path = nullptr;
+    syscalls = nullptr;
+    snapshot_interval = SNAPSHOT_INTERVAL_DEFAULT;
+    replay_until = 0;
+    checkpoint_path = nullptr;
+    checkpoint_at = 0;
+    start_checkpoint = nullptr;
+    // created before the hart threads are started
+    Stack::getInstance();
 }
 
 /**
- * Function for loading the binary file and converting it into
- * a standard vector of integers
+ * Sets the number of instructions a hart executes before it synchronizes with the others
+ * @param length    quantum length in instructions
+ */
+void ISA_Simulator::setQuantum (unsigned long long length) {
+    quantum = length;
+}
+
+/**
+ * Selects deterministic execution: harts run one after another on a single
+ * host thread in round-robin order, one quantum each
+ * @param enabled   true for deterministic execution
+ */
+void ISA_Simulator::setDeterministic (bool enabled) {
+    deterministic = enabled;
+}
+
+/**
+ * Sets the number of host threads the guests are multiplexed on
+ * @param count     number of host threads
+ */
+void ISA_Simulator::setThreads (unsigned int count) {
+    thread_count = count;
+}
+
+/**
+ * Sets the image file read by the block device
+ * @param imagepath the path to the image
+ */
+void ISA_Simulator::setDisk (const char *imagepath) {
+    disk_path = imagepath;
+}
+
+/**
+ * Sets how often a recording run writes a snapshot of the machine into the log
+ * @param length    instructions of hart 0 between snapshots, 0 disables them
+ */
+void ISA_Simulator::setSnapshotInterval (unsigned long long length) {
+    snapshot_interval = length;
+}
+
+/**
+ * Makes a replay stop once hart 0 retired the given number of instructions.
+ * The replay starts from the last snapshot before it.
+ * @param instruction   retired instructions of hart 0
+ */
+void ISA_Simulator::setReplayUntil (unsigned long long instruction) {
+    replay_until = instruction;
+}
+
+/**
+ * Makes the run write a checkpoint once, at the given instruction of hart 0 or when
+ * a hart executes the marker ecall
+ * @param path          path of the checkpoint file
+ * @param instruction   retired instructions of hart 0, 0 for the marker ecall
+ */
+void ISA_Simulator::setCheckpoint (const char *path, unsigned long long instruction) {
+    checkpoint_path = path;
+    checkpoint_at = instruction;
+}
+
+/**
+ * Makes the run start from a checkpoint taken from the same binary and configuration
+ * @param path  path of the checkpoint file
+ */
+void ISA_Simulator::setStartCheckpoint (const char *path) {
+    start_checkpoint = path;
+}
+
+/**
+ * Function for loading the binary file and starting the harts
  * @param filepath  the path to the binary file
  * @return          true if successful otherwise false
  */
 bool ISA_Simulator::loadFile (const char *filepath) {
+    std::vector<unsigned int> words;
+    if (!readBinary(filepath, words)) {
+        return false;
+    }
+    image = std::make_shared<const ProgramImage>(std::move(words));
+    Stack::getInstance()->loadImage(image);
+    syscalls = new SyscallHandler(image->size());
+    for (unsigned int i = 0; i < hart_count; i++) {
+        harts.push_back(new Hart(i, *Stack::getInstance()));
+        harts.back()->setSyscalls(syscalls);
+    }
+    clint = new Clint(harts);
+    Stack::getInstance()->attach(CLINT_BASE, CLINT_SIZE, clint);
+    uart = new Uart();
+    Stack::getInstance()->attach(UART_BASE, UART_SIZE, uart);
+    if (disk_path != nullptr) {
+        auto *disk = new BlockDevice(*Stack::getInstance());
+        if (!disk->open(disk_path)) {
+            return false;
+        }
+        Stack::getInstance()->attach(BLOCK_DEVICE_BASE, BLOCK_DEVICE_SIZE, disk);
+    }
+    return start_checkpoint == nullptr || load_checkpoint();
+}
+
+/**
+ * Loads the list of guests. Every line holds the path of a binary, relative
+ * to the list, optionally followed by the number of its instances.
+ * Empty lines and lines starting with # are ignored. Every binary is loaded
+ * and predecoded once, its instances share the program image. Binaries with
+ * the same contents share one image even under different paths.
+ * @param listpath  the path to the list of guests
+ * @return          true if successful otherwise false
+ */
+bool ISA_Simulator::loadGuests (const char *listpath) {
+    std::ifstream file(listpath);
+    if (!file.is_open()) {
+        std::cerr << "Not a valid file\n";
+        return false;
+    }
+
+    std::map<std::string, std::shared_ptr<const ProgramImage>> loaded;
+    std::unordered_multimap<uint64_t, std::shared_ptr<const ProgramImage>> images;
+    std::filesystem::path directory = std::filesystem::path(listpath).parent_path();
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream tokens(line);
+        std::string path;
+        std::string instances;
+        unsigned long count = 1;
+        if (!(tokens >> path) || path[0] == '#') {
+            continue;
+        }
+        if (tokens >> instances) {
+            char *end;
+            count = std::strtoul(instances.c_str(), &end, 10);
+            if (*end != '\0' || count == 0) {
+                std::cerr << "Invalid number of instances: " << line << "\n";
+                return false;
+            }
+        }
+        path = (directory / path).string();
+
+        auto it = loaded.find(path);
+        if (it == loaded.end()) {
+            std::vector<unsigned int> words;
+            if (!readBinary(path.c_str(), words)) {
+                return false;
+            }
+            uint64_t hash = ProgramImage::hash(words);
+            std::shared_ptr<const ProgramImage> program;
+            auto range = images.equal_range(hash);
+            for (auto same = range.first; same != range.second; ++same) {
+                if (same->second->words() == words) {
+                    program = same->second;
+                }
+            }
+            if (program == nullptr) {
+                program = std::make_shared<const ProgramImage>(std::move(words));
+                images.emplace(hash, program);
+            }
+            it = loaded.insert({path, program}).first;
+        }
+        for (unsigned long i = 0; i < count; i++) {
+            guests.push_back(new Guest(guests.size(), it->second, quantum));
+        }
+    }
+    if (guests.empty()) {
+        std::cerr << "No guests in " << listpath << "\n";
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Function for reading the binary file and converting it into
+ * a standard vector of integers
+ * @param filepath  the path to the binary file
+ * @param words     vector the instructions are appended to
+ * @return          true if successful otherwise false
+ */
+bool ISA_Simulator::readBinary (const char *filepath, std::vector<unsigned int> &words) {
     std::ifstream file;
 
     if (!std::filesystem::exists(filepath) ||
@@ -55,59 +239,202 @@ bool ISA_Simulator::loadFile (const char *filepath) {
         file.close();
     }
 
+    // code with compressed instructions may end in the middle of a word
+    lines.resize((lines.length() + 3) / 4 * 4, '\0');
     auto *temp = reinterpret_cast<unsigned int*>(lines.data());
-    inst_mem.insert(inst_mem.end(), &temp[0], &temp[lines.length() / 4]);
+    words.insert(words.end(), &temp[0], &temp[lines.length() / 4]);
     return true;
 }
 
 /**
- * Fetch and execute next instruction from the instruction memory
- * @return  false if EOF is reached otherwise true
- */
-exec_result_t ISA_Simulator::executeInstruction () {
-    unsigned char opcode = 0;
-    try {
-        // fetch instruction
-        unsigned int inst = inst_mem.at(pc / 4);
-        // decode instruction and execute
-        opcode = inst & 0x0000007Fu;
-
-        // execute instruction and update pc
-        pc = opcode_map.at(opcode)->decode(pc, inst);
-
-#ifdef DEBUG
-        std::cout << "\nProgram counter: " << std::dec << pc << "\n";
-        registerFile->print_registers();
-#endif
-
-    } catch (const std::out_of_range& e) {
-        std::string exception = e.what();
-        // distinguish between individual exceptions
-        if (exception.find("vector::_M_range_check") != std::string::npos) {
-            // out of range of inst_mem
-            //TODO: test this
-            if (pc == inst_mem.size() * 4 + 4) {
-                // one further than the size => EOF
-                term->terminate("End of file reached", 0);
-                return EXEC_EOF;
-            } else {
-                //wrong address (pc)
-                term->terminate("Wrong instruction address: pc = " + std::to_string(pc), 2);
-                return EXEC_ERROR;
+ * Prints disassembly of the loaded binary
+ */
+void ISA_Simulator::disassemble () {
+    Disassembler::dump(image->words());
+}
+
+/**
+ * Runs all harts until one of them terminates, then prints the result and exits
+ */
+void ISA_Simulator::run () {
+    if (!guests.empty()) {
+        run_guests();
+    }
+    ReplayLog *log = ReplayLog::active();
+    std::string state;
+    if (log != nullptr && log->replaying() && replay_until != 0 && log->findSnapshot(replay_until, state)) {
+        std::istringstream in(state);
+        restore_snapshot(in);
+    }
+    unsigned int halted;
+    if (harts.size() == 1 || deterministic || log != nullptr || checkpoint_path != nullptr) {
+        halted = run_round_robin();
+    } else {
+        halted = run_threaded();
+    }
+    Termination::finish(harts, halted);
+}
+
+/**
+ * Runs the harts one quantum after another on the calling thread.
+ * A recording run writes snapshots between the rounds, a replay stops
+ * hart 0 at the requested instruction. A checkpoint is written right after
+ * the run of the hart which reached its instruction or marker.
+ * @return  hart which terminated
+ */
+unsigned int ISA_Simulator::run_round_robin () {
+    ReplayLog *log = ReplayLog::active();
+    bool snapshots = log != nullptr && !log->replaying() && snapshot_interval != 0;
+    unsigned long long next_snapshot = snapshot_interval;
+    for (unsigned int i = 0; ; i = (i + 1) % harts.size()) {
+        Hart *hart = harts[i];
+        unsigned long long count = quantum;
+        if (i == 0 && replay_until != 0) {
+            count = std::min(count, replay_until - std::min(replay_until, hart->statistics()->instructions()));
+        }
+        if (i == 0 && checkpoint_path != nullptr && checkpoint_at != 0) {
+            count = std::min(count, checkpoint_at - std::min(checkpoint_at, hart->statistics()->instructions()));
+        }
+        // the host FPU state belongs to the hart which is running on the thread
+        if (harts.size() > 1) {
+            hart->floatRegisters()->attachHost();
+        }
+        if (hart->run(count) != EXEC_OK) {
+            return i;
+        }
+        if (harts.size() > 1) {
+            hart->floatRegisters()->detachHost();
+        }
+        if (i == 0 && replay_until != 0 && hart->statistics()->instructions() >= replay_until) {
+            hart->stop(halt_t{"Replay reached instruction " + std::to_string(hart->statistics()->instructions()), 0, false});
+            return i;
+        }
+        if (checkpoint_path != nullptr) {
+            bool reached = checkpoint_at != 0 ? i == 0 && hart->statistics()->instructions() >= checkpoint_at
+                                              : hart->markerReached();
+            if (reached) {
+                save_checkpoint();
             }
-        } else if (exception.find("map::at") != std::string::npos) {
-            // wrong opcode
-            term->terminate("Wrong opcode or not implemented instruction: opcode="
-                               + std::bitset<7>(opcode).to_string(), 1);
-            return EXEC_ERROR;
-        } else {
-            // other error
-            std::string msg = "Unknown error occurred: ";
-            msg += e.what();
-            term->terminate(msg, -1);
-            return EXEC_ERROR;
+        }
+        if (snapshots && i == harts.size() - 1 && harts[0]->statistics()->instructions() >= next_snapshot) {
+            std::ostringstream out;
+            save_snapshot(out);
+            log->writeSnapshot(harts[0]->statistics()->instructions(), out.str());
+            next_snapshot = harts[0]->statistics()->instructions() + snapshot_interval;
         }
     }
-    return EXEC_OK;
 }
 
+/**
+ * Writes the state of the whole machine, taken between two rounds of the harts
+ * @param out   snapshot stream
+ */
+void ISA_Simulator::save_snapshot (std::ostream &out) {
+    for (Hart *hart : harts) {
+        hart->save(out);
+    }
+    Stack::getInstance()->save(out);
+    syscalls->save(out);
+}
+
+/**
+ * Replaces the state of the whole machine by a snapshot
+ * @param in    snapshot stream
+ */
+void ISA_Simulator::restore_snapshot (std::istream &in) {
+    for (Hart *hart : harts) {
+        hart->restore(in);
+    }
+    Stack::getInstance()->restore(in);
+    syscalls->restore(in);
+}
+
+/**
+ * Writes the checkpoint of the whole machine and continues the run without further checkpoints
+ */
+void ISA_Simulator::save_checkpoint () {
+    checkpoint_header_t header{};
+    header.harts = harts.size();
+    header.vlen = VectorRegisterFile::vlen();
+    header.image_hash = image->hash();
+    header.instructions = harts[0]->statistics()->instructions();
+    std::ostringstream state;
+    for (Hart *hart : harts) {
+        hart->save(state);
+    }
+    Stack::getInstance()->saveDevices(state);
+    syscalls->save(state);
+    if (!Checkpoint::write(checkpoint_path, header, state.str(), *Stack::getInstance())) {
+        std::cerr << "Cannot write the checkpoint " << checkpoint_path << "\n";
+    } else {
+        std::cerr << "Checkpoint written at instruction " << header.instructions << " of hart 0\n";
+    }
+    checkpoint_path = nullptr;
+}
+
+/**
+ * Replaces the state of the machine by the checkpoint it starts from. Its pages
+ * are mapped into the memory, not read.
+ * @return  false if the file is not a checkpoint of this binary and configuration
+ */
+bool ISA_Simulator::load_checkpoint () {
+    checkpoint_header_t header{};
+    std::string state;
+    if (!Checkpoint::map(start_checkpoint, header, state, *Stack::getInstance())) {
+        std::cerr << "Not a valid checkpoint\n";
+        return false;
+    }
+    if (header.image_hash != image->hash() || header.harts != harts.size()
+        || header.vlen != VectorRegisterFile::vlen()) {
+        std::cerr << "Checkpoint was taken from another binary, number of harts or VLEN\n";
+        return false;
+    }
+    std::istringstream in(state);
+    for (Hart *hart : harts) {
+        hart->restore(in);
+    }
+    Stack::getInstance()->restoreDevices(in);
+    syscalls->restore(in);
+    return true;
+}
+
+/**
+ * Runs every hart on its own host thread. The harts meet at a barrier after
+ * every quantum, so none of them gets more than one quantum ahead of the others.
+ * @return  hart which terminated first
+ */
+unsigned int ISA_Simulator::run_threaded () {
+    QuantumBarrier barrier(harts.size());
+    std::atomic<int> halted{-1};
+    std::vector<std::thread> threads;
+
+    for (unsigned int i = 0; i < harts.size(); i++) {
+        threads.emplace_back([this, i, &barrier, &halted] {
+            Hart *hart = harts[i];
+            hart->floatRegisters()->attachHost();
+            do {
+                if (hart->run(quantum) != EXEC_OK) {
+                    // the first hart to terminate ends the simulation
+                    int none = -1;
+                    halted.compare_exchange_strong(none, int(i));
+                    barrier.stop();
+                    return;
+                }
+            } while (barrier.arriveAndWait());
+        });
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    return (unsigned int)(halted.load());
+}
+
+/**
+ * Runs all guests on the host threads until every one of them terminates,
+ * then prints the results and exits
+ */
+void ISA_Simulator::run_guests () {
+    GuestScheduler scheduler(std::min<unsigned long>(thread_count, guests.size()));
+    scheduler.run(guests);
+    Termination::finishGuests(guests, scheduler);
+}
@@ -5,32 +5,62 @@
 #ifndef ISA_SIM_CPP_ISA_SIMULATOR_H
 #define ISA_SIM_CPP_ISA_SIMULATOR_H
 
+#include <memory>
 #include <vector>
 #include <map>
-#include "instruction_decoder.h"
-#include "register_file.h"
-#include "isa_simulator.h"
+#include "hart.h"
+#include "guest_scheduler.h"
+#include "program_image.h"
 #include "termination.h"
+#include "macro_fusion.h"
+#include "syscall_handler.h"
+#include "replay_log.h"
 
-typedef enum {
-    EXEC_OK,
-    EXEC_ERROR,
-    EXEC_EOF,
-    EXEC_ECALL
-} exec_result_t;
-
+#define HARTS_MAX           64
+#define QUANTUM_DEFAULT     10000
+#define THREADS_MAX         256
 
 class ISA_Simulator {
 public:
-    ISA_Simulator ();
+    explicit ISA_Simulator (unsigned int harts = 1);
+    void setQuantum (unsigned long long length);
+    void setDeterministic (bool enabled);
+    void setThreads (unsigned int count);
+    void setDisk (const char *imagepath);
+    void setSnapshotInterval (unsigned long long length);
+    void setReplayUntil (unsigned long long instruction);
+    void setCheckpoint (const char *path, unsigned long long instruction);
+    void setStartCheckpoint (const char *path);
     bool loadFile (const char * filepath);
-    exec_result_t executeInstruction ();
+    bool loadGuests (const char *listpath);
+    static bool readBinary (const char *filepath, std::vector<unsigned int> &words);
+    void run ();
+    void disassemble ();
 private:
-    unsigned int pc;
-    Termination *term;
-    RegisterFile *registerFile;
-    std::vector<unsigned int> inst_mem;
-    std::map<unsigned int, InstructionDecoder*> opcode_map;
+    unsigned int run_round_robin ();
+    void save_snapshot (std::ostream &out);
+    void restore_snapshot (std::istream &in);
+    void save_checkpoint ();
+    bool load_checkpoint ();
+    unsigned int run_threaded ();
+    [[noreturn]] void run_guests ();
+
+    unsigned int hart_count;
+    unsigned long long quantum;
+    bool deterministic;
+    std::vector<Hart*> harts;
+    Device *clint;
+    Device *uart;
+    const char *disk_path;
+    SyscallHandler *syscalls;
+    unsigned long long snapshot_interval;
+    unsigned long long replay_until;           // instruction of hart 0 a replay stops at, 0 for the whole run
+    const char *checkpoint_path;                // checkpoint written during the run, or nullptr
+    unsigned long long checkpoint_at;           // instruction of hart 0 it is written at, 0 for the marker ecall
+    const char *start_checkpoint;               // checkpoint the run starts from, or nullptr
+    std::shared_ptr<const ProgramImage> image;
+    unsigned int thread_count;
+    std::vector<Guest*> guests;
 };
 
 
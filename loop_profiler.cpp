@@ -0,0 +1,289 @@
+// loop_profiler.cpp
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include "loop_profiler.h"
+#include "instrumentation.h"
+#include "hart.h"
+
+std::mutex LoopProfiler::s_lock;
+std::vector<std::unique_ptr<LoopProfile>> LoopProfiler::s_profiles;
+
+static const char *const mix_names[LOOP_MIX_COUNT] = {
+        "alu", "mul/div", "load", "store", "branch", "jump", "float", "vector", "atomic", "system"
+};
+
+/**
+ * Loop profile constructor
+ */
+LoopProfile::LoopProfile () {
+    m_time = 0;
+    m_depth = 0;
+    m_previous_pc = 0;
+    m_previous_inst = 0;
+}
+
+/**
+ * Follows the control flow of the hart before an instruction executes
+ * @param pc    program counter
+ * @param inst  instruction, expanded if it is compressed
+ */
+void LoopProfile::fetch (unsigned int pc, unsigned int inst) {
+    unsigned int opcode = m_previous_inst & 0x7Fu;
+    unsigned int rd = (m_previous_inst >> 7) & 0x1Fu;
+    unsigned int rs1 = (m_previous_inst >> 15) & 0x1Fu;
+    // calls and returns by the conventions of the ABI, ra or t0 holds the return address
+    if ((opcode == 0x6F || opcode == 0x67) && (rd == 1 || rd == 5)) {
+        m_depth++;
+    } else if (opcode == 0x67 && rd == 0 && (rs1 == 1 || rs1 == 5) && m_depth > 0) {
+        m_depth--;
+    }
+
+    while (!m_running.empty()) {
+        const loop_entry_t &entry = m_running.back();
+        const loop_t &loop = m_loops[entry.loop];
+        if (m_depth > entry.depth || (m_depth == entry.depth && pc >= loop.header && pc <= loop.latch)) {
+            break;
+        }
+        leave(m_time);
+    }
+
+    // a taken branch or jump (jal x0) to its own address or before it
+    bool backward = (opcode == 0x63 || (opcode == 0x6F && rd == 0)) && offset(m_previous_inst) <= 0
+                    && pc == m_previous_pc + offset(m_previous_inst);
+    uint32_t index = pc / 2 < m_headers.size() ? m_headers[pc / 2] : 0;
+    if (backward) {
+        if (index == 0) {
+            m_loops.push_back(loop_t{pc, m_previous_pc, false, 0, 0, 0, {}, {}});
+            if (pc / 2 >= m_headers.size()) {
+                m_headers.resize(pc / 2 + 1, 0);
+            }
+            index = m_headers[pc / 2] = m_loops.size();
+        }
+        loop_t &loop = m_loops[index - 1];
+        loop.latch = std::max(loop.latch, m_previous_pc);
+        if (loop.active) {
+            while (m_running.back().loop != index - 1) {
+                leave(m_time);
+            }
+            m_running.back().trips++;
+        } else {
+            enter(index - 1, 2);
+        }
+    } else if (index != 0 && !m_loops[index - 1].active) {
+        enter(index - 1, 1);
+    }
+
+    if (!m_running.empty()) {
+        m_loops[m_running.back().loop].mix[kind(inst)]++;
+    }
+    m_time++;
+    m_previous_pc = pc;
+    m_previous_inst = inst;
+}
+
+/**
+ * Ends the running loops, called once the hart stopped
+ */
+void LoopProfile::close () {
+    while (!m_running.empty()) {
+        leave(m_time);
+    }
+}
+
+/**
+ * Starts an entry of a loop at the current instruction
+ * @param loop  index of the loop
+ * @param trips iteration the entry starts at
+ */
+void LoopProfile::enter (unsigned int loop, uint64_t trips) {
+    m_loops[loop].active = true;
+    m_running.push_back(loop_entry_t{loop, m_depth, m_time, trips});
+}
+
+/**
+ * Ends the entry of the innermost running loop and counts it
+ * @param end   instructions executed before the loop was left
+ */
+void LoopProfile::leave (uint64_t end) {
+    const loop_entry_t &entry = m_running.back();
+    loop_t &loop = m_loops[entry.loop];
+    loop.active = false;
+    loop.entries++;
+    loop.iterations += entry.trips;
+    loop.instructions += end - entry.start;
+    loop.trips[std::min(63u - __builtin_clzll(entry.trips), LOOP_TRIP_BUCKETS - 1u)]++;
+    m_running.pop_back();
+}
+
+/**
+ * @param inst  branch or jal instruction, expanded if it is compressed
+ * @return      offset of its target from its own address
+ */
+int LoopProfile::offset (unsigned int inst) {
+    if ((inst & 0x7Fu) == 0x6F) {
+        return (int32_t(inst & 0x80000000u) >> 11) | (inst & 0xFF000u) | ((inst >> 9) & 0x800u)
+               | ((inst >> 20) & 0x7FEu);
+    }
+    return (int32_t(inst & 0x80000000u) >> 19) | ((inst << 4) & 0x800u) | ((inst >> 20) & 0x7E0u)
+           | ((inst >> 7) & 0x1Eu);
+}
+
+/**
+ * @param inst  instruction, expanded if it is compressed
+ * @return      kind of the instruction in the mix
+ */
+loop_mix_t LoopProfile::kind (unsigned int inst) {
+    switch (inst & 0x7Fu) {
+        case 0x33:
+            return (inst >> 25) == 0x01 ? LOOP_MIX_MUL_DIV : LOOP_MIX_ALU;
+        case 0x13:
+        case 0x37:
+        case 0x17:
+            return LOOP_MIX_ALU;
+        case 0x03:
+        case 0x07:
+            return LOOP_MIX_LOAD;
+        case 0x23:
+        case 0x27:
+            return LOOP_MIX_STORE;
+        case 0x63:
+            return LOOP_MIX_BRANCH;
+        case 0x6F:
+        case 0x67:
+            return LOOP_MIX_JUMP;
+        case 0x43:
+        case 0x47:
+        case 0x4B:
+        case 0x4F:
+        case 0x53:
+            return LOOP_MIX_FLOAT;
+        case 0x57:
+            return LOOP_MIX_VECTOR;
+        case 0x2F:
+            return LOOP_MIX_ATOMIC;
+        default:
+            return LOOP_MIX_SYSTEM;
+    }
+}
+
+/**
+ * Enables the loop profiler, the loops are printed at the end of simulation
+ */
+void LoopProfiler::enable () {
+    Instrumentation::select(INSTRUMENT_LOOPS);
+}
+
+/**
+ * Follows the control flow of a hart
+ * @param hart  hart fetching the instruction
+ * @param pc    program counter
+ * @param inst  instruction, expanded if it is compressed
+ */
+void LoopProfiler::fetch (Hart &hart, unsigned int pc, unsigned int inst) {
+    profile(hart).fetch(pc, inst);
+}
+
+/**
+ * @param hart  hart executing the instructions
+ * @return      loop profile of the hart, created on its first instruction
+ */
+LoopProfile &LoopProfiler::profile (Hart &hart) {
+    if (hart.loopProfile() == nullptr) {
+        std::lock_guard<std::mutex> guard(s_lock);
+        s_profiles.push_back(std::make_unique<LoopProfile>());
+        hart.setLoopProfile(s_profiles.back().get());
+    }
+    return *hart.loopProfile();
+}
+
+/**
+ * Merges the loops of all harts by their headers and prints them ranked by
+ * the instructions executed inside them. Called once all harts stopped.
+ */
+void LoopProfiler::finish () {
+    if (!(Instrumentation::selected() & INSTRUMENT_LOOPS)) {
+        return;
+    }
+    uint64_t total = 0;
+    std::map<unsigned int, loop_t> merged;
+    for (const auto &profile : s_profiles) {
+        profile->close();
+        total += profile->m_time;
+        for (const loop_t &loop : profile->m_loops) {
+            auto inserted = merged.emplace(loop.header, loop);
+            if (inserted.second) {
+                continue;
+            }
+            loop_t &into = inserted.first->second;
+            into.latch = std::max(into.latch, loop.latch);
+            into.entries += loop.entries;
+            into.iterations += loop.iterations;
+            into.instructions += loop.instructions;
+            for (unsigned int i = 0; i < LOOP_MIX_COUNT; i++) {
+                into.mix[i] += loop.mix[i];
+            }
+            for (unsigned int i = 0; i < LOOP_TRIP_BUCKETS; i++) {
+                into.trips[i] += loop.trips[i];
+            }
+        }
+    }
+    std::vector<loop_t> loops;
+    for (const auto &entry : merged) {
+        loops.push_back(entry.second);
+    }
+    std::stable_sort(loops.begin(), loops.end(), [] (const loop_t &a, const loop_t &b) {
+        return a.instructions > b.instructions;
+    });
+
+    std::cout << std::setfill(' ') << "\n\033[1mLoops:\033[0m " << std::dec << loops.size() << " detected, "
+              << total << " instructions\n";
+    if (loops.empty()) {
+        return;
+    }
+    std::cout << "  header      latch          entries   iterations  trips/entry   instructions    share  per iteration\n";
+    for (unsigned long i = 0; i < std::min<unsigned long>(loops.size(), LOOP_REPORT_LOOPS); i++) {
+        const loop_t &loop = loops[i];
+        std::cout << "  0x" << std::hex << std::setfill('0') << std::setw(8) << loop.header
+                  << "  0x" << std::setw(8) << loop.latch << std::dec << std::setfill(' ')
+                  << std::setw(11) << loop.entries << std::setw(13) << loop.iterations
+                  << std::fixed << std::setprecision(1)
+                  << std::setw(13) << double(loop.iterations) / double(loop.entries)
+                  << std::setw(15) << loop.instructions
+                  << std::setw(8) << std::setprecision(2) << 100.0 * double(loop.instructions) / double(total) << "%"
+                  << std::setw(15) << std::setprecision(1) << double(loop.instructions) / double(loop.iterations)
+                  << "\n";
+
+        uint64_t body = 0;
+        for (uint64_t count : loop.mix) {
+            body += count;
+        }
+        std::cout << "    mix:  ";
+        for (unsigned int kind = 0; kind < LOOP_MIX_COUNT; kind++) {
+            if (loop.mix[kind] != 0) {
+                std::cout << " " << mix_names[kind] << " " << std::setprecision(1)
+                          << 100.0 * double(loop.mix[kind]) / double(body) << "%";
+            }
+        }
+        std::cout << "\n    trips:";
+        for (unsigned int bucket = 0; bucket < LOOP_TRIP_BUCKETS; bucket++) {
+            if (loop.trips[bucket] == 0) {
+                continue;
+            }
+            uint64_t low = 1ull << bucket;
+            std::string range = bucket == LOOP_TRIP_BUCKETS - 1 ? std::to_string(low) + "+"
+                              : low == 1 ? std::string("1")
+                              : std::to_string(low) + "-" + std::to_string(2 * low - 1);
+            std::cout << " " << range << " x" << loop.trips[bucket];
+        }
+        std::cout << "\n";
+    }
+    if (loops.size() > LOOP_REPORT_LOOPS) {
+        std::cout << "  ... " << loops.size() - LOOP_REPORT_LOOPS << " more\n";
+    }
+}
@@ -0,0 +1,110 @@
+// loop_profiler.h
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#ifndef ISA_SIM_CPP_LOOP_PROFILER_H
+#define ISA_SIM_CPP_LOOP_PROFILER_H
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class Hart;
+
+#define LOOP_TRIP_BUCKETS   16      // [2^b, 2^(b+1)) trips per entry, the last one is open
+#define LOOP_REPORT_LOOPS   20      // loops listed in the report
+
+/**
+ * Kinds of instructions of the mix of a loop
+ */
+typedef enum {
+    LOOP_MIX_ALU,               // integer arithmetic, logic and upper immediates
+    LOOP_MIX_MUL_DIV,
+    LOOP_MIX_LOAD,              // integer, float and vector loads
+    LOOP_MIX_STORE,             // integer, float and vector stores
+    LOOP_MIX_BRANCH,
+    LOOP_MIX_JUMP,
+    LOOP_MIX_FLOAT,
+    LOOP_MIX_VECTOR,
+    LOOP_MIX_ATOMIC,
+    LOOP_MIX_SYSTEM,            // ecall, CSR and fence instructions
+    LOOP_MIX_COUNT
+} loop_mix_t;
+
+/**
+ * Counters of a loop, identified by its header
+ */
+typedef struct {
+    unsigned int header;                            // target of the backward branches and jumps
+    unsigned int latch;                             // highest address of such a branch or jump
+    bool active;                                    // on the stack of the running loops
+    uint64_t entries;
+    uint64_t iterations;
+    uint64_t instructions;                          // nested loops and called functions included
+    std::array<uint64_t, LOOP_MIX_COUNT> mix;       // instructions while no nested loop ran
+    std::array<uint64_t, LOOP_TRIP_BUCKETS> trips;  // histogram of the iterations per entry
+} loop_t;
+
+/**
+ * Entry of a running loop
+ */
+typedef struct {
+    unsigned int loop;              // index of the loop
+    unsigned int depth;             // calls in progress when the loop was entered
+    uint64_t start;                 // instructions executed before the entry
+    uint64_t trips;                 // iterations of the entry so far
+} loop_entry_t;
+
+/**
+ * Loops of one hart. A taken backward branch or jump (jal x0) makes its target
+ * the header of a loop whose body reaches up to the branch. The header table maps
+ * every halfword of the code to its loop, so the instruction fetch checks for an
+ * entry by one lookup. A loop ends when the hart leaves its body at the call depth it
+ * was entered at, or returns from the function containing it.
+ */
+class LoopProfile {
+public:
+    LoopProfile ();
+    void fetch (unsigned int pc, unsigned int inst);
+    void close ();
+private:
+    friend class LoopProfiler;
+
+    void enter (unsigned int loop, uint64_t trips);
+    void leave (uint64_t end);
+    static int offset (unsigned int inst);
+    static loop_mix_t kind (unsigned int inst);
+
+    std::vector<loop_t> m_loops;
+    std::vector<uint32_t> m_headers;    // index of the loop + 1 per halfword of the code, 0 if none
+    std::vector<loop_entry_t> m_running;// innermost loop last
+    uint64_t m_time;                    // instructions fetched
+    unsigned int m_depth;               // calls in progress
+    unsigned int m_previous_pc;
+    unsigned int m_previous_inst;
+};
+
+/**
+ * Dynamic loop detection and profiling. Every hart detects loops on its own,
+ * at exit the loops of all harts are merged by their headers and printed ranked
+ * by the instructions executed inside them, with their entries, the histogram of
+ * their trip counts, the instructions per iteration and the instruction mix.
+ * A loop is only known from its first backward branch on, so the entry it is
+ * detected in counts from its second iteration.
+ */
+class LoopProfiler {
+public:
+    static void enable ();
+    static void fetch (Hart &hart, unsigned int pc, unsigned int inst);
+    static void finish ();
+private:
+    static LoopProfile &profile (Hart &hart);
+
+    static std::mutex s_lock;
+    static std::vector<std::unique_ptr<LoopProfile>> s_profiles;
+};
+
+
+#endif //ISA_SIM_CPP_LOOP_PROFILER_H
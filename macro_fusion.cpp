@@ -0,0 +1,147 @@
+// macro_fusion.cpp
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#include "macro_fusion.h"
+#include "instruction_decoder.h"
+
+#define OPCODE_LUI      0b0110111u
+#define OPCODE_AUIPC    0b0010111u
+#define OPCODE_IMM      0b0010011u
+#define OPCODE_LOAD     0b0000011u
+#define OPCODE_JALR     0b1100111u
+
+/**
+ * Sign-extends 12-bit immediate of I-type instruction
+ * @param decoder   decoder union
+ * @return          sign-extended immediate
+ */
+static unsigned int i_imm (i_inst_t decoder) {
+    unsigned int imm = decoder.f.imm;
+    if (imm & 0x800) {
+        imm |= 0xFFFFF000;
+    }
+    return imm;
+}
+
+/**
+ * Macro fusion constructor
+ * @param registers   register file of the hart executing the fused pairs
+ * @param memory      data memory of the hart
+ */
+MacroFusion::MacroFusion (RegisterFile *registers, Stack *memory) {
+    reg = registers;
+    stack = memory;
+}
+
+/**
+ * Checks whether two consecutive instructions form a fusible idiom.
+ * Only pairs where the second instruction consumes the result of the first
+ * and the intermediate register is not x0 are fused.
+ * @param first     raw instruction at pc
+ * @param second    raw instruction at pc + 4
+ * @return          kind of fusion or FUSE_NONE
+ */
+fusion_t MacroFusion::detect (unsigned int first, unsigned int second) {
+    u_inst_t head{};
+    i_inst_t tail{};
+    head.inst = first;
+    tail.inst = second;
+
+    if (head.f.rd == RegisterFile::x0 || tail.f.rs1 != head.f.rd) {
+        return FUSE_NONE;
+    }
+
+    switch (head.f.opcode) {
+        case OPCODE_LUI:
+            if (tail.f.opcode == OPCODE_IMM && tail.f.funct3 == 0b000 && tail.f.rd == head.f.rd) {
+                return FUSE_LUI_ADDI;
+            }
+            break;
+        case OPCODE_AUIPC:
+            if (tail.f.opcode == OPCODE_JALR && tail.f.funct3 == 0b000) {
+                return FUSE_AUIPC_JALR;
+            }
+            if (tail.f.opcode == OPCODE_LOAD && tail.f.funct3 == 0b010) {
+                return FUSE_AUIPC_LW;
+            }
+            break;
+        case OPCODE_IMM: {
+            i_inst_t shift{};
+            shift.inst = first;
+            // both shifts have to use the same shift amount with funct7 = 0
+            if (shift.f.funct3 == 0b001 && tail.f.opcode == OPCODE_IMM && tail.f.funct3 == 0b101 &&
+                tail.f.rd == shift.f.rd && shift.f.imm < 32 && tail.f.imm == shift.f.imm) {
+                return FUSE_SLLI_SRLI;
+            }
+            break;
+        }
+        default:
+            break;
+    }
+    return FUSE_NONE;
+}
+
+/**
+ * Gets printable name of the fused idiom
+ * @param kind  kind of fusion
+ * @return      name of the idiom
+ */
+const char *MacroFusion::name (fusion_t kind) {
+    switch (kind) {
+        case FUSE_LUI_ADDI:
+            return "lui+addi";
+        case FUSE_AUIPC_JALR:
+            return "auipc+jalr";
+        case FUSE_AUIPC_LW:
+            return "auipc+lw";
+        case FUSE_SLLI_SRLI:
+            return "slli+srli";
+        default:
+            return "none";
+    }
+}
+
+/**
+ * Executes a fused pair of instructions. The architectural state after the call
+ * is the same as after executing both instructions one by one.
+ * @param kind      kind of fusion returned by detect
+ * @param pc        program counter of the first instruction
+ * @param first     raw instruction at pc
+ * @param second    raw instruction at pc + 4
+ * @return          new program counter
+ */
+unsigned int MacroFusion::execute (fusion_t kind, unsigned int pc, unsigned int first, unsigned int second) {
+    u_inst_t head{};
+    i_inst_t tail{};
+    head.inst = first;
+    tail.inst = second;
+
+    unsigned int upper = head.f.imm31_12 << 12u;
+    unsigned int lower = i_imm(tail);
+
+    switch (kind) {
+        case FUSE_LUI_ADDI:
+            reg->write(tail.f.rd, upper + lower);
+            return pc + 8;
+        case FUSE_AUIPC_JALR:
+            // rd of auipc is written first, so jalr ra, lo(ra) leaves the link in ra
+            reg->write(head.f.rd, pc + upper);
+            reg->write(tail.f.rd, pc + 8);
+            return (pc + upper + lower) & 0xFFFFFFFEu;
+        case FUSE_AUIPC_LW:
+            // write the address first so a faulting load leaves the same state
+            reg->write(head.f.rd, pc + upper);
+            reg->write(tail.f.rd, stack->readWord(pc + upper + lower));
+            return pc + 8;
+        case FUSE_SLLI_SRLI: {
+            i_inst_t shift{};
+            shift.inst = first;
+            unsigned int shamt = shift.f.imm;
+            reg->write(tail.f.rd, (reg->read(shift.f.rs1) << shamt) >> shamt);
+            return pc + 8;
+        }
+        default:
+            return pc;
+    }
+}
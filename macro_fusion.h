@@ -0,0 +1,38 @@
+// macro_fusion.h
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#ifndef ISA_SIM_CPP_MACRO_FUSION_H
+#define ISA_SIM_CPP_MACRO_FUSION_H
+
+#include "register_file.h"
+#include "stack.h"
+
+/**
+ * Instruction pairs that can be executed as one fused operation
+ */
+typedef enum {
+    FUSE_NONE,
+    FUSE_LUI_ADDI,      // lui rd, hi; addi rd, rd, lo
+    FUSE_AUIPC_JALR,    // auipc rd, hi; jalr rd2, lo(rd)
+    FUSE_AUIPC_LW,      // auipc rd, hi; lw rd2, lo(rd)
+    FUSE_SLLI_SRLI,     // slli rd, rs, n; srli rd, rd, n
+    FUSE_COUNT
+} fusion_t;
+
+/**
+ * Macro-op fusion of common instruction idioms
+ */
+class MacroFusion {
+private:
+    RegisterFile *reg;
+    Stack *stack;
+public:
+    MacroFusion (RegisterFile *registers, Stack *memory);
+    static fusion_t detect (unsigned int first, unsigned int second);
+    static const char *name (fusion_t kind);
+    unsigned int execute (fusion_t kind, unsigned int pc, unsigned int first, unsigned int second);
+};
+
+
+#endif //ISA_SIM_CPP_MACRO_FUSION_H
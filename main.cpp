@@ -3,17 +3,249 @@
 // 02-12-2019
 
 #include <iostream>
+#include <cstring>
+#include <cstdlib>
+#include <thread>
 #include "isa_simulator.h"
+#include "simt_simulator.h"
+#include "statistics.h"
+#include "vector_register_file.h"
+#include "replay_log.h"
+#include "simulation_server.h"
+#include "co_simulator.h"
+#include "instrumentation.h"
+#include "memory_profiler.h"
+#include "cache_analyzer.h"
+#include "loop_profiler.h"
+#include "fuzzer.h"
+
+/**
+ * Prints error message about invalid command line argument and exits
+ * @param msg   error message
+ */
+static void usage_error (const std::string &msg) {
+    std::cerr << "\x1B[1;31m" << msg << "\x1B[0m\r\n";
+    std::cerr << "\x1B[1;31mTerminated with exit code: 3\x1B[0m\r\n\r\n";
+    exit(3);
+}
 
 int main (int argc, char *argv[]) {
-    if (argc < 2) {
-        std::cerr << "\x1B[1;31mNo input binary file\x1B[0m\r\n";
-        std::cerr << "\x1B[1;31mTerminated with exit code: 3\x1B[0m\r\n\r\n";
-        exit(3);
-    }
-    ISA_Simulator sim;
-    if (sim.loadFile(argv[1])) {
-        while (sim.executeInstruction() == EXEC_OK);
+    const char *binary = nullptr;
+    bool disasm = false;
+    bool deterministic = false;
+    bool lockstep = false;
+    bool cache_sweep = false;
+    unsigned long random_programs = 0;
+    unsigned long long seed = 1;
+    const char *lane_file = nullptr;
+    const char *guest_file = nullptr;
+    const char *disk_file = nullptr;
+    const char *record_file = nullptr;
+    const char *socket_path = nullptr;
+    const char *replay_file = nullptr;
+    const char *heatmap_file = nullptr;
+    const char *checkpoint_file = nullptr;
+    const char *fuzz_corpus = nullptr;
+    unsigned long long fuzz_runs = FUZZ_RUNS_DEFAULT;
+    unsigned long long fuzz_steps = FUZZ_STEPS_DEFAULT;
+    const char *start_checkpoint = nullptr;
+    unsigned long long checkpoint_at = 0;
+    unsigned long long heatmap_window = PROFILE_WINDOW_DEFAULT;
+    unsigned long long snapshot_interval = SNAPSHOT_INTERVAL_DEFAULT;
+    unsigned long long until = 0;
+    unsigned long harts = 1;
+    unsigned long threads = 0;
+    unsigned long long quantum = QUANTUM_DEFAULT;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--stats") == 0) {
+            Statistics::enable();
+        } else if (std::strcmp(argv[i], "--vlen") == 0 && i + 1 < argc) {
+            if (!VectorRegisterFile::setVlen(std::strtoul(argv[++i], nullptr, 10))) {
+                usage_error("VLEN must be a power of two between " + std::to_string(VLEN_MIN)
+                            + " and " + std::to_string(VLEN_MAX));
+            }
+        } else if (std::strcmp(argv[i], "--harts") == 0 && i + 1 < argc) {
+            harts = std::strtoul(argv[++i], nullptr, 10);
+            if (harts < 1 || harts > HARTS_MAX) {
+                usage_error("Number of harts must be between 1 and " + std::to_string(HARTS_MAX));
+            }
+        } else if (std::strcmp(argv[i], "--quantum") == 0 && i + 1 < argc) {
+            quantum = std::strtoull(argv[++i], nullptr, 10);
+            if (quantum == 0) {
+                usage_error("Quantum must be at least one instruction");
+            }
+        } else if (std::strcmp(argv[i], "--simt") == 0 && i + 1 < argc) {
+            lane_file = argv[++i];
+        } else if (std::strcmp(argv[i], "--guests") == 0 && i + 1 < argc) {
+            guest_file = argv[++i];
+        } else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = std::strtoul(argv[++i], nullptr, 10);
+            if (threads < 1 || threads > THREADS_MAX) {
+                usage_error("Number of threads must be between 1 and " + std::to_string(THREADS_MAX));
+            }
+        } else if (std::strcmp(argv[i], "--disk") == 0 && i + 1 < argc) {
+            disk_file = argv[++i];
+        } else if (std::strcmp(argv[i], "--sandbox") == 0 && i + 1 < argc) {
+            if (!SyscallHandler::setSandbox(argv[++i])) {
+                usage_error("Not a valid sandbox directory");
+            }
+        } else if (std::strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+            socket_path = argv[++i];
+        } else if (std::strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            record_file = argv[++i];
+        } else if (std::strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replay_file = argv[++i];
+        } else if (std::strcmp(argv[i], "--snapshot-interval") == 0 && i + 1 < argc) {
+            snapshot_interval = std::strtoull(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--until") == 0 && i + 1 < argc) {
+            until = std::strtoull(argv[++i], nullptr, 10);
+            if (until == 0) {
+                usage_error("Replay must stop after at least one instruction");
+            }
+        } else if (std::strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc) {
+            checkpoint_file = argv[++i];
+        } else if (std::strcmp(argv[i], "--checkpoint-at") == 0 && i + 1 < argc) {
+            checkpoint_at = std::strtoull(argv[++i], nullptr, 10);
+            if (checkpoint_at == 0) {
+                usage_error("Checkpoint must be taken after at least one instruction");
+            }
+        } else if (std::strcmp(argv[i], "--from-checkpoint") == 0 && i + 1 < argc) {
+            start_checkpoint = argv[++i];
+        } else if (std::strcmp(argv[i], "--deterministic") == 0) {
+            deterministic = true;
+        } else if (std::strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            if (!Instrumentation::setTrace(argv[++i])) {
+                usage_error("Cannot create the trace file");
+            }
+        } else if (std::strcmp(argv[i], "--break") == 0 && i + 1 < argc) {
+            Instrumentation::addBreakpoint(std::strtoul(argv[++i], nullptr, 0));
+        } else if (std::strcmp(argv[i], "--heatmap") == 0 && i + 1 < argc) {
+            heatmap_file = argv[++i];
+        } else if (std::strcmp(argv[i], "--heatmap-window") == 0 && i + 1 < argc) {
+            heatmap_window = std::strtoull(argv[++i], nullptr, 10);
+            if (heatmap_window == 0) {
+                usage_error("Heatmap window must be at least one instruction");
+            }
+        } else if (std::strcmp(argv[i], "--cache-sweep") == 0) {
+            cache_sweep = true;
+        } else if (std::strcmp(argv[i], "--loops") == 0) {
+            LoopProfiler::enable();
+        } else if (std::strcmp(argv[i], "--lockstep") == 0) {
+            lockstep = true;
+        } else if (std::strcmp(argv[i], "--lockstep-random") == 0 && i + 1 < argc) {
+            random_programs = std::strtoul(argv[++i], nullptr, 10);
+            if (random_programs == 0) {
+                usage_error("Number of random programs must be at least one");
+            }
+        } else if (std::strcmp(argv[i], "--fuzz") == 0 && i + 1 < argc) {
+            fuzz_corpus = argv[++i];
+        } else if (std::strcmp(argv[i], "--fuzz-runs") == 0 && i + 1 < argc) {
+            fuzz_runs = std::strtoull(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--fuzz-steps") == 0 && i + 1 < argc) {
+            fuzz_steps = std::strtoull(argv[++i], nullptr, 10);
+            if (fuzz_steps == 0) {
+                usage_error("Fuzzed runs must execute at least one instruction");
+            }
+        } else if (std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = std::strtoull(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--disasm") == 0) {
+            disasm = true;
+        } else {
+            binary = argv[i];
+        }
+    }
+
+    if (heatmap_file != nullptr) {
+        MemoryProfiler::enable(heatmap_file, heatmap_window);
+    }
+    if (cache_sweep) {
+        CacheAnalyzer::enable(threads != 0 ? threads : std::max(1u, std::thread::hardware_concurrency()));
+    }
+    if (socket_path != nullptr) {
+        SimulationServer server(threads != 0 ? threads : std::max(1u, std::thread::hardware_concurrency()));
+        if (!server.listen(socket_path)) {
+            usage_error("Cannot listen on socket " + std::string(socket_path));
+        }
+        server.run();
+    }
+    if (random_programs != 0) {
+        CoSimulator cosim;
+        return cosim.runRandom(random_programs, seed) ? 0 : 1;
+    }
+    if ((record_file != nullptr || replay_file != nullptr)
+        && (guest_file != nullptr || lane_file != nullptr || (record_file != nullptr && replay_file != nullptr))) {
+        usage_error("Record or replay works with a single binary only");
+    }
+    if ((checkpoint_file != nullptr || start_checkpoint != nullptr)
+        && (guest_file != nullptr || lane_file != nullptr || record_file != nullptr || replay_file != nullptr)) {
+        usage_error("Checkpoints work with a single binary only, without record or replay");
+    }
+    if (checkpoint_at != 0 && checkpoint_file == nullptr) {
+        usage_error("No checkpoint file for --checkpoint-at");
+    }
+    if (record_file != nullptr && !ReplayLog::startRecording(record_file, harts, quantum)) {
+        usage_error("Not a valid log file");
+    }
+    if (replay_file != nullptr) {
+        // the machine is configured as it was recorded
+        if (!ReplayLog::startReplay(replay_file)) {
+            usage_error("Not a valid log file");
+        }
+        harts = ReplayLog::active()->header().harts;
+        quantum = ReplayLog::active()->header().quantum;
+        VectorRegisterFile::setVlen(ReplayLog::active()->header().vlen);
+    }
+
+    if (guest_file != nullptr) {
+        ISA_Simulator sim;
+        sim.setQuantum(quantum);
+        if (threads != 0) {
+            sim.setThreads(threads);
+        }
+        if (sim.loadGuests(guest_file)) {
+            sim.run();
+        }
+        return 0;
+    }
+    if (binary == nullptr) {
+        usage_error("No input binary file");
+    }
+    if (fuzz_corpus != nullptr) {
+        Fuzzer fuzzer(threads != 0 ? threads : std::max(1u, std::thread::hardware_concurrency()), seed);
+        fuzzer.setRuns(fuzz_runs);
+        fuzzer.setSteps(fuzz_steps);
+        if (!fuzzer.loadFile(binary) || !fuzzer.loadCorpus(fuzz_corpus)) {
+            return 3;
+        }
+        return fuzzer.run() ? 0 : 1;
+    }
+    if (lockstep) {
+        CoSimulator cosim;
+        return cosim.runFile(binary) ? 0 : 1;
+    }
+    if (lane_file != nullptr && !disasm) {
+        SimtSimulator simt;
+        if (simt.loadFile(binary) && simt.loadLanes(lane_file)) {
+            simt.run();
+        }
+        return 0;
+    }
+    ISA_Simulator sim(harts);
+    if (disasm) {
+        if (sim.loadFile(binary)) {
+            sim.disassemble();
+        }
+        return 0;
+    }
+    sim.setQuantum(quantum);
+    sim.setDeterministic(deterministic);
+    sim.setDisk(disk_file);
+    sim.setSnapshotInterval(snapshot_interval);
+    sim.setReplayUntil(until);
+    sim.setCheckpoint(checkpoint_file, checkpoint_at);
+    sim.setStartCheckpoint(start_checkpoint);
+    if (sim.loadFile(binary)) {
+        sim.run();
     }
     return 0;
 }
@@ -0,0 +1,306 @@
+// memory_profiler.cpp
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include "memory_profiler.h"
+#include "instrumentation.h"
+#include "snapshot.h"
+#include "hart.h"
+
+std::string MemoryProfiler::s_path;
+unsigned long long MemoryProfiler::s_window = PROFILE_WINDOW_DEFAULT;
+std::mutex MemoryProfiler::s_lock;
+std::vector<std::unique_ptr<profile_shard_t>> MemoryProfiler::s_shards;
+std::vector<std::unique_ptr<MemoryProfile>> MemoryProfiler::s_profiles;
+thread_local profile_shard_t *MemoryProfiler::t_shard = nullptr;
+
+/**
+ * @param distance  reuse distance in lines
+ * @return          histogram bucket of the distance
+ */
+static unsigned int reuse_bucket (unsigned int distance) {
+    if (distance == STACK_DISTANCE_COLD) {
+        return PROFILE_REUSE_BUCKETS - 1;
+    }
+    if (distance == 0) {
+        return 0;
+    }
+    return std::min<unsigned int>(32 - __builtin_clz(distance), PROFILE_REUSE_BUCKETS - 2);
+}
+
+/**
+ * Hart profile constructor
+ * @param hart  id of the hart
+ */
+MemoryProfile::MemoryProfile (unsigned int hart) : m_distance(PROFILE_LINES), m_touched(PROFILE_LINES / 64, 0) {
+    m_hart = hart;
+    m_reuse.fill(0);
+    m_window = 0;
+    m_open = false;
+    m_current = profile_window_t{};
+    m_page_reads.fill(0);
+    m_page_writes.fill(0);
+}
+
+/**
+ * Records an access of the hart
+ * @param time  retired instructions of the hart
+ * @param line  accessed line
+ * @param store true if the line is written
+ */
+void MemoryProfile::access (unsigned long long time, unsigned int line, bool store) {
+    unsigned long long window = time / MemoryProfiler::s_window;
+    if (m_open && window != m_window) {
+        closeWindow();
+    }
+    if (!m_open) {
+        m_window = window;
+        m_open = true;
+    }
+    m_reuse[reuse_bucket(m_distance.access(line))]++;
+
+    uint64_t bit = 1ull << (line % 64);
+    if (!(m_touched[line / 64] & bit)) {
+        m_touched[line / 64] |= bit;
+        m_current.lines++;
+    }
+    unsigned int page = line >> (PAGE_BITS - PROFILE_LINE_BITS);
+    if (store) {
+        m_current.writes++;
+        m_page_writes[page]++;
+    } else {
+        m_current.reads++;
+        m_page_reads[page]++;
+    }
+}
+
+/**
+ * Ends the current window and keeps its record, if it has any accesses
+ */
+void MemoryProfile::closeWindow () {
+    if (!m_open) {
+        return;
+    }
+    m_current.hart = m_hart;
+    m_current.index = m_window;
+    m_current.pages = 0;
+    for (unsigned int page = 0; page < PAGE_COUNT; page++) {
+        if (m_page_reads[page] != 0 || m_page_writes[page] != 0) {
+            m_pages.push_back(profile_page_t{page, m_page_reads[page], m_page_writes[page]});
+            m_current.pages++;
+        }
+    }
+    m_windows.push_back(m_current);
+
+    m_current = profile_window_t{};
+    m_page_reads.fill(0);
+    m_page_writes.fill(0);
+    std::fill(m_touched.begin(), m_touched.end(), 0);
+    m_open = false;
+}
+
+/**
+ * Enables the profiler, the profile is written at the end of simulation
+ * @param path      path of the profile file
+ * @param window    instructions of a hart per window
+ */
+void MemoryProfiler::enable (const char *path, unsigned long long window) {
+    s_path = path;
+    s_window = window;
+    Instrumentation::select(INSTRUMENT_PROFILE);
+}
+
+/**
+ * Counts an access of the data memory
+ * @param hart      hart accessing the memory
+ * @param address   accessed address
+ * @param store     true if the memory is written
+ */
+void MemoryProfiler::access (Hart &hart, unsigned int address, bool store) {
+    if (address >= STACK_SIZE) {
+        return;
+    }
+    unsigned int line = address >> PROFILE_LINE_BITS;
+    profile_shard_t &counters = shard();
+    if (store) {
+        counters.writes[line]++;
+    } else {
+        counters.reads[line]++;
+    }
+    profile(hart).access(hart.statistics()->instructions(), line, store);
+}
+
+/**
+ * @return  counters of the calling host thread
+ */
+profile_shard_t &MemoryProfiler::shard () {
+    if (t_shard == nullptr) {
+        auto counters = std::make_unique<profile_shard_t>();
+        counters->reads.fill(0);
+        counters->writes.fill(0);
+        t_shard = counters.get();
+        std::lock_guard<std::mutex> guard(s_lock);
+        s_shards.push_back(std::move(counters));
+    }
+    return *t_shard;
+}
+
+/**
+ * @param hart  hart accessing the memory
+ * @return      profile of the hart, created on its first access
+ */
+MemoryProfile &MemoryProfiler::profile (Hart &hart) {
+    if (hart.memoryProfile() == nullptr) {
+        std::lock_guard<std::mutex> guard(s_lock);
+        s_profiles.push_back(std::make_unique<MemoryProfile>(hart.id()));
+        hart.setMemoryProfile(s_profiles.back().get());
+    }
+    return *hart.memoryProfile();
+}
+
+/**
+ * Merges the shards and the profiles of the harts, writes the profile file and
+ * prints the summary. Called once all harts stopped.
+ */
+void MemoryProfiler::finish () {
+    if (s_path.empty()) {
+        return;
+    }
+    std::vector<uint64_t> reads(PROFILE_LINES, 0);
+    std::vector<uint64_t> writes(PROFILE_LINES, 0);
+    for (const auto &counters : s_shards) {
+        for (unsigned int line = 0; line < PROFILE_LINES; line++) {
+            reads[line] += counters->reads[line];
+            writes[line] += counters->writes[line];
+        }
+    }
+    std::array<uint64_t, PROFILE_REUSE_BUCKETS> reuse{};
+    for (const auto &profile : s_profiles) {
+        profile->closeWindow();
+        for (unsigned int i = 0; i < PROFILE_REUSE_BUCKETS; i++) {
+            reuse[i] += profile->m_reuse[i];
+        }
+    }
+
+    std::ofstream out(s_path, std::ios::binary);
+    save_value(out, profile_header_t{PROFILE_MAGIC, PROFILE_VERSION, PROFILE_LINE_SIZE, PAGE_SIZE, s_window});
+    std::vector<profile_line_t> lines;
+    for (unsigned int line = 0; line < PROFILE_LINES; line++) {
+        if (reads[line] != 0 || writes[line] != 0) {
+            lines.push_back(profile_line_t{line, 0, reads[line], writes[line]});
+        }
+    }
+    save_value(out, uint32_t(lines.size()));
+    out.write(reinterpret_cast<const char *>(lines.data()), std::streamsize(lines.size() * sizeof(profile_line_t)));
+    uint32_t windows = 0;
+    for (const auto &profile : s_profiles) {
+        windows += uint32_t(profile->m_windows.size());
+    }
+    save_value(out, windows);
+    for (const auto &profile : s_profiles) {
+        const profile_page_t *pages = profile->m_pages.data();
+        for (const profile_window_t &window : profile->m_windows) {
+            save_value(out, window);
+            out.write(reinterpret_cast<const char *>(pages), std::streamsize(window.pages * sizeof(profile_page_t)));
+            pages += window.pages;
+        }
+    }
+    save_value(out, reuse);
+    out.close();
+
+    print_summary(reads, writes, reuse);
+}
+
+/**
+ * Prints the totals, the working sets of the windows, the hottest pages and the
+ * reuse distance histogram. The cumulative share of a reuse distance bucket is the
+ * hit rate of a fully associative LRU cache holding the lines up to its bound.
+ * @param reads     reads of every line
+ * @param writes    writes of every line
+ * @param reuse     reuse distance histogram
+ */
+void MemoryProfiler::print_summary (const std::vector<uint64_t> &reads, const std::vector<uint64_t> &writes,
+                                    const std::array<uint64_t, PROFILE_REUSE_BUCKETS> &reuse) {
+    uint64_t total_reads = 0;
+    uint64_t total_writes = 0;
+    unsigned int touched_lines = 0;
+    std::array<uint64_t, PAGE_COUNT> page_accesses{};
+    for (unsigned int line = 0; line < PROFILE_LINES; line++) {
+        total_reads += reads[line];
+        total_writes += writes[line];
+        touched_lines += reads[line] != 0 || writes[line] != 0;
+        page_accesses[line >> (PAGE_BITS - PROFILE_LINE_BITS)] += reads[line] + writes[line];
+    }
+    unsigned int touched_pages = 0;
+    for (uint64_t accesses : page_accesses) {
+        touched_pages += accesses != 0;
+    }
+
+    std::cout << "\n\033[1mMemory profile:\033[0m " << s_path << "\n";
+    std::cout << "Accesses:               " << std::dec << total_reads << " reads, " << total_writes << " writes\n";
+    std::cout << "Footprint:              " << touched_lines << " lines (" << touched_lines * PROFILE_LINE_SIZE / 1024
+              << " KiB), " << touched_pages << " pages (" << touched_pages * PAGE_SIZE / 1024 << " KiB)\n";
+
+    unsigned long long windows = 0;
+    unsigned long long sum = 0;
+    unsigned int smallest = PROFILE_LINES;
+    unsigned int largest = 0;
+    for (const auto &profile : s_profiles) {
+        for (const profile_window_t &window : profile->m_windows) {
+            windows++;
+            sum += window.lines;
+            smallest = std::min(smallest, window.lines);
+            largest = std::max(largest, window.lines);
+        }
+    }
+    if (windows != 0) {
+        std::cout << "Working set:            " << std::fixed << std::setprecision(2)
+                  << double(smallest * PROFILE_LINE_SIZE) / 1024 << " / "
+                  << double(sum) / double(windows) * PROFILE_LINE_SIZE / 1024 << " / "
+                  << double(largest * PROFILE_LINE_SIZE) / 1024 << " KiB (min / avg / max of " << windows
+                  << " windows of " << s_window << " instructions)\n";
+    }
+
+    std::vector<unsigned int> order;
+    for (unsigned int page = 0; page < PAGE_COUNT; page++) {
+        if (page_accesses[page] != 0) {
+            order.push_back(page);
+        }
+    }
+    std::sort(order.begin(), order.end(), [&page_accesses] (unsigned int a, unsigned int b) {
+        return page_accesses[a] > page_accesses[b];
+    });
+    order.resize(std::min<unsigned long>(order.size(), PROFILE_HOT_PAGES));
+    std::cout << "Hottest pages:\n";
+    for (unsigned int page : order) {
+        std::cout << "  0x" << std::hex << std::setfill('0') << std::setw(8) << (page << PAGE_BITS) << std::dec
+                  << std::setfill(' ') << "  " << page_accesses[page] << "\n";
+    }
+
+    uint64_t accesses = total_reads + total_writes;
+    uint64_t hits = 0;
+    std::cout << "Reuse distance:         accesses (LRU hit rate)\n";
+    for (unsigned int i = 0; i < PROFILE_REUSE_BUCKETS; i++) {
+        std::string range;
+        if (i == 0) {
+            range = "0";
+        } else if (i == PROFILE_REUSE_BUCKETS - 1) {
+            range = "cold";
+        } else if (i == PROFILE_REUSE_BUCKETS - 2) {
+            range = ">= " + std::to_string(1u << (i - 1));
+        } else {
+            range = "< " + std::to_string(1u << i) + " lines";
+        }
+        if (reuse[i] == 0) {
+            continue;
+        }
+        hits += i == PROFILE_REUSE_BUCKETS - 1 ? 0 : reuse[i];
+        double rate = accesses ? 100.0 * double(hits) / double(accesses) : 0.0;
+        std::cout << "  " << std::left << std::setw(22) << range << std::right << reuse[i] << " (" << std::fixed
+                  << std::setprecision(2) << rate << "%)\n";
+    }
+}
@@ -0,0 +1,128 @@
+// memory_profiler.h
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#ifndef ISA_SIM_CPP_MEMORY_PROFILER_H
+#define ISA_SIM_CPP_MEMORY_PROFILER_H
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "stack.h"
+#include "stack_distance.h"
+
+class Hart;
+
+#define PROFILE_MAGIC           0x504D5652u     // "RVMP"
+#define PROFILE_VERSION         1u
+#define PROFILE_LINE_BITS       6
+#define PROFILE_LINE_SIZE       (1u << PROFILE_LINE_BITS)
+#define PROFILE_LINES           (STACK_SIZE >> PROFILE_LINE_BITS)
+#define PROFILE_WINDOW_DEFAULT  100000ull       // instructions of a hart per window
+#define PROFILE_REUSE_BUCKETS   16              // distance 0, then [2^(b-1), 2^b) lines, the last one is cold
+#define PROFILE_HOT_PAGES       10              // pages listed in the summary
+
+/**
+ * Header of the profile file. It is followed by the touched lines (count, then
+ * profile_line_t records), the windows (count, then every profile_window_t with
+ * its profile_page_t records) and the reuse distance histogram (PROFILE_REUSE_BUCKETS
+ * counters of uint64_t). All values are little-endian.
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t line_size;
+    uint32_t page_size;
+    uint64_t window;                // instructions per window
+} profile_header_t;
+
+typedef struct {
+    uint32_t line;                  // address / line_size
+    uint32_t reserved;
+    uint64_t reads;
+    uint64_t writes;
+} profile_line_t;
+
+typedef struct {
+    uint32_t hart;
+    uint32_t pages;                 // profile_page_t records following
+    uint64_t index;                 // start of the window = index * window instructions
+    uint64_t reads;
+    uint64_t writes;
+    uint32_t lines;                 // working set: distinct lines accessed in the window
+    uint32_t reserved;
+} profile_window_t;
+
+typedef struct {
+    uint32_t page;                  // address / page_size
+    uint32_t reads;
+    uint32_t writes;
+} profile_page_t;
+
+/**
+ * Access counters of all lines, one instance per host thread
+ */
+typedef struct {
+    std::array<uint64_t, PROFILE_LINES> reads;
+    std::array<uint64_t, PROFILE_LINES> writes;
+} profile_shard_t;
+
+/**
+ * Profile of one hart: its windows and the reuse distances of its accesses
+ */
+class MemoryProfile {
+public:
+    explicit MemoryProfile (unsigned int hart);
+    void access (unsigned long long time, unsigned int line, bool store);
+    void closeWindow ();
+private:
+    friend class MemoryProfiler;
+
+    unsigned int m_hart;
+    StackDistance m_distance;
+    std::array<uint64_t, PROFILE_REUSE_BUCKETS> m_reuse;
+    unsigned long long m_window;                    // index of the current window
+    bool m_open;                                    // the current window has accesses
+    std::vector<uint64_t> m_touched;                // lines accessed in the current window, one bit each
+    profile_window_t m_current;
+    std::array<uint32_t, PAGE_COUNT> m_page_reads;
+    std::array<uint32_t, PAGE_COUNT> m_page_writes;
+    std::vector<profile_window_t> m_windows;
+    std::vector<profile_page_t> m_pages;            // pages of all windows in their order
+};
+
+/**
+ * Memory access heatmap and working-set profiler of the data memory. Every load,
+ * store and atomic access is counted per 64-byte line by the host thread of the
+ * hart into its own shard, so harts and guests on different threads never share
+ * a counter. Every hart additionally keeps its accesses per page and its working
+ * set in windows of its retired instructions and the histogram of its reuse
+ * distances. At exit the shards and harts are merged into the profile file and
+ * a summary. Accesses of devices are not counted.
+ */
+class MemoryProfiler {
+public:
+    static void enable (const char *path, unsigned long long window);
+    static void access (Hart &hart, unsigned int address, bool store);
+    static void finish ();
+private:
+    friend class MemoryProfile;
+
+    static profile_shard_t &shard ();
+    static MemoryProfile &profile (Hart &hart);
+    static void print_summary (const std::vector<uint64_t> &reads, const std::vector<uint64_t> &writes,
+                               const std::array<uint64_t, PROFILE_REUSE_BUCKETS> &reuse);
+
+    static std::string s_path;
+    static unsigned long long s_window;
+    static std::mutex s_lock;                       // taken once per host thread and hart
+    static std::vector<std::unique_ptr<profile_shard_t>> s_shards;
+    static std::vector<std::unique_ptr<MemoryProfile>> s_profiles;
+    static thread_local profile_shard_t *t_shard;
+};
+
+
+#endif //ISA_SIM_CPP_MEMORY_PROFILER_H
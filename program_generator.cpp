@@ -0,0 +1,235 @@
+// program_generator.cpp
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#include "program_generator.h"
+
+#define OP_LOAD     0x03u
+#define OP_IMM      0x13u
+#define OP_AUIPC    0x17u
+#define OP_STORE    0x23u
+#define OP_REG      0x33u
+#define OP_LUI      0x37u
+#define OP_BRANCH   0x63u
+#define OP_JALR     0x67u
+#define OP_JAL      0x6Fu
+#define OP_SYSTEM   0x73u
+
+#define REG_COUNTER 30u
+#define REG_DATA    31u
+
+/**
+ * Instruction encoders of the base formats
+ */
+static unsigned int encode_r (unsigned int funct7, unsigned int rs2, unsigned int rs1, unsigned int funct3,
+                              unsigned int rd, unsigned int opcode) {
+    return funct7 << 25u | rs2 << 20u | rs1 << 15u | funct3 << 12u | rd << 7u | opcode;
+}
+
+static unsigned int encode_i (int imm, unsigned int rs1, unsigned int funct3, unsigned int rd, unsigned int opcode) {
+    return (unsigned(imm) & 0xFFFu) << 20u | rs1 << 15u | funct3 << 12u | rd << 7u | opcode;
+}
+
+static unsigned int encode_s (int imm, unsigned int rs2, unsigned int rs1, unsigned int funct3) {
+    auto offset = unsigned(imm);
+    return (offset >> 5u & 0x7Fu) << 25u | rs2 << 20u | rs1 << 15u | funct3 << 12u | (offset & 0x1Fu) << 7u
+           | OP_STORE;
+}
+
+static unsigned int encode_b (int imm, unsigned int rs2, unsigned int rs1, unsigned int funct3) {
+    auto offset = unsigned(imm);
+    return (offset >> 12u & 1u) << 31u | (offset >> 5u & 0x3Fu) << 25u | rs2 << 20u | rs1 << 15u | funct3 << 12u
+           | (offset >> 1u & 0xFu) << 8u | (offset >> 11u & 1u) << 7u | OP_BRANCH;
+}
+
+static unsigned int encode_u (unsigned int imm20, unsigned int rd, unsigned int opcode) {
+    return (imm20 & 0xFFFFFu) << 12u | rd << 7u | opcode;
+}
+
+static unsigned int encode_j (int imm, unsigned int rd) {
+    auto offset = unsigned(imm);
+    return (offset >> 20u & 1u) << 31u | (offset >> 1u & 0x3FFu) << 21u | (offset >> 11u & 1u) << 20u
+           | (offset >> 12u & 0xFFu) << 12u | rd << 7u | OP_JAL;
+}
+
+/**
+ * Program generator constructor
+ * @param seed  seed of the random numbers, the same seed generates the same programs
+ */
+ProgramGenerator::ProgramGenerator (uint64_t seed) : m_random(seed) {
+}
+
+/**
+ * @param bound     number of possible values
+ * @return          random number from 0 to bound - 1
+ */
+unsigned int ProgramGenerator::random (unsigned int bound) {
+    return (unsigned int)(m_random() % bound);
+}
+
+/**
+ * @return  random source register, any of them
+ */
+unsigned int ProgramGenerator::source () {
+    return random(32);
+}
+
+/**
+ * @return  random destination register, neither the loop counter nor the data pointer
+ */
+unsigned int ProgramGenerator::destination () {
+    return random(REG_COUNTER);
+}
+
+/**
+ * Generates the next program
+ * @return  the instructions
+ */
+std::vector<unsigned int> ProgramGenerator::generate () {
+    m_code.clear();
+    // random values in all registers, as fusable lui and addi pairs
+    for (unsigned int rd = 1; rd < REG_COUNTER; rd++) {
+        m_code.push_back(encode_u((unsigned int)m_random(), rd, OP_LUI));
+        m_code.push_back(encode_i(int(random(4096)), rd, 0b000, rd, OP_IMM));
+    }
+    m_code.push_back(encode_i(0, 0, 0b000, REG_COUNTER, OP_IMM));
+    m_code.push_back(encode_u(GENERATOR_DATA_BASE >> 12u, REG_DATA, OP_LUI));
+
+    unsigned int segments = 1 + random(GENERATOR_SEGMENTS_MAX);
+    for (unsigned int i = 0; i < segments; i++) {
+        unsigned int length = 1 + random(GENERATOR_SEGMENT_MAX);
+        if (random(3) != 0) {
+            emit_segment(length);
+            continue;
+        }
+        // counted loop, the body never writes the counter
+        m_code.push_back(encode_i(int(1 + random(GENERATOR_LOOP_MAX)), 0, 0b000, REG_COUNTER, OP_IMM));
+        unsigned long body = m_code.size();
+        emit_segment(length);
+        m_code.push_back(encode_i(-1, REG_COUNTER, 0b000, REG_COUNTER, OP_IMM));
+        m_code.push_back(encode_b(-int((m_code.size() - body) * 4), 0, REG_COUNTER, 0b001));
+    }
+
+    // a7 = 0 selects the exit by a0 instead of a system call
+    m_code.push_back(encode_i(0, 0, 0b000, 17, OP_IMM));
+    m_code.push_back(encode_i(10, 0, 0b000, 10, OP_IMM));
+    m_code.push_back(encode_i(0, 0, 0b000, 0, OP_SYSTEM));
+    return m_code;
+}
+
+/**
+ * Emits random instructions, whose branches and jumps stay inside of them
+ * @param length    minimal number of instructions
+ */
+void ProgramGenerator::emit_segment (unsigned int length) {
+    std::vector<unsigned long> branches;
+    unsigned long start = m_code.size();
+    while (m_code.size() - start < length) {
+        emit_instruction(branches);
+    }
+    patch_branches(branches, m_code.size());
+}
+
+/**
+ * Emits one random instruction or fusable pair. Branches and jumps are emitted
+ * with their target unknown, it is chosen once the segment is complete.
+ * @param branches  indices of the branches and jumps of the segment
+ */
+void ProgramGenerator::emit_instruction (std::vector<unsigned long> &branches) {
+    static const unsigned int reg_functs[] = {0x000, 0x100, 0x001, 0x002, 0x003, 0x004, 0x005, 0x105, 0x006, 0x007};
+    static const unsigned int imm_functs[] = {0b000, 0b010, 0b011, 0b100, 0b110, 0b111};
+    static const unsigned int load_functs[] = {0b000, 0b001, 0b010, 0b100, 0b101};
+    static const unsigned int branch_functs[] = {0b000, 0b001, 0b100, 0b101, 0b110, 0b111};
+
+    unsigned int kind = random(100);
+    unsigned int rd = destination();
+    unsigned int rs1 = source();
+    unsigned int rs2 = source();
+    if (kind < 30) {
+        // base register-register arithmetic, funct7 bit 5 selects sub and sra
+        unsigned int funct = reg_functs[random(10)];
+        m_code.push_back(encode_r(funct >> 8u << 5u, rs2, rs1, funct & 0x7u, rd, OP_REG));
+    } else if (kind < 45) {
+        // M extension
+        m_code.push_back(encode_r(0b0000001, rs2, rs1, random(8), rd, OP_REG));
+    } else if (kind < 58) {
+        m_code.push_back(encode_i(int(random(4096)), rs1, imm_functs[random(6)], rd, OP_IMM));
+    } else if (kind < 65) {
+        // shifts by immediate, funct7 bit 5 selects srai
+        unsigned int funct3 = random(2) ? 0b001 : 0b101;
+        unsigned int arithmetic = funct3 == 0b101 && random(2) ? 0x400 : 0;
+        m_code.push_back(encode_i(int(arithmetic | random(32)), rs1, funct3, rd, OP_IMM));
+    } else if (kind < 70) {
+        m_code.push_back(encode_u((unsigned int)m_random(), rd, random(2) ? OP_LUI : OP_AUIPC));
+    } else if (kind < 78) {
+        unsigned int funct3 = load_functs[random(5)];
+        int offset = int(random(4096)) - 2048;
+        m_code.push_back(encode_i(offset & ~int((1u << (funct3 & 0x3u)) - 1), REG_DATA, funct3, rd, OP_LOAD));
+    } else if (kind < 86) {
+        unsigned int funct3 = random(3);
+        int offset = int(random(4096)) - 2048;
+        m_code.push_back(encode_s(offset & ~int((1u << funct3) - 1), rs2, REG_DATA, funct3));
+    } else if (kind < 90) {
+        // lui and addi of the same register
+        rd = 1 + random(REG_COUNTER - 1);
+        m_code.push_back(encode_u((unsigned int)m_random(), rd, OP_LUI));
+        m_code.push_back(encode_i(int(random(4096)), rd, 0b000, rd, OP_IMM));
+    } else if (kind < 93) {
+        // zero extension by a pair of shifts
+        rd = 1 + random(REG_COUNTER - 1);
+        int shamt = int(random(32));
+        m_code.push_back(encode_i(shamt, rs1, 0b001, rd, OP_IMM));
+        m_code.push_back(encode_i(shamt, rd, 0b101, rd, OP_IMM));
+    } else if (kind < 95) {
+        // pc-relative load of the program itself
+        unsigned int base = 1 + random(REG_COUNTER - 1);
+        m_code.push_back(encode_u(0, base, OP_AUIPC));
+        m_code.push_back(encode_i(int(random(512) * 4), base, 0b010, rd, OP_LOAD));
+    } else if (kind < 98) {
+        branches.push_back(m_code.size());
+        m_code.push_back(encode_b(0, rs2, rs1, branch_functs[random(6)]));
+    } else if (kind < 99) {
+        branches.push_back(m_code.size());
+        m_code.push_back(encode_j(0, rd));
+    } else {
+        // pc-relative jump through a register
+        unsigned int base = 1 + random(REG_COUNTER - 1);
+        branches.push_back(m_code.size());
+        m_code.push_back(encode_u(0, base, OP_AUIPC));
+        m_code.push_back(encode_i(0, base, 0b000, rd, OP_JALR));
+    }
+}
+
+/**
+ * Sets random forward targets of the branches and jumps of a segment
+ * @param branches  indices of the branches and jumps of the segment
+ * @param end       index of the first instruction after the segment, the furthest target
+ */
+void ProgramGenerator::patch_branches (const std::vector<unsigned long> &branches, unsigned long end) {
+    for (unsigned long index : branches) {
+        unsigned int inst = m_code[index];
+        // the jump of auipc and jalr goes beyond the jalr
+        unsigned long first = (inst & 0x7Fu) == OP_AUIPC ? index + 2 : index + 1;
+        unsigned long target = first + random((unsigned int)(end - first + 1));
+        // the jalr of a pair can only be reached from its auipc
+        if (target < end && (m_code[target] & 0x7Fu) == OP_JALR && (m_code[target - 1] & 0x7Fu) == OP_AUIPC) {
+            target++;
+        }
+        switch (inst & 0x7Fu) {
+            case OP_BRANCH:
+                m_code[index] = encode_b(int(target - index) * 4, inst >> 20u & 0x1Fu, inst >> 15u & 0x1Fu,
+                                         inst >> 12u & 0x7u);
+                break;
+            case OP_JAL:
+                m_code[index] = encode_j(int(target - index) * 4, inst >> 7u & 0x1Fu);
+                break;
+            default: {
+                // auipc and jalr, the offset is relative to the auipc
+                int offset = int(target - index) * 4;
+                unsigned int jalr = m_code[index + 1];
+                m_code[index + 1] = encode_i(offset, jalr >> 15u & 0x1Fu, 0b000, jalr >> 7u & 0x1Fu, OP_JALR);
+                break;
+            }
+        }
+    }
+}
@@ -0,0 +1,42 @@
+// program_generator.h
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#ifndef ISA_SIM_CPP_PROGRAM_GENERATOR_H
+#define ISA_SIM_CPP_PROGRAM_GENERATOR_H
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#define GENERATOR_SEGMENTS_MAX  12
+#define GENERATOR_SEGMENT_MAX   24          // instructions of a straight segment or a loop body
+#define GENERATOR_LOOP_MAX      8           // iterations of a loop
+#define GENERATOR_DATA_BASE     0x40000u    // data the loads and stores access, held in x31
+
+/**
+ * Generator of random RV32IM programs which always terminate. A program sets all
+ * registers to random values, runs straight segments and counted loops of random
+ * instructions and exits with ecall 10. Branches and jumps only go forward inside
+ * of their segment, the loop counter (x30) and the data pointer (x31) are never
+ * written by the random instructions. The generated idioms include the pairs the
+ * macro fusion recognizes, so both ways of executing them are compared.
+ */
+class ProgramGenerator {
+public:
+    explicit ProgramGenerator (uint64_t seed);
+    std::vector<unsigned int> generate ();
+private:
+    unsigned int random (unsigned int bound);
+    unsigned int source ();
+    unsigned int destination ();
+    void emit_segment (unsigned int length);
+    void emit_instruction (std::vector<unsigned long> &branches);
+    void patch_branches (const std::vector<unsigned long> &branches, unsigned long end);
+
+    std::mt19937_64 m_random;
+    std::vector<unsigned int> m_code;
+};
+
+
+#endif //ISA_SIM_CPP_PROGRAM_GENERATOR_H
@@ -0,0 +1,216 @@
+// program_image.cpp
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <new>
+#include <utility>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "program_image.h"
+#include "compressed_expander.h"
+
+/**
+ * Program image constructor
+ * @param words     instructions and data of the binary file
+ * @param fuse      false to execute every instruction by its own decoder, as the reference of the lockstep mode
+ */
+ProgramImage::ProgramImage (std::vector<unsigned int> words, bool fuse)
+        : m_words(std::move(words)), m_fuse(fuse) {
+    predecode(m_words, m_instructions, m_decoded);
+    if (!fuse) {
+        for (predecoded_t &entry : m_decoded) {
+            entry.fusion = FUSE_NONE;
+        }
+    }
+    // the part beyond the data memory is never mapped
+    unsigned int length = std::min<unsigned long>(m_words.size() * 4, STACK_SIZE);
+    m_page_count = (length + PAGE_MASK) >> PAGE_BITS;
+    // only pages holding instructions are watched for stores into the code
+    m_code_entries.assign(m_page_count, 0);
+    for (unsigned long i = 0; i < m_decoded.size() && (i * 2 >> PAGE_BITS) < m_page_count; i++) {
+        if (m_decoded[i].decoder != DECODER_NONE) {
+            m_code_entries[i * 2 >> PAGE_BITS]++;
+        }
+    }
+    m_pages = static_cast<unsigned char *>(std::aligned_alloc(PAGE_SIZE, std::max(m_page_count, 1u) * PAGE_SIZE));
+    if (m_pages == nullptr) {
+        throw std::bad_alloc();
+    }
+    std::memset(m_pages, 0, (unsigned long)m_page_count * PAGE_SIZE);
+    std::memcpy(m_pages, m_words.data(), length);
+    m_hash = hash(m_words);
+
+    unsigned long host_page = (unsigned long)sysconf(_SC_PAGESIZE);
+    unsigned long words_length = m_instructions.size() * sizeof(unsigned int);
+    m_decoded_offset = (words_length + host_page - 1) / host_page * host_page;
+    m_code_length = m_decoded_offset + m_decoded.size() * sizeof(predecoded_t);
+    m_code_file = memfd_create("program_image", MFD_CLOEXEC);
+    if (m_code_file < 0 || ftruncate(m_code_file, (off_t)m_code_length) != 0
+        || pwrite(m_code_file, m_instructions.data(), words_length, 0) != (ssize_t)words_length
+        || pwrite(m_code_file, m_decoded.data(), m_decoded.size() * sizeof(predecoded_t), (off_t)m_decoded_offset)
+           != (ssize_t)(m_decoded.size() * sizeof(predecoded_t))) {
+        if (m_code_file >= 0) {
+            close(m_code_file);
+        }
+        std::free(m_pages);
+        throw std::bad_alloc();
+    }
+}
+
+ProgramImage::~ProgramImage () {
+    close(m_code_file);
+    std::free(m_pages);
+}
+
+/**
+ * Maps the instructions and predecoded instructions privately, the host kernel
+ * copies a page of them only when it is written
+ * @param instructions  set to the instructions in the mapping
+ * @param decoded       set to the predecoded instructions in the mapping
+ * @return              the mapping of codeLength bytes, nullptr if the image has no instructions
+ */
+unsigned char *ProgramImage::mapCode (unsigned int *&instructions, predecoded_t *&decoded) const {
+    if (m_code_length == 0) {
+        return nullptr;
+    }
+    void *mapping = mmap(nullptr, m_code_length, PROT_READ | PROT_WRITE, MAP_PRIVATE, m_code_file, 0);
+    if (mapping == MAP_FAILED) {
+        throw std::bad_alloc();
+    }
+    auto *bytes = static_cast<unsigned char *>(mapping);
+    instructions = reinterpret_cast<unsigned int *>(bytes);
+    decoded = reinterpret_cast<predecoded_t *>(bytes + m_decoded_offset);
+    return bytes;
+}
+
+/**
+ * Hashes the contents of a program, FNV-1a over its bytes
+ * @param words     instructions and data of the binary file
+ * @return          64-bit hash
+ */
+uint64_t ProgramImage::hash (const std::vector<unsigned int> &words) {
+    uint64_t hash = 0xCBF29CE484222325ull;
+    auto *bytes = reinterpret_cast<const unsigned char *>(words.data());
+    for (unsigned long i = 0; i < words.size() * 4; i++) {
+        hash = (hash ^ bytes[i]) * 0x100000001B3ull;
+    }
+    return hash;
+}
+
+/**
+ * Looks up the decoder of an instruction
+ * @param inst  raw instruction
+ * @return      the decoder, DECODER_NONE for unknown opcodes
+ */
+decoder_t ProgramImage::decoder (unsigned int inst) {
+    // opcode lookup maps, built on first use
+    static const std::map<unsigned int, decoder_t> opcode_map = {
+            {0b0110011, DECODER_REG_ARITH},
+            {0b0010011, DECODER_IMM_ARITH},
+            {0b0000011, DECODER_LOAD},
+            {0b0100011, DECODER_STORE},
+            {0b1100011, DECODER_BRANCH},
+            {0b0110111, DECODER_UPPER_IMM},
+            {0b0010111, DECODER_UPPER_IMM},
+            {0b1101111, DECODER_JUMP_LINK},
+            {0b1100111, DECODER_JUMP_LINK_REG},
+            {0b1110011, DECODER_ECALL},
+            {0b0001111, DECODER_FENCE},
+            {0b0101111, DECODER_ATOMIC},
+            {0b0000111, DECODER_FLOAT_LOAD},
+            {0b0100111, DECODER_FLOAT_STORE},
+            {0b1000011, DECODER_FLOAT_FMA},
+            {0b1000111, DECODER_FLOAT_FMA},
+            {0b1001011, DECODER_FLOAT_FMA},
+            {0b1001111, DECODER_FLOAT_FMA},
+            {0b1010011, DECODER_FLOAT_ARITH},
+            {0b1010111, DECODER_VECTOR_ARITH}};
+    // vector loads and stores share the opcode with floating-point ones,
+    // they are told apart by the width in funct3
+    static const std::map<unsigned int, decoder_t> opcode_funct3_map = [] {
+        std::map<unsigned int, decoder_t> map;
+        for (unsigned int width : {0b000u, 0b101u, 0b110u, 0b111u}) {
+            map.insert({width << 12u | 0b0000111u, DECODER_VECTOR_LOAD});
+            map.insert({width << 12u | 0b0100111u, DECODER_VECTOR_STORE});
+        }
+        return map;
+    }();
+
+    // decoders selected by opcode and funct3 take precedence over the opcode only ones
+    auto it = opcode_funct3_map.find(inst & 0x0000707Fu);
+    if (it != opcode_funct3_map.end()) {
+        return it->second;
+    }
+    it = opcode_map.find(inst & 0x0000007Fu);
+    return it != opcode_map.end() ? it->second : DECODER_NONE;
+}
+
+/**
+ * Assembles the instruction starting at a halfword. A compressed instruction
+ * is executed as its expansion placed two bytes before it, so the expansion
+ * ends where the compressed instruction ends: the decoders continue with the
+ * following instruction and link to it as for any other instruction, without
+ * knowing the length. The offsets of expanded jumps and branches are two bytes
+ * longer to keep their targets.
+ * @param low           halfword at the address of the instruction
+ * @param high          following halfword
+ * @param compressed    set to true for a 16-bit instruction
+ * @return              the instruction, a compressed one expanded to 32 bits
+ */
+unsigned int ProgramImage::fetch (unsigned int low, unsigned int high, bool &compressed) {
+    compressed = CompressedExpander::compressed(low);
+    return compressed ? CompressedExpander::expand(low, 2) : (low & 0xFFFFu) | (high & 0xFFFFu) << 16u;
+}
+
+/**
+ * Checks whether the instruction at a halfword is fused with the following one.
+ * Only pairs of 32-bit instructions are fused, the fused operations advance
+ * the program counter by eight.
+ * @param instructions  instruction memory
+ * @param decoded       predecoded instruction memory
+ * @param count         number of entries of both
+ * @param index         index of the first instruction
+ * @return              kind of fusion or FUSE_NONE
+ */
+fusion_t ProgramImage::fusion (const unsigned int *instructions, const predecoded_t *decoded, unsigned long count,
+                               unsigned long index) {
+    if (index + 2 >= count || decoded[index].compressed || decoded[index + 2].compressed
+        || decoded[index].decoder == DECODER_STALE || decoded[index + 2].decoder == DECODER_STALE) {
+        return FUSE_NONE;
+    }
+    return MacroFusion::detect(instructions[index], instructions[index + 2]);
+}
+
+/**
+ * Resolves the decoder of the instruction starting at every halfword of the
+ * instruction memory and marks instruction pairs that can be executed as one
+ * fused operation. Compressed instructions are expanded here once, so they
+ * execute as fast as uncompressed ones. Entries in the middle of 32-bit
+ * instructions are decoded as well, they are only reached by jumping there.
+ * The fused operation is attached to the first instruction of the pair only,
+ * so a jump to the second instruction executes it on its own.
+ * @param words         binary as loaded
+ * @param instructions  instruction memory, one entry per halfword
+ * @param decoded       predecoded instruction memory
+ */
+void ProgramImage::predecode (const std::vector<unsigned int> &words, std::vector<unsigned int> &instructions,
+                              std::vector<predecoded_t> &decoded) {
+    unsigned long count = words.size() * 2;
+    instructions.resize(count);
+    decoded.resize(count);
+    for (unsigned long i = 0; i < count; i++) {
+        unsigned int low = words[i / 2] >> (i % 2 * 16);
+        unsigned int high = i + 1 < count ? words[(i + 1) / 2] >> ((i + 1) % 2 * 16) : 0;
+        bool compressed;
+        instructions[i] = fetch(low, high, compressed);
+        decoded[i].compressed = compressed;
+        decoded[i].decoder = decoder(instructions[i]);
+    }
+    for (unsigned long i = 0; i < count; i++) {
+        decoded[i].fusion = fusion(instructions.data(), decoded.data(), count, i);
+    }
+}
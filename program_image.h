@@ -0,0 +1,65 @@
+// program_image.h
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#ifndef ISA_SIM_CPP_PROGRAM_IMAGE_H
+#define ISA_SIM_CPP_PROGRAM_IMAGE_H
+
+#include <cstdint>
+#include <vector>
+#include "hart.h"
+
+/**
+ * Read-only part of a loaded program: the binary, its predecoded instructions
+ * and a page-aligned copy of the binary which the data memories of all instances
+ * map instead of copying it. An image never changes once it is created, so it is
+ * shared through std::shared_ptr by any number of harts, guests and host threads
+ * and released with its last instance. Pages an instance writes to are copied
+ * into its own memory first.
+ * The instructions are indexed by halfword (pc / 2), every entry holds the
+ * instruction starting at that halfword, compressed ones expanded to 32 bits.
+ * The instructions and predecoded instructions are also kept in an in-memory
+ * file, which an instance maps privately once it stores into its code, so the
+ * host kernel copies only the pages of the code it modifies.
+ */
+class ProgramImage {
+public:
+    explicit ProgramImage (std::vector<unsigned int> words, bool fuse = true);
+    ~ProgramImage ();
+    ProgramImage (const ProgramImage &) = delete;
+    ProgramImage &operator= (const ProgramImage &) = delete;
+
+    const std::vector<unsigned int> &words () const { return m_words; }
+    const std::vector<unsigned int> &instructions () const { return m_instructions; }
+    const std::vector<predecoded_t> &decoded () const { return m_decoded; }
+    unsigned int size () const { return (unsigned int)(m_words.size() * 4); }
+    unsigned int pageCount () const { return m_page_count; }
+    const std::vector<unsigned int> &codeEntries () const { return m_code_entries; }
+    const unsigned char *page (unsigned int index) const { return m_pages + (unsigned long)index * PAGE_SIZE; }
+    uint64_t hash () const { return m_hash; }
+    bool fused () const { return m_fuse; }
+    unsigned long codeLength () const { return m_code_length; }
+    unsigned char *mapCode (unsigned int *&instructions, predecoded_t *&decoded) const;
+    static uint64_t hash (const std::vector<unsigned int> &words);
+    static decoder_t decoder (unsigned int inst);
+    static unsigned int fetch (unsigned int low, unsigned int high, bool &compressed);
+    static fusion_t fusion (const unsigned int *instructions, const predecoded_t *decoded, unsigned long count,
+                            unsigned long index);
+    static void predecode (const std::vector<unsigned int> &words, std::vector<unsigned int> &instructions,
+                           std::vector<predecoded_t> &decoded);
+private:
+    const std::vector<unsigned int> m_words;
+    std::vector<unsigned int> m_instructions;
+    std::vector<predecoded_t> m_decoded;
+    unsigned int m_page_count;
+    std::vector<unsigned int> m_code_entries;   // entries with a known opcode of every mapped page
+    unsigned char *m_pages;                     // the binary padded with zeros to whole pages
+    uint64_t m_hash;
+    bool m_fuse;
+    int m_code_file;                            // instructions followed by the predecoded ones
+    unsigned long m_decoded_offset;             // of the predecoded instructions in the file, page-aligned
+    unsigned long m_code_length;
+};
+
+
+#endif //ISA_SIM_CPP_PROGRAM_IMAGE_H
@@ -0,0 +1,51 @@
+// quantum_barrier.cpp
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#include <thread>
+#include "quantum_barrier.h"
+
+#define SPIN_LIMIT 1024
+
+/**
+ * Quantum barrier constructor
+ * @param count number of threads meeting at the barrier
+ */
+QuantumBarrier::QuantumBarrier (unsigned int count) : m_count(count) {
+    m_waiting = 0;
+    m_generation = 0;
+    m_stopped = false;
+}
+
+/**
+ * Waits until all threads finish the current quantum
+ * @return  false if the simulation was stopped and the thread should exit
+ */
+bool QuantumBarrier::arriveAndWait () {
+    if (m_stopped.load(std::memory_order_acquire)) {
+        return false;
+    }
+    unsigned int generation = m_generation.load(std::memory_order_acquire);
+    if (m_waiting.fetch_add(1, std::memory_order_acq_rel) + 1 == m_count) {
+        // last thread releases the others, the counter is reset before the release
+        m_waiting.store(0, std::memory_order_relaxed);
+        m_generation.fetch_add(1, std::memory_order_release);
+        return !m_stopped.load(std::memory_order_acquire);
+    }
+    for (unsigned int spins = 0; m_generation.load(std::memory_order_acquire) == generation; spins++) {
+        if (m_stopped.load(std::memory_order_acquire)) {
+            return false;
+        }
+        if (spins >= SPIN_LIMIT) {
+            std::this_thread::yield();
+        }
+    }
+    return !m_stopped.load(std::memory_order_acquire);
+}
+
+/**
+ * Releases all waiting threads, the following arriveAndWait calls return false
+ */
+void QuantumBarrier::stop () {
+    m_stopped.store(true, std::memory_order_release);
+}
@@ -0,0 +1,27 @@
+// quantum_barrier.h
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#ifndef ISA_SIM_CPP_QUANTUM_BARRIER_H
+#define ISA_SIM_CPP_QUANTUM_BARRIER_H
+
+#include <atomic>
+
+/**
+ * Barrier the hart threads meet at after every quantum. Waiting threads spin
+ * for a short time and then yield, because a quantum takes only microseconds.
+ */
+class QuantumBarrier {
+public:
+    explicit QuantumBarrier (unsigned int count);
+    bool arriveAndWait ();
+    void stop ();
+private:
+    const unsigned int m_count;
+    std::atomic<unsigned int> m_waiting;
+    std::atomic<unsigned int> m_generation;
+    std::atomic<bool> m_stopped;
+};
+
+
+#endif //ISA_SIM_CPP_QUANTUM_BARRIER_H
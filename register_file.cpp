@@ -4,11 +4,9 @@
 
 #include <iostream>
 #include <iomanip>
-#include <filesystem>
 #include <fstream>
 #include "register_file.h"
-
-RegisterFile* RegisterFile::instance = nullptr;
+#include "snapshot.h"
 
 /**
  * Register file constructor
@@ -60,21 +58,10 @@ void RegisterFile::print_registers () {
 }
 
 /**
- * Gets singleton instance of the Register File
- * @return  instance of singleton
+ * Dumps register file into a binary .res file
+ * @param path  path of the output file
  */
-RegisterFile *RegisterFile::getInstance () {
-    if (instance == nullptr) {
-        instance = new RegisterFile();
-    }
-    return instance;
-}
-
-/**
- * Dumps register file into a binary output.res file
- */
-void RegisterFile::dump_registers () {
-    std::filesystem::path path{"./output.res"};
+void RegisterFile::dump_registers (const std::string &path) {
 
     std::ofstream ofs(path);
     auto buffer = reinterpret_cast<char *>(m_reg_file.data());
@@ -83,3 +70,19 @@ void RegisterFile::dump_registers () {
     ofs.close();
 }
 
+
+/**
+ * Writes the registers into a snapshot
+ * @param out   snapshot stream
+ */
+void RegisterFile::save (std::ostream &out) const {
+    save_value(out, m_reg_file);
+}
+
+/**
+ * Reads the registers from a snapshot
+ * @param in    snapshot stream
+ */
+void RegisterFile::restore (std::istream &in) {
+    restore_value(in, m_reg_file);
+}
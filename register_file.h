@@ -7,10 +7,16 @@
 
 
 #include <array>
+#include <istream>
+#include <ostream>
+#include <string>
 
+/**
+ * Integer register file of one hart
+ */
 class RegisterFile {
 public:
-    static RegisterFile* getInstance();
+    RegisterFile();
     enum Register {
         x0, x1, x2, x3, x4, x5, x6, x7,
         x8, x9, x10, x11, x12, x13, x14, x15,
@@ -20,11 +26,10 @@ public:
     void write (Register reg, unsigned int data);
     unsigned int read (Register reg);
     void print_registers ();
-    void dump_registers ();
+    void dump_registers (const std::string &path = "./output.res");
+    void save (std::ostream &out) const;
+    void restore (std::istream &in);
 private:
-    static RegisterFile* instance;
-    RegisterFile();
-
     std::array<unsigned int, 32> m_reg_file;
 };
 
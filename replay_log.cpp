@@ -0,0 +1,200 @@
+// replay_log.cpp
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#include <vector>
+#include "replay_log.h"
+#include "hart.h"
+#include "stack.h"
+#include "vector_register_file.h"
+
+ReplayLog *ReplayLog::s_active = nullptr;
+
+/**
+ * Creates the log and starts recording the inputs of the simulation into it
+ * @param path      the path to the log file
+ * @param harts     number of harts
+ * @param quantum   number of instructions a hart executes before the next one runs
+ * @return          true if successful otherwise false
+ */
+bool ReplayLog::startRecording (const char *path, unsigned int harts, unsigned long long quantum) {
+    auto *log = new ReplayLog();
+    log->m_out.open(path, std::ios::binary | std::ios::trunc);
+    if (!log->m_out) {
+        delete log;
+        return false;
+    }
+    log->m_header = replay_header_t{REPLAY_MAGIC, REPLAY_VERSION, harts, VectorRegisterFile::vlen(), quantum};
+    log->m_out.write(reinterpret_cast<const char *>(&log->m_header), sizeof(replay_header_t));
+    s_active = log;
+    return true;
+}
+
+/**
+ * Opens a recorded log, the inputs of the simulation are taken from it
+ * @param path      the path to the log file
+ * @return          true if successful otherwise false
+ */
+bool ReplayLog::startReplay (const char *path) {
+    auto *log = new ReplayLog();
+    log->m_in.open(path, std::ios::binary);
+    log->m_in.read(reinterpret_cast<char *>(&log->m_header), sizeof(replay_header_t));
+    if (!log->m_in || log->m_header.magic != REPLAY_MAGIC || log->m_header.version != REPLAY_VERSION) {
+        delete log;
+        return false;
+    }
+    log->m_replaying = true;
+    s_active = log;
+    return true;
+}
+
+/**
+ * Appends an entry with its payload to the recorded log
+ * @param time      retired instructions of the hart
+ * @param hart      hart id
+ * @param kind      kind of entry
+ * @param data      payload
+ * @param length    payload size in bytes
+ */
+void ReplayLog::write_entry (unsigned long long time, unsigned int hart, replay_kind_t kind, const void *data,
+                             unsigned int length) {
+    replay_entry_t entry{time, hart, uint32_t(kind), length, 0};
+    m_out.write(reinterpret_cast<const char *>(&entry), sizeof(entry));
+    m_out.write(static_cast<const char *>(data), length);
+}
+
+/**
+ * Records an input value read by the current hart
+ * @param kind      kind of input
+ * @param value     the value
+ */
+void ReplayLog::recordValue (replay_kind_t kind, unsigned int value) {
+    Hart *hart = Hart::current();
+    write_entry(hart->statistics()->instructions(), hart->id(), kind, &value, sizeof(value));
+}
+
+/**
+ * Records bytes written into the data memory on behalf of the current hart
+ * @param address   guest address of the first byte
+ * @param data      the bytes
+ * @param length    number of bytes
+ */
+void ReplayLog::recordMemory (unsigned int address, const void *data, unsigned int length) {
+    Hart *hart = Hart::current();
+    replay_entry_t entry{hart->statistics()->instructions(), hart->id(), REPLAY_MEMORY,
+                         uint32_t(sizeof(address) + length), 0};
+    m_out.write(reinterpret_cast<const char *>(&entry), sizeof(entry));
+    m_out.write(reinterpret_cast<const char *>(&address), sizeof(address));
+    m_out.write(static_cast<const char *>(data), length);
+}
+
+/**
+ * Reads the header of the next input entry of the replayed log, snapshots are skipped
+ * @return  false at the end of the log
+ */
+bool ReplayLog::peek_entry () {
+    while (!m_has_next) {
+        if (!m_in.read(reinterpret_cast<char *>(&m_next), sizeof(m_next))) {
+            return false;
+        }
+        if (m_next.kind == REPLAY_SNAPSHOT) {
+            m_in.seekg(m_next.length, std::ios::cur);
+        } else {
+            m_has_next = true;
+        }
+    }
+    return true;
+}
+
+/**
+ * Terminates the current hart if the next entry of the log is not an input
+ * of the given kind read by it at this instruction
+ * @param kind  expected kind of entry
+ */
+void ReplayLog::expect (replay_kind_t kind) {
+    Hart *hart = Hart::current();
+    unsigned long long time = hart->statistics()->instructions();
+    if (!peek_entry() || m_next.time != time || m_next.hart != hart->id() || m_next.kind != uint32_t(kind)) {
+        term.terminate("Replay diverged from the log at instruction " + std::to_string(time), 1);
+    }
+}
+
+/**
+ * Takes the next input value of the current hart from the log
+ * @param kind  kind of input
+ * @return      the recorded value
+ */
+unsigned int ReplayLog::replayValue (replay_kind_t kind) {
+    expect(kind);
+    unsigned int value = 0;
+    m_in.read(reinterpret_cast<char *>(&value), sizeof(value));
+    m_has_next = false;
+    return value;
+}
+
+/**
+ * Writes the recorded bytes of the current instruction into the data memory
+ * @param memory    data memory of the current hart
+ */
+void ReplayLog::replayMemory (Stack *memory) {
+    Hart *hart = Hart::current();
+    std::vector<unsigned char> data;
+    while (peek_entry() && m_next.kind == REPLAY_MEMORY && m_next.hart == hart->id()
+           && m_next.time == hart->statistics()->instructions()) {
+        unsigned int address = 0;
+        m_in.read(reinterpret_cast<char *>(&address), sizeof(address));
+        data.resize(m_next.length - sizeof(address));
+        m_in.read(reinterpret_cast<char *>(data.data()), std::streamsize(data.size()));
+        m_has_next = false;
+        memory->writeBlock(address, data.data(), (unsigned int)(data.size()));
+    }
+}
+
+/**
+ * Appends a snapshot of the machine to the recorded log
+ * @param time      retired instructions of hart 0
+ * @param state     the serialized machine
+ */
+void ReplayLog::writeSnapshot (unsigned long long time, const std::string &state) {
+    write_entry(time, 0, REPLAY_SNAPSHOT, state.data(), (unsigned int)(state.size()));
+}
+
+/**
+ * Finds the last snapshot taken at or before the given instruction of hart 0,
+ * the replay continues with the inputs following it
+ * @param time      retired instructions of hart 0
+ * @param state     the serialized machine
+ * @return          false if there is no such snapshot, the replay starts from the beginning then
+ */
+bool ReplayLog::findSnapshot (unsigned long long time, std::string &state) {
+    std::streampos found = -1;
+    replay_entry_t entry{};
+    m_in.seekg(sizeof(replay_header_t));
+    for (std::streampos position = m_in.tellg(); m_in.read(reinterpret_cast<char *>(&entry), sizeof(entry));
+         position = m_in.tellg()) {
+        if (entry.kind == REPLAY_SNAPSHOT && entry.time <= time) {
+            found = position;
+        }
+        m_in.seekg(entry.length, std::ios::cur);
+    }
+    m_in.clear();
+    m_has_next = false;
+    if (found == std::streampos(-1)) {
+        m_in.seekg(sizeof(replay_header_t));
+        return false;
+    }
+    m_in.seekg(found);
+    m_in.read(reinterpret_cast<char *>(&entry), sizeof(entry));
+    state.resize(entry.length);
+    m_in.read(state.data(), entry.length);
+    return true;
+}
+
+/**
+ * Writes the rest of the recorded log to the file
+ */
+void ReplayLog::close () {
+    if (m_out.is_open()) {
+        m_out.close();
+    }
+}
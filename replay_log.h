@@ -0,0 +1,92 @@
+// replay_log.h
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#ifndef ISA_SIM_CPP_REPLAY_LOG_H
+#define ISA_SIM_CPP_REPLAY_LOG_H
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include "termination.h"
+
+class Stack;
+
+#define REPLAY_MAGIC                0x4C525652u     // "RVRL"
+#define REPLAY_VERSION              2u
+#define SNAPSHOT_INTERVAL_DEFAULT   10000000ull
+
+/**
+ * Kinds of log entries
+ */
+typedef enum {
+    REPLAY_SYSCALL,             // result of a system call
+    REPLAY_DEVICE,              // value loaded from a device or status of a device command
+    REPLAY_MEMORY,              // bytes written into the data memory by a system call or a device
+    REPLAY_SNAPSHOT             // state of the whole machine, skipped when replaying
+} replay_kind_t;
+
+/**
+ * Configuration of the recorded machine, the replay uses the same one
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t harts;
+    uint32_t vlen;
+    uint64_t quantum;
+} replay_header_t;
+
+typedef struct {
+    uint64_t time;              // retired instructions of the hart, of hart 0 for snapshots
+    uint32_t hart;
+    uint32_t kind;
+    uint32_t length;            // bytes following the entry
+    uint32_t reserved;
+} replay_entry_t;
+
+/**
+ * Log of the nondeterministic inputs of a simulation: results of system calls,
+ * loads from devices and the memory they write, each tagged with the hart and its
+ * retired instruction count. A recording run appends the inputs as they happen,
+ * a replaying run takes them from the log instead of the host, so the run repeats
+ * exactly. Snapshots of the machine are written every few instructions, a replay
+ * can start from the nearest one before the instruction it has to reach.
+ * The harts run in deterministic round-robin order in both modes.
+ */
+class ReplayLog {
+public:
+    static ReplayLog *active () { return s_active; }
+    static bool startRecording (const char *path, unsigned int harts, unsigned long long quantum);
+    static bool startReplay (const char *path);
+    bool replaying () const { return m_replaying; }
+    const replay_header_t &header () const { return m_header; }
+
+    void recordValue (replay_kind_t kind, unsigned int value);
+    unsigned int replayValue (replay_kind_t kind);
+    void recordMemory (unsigned int address, const void *data, unsigned int length);
+    void replayMemory (Stack *memory);
+
+    void writeSnapshot (unsigned long long time, const std::string &state);
+    bool findSnapshot (unsigned long long time, std::string &state);
+    void close ();
+private:
+    ReplayLog () = default;
+    void write_entry (unsigned long long time, unsigned int hart, replay_kind_t kind, const void *data,
+                      unsigned int length);
+    bool peek_entry ();
+    void expect (replay_kind_t kind);
+
+    static ReplayLog *s_active;
+
+    bool m_replaying = false;
+    replay_header_t m_header{};
+    std::ofstream m_out;
+    std::ifstream m_in;
+    replay_entry_t m_next{};            // next entry of the replayed log
+    bool m_has_next = false;
+    Termination term;
+};
+
+
+#endif //ISA_SIM_CPP_REPLAY_LOG_H
@@ -0,0 +1,624 @@
+// simt_simulator.cpp
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#include <algorithm>
+#include <bitset>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <new>
+#include <sstream>
+#include "simt_simulator.h"
+#include "isa_simulator.h"
+#include "instruction_decoder.h"
+#include "integer_alu.h"
+#include "register_file.h"
+#include "stack.h"
+#include "statistics.h"
+
+/**
+ * Helpers working on all lanes, a scalar is broadcast to all lanes as lanes_t{} + value
+ */
+
+static inline bool any_lane (const lanes_t &mask) {
+    unsigned int any = 0;
+    for (unsigned int l = 0; l < SIMT_LANES; l++) {
+        any |= mask[l];
+    }
+    return any != 0;
+}
+
+static inline unsigned int first_lane (const lanes_t &mask) {
+    unsigned int l = 0;
+    while (l < SIMT_LANES && !mask[l]) {
+        l++;
+    }
+    return l;
+}
+
+static inline unsigned int count_lanes (const lanes_t &mask) {
+    unsigned int count = 0;
+    for (unsigned int l = 0; l < SIMT_LANES; l++) {
+        count += mask[l] & 1u;
+    }
+    return count;
+}
+
+static inline unsigned int sign_extend (unsigned int value, unsigned int bits) {
+    unsigned int shift = 32 - bits;
+    return (unsigned int)(int(value << shift) >> shift);
+}
+
+/**
+ * SIMT simulator constructor
+ */
+SimtSimulator::SimtSimulator () {
+    batch_first = 0;
+    steps = 0;
+    lane_instructions = 0;
+    // calloc leaves the pages of the (mostly unused) memory unmapped until they are touched
+    memory = static_cast<unsigned int *>(std::calloc(size_t(SIMT_ROWS) * SIMT_LANES, sizeof(unsigned int)));
+    if (memory == nullptr) {
+        throw std::bad_alloc();
+    }
+    page_dirty.assign(PAGE_COUNT, false);
+}
+
+/**
+ * Function for loading the binary file executed by all lanes
+ * @param filepath  the path to the binary file
+ * @return          true if successful otherwise false
+ */
+bool SimtSimulator::loadFile (const char *filepath) {
+    return ISA_Simulator::readBinary(filepath, inst_mem);
+}
+
+/**
+ * Function for loading the initial state of the lanes. Every non-empty line
+ * describes one lane as whitespace separated assignments xN=value or
+ * mem[address]=value (a word), text after # is ignored. a0 holds the lane
+ * index unless it is assigned.
+ * @param filepath  the path to the lane file
+ * @return          true if successful otherwise false
+ */
+bool SimtSimulator::loadLanes (const char *filepath) {
+    std::ifstream file(filepath);
+    if (!file.is_open()) {
+        std::cerr << "Not a valid lane file\n";
+        return false;
+    }
+
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream tokens(line.substr(0, line.find('#')));
+        std::string token;
+        lane_init_t lane;
+        bool empty = true;
+        while (tokens >> token) {
+            empty = false;
+            size_t assign = token.find('=');
+            std::string name = token.substr(0, assign);
+            char *end = nullptr;
+            unsigned int value = 0;
+            if (assign != std::string::npos && assign + 1 < token.size()) {
+                value = (unsigned int)std::strtoll(token.c_str() + assign + 1, &end, 0);
+            }
+            if (end == nullptr || *end != '\0') {
+                std::cerr << "Invalid lane assignment: " << token << "\n";
+                return false;
+            }
+            if (name.size() > 1 && name[0] == 'x') {
+                unsigned long r = std::strtoul(name.c_str() + 1, &end, 10);
+                if (*end == '\0' && r < 32) {
+                    lane.registers.emplace_back(r, value);
+                    continue;
+                }
+            } else if (name.size() > 5 && name.compare(0, 4, "mem[") == 0 && name.back() == ']') {
+                unsigned long address = std::strtoul(name.c_str() + 4, &end, 0);
+                if (*end == ']' && address <= STACK_END - 4) {
+                    lane.memory.emplace_back(address, value);
+                    continue;
+                }
+            }
+            std::cerr << "Invalid lane assignment: " << token << "\n";
+            return false;
+        }
+        if (!empty) {
+            lanes.push_back(lane);
+        }
+    }
+    if (lanes.empty()) {
+        std::cerr << "No lanes in lane file\n";
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Runs all lanes in batches of SIMT_LANES, prints the result of every lane and exits.
+ * The exit code is the first non-zero exit code of a lane.
+ */
+void SimtSimulator::run () {
+    results.resize(lanes.size());
+    for (unsigned int first = 0; first < lanes.size(); first += SIMT_LANES) {
+        run_batch(first);
+    }
+
+    int exit_code = 0;
+    for (unsigned long i = 0; i < results.size(); i++) {
+        const halt_t &result = results[i];
+        if (result.exit_code == 0) {
+            std::cout << "\x1B[1;32mLane " << std::dec << i << ": " << result.msg << "\x1B[0m\r\n";
+        } else {
+            std::cout << "\x1B[1;31mLane " << std::dec << i << ": " << result.msg
+                      << " (exit code " << result.exit_code << ")\x1B[0m\r\n";
+            if (exit_code == 0) {
+                exit_code = result.exit_code;
+            }
+        }
+    }
+
+    if (Statistics::isEnabled()) {
+        double utilization = steps ? 100.0 * double(lane_instructions) / double(steps * SIMT_LANES) : 0.0;
+        std::cout << "\n\033[1mStatistics:\033[0m\n";
+        std::cout << "Executed instructions:  " << std::dec << lane_instructions << "\n";
+        std::cout << "Lockstep steps:         " << steps << "\n";
+        std::cout << "Lane utilization:       " << std::fixed << std::setprecision(2) << utilization << "%\n";
+    }
+    exit(exit_code);
+}
+
+/**
+ * Runs one batch of lanes until all of them terminate and dumps their registers
+ * into output_lane<i>.res files
+ * @param first index of the first lane of the batch
+ */
+void SimtSimulator::run_batch (unsigned int first) {
+    unsigned int count = std::min<unsigned long>(SIMT_LANES, lanes.size() - first);
+    batch_first = first;
+    // only the pages written by the previous batch are not zero
+    for (unsigned int page : dirty_pages) {
+        unsigned int row = page * (PAGE_SIZE / 4);
+        unsigned int rows = std::min<unsigned int>(PAGE_SIZE / 4, SIMT_ROWS - row);
+        std::memset(memory + size_t(row) * SIMT_LANES, 0, size_t(rows) * SIMT_LANES * sizeof(unsigned int));
+        page_dirty[page] = false;
+    }
+    dirty_pages.clear();
+    for (lanes_t &r : reg) {
+        r = lanes_t{};
+    }
+
+    lanes_t mask{};
+    for (unsigned int l = 0; l < count; l++) {
+        const lane_init_t &lane = lanes[first + l];
+        mask[l] = 0xFFFFFFFFu;
+        reg[RegisterFile::x10][l] = first + l;
+        for (const auto &assignment : lane.registers) {
+            reg[assignment.first][l] = assignment.second;
+        }
+        for (const auto &assignment : lane.memory) {
+            touch(assignment.first);
+            touch(assignment.first + 3);
+            for (unsigned int b = 0; b < 4; b++) {
+                *lane_byte(l, assignment.first + b) = assignment.second >> (8 * b);
+            }
+        }
+    }
+    reg[RegisterFile::x0] = lanes_t{};
+
+    groups.assign(1, lane_group_t{0, mask});
+    while (!groups.empty()) {
+        // the group with the lowest pc runs next, so lanes which skipped forward
+        // wait for the others and run together again once they reach the same pc
+        unsigned long current = 0;
+        for (unsigned long i = 1; i < groups.size(); i++) {
+            if (groups[i].pc < groups[current].pc) {
+                current = i;
+            }
+        }
+        for (unsigned long i = groups.size(); i-- > 0;) {
+            if (i != current && groups[i].pc == groups[current].pc) {
+                groups[current].mask |= groups[i].mask;
+                groups.erase(groups.begin() + long(i));
+                if (i < current) {
+                    current--;
+                }
+            }
+        }
+
+        execute(groups[current]);
+        if (!any_lane(groups[current].mask)) {
+            groups.erase(groups.begin() + long(current));
+        }
+        groups.insert(groups.end(), split.begin(), split.end());
+        split.clear();
+    }
+
+    for (unsigned int l = 0; l < count; l++) {
+        RegisterFile registers;
+        for (unsigned int r = 1; r < 32; r++) {
+            registers.write(RegisterFile::Register(r), reg[r][l]);
+        }
+        registers.dump_registers("./output_lane" + std::to_string(first + l) + ".res");
+    }
+}
+
+/**
+ * Fetch and execute the instruction at pc of the group for all its active lanes
+ * @param group group of lanes, its pc and mask are updated
+ */
+void SimtSimulator::execute (lane_group_t &group) {
+    unsigned int pc = group.pc;
+    if (pc / 4 >= inst_mem.size()) {
+        if (pc == inst_mem.size() * 4 + 4) {
+            halt_all(group, "End of file reached", 0);
+        } else {
+            halt_all(group, "Wrong instruction address: pc = " + std::to_string(pc), 2);
+        }
+        return;
+    }
+
+    unsigned int inst = inst_mem[pc / 4];
+    unsigned char opcode = inst & 0x0000007Fu;
+    u_inst_t upper{};
+    j_inst_t jump{};
+    upper.inst = jump.inst = inst;
+    steps++;
+    lane_instructions += count_lanes(group.mask);
+
+    switch (opcode) {
+        case 0b0110011:
+            reg_arith(group, inst);
+            break;
+        case 0b0010011:
+            imm_arith(group, inst);
+            break;
+        case 0b0000011:
+            load(group, inst);
+            break;
+        case 0b0100011:
+            store(group, inst);
+            break;
+        case 0b1100011:
+            branch(group, inst);
+            break;
+        case 0b0110111:
+            // LUI
+            write(upper.f.rd, lanes_t{} + (upper.f.imm31_12 << 12u), group.mask);
+            group.pc = pc + 4;
+            break;
+        case 0b0010111:
+            // AUIPC
+            write(upper.f.rd, lanes_t{} + pc + (upper.f.imm31_12 << 12u), group.mask);
+            group.pc = pc + 4;
+            break;
+        case 0b1101111: {
+            // JAL, the target is the same for all lanes
+            unsigned int imm = (jump.f.imm19_12 << 12u) | (jump.f.imm11 << 11u) |
+                               (jump.f.imm10_1 << 1u) | (jump.f.imm20 << 20u);
+            write(jump.f.rd, lanes_t{} + pc + 4, group.mask);
+            group.pc = pc + sign_extend(imm, 21);
+            break;
+        }
+        case 0b1100111:
+            jump_link_reg(group, inst);
+            break;
+        case 0b1110011:
+            ecall(group, inst);
+            break;
+        case 0b0001111:
+            // FENCE, every lane has its own memory
+            group.pc = pc + 4;
+            break;
+        default:
+            halt_all(group, "Wrong opcode or not implemented instruction: opcode="
+                            + std::bitset<7>(opcode).to_string(), 1);
+    }
+}
+
+/**
+ * Executes register-register arithmetic and logic instructions (RV32I and RV32M)
+ * @param group group of lanes
+ * @param inst  raw instruction
+ */
+void SimtSimulator::reg_arith (lane_group_t &group, unsigned int inst) {
+    r_inst_t decoder{};
+    decoder.inst = inst;
+    lanes_t r;
+
+    // Zba and Zbb are not supported in lane-parallel mode
+    if (!IntegerAlu::registerOp<lanes_t, slanes_t>(decoder.f.funct7 << 3u | decoder.f.funct3,
+                                                   reg[decoder.f.rs1], reg[decoder.f.rs2], r)) {
+        halt_all(group, "Unsupported instruction in lane-parallel mode", 1);
+        return;
+    }
+    write(decoder.f.rd, r, group.mask);
+    group.pc += 4;
+}
+
+/**
+ * Executes register-immediate arithmetic and logic instructions
+ * @param group group of lanes
+ * @param inst  raw instruction
+ */
+void SimtSimulator::imm_arith (lane_group_t &group, unsigned int inst) {
+    i_inst_t decoder{};
+    decoder.inst = inst;
+    lanes_t r;
+
+    if (!IntegerAlu::immediateOp<lanes_t, slanes_t>(decoder.f.funct3, sign_extend(decoder.f.imm, 12),
+                                                    reg[decoder.f.rs1], r)) {
+        halt_all(group, "Unsupported instruction in lane-parallel mode", 1);
+        return;
+    }
+    write(decoder.f.rd, r, group.mask);
+    group.pc += 4;
+}
+
+/**
+ * Executes load instructions. A word load from the same aligned address in all
+ * lanes is a single SIMD load, because the memory of the lanes is interleaved.
+ * @param group group of lanes
+ * @param inst  raw instruction
+ */
+void SimtSimulator::load (lane_group_t &group, unsigned int inst) {
+    i_inst_t decoder{};
+    decoder.inst = inst;
+    const unsigned int funct3 = decoder.f.funct3;
+    const lanes_t sp = reg[decoder.f.rs1] + sign_extend(decoder.f.imm, 12);
+    lanes_t data = reg[decoder.f.rd];
+
+    if (funct3 == 0b011 || funct3 > 0b101) {
+        halt_all(group, "Invalid funct3 while decoding load instruction: "
+                        + std::to_string(funct3) + "\n", 1);
+        return;
+    }
+    unsigned int length = 1u << (funct3 & 0b11u);
+    unsigned int first = first_lane(group.mask);
+    unsigned int address = sp[first];
+
+    if (funct3 == 0b010 && address % 4 == 0 && address <= STACK_SIZE - 4 &&
+        !any_lane((sp ^ (lanes_t{} + address)) & group.mask)) {
+        std::memcpy(&data, memory + size_t(address / 4) * SIMT_LANES, sizeof(data));
+    } else {
+        for (unsigned int l = first; l < SIMT_LANES; l++) {
+            if (!group.mask[l] || !lane_address(group, l, sp[l], length)) {
+                continue;
+            }
+            unsigned int value = 0;
+            for (unsigned int b = 0; b < length; b++) {
+                value |= (unsigned int)(*lane_byte(l, sp[l] + b)) << (8 * b);
+            }
+            // LB and LH are sign-extended
+            if (funct3 == 0b000) {
+                value = sign_extend(value, 8);
+            } else if (funct3 == 0b001) {
+                value = sign_extend(value, 16);
+            }
+            data[l] = value;
+        }
+    }
+    write(decoder.f.rd, data, group.mask);
+    group.pc += 4;
+}
+
+/**
+ * Executes store instructions
+ * @param group group of lanes
+ * @param inst  raw instruction
+ */
+void SimtSimulator::store (lane_group_t &group, unsigned int inst) {
+    s_inst_t decoder{};
+    decoder.inst = inst;
+    const unsigned int funct3 = decoder.f.funct3;
+    const unsigned int imm = sign_extend(decoder.f.imm4_0 | (decoder.f.imm5_11 << 5u), 12);
+    const lanes_t sp = reg[decoder.f.rs1] + imm;
+    const lanes_t data = reg[decoder.f.rs2];
+
+    if (funct3 > 0b010) {
+        halt_all(group, "Invalid funct3 while decoding store instruction: "
+                        + std::to_string(funct3) + "\n", 1);
+        return;
+    }
+    unsigned int length = 1u << funct3;
+    unsigned int first = first_lane(group.mask);
+    unsigned int address = sp[first];
+
+    if (funct3 == 0b010 && address % 4 == 0 && address <= STACK_SIZE - 4 &&
+        !any_lane((sp ^ (lanes_t{} + address)) & group.mask)) {
+        touch(address);
+        lanes_t row;
+        unsigned int *words = memory + size_t(address / 4) * SIMT_LANES;
+        std::memcpy(&row, words, sizeof(row));
+        row = (data & group.mask) | (row & ~group.mask);
+        std::memcpy(words, &row, sizeof(row));
+    } else {
+        for (unsigned int l = first; l < SIMT_LANES; l++) {
+            if (!group.mask[l] || !lane_address(group, l, sp[l], length)) {
+                continue;
+            }
+            touch(sp[l]);
+            touch(sp[l] + length - 1);
+            for (unsigned int b = 0; b < length; b++) {
+                *lane_byte(l, sp[l] + b) = data[l] >> (8 * b);
+            }
+        }
+    }
+    group.pc += 4;
+}
+
+/**
+ * Executes branch instructions. Lanes which do not agree on the direction
+ * are split into two groups.
+ * @param group group of lanes
+ * @param inst  raw instruction
+ */
+void SimtSimulator::branch (lane_group_t &group, unsigned int inst) {
+    b_inst_t decoder{};
+    decoder.inst = inst;
+    unsigned int imm = (decoder.f.imm4_1 << 1u) | (decoder.f.imm5_10 << 5u) |
+                       (decoder.f.imm11 << 11u) | (decoder.f.imm12 << 12u);
+    lanes_t taken;
+
+    // the condition of BranchDecoder, evaluated for all lanes at once
+    if (!IntegerAlu::branchTaken<lanes_t, slanes_t>(decoder.f.funct3, reg[decoder.f.rs1], reg[decoder.f.rs2], taken)) {
+        halt_all(group, "Invalid funct3 while decoding branch instruction: "
+                        + std::to_string(decoder.f.funct3) + "\n", 1);
+        return;
+    }
+
+    unsigned int target = group.pc + sign_extend(imm, 13);
+    taken &= group.mask;
+    lanes_t not_taken = group.mask & ~taken;
+    if (!any_lane(taken)) {
+        group.pc += 4;
+    } else if (!any_lane(not_taken)) {
+        group.pc = target;
+    } else {
+        // divergence, the taken lanes continue as a new group
+        split.push_back(lane_group_t{target, taken});
+        group.mask = not_taken;
+        group.pc += 4;
+    }
+}
+
+/**
+ * Executes JALR instruction. Lanes jumping to different targets are split into groups.
+ * @param group group of lanes
+ * @param inst  raw instruction
+ */
+void SimtSimulator::jump_link_reg (lane_group_t &group, unsigned int inst) {
+    i_inst_t decoder{};
+    decoder.inst = inst;
+    const lanes_t target = (reg[decoder.f.rs1] + sign_extend(decoder.f.imm, 12)) & ~1u;
+
+    write(decoder.f.rd, lanes_t{} + group.pc + 4, group.mask);
+
+    lanes_t remaining = group.mask;
+    unsigned int first = first_lane(remaining);
+    lanes_t same = (lanes_t)(target == (lanes_t{} + target[first])) & remaining;
+    group.pc = target[first];
+    group.mask = same;
+    remaining &= ~same;
+    while (any_lane(remaining)) {
+        first = first_lane(remaining);
+        same = (lanes_t)(target == (lanes_t{} + target[first])) & remaining;
+        split.push_back(lane_group_t{target[first], same});
+        remaining &= ~same;
+    }
+}
+
+/**
+ * Executes environment calls, every lane terminates on its own
+ * @param group group of lanes
+ * @param inst  raw instruction
+ */
+void SimtSimulator::ecall (lane_group_t &group, unsigned int inst) {
+    i_inst_t decoder{};
+    decoder.inst = inst;
+
+    if (decoder.f.funct3 != 0) {
+        halt_all(group, "Unsupported instruction in lane-parallel mode", 1);
+        return;
+    }
+    if (decoder.f.imm != 0) {
+        halt_all(group, "Unsupported instruction", 1);
+        return;
+    }
+    for (unsigned int l = 0; l < SIMT_LANES; l++) {
+        if (!group.mask[l]) {
+            continue;
+        }
+        switch (reg[RegisterFile::x10][l]) {
+            case 10: // exit
+                halt(group, l, "Ecall 10 reached", 0);
+                break;
+            case 17: // exit2
+                halt(group, l, "Ecall 12 reached - exit code: " + std::to_string(reg[RegisterFile::x11][l]), 0);
+                break;
+            default:
+                halt(group, l, "Unsupported instruction", 1);
+        }
+    }
+}
+
+/**
+ * Writes register of the active lanes
+ * @param rd    register number
+ * @param value value of every lane
+ * @param mask  active lanes
+ */
+void SimtSimulator::write (unsigned int rd, const lanes_t &value, const lanes_t &mask) {
+    if (rd != RegisterFile::x0) {
+        reg[rd] = (value & mask) | (reg[rd] & ~mask);
+    }
+}
+
+/**
+ * Terminates one lane and removes it from its group
+ * @param group     group of the lane
+ * @param lane      lane within the batch
+ * @param msg       message printed at the end of simulation
+ * @param exit_code exit code of the lane
+ */
+void SimtSimulator::halt (lane_group_t &group, unsigned int lane, const std::string &msg, int exit_code) {
+    results[batch_first + lane] = halt_t{msg, exit_code, false};
+    group.mask[lane] = 0;
+}
+
+/**
+ * Terminates all active lanes of the group
+ * @param group     group of lanes
+ * @param msg       message printed at the end of simulation
+ * @param exit_code exit code of the lanes
+ */
+void SimtSimulator::halt_all (lane_group_t &group, const std::string &msg, int exit_code) {
+    for (unsigned int l = 0; l < SIMT_LANES; l++) {
+        if (group.mask[l]) {
+            halt(group, l, msg, exit_code);
+        }
+    }
+}
+
+/**
+ * Gets host byte of the lane-interleaved memory. Word w of lane l is stored
+ * at index w * SIMT_LANES + l, so the same word of all lanes is contiguous.
+ * @param lane  lane within the batch
+ * @param sp    guest address
+ * @return      pointer to the byte
+ */
+unsigned char *SimtSimulator::lane_byte (unsigned int lane, unsigned int sp) {
+    return reinterpret_cast<unsigned char *>(memory + size_t(sp / 4) * SIMT_LANES + lane) + sp % 4;
+}
+
+/**
+ * Checks that the memory access of the lane is within the memory, terminates the lane otherwise
+ * @param group     group of the lane
+ * @param lane      lane within the batch
+ * @param sp        guest address
+ * @param length    number of bytes
+ * @return          true if the access is valid
+ */
+bool SimtSimulator::lane_address (lane_group_t &group, unsigned int lane, unsigned int sp, unsigned int length) {
+    if (sp > STACK_END - length) {
+        halt(group, lane, "Unknown error occurred: memory access out of range: address = " + std::to_string(sp), -1);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Records the page of a written address, so the next batch zeroes it
+ * @param sp    guest address
+ */
+void SimtSimulator::touch (unsigned int sp) {
+    unsigned int page = sp >> PAGE_BITS;
+    if (!page_dirty[page]) {
+        page_dirty[page] = true;
+        dirty_pages.push_back(page);
+    }
+}
@@ -0,0 +1,83 @@
+// simt_simulator.h
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#ifndef ISA_SIM_CPP_SIMT_SIMULATOR_H
+#define ISA_SIM_CPP_SIMT_SIMULATOR_H
+
+#include <string>
+#include <vector>
+#include "termination.h"
+#include "stack.h"
+
+// number of program instances executed in lockstep, 16 lanes of 32 bits fill
+// one AVX-512 register (two AVX2 or four SSE2 registers)
+#define SIMT_LANES 16
+#define SIMT_ROWS  ((STACK_END + 3) / 4)    // words of the memory of a lane
+
+typedef unsigned int lanes_t __attribute__((vector_size(SIMT_LANES * 4)));
+typedef int slanes_t __attribute__((vector_size(SIMT_LANES * 4)));
+
+/**
+ * Lanes executing the same instruction. Active lanes have all bits of mask set.
+ */
+typedef struct {
+    unsigned int pc;
+    lanes_t mask;
+} lane_group_t;
+
+/**
+ * Initial state of one program instance: register and memory word assignments
+ */
+typedef struct {
+    std::vector<std::pair<unsigned int, unsigned int>> registers;
+    std::vector<std::pair<unsigned int, unsigned int>> memory;
+} lane_init_t;
+
+/**
+ * Lane-parallel (SIMT) execution of many instances of one RV32IM program.
+ * Register files are stored as structure of arrays, every instruction is
+ * decoded once and executed for all active lanes of its group with host SIMD.
+ * Lanes which diverge at a branch or jump are split into groups by pc, the
+ * group with the lowest pc runs first and groups reaching the same pc merge again.
+ */
+class SimtSimulator {
+public:
+    SimtSimulator ();
+    bool loadFile (const char *filepath);
+    bool loadLanes (const char *filepath);
+    [[noreturn]] void run ();
+private:
+    void run_batch (unsigned int first);
+    void execute (lane_group_t &group);
+    void reg_arith (lane_group_t &group, unsigned int inst);
+    void imm_arith (lane_group_t &group, unsigned int inst);
+    void load (lane_group_t &group, unsigned int inst);
+    void store (lane_group_t &group, unsigned int inst);
+    void branch (lane_group_t &group, unsigned int inst);
+    void jump_link_reg (lane_group_t &group, unsigned int inst);
+    void ecall (lane_group_t &group, unsigned int inst);
+
+    void write (unsigned int rd, const lanes_t &value, const lanes_t &mask);
+    void halt (lane_group_t &group, unsigned int lane, const std::string &msg, int exit_code);
+    void halt_all (lane_group_t &group, const std::string &msg, int exit_code);
+    unsigned char *lane_byte (unsigned int lane, unsigned int sp);
+    bool lane_address (lane_group_t &group, unsigned int lane, unsigned int sp, unsigned int length);
+    void touch (unsigned int sp);
+
+    std::vector<unsigned int> inst_mem;
+    std::vector<lane_init_t> lanes;
+    std::vector<halt_t> results;
+    unsigned int batch_first;                   // index of lane 0 of the current batch
+    alignas(64) lanes_t reg[32];                // structure of arrays register file
+    unsigned int *memory;                       // lane-interleaved data memory
+    std::vector<bool> page_dirty;               // page written by the current batch
+    std::vector<unsigned int> dirty_pages;      // pages zeroed before the next batch
+    std::vector<lane_group_t> groups;
+    std::vector<lane_group_t> split;            // groups created by the current instruction
+    unsigned long long steps;                   // instructions executed by groups
+    unsigned long long lane_instructions;       // instructions executed by lanes
+};
+
+
+#endif //ISA_SIM_CPP_SIMT_SIMULATOR_H
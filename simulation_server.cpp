@@ -0,0 +1,294 @@
+// simulation_server.cpp
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "simulation_server.h"
+
+/**
+ * Sends the whole buffer to the client
+ * @param connection    socket of the client
+ * @param data          the answer
+ * @return              false if the client closed the connection
+ */
+static bool send_all (int connection, const std::string &data) {
+    const char *buffer = data.data();
+    size_t length = data.size();
+    while (length != 0) {
+        ssize_t sent = send(connection, buffer, length, MSG_NOSIGNAL);
+        if (sent <= 0) {
+            return false;
+        }
+        buffer += sent;
+        length -= size_t(sent);
+    }
+    return true;
+}
+
+/**
+ * Simulation server constructor
+ * @param threads   number of host threads serving the connections
+ */
+SimulationServer::SimulationServer (unsigned int threads)
+        : jobs(0), instructions(0), hits(0), misses(0) {
+    listener = -1;
+    thread_count = threads;
+    start = std::chrono::steady_clock::now();
+}
+
+/**
+ * Creates the socket, a stale socket file of a previous server is replaced
+ * @param path  the path to the socket
+ * @return      true if successful otherwise false
+ */
+bool SimulationServer::listen (const char *path) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (std::strlen(path) >= sizeof(address.sun_path)) {
+        return false;
+    }
+    std::strcpy(address.sun_path, path);
+    listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listener < 0) {
+        return false;
+    }
+    unlink(path);
+    if (bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0
+        || ::listen(listener, SERVER_BACKLOG) != 0) {
+        close(listener);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Accepts connections and passes them to the thread pool, never returns
+ */
+void SimulationServer::run () {
+    std::vector<std::thread> threads;
+    for (unsigned int i = 0; i < thread_count; i++) {
+        threads.emplace_back([this] { work(); });
+    }
+    std::cout << "Serving with " << thread_count << " threads\n" << std::flush;
+    while (true) {
+        int connection = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+        if (connection < 0) {
+            continue;
+        }
+        {
+            std::lock_guard<std::mutex> guard(queue_lock);
+            connections.push_back(connection);
+        }
+        queue_ready.notify_one();
+    }
+}
+
+/**
+ * Body of a pool thread: serves one waiting connection after another
+ */
+void SimulationServer::work () {
+    while (true) {
+        int connection;
+        {
+            std::unique_lock<std::mutex> guard(queue_lock);
+            queue_ready.wait(guard, [this] { return !connections.empty(); });
+            connection = connections.front();
+            connections.pop_front();
+        }
+        serve(connection);
+        close(connection);
+    }
+}
+
+/**
+ * Answers the requests of a connection until the client closes it
+ * @param connection    socket of the client
+ */
+void SimulationServer::serve (int connection) {
+    std::string buffer;
+    char chunk[SERVER_LINE_MAX];
+    while (true) {
+        size_t end = buffer.find('\n');
+        if (end == std::string::npos) {
+            if (buffer.size() > SERVER_LINE_MAX) {
+                send_all(connection, "error request too long\n");
+                return;
+            }
+            ssize_t length = recv(connection, chunk, sizeof(chunk), 0);
+            if (length <= 0) {
+                return;
+            }
+            buffer.append(chunk, size_t(length));
+            continue;
+        }
+
+        std::istringstream request(buffer.substr(0, end));
+        buffer.erase(0, end + 1);
+        std::string command;
+        request >> command;
+        std::string answer;
+        if (command == "run") {
+            answer = run_job(request);
+        } else if (command == "stats") {
+            answer = stats();
+        } else if (command.empty()) {
+            continue;
+        } else {
+            answer = "error unknown command " + command;
+        }
+        if (!send_all(connection, answer + "\n")) {
+            return;
+        }
+    }
+}
+
+/**
+ * Runs one job
+ * @param request   arguments of the run request
+ * @return          the answer without the line end
+ */
+std::string SimulationServer::run_job (std::istringstream &request) {
+    std::string path;
+    if (!(request >> path)) {
+        return "error missing binary";
+    }
+    std::vector<std::pair<unsigned int, unsigned int>> registers;
+    unsigned long long steps = STEP_LIMIT_DEFAULT;
+    std::string argument;
+    while (request >> argument) {
+        size_t equals = argument.find('=');
+        if (equals == std::string::npos) {
+            return "error invalid argument " + argument;
+        }
+        std::string name = argument.substr(0, equals);
+        const char *value = argument.c_str() + equals + 1;
+        char *end;
+        if (name == "steps") {
+            steps = std::strtoull(value, &end, 0);
+        } else if (name.size() > 1 && name[0] == 'x') {
+            unsigned long reg = std::strtoul(name.c_str() + 1, &end, 10);
+            if (*end != '\0' || reg > 31) {
+                return "error invalid register " + name;
+            }
+            registers.emplace_back(reg, (unsigned int)(std::strtoul(value, &end, 0)));
+        } else {
+            return "error invalid argument " + argument;
+        }
+        if (*end != '\0') {
+            return "error invalid value " + argument;
+        }
+    }
+
+    cached_program_t *entry = load(path);
+    if (entry == nullptr) {
+        return "error cannot load " + path;
+    }
+    Guest *guest = acquire(entry);
+    Hart *hart = guest->hart();
+    for (auto &reg : registers) {
+        hart->registers()->write(RegisterFile::Register(reg.first), reg.second);
+    }
+
+    hart->floatRegisters()->attachHost();
+    exec_result_t result = hart->run(steps);
+    hart->floatRegisters()->detachHost();
+    hart->syscalls()->flush();
+
+    std::ostringstream answer;
+    if (result == EXEC_OK) {
+        answer << "limit";
+    } else {
+        answer << "halted exit=" << hart->halt().exit_code;
+    }
+    answer << " instructions=" << hart->statistics()->instructions();
+    char value[16];
+    for (unsigned int i = 0; i < 32; i++) {
+        std::snprintf(value, sizeof(value), "0x%08x", hart->registers()->read(RegisterFile::Register(i)));
+        answer << " x" << i << "=" << value;
+    }
+    if (result != EXEC_OK) {
+        answer << " message=" << hart->halt().msg;
+    }
+    jobs++;
+    instructions += hart->statistics()->instructions();
+    release(entry, guest);
+    return answer.str();
+}
+
+/**
+ * Reports the throughput of the server since it was started
+ * @return  the answer without the line end
+ */
+std::string SimulationServer::stats () {
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::ostringstream answer;
+    answer << "jobs=" << jobs << " instructions=" << instructions << " seconds=" << seconds
+           << " jobs_per_second=" << double(jobs) / seconds << " mips=" << double(instructions) / seconds / 1e6
+           << " cache_hits=" << hits << " cache_misses=" << misses;
+    std::lock_guard<std::mutex> guard(cache_lock);
+    answer << " programs=" << cache.size();
+    return answer.str();
+}
+
+/**
+ * Gets the cached program with the contents of the binary, loading and predecoding it on a miss
+ * @param path  the path to the binary
+ * @return      the cached program or nullptr if the binary cannot be read
+ */
+cached_program_t *SimulationServer::load (const std::string &path) {
+    std::vector<unsigned int> words;
+    if (!ISA_Simulator::readBinary(path.c_str(), words)) {
+        return nullptr;
+    }
+    uint64_t hash = ProgramImage::hash(words);
+    std::lock_guard<std::mutex> guard(cache_lock);
+    // programs with colliding hashes are told apart by their contents
+    auto range = cache.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second->image->words() == words) {
+            hits++;
+            return it->second.get();
+        }
+    }
+    misses++;
+    auto entry = std::make_unique<cached_program_t>();
+    entry->image = std::make_shared<const ProgramImage>(std::move(words));
+    return cache.emplace(hash, std::move(entry))->second.get();
+}
+
+/**
+ * Gets an instance of the program in its initial state, a warm one if available
+ * @param entry     the cached program
+ * @return          the instance
+ */
+Guest *SimulationServer::acquire (cached_program_t *entry) {
+    Guest *guest = nullptr;
+    {
+        std::lock_guard<std::mutex> guard(cache_lock);
+        if (!entry->idle.empty()) {
+            guest = entry->idle.back();
+            entry->idle.pop_back();
+        }
+    }
+    if (guest == nullptr) {
+        return new Guest(0, entry->image, QUANTUM_DEFAULT);
+    }
+    guest->reset(0);
+    return guest;
+}
+
+/**
+ * Keeps a finished instance for the next job of its program
+ * @param entry     the cached program
+ * @param guest     the instance
+ */
+void SimulationServer::release (cached_program_t *entry, Guest *guest) {
+    std::lock_guard<std::mutex> guard(cache_lock);
+    entry->idle.push_back(guest);
+}
@@ -0,0 +1,78 @@
+// simulation_server.h
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#ifndef ISA_SIM_CPP_SIMULATION_SERVER_H
+#define ISA_SIM_CPP_SIMULATION_SERVER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "isa_simulator.h"
+#include "guest_scheduler.h"
+
+#define SERVER_BACKLOG      64
+#define SERVER_LINE_MAX     4096
+#define STEP_LIMIT_DEFAULT  100000000ull
+
+/**
+ * Program loaded by the server, kept for later jobs with the same binary
+ */
+typedef struct {
+    std::shared_ptr<const ProgramImage> image;
+    std::vector<Guest*> idle;       // instances which finished a job, ready to be reset
+} cached_program_t;
+
+/**
+ * Daemon running simulation jobs sent over a Unix domain socket. Every line of
+ * a connection is one request, answered by one line:
+ *
+ *   run <binary> [x<n>=<value>]... [steps=<n>]
+ *      runs the binary from address 0 until it terminates or executes the given
+ *      number of instructions, answers with "halted exit=<code>" or "limit",
+ *      the instruction count, all registers and the termination message
+ *   stats
+ *      answers with the number of jobs and instructions, the throughput and the cache hits
+ *
+ * Programs are loaded and predecoded once and cached by the hash of their contents.
+ * Instances (memory and hart) are reused by later jobs of the same program.
+ * Connections are served by a pool of host threads, one connection at a time per thread.
+ */
+class SimulationServer {
+public:
+    explicit SimulationServer (unsigned int threads);
+    bool listen (const char *path);
+    [[noreturn]] void run ();
+private:
+    void work ();
+    void serve (int connection);
+    std::string run_job (std::istringstream &request);
+    std::string stats ();
+    cached_program_t *load (const std::string &path);
+    Guest *acquire (cached_program_t *entry);
+    void release (cached_program_t *entry, Guest *guest);
+
+    int listener;
+    unsigned int thread_count;
+    std::mutex queue_lock;
+    std::condition_variable queue_ready;
+    std::deque<int> connections;                // accepted connections waiting for a thread
+    std::mutex cache_lock;
+    std::unordered_multimap<uint64_t, std::unique_ptr<cached_program_t>> cache;
+    std::atomic<unsigned long long> jobs;
+    std::atomic<unsigned long long> instructions;
+    std::atomic<unsigned long long> hits;
+    std::atomic<unsigned long long> misses;
+    std::chrono::steady_clock::time_point start;
+};
+
+
+#endif //ISA_SIM_CPP_SIMULATION_SERVER_H
@@ -0,0 +1,35 @@
+// snapshot.h
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#ifndef ISA_SIM_CPP_SNAPSHOT_H
+#define ISA_SIM_CPP_SNAPSHOT_H
+
+#include <istream>
+#include <ostream>
+#include <type_traits>
+
+/**
+ * Writes the raw bytes of a value into a snapshot
+ * @param out   snapshot stream
+ * @param value value to be written, must be trivially copyable
+ */
+template <typename T>
+inline void save_value (std::ostream &out, const T &value) {
+    static_assert(std::is_trivially_copyable<T>::value, "only plain values can be saved");
+    out.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+/**
+ * Reads the raw bytes of a value from a snapshot
+ * @param in    snapshot stream
+ * @param value value to be read, must be trivially copyable
+ */
+template <typename T>
+inline void restore_value (std::istream &in, T &value) {
+    static_assert(std::is_trivially_copyable<T>::value, "only plain values can be restored");
+    in.read(reinterpret_cast<char *>(&value), sizeof(T));
+}
+
+
+#endif //ISA_SIM_CPP_SNAPSHOT_H
@@ -2,50 +2,687 @@
 // Matej Majtan (s184457) & Søren Tønnesen (s180381)
 // 02-12-2019
 
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <string>
 #include "stack.h"
+#include "code_memory.h"
+#include "hart.h"
+#include "program_image.h"
+#include "replay_log.h"
+#include "snapshot.h"
 
 Stack* Stack::instance = nullptr;
 
-Stack::Stack () {}
+alignas(64) const unsigned char Stack::zero_page[PAGE_SIZE] = {};
+
+Stack::Stack () {
+    m_pages.fill(zero_entry());
+    m_mapping = nullptr;
+    m_mapping_length = 0;
+    m_tracking = false;
+}
+
+Stack::~Stack () {
+    for (uintptr_t entry : m_pages) {
+        release(entry);
+    }
+    if (m_mapping != nullptr) {
+        munmap(m_mapping, m_mapping_length);
+    }
+}
+
+/**
+ * Frees a touched page, pages of a mapped checkpoint are released with the whole mapping
+ * @param entry     page table entry
+ */
+void Stack::release (uintptr_t entry) {
+    auto *data = page(entry);
+    auto *mapping = static_cast<unsigned char *>(m_mapping);
+    if (owned(entry) && !(data >= mapping && data < mapping + m_mapping_length)) {
+        std::free(data);
+    }
+}
+
+/**
+ * Allocates a copy of the zero page or an image page in its place. Harts running on different
+ * host threads may write to the same new page at once, only the first allocation is kept.
+ * @param index     page number
+ * @param expected  entry of the zero or image page
+ * @return          the page
+ */
+unsigned char *Stack::allocate (unsigned int index, uintptr_t expected) {
+    auto *data = static_cast<unsigned char *>(std::aligned_alloc(PAGE_SIZE, PAGE_SIZE));
+    if (data == nullptr) {
+        throw std::bad_alloc();
+    }
+    std::memcpy(data, page(expected), PAGE_SIZE);
+    // the copy of an image page keeps its code tag
+    uintptr_t copy = reinterpret_cast<uintptr_t>(data) | (expected & PAGE_CODE);
+    if (!__atomic_compare_exchange_n(&m_pages[index], &expected, copy, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        std::free(data);
+        return page(expected);
+    }
+    return data;
+}
+
+/**
+ * Gets the page holding address sp for writing, allocating it on the first write.
+ * The first write to a page since trackWrites is recorded.
+ * @param sp    guest address inside of the data memory, not of a device
+ * @return      the page
+ */
+unsigned char *Stack::write_page (unsigned int sp) {
+    uintptr_t current = entry(sp);
+    if (!(current & PAGE_NO_WRITE)) {
+        return page(current);
+    }
+    if (m_tracking) {
+        m_written.push_back(sp >> PAGE_BITS);
+    }
+    if (current & PAGE_TRACKED) {
+        __atomic_fetch_and(&m_pages[sp >> PAGE_BITS], ~uintptr_t(PAGE_NO_WRITE | PAGE_TRACKED), __ATOMIC_ACQ_REL);
+        return page(current);
+    }
+    return allocate(sp >> PAGE_BITS, current);
+}
+
+/**
+ * Copies guest memory into host buffer, the range may cross pages and devices
+ * @param sp        guest address of the first byte, the range is already checked
+ * @param data      destination buffer
+ * @param length    number of bytes
+ */
+void Stack::read (unsigned int sp, void *data, unsigned int length) {
+    auto *dst = static_cast<unsigned char *>(data);
+    while (length != 0) {
+        unsigned int chunk = std::min(length, PAGE_SIZE - (sp & PAGE_MASK));
+        uintptr_t current = entry(sp);
+        if (current & PAGE_NO_READ) {
+            auto *region = reinterpret_cast<mmio_region_t *>(page(current));
+            for (unsigned int i = 0; i < chunk; i++) {
+                dst[i] = device_read(region, sp + i, 1);
+            }
+        } else {
+            std::memcpy(dst, page(current) + (sp & PAGE_MASK), chunk);
+        }
+        sp += chunk;
+        dst += chunk;
+        length -= chunk;
+    }
+}
+
+/**
+ * Copies host buffer into guest memory, the range may cross pages and devices
+ * @param sp        guest address of the first byte, the range is already checked
+ * @param data      source buffer
+ * @param length    number of bytes
+ */
+void Stack::write (unsigned int sp, const void *data, unsigned int length) {
+    auto *src = static_cast<const unsigned char *>(data);
+    while (length != 0) {
+        unsigned int chunk = std::min(length, PAGE_SIZE - (sp & PAGE_MASK));
+        uintptr_t current = entry(sp);
+        if (current & PAGE_NO_READ) {
+            auto *region = reinterpret_cast<mmio_region_t *>(page(current));
+            for (unsigned int i = 0; i < chunk; i++) {
+                region->device->write(sp + i - region->base, src[i], 1);
+            }
+        } else {
+            std::memcpy(write_page(sp) + (sp & PAGE_MASK), src, chunk);
+            if (current & PAGE_CODE) {
+                invalidate_code(sp, chunk);
+            }
+        }
+        sp += chunk;
+        src += chunk;
+        length -= chunk;
+    }
+}
+
+/**
+ * Finds the device whose address range contains the whole access
+ * @param sp        guest address of the access
+ * @param length    number of bytes
+ * @return          address range of the device or nullptr
+ */
+mmio_region_t *Stack::find_device (unsigned int sp, unsigned int length) {
+    mmio_region_t *region = nullptr;
+    if ((sp >> PAGE_BITS) < PAGE_COUNT) {
+        uintptr_t current = entry(sp);
+        if (current & PAGE_NO_READ) {
+            region = reinterpret_cast<mmio_region_t *>(page(current));
+        }
+    } else if (!m_device_pages.empty()) {
+        auto it = m_device_pages.find(sp >> PAGE_BITS);
+        if (it != m_device_pages.end()) {
+            region = it->second;
+        }
+    }
+    if (region != nullptr && sp - region->base <= region->size - length) {
+        return region;
+    }
+    return nullptr;
+}
+
+/**
+ * Loads from a device. Loaded values are recorded, a replay takes them from the log.
+ * @param region    address range of the device
+ * @param sp        guest address of the access
+ * @param length    number of bytes
+ * @return          loaded value
+ */
+unsigned int Stack::device_read (mmio_region_t *region, unsigned int sp, unsigned int length) {
+    ReplayLog *log = ReplayLog::active();
+    if (log != nullptr && log->replaying()) {
+        return log->replayValue(REPLAY_DEVICE);
+    }
+    unsigned int data = region->device->read(sp - region->base, length);
+    if (log != nullptr) {
+        log->recordValue(REPLAY_DEVICE, data);
+    }
+    return data;
+}
+
+/**
+ * Slow path of loads: devices, accesses crossing pages and addresses out of range
+ * @param sp        guest address of the access
+ * @param length    number of bytes
+ * @return          loaded value
+ */
+unsigned int Stack::load (unsigned int sp, unsigned int length) {
+    mmio_region_t *region = find_device(sp, length);
+    if (region != nullptr) {
+        return device_read(region, sp, length);
+    }
+    check_range(sp, length);
+    unsigned int data = 0;
+    read(sp, &data, length);
+    return data;
+}
+
+/**
+ * Slow path of stores: devices, untouched pages, accesses crossing pages and addresses out of range
+ * @param sp        guest address of the access
+ * @param data      value to be stored
+ * @param length    number of bytes
+ */
+void Stack::store (unsigned int sp, unsigned int data, unsigned int length) {
+    mmio_region_t *region = find_device(sp, length);
+    if (region != nullptr) {
+        region->device->write(sp - region->base, data, length);
+        return;
+    }
+    check_range(sp, length);
+    write(sp, &data, length);
+}
+
+/**
+ * Maps the program image to the start of the data memory, so its constants
+ * and initialized data can be loaded. The part beyond the data memory is dropped.
+ * The memory keeps the image alive and maps it again whenever it is cleared.
+ * @param image     the program image
+ */
+void Stack::loadImage (std::shared_ptr<const ProgramImage> image) {
+    m_image = std::move(image);
+    m_code = std::make_unique<CodeMemory>(m_image, *this);
+    clear();
+}
+
+/**
+ * Maps the pages of the program image in place of the zero pages, pages of devices stay.
+ * Pages holding instructions are tagged as code.
+ */
+void Stack::map_image () {
+    if (m_image == nullptr) {
+        return;
+    }
+    for (unsigned int index = 0; index < m_image->pageCount(); index++) {
+        if (!(m_pages[index] & PAGE_NO_READ)) {
+            uintptr_t code = m_image->codeEntries()[index] != 0 ? PAGE_CODE : 0;
+            m_pages[index] = reinterpret_cast<uintptr_t>(m_image->page(index)) | PAGE_NO_WRITE | code;
+        }
+    }
+}
+
+/**
+ * Sets or clears the code tag of a page, stores to untagged pages stay on the fast path
+ * @param index     page number
+ * @param code      true if the page holds valid predecoded instructions
+ */
+void Stack::tagCode (unsigned int index, bool code) {
+    if (code) {
+        __atomic_fetch_or(&m_pages[index], uintptr_t(PAGE_CODE), __ATOMIC_ACQ_REL);
+    } else {
+        __atomic_fetch_and(&m_pages[index], ~uintptr_t(PAGE_CODE), __ATOMIC_ACQ_REL);
+    }
+}
+
+/**
+ * Invalidates the predecoded instructions overwritten by a write, counted by the
+ * current hart, which sees the new instructions at once. Other harts see them
+ * at their next boundary or fence.i.
+ * @param sp        guest address of the first written byte
+ * @param length    number of bytes
+ */
+void Stack::invalidate_code (unsigned int sp, unsigned int length) {
+    unsigned int count = m_code->invalidate(sp, length);
+    Hart *hart = Hart::current();
+    if (hart != nullptr && hart->memory() == this) {
+        hart->statistics()->countInvalidations(count);
+        hart->refreshCode();
+    }
+}
+
+/**
+ * Releases all touched pages, the memory reads as the program image and zeros again
+ * and the instructions are those of the image. Devices stay attached.
+ */
+void Stack::clear () {
+    for (uintptr_t &entry : m_pages) {
+        release(entry);
+        if (!(entry & PAGE_NO_READ)) {
+            entry = zero_entry();
+        }
+    }
+    if (m_mapping != nullptr) {
+        munmap(m_mapping, m_mapping_length);
+        m_mapping = nullptr;
+        m_mapping_length = 0;
+    }
+    m_tracking = false;
+    m_written.clear();
+    map_image();
+    if (m_code != nullptr) {
+        m_code->reset();
+    }
+}
+
+/**
+ * Attaches a memory-mapped device. Pages of the data memory in its range are replaced.
+ * @param base      address of the first register of the device, aligned to a page
+ * @param size      size of the address range in bytes, rounded up to whole pages
+ * @param device    the device
+ */
+void Stack::attach (unsigned int base, unsigned int size, Device *device) {
+    size = (size + PAGE_MASK) & ~PAGE_MASK;
+    m_devices.push_back(mmio_region_t{base, size, device});
+    mmio_region_t *region = &m_devices.back();
+    for (unsigned int offset = 0; offset < size; offset += PAGE_SIZE) {
+        unsigned int index = (base + offset) >> PAGE_BITS;
+        if (index < PAGE_COUNT) {
+            release(m_pages[index]);
+            m_pages[index] = reinterpret_cast<uintptr_t>(region) | PAGE_NO_READ | PAGE_NO_WRITE;
+        } else {
+            m_device_pages[index] = region;
+        }
+    }
+}
+
+/**
+ * Passes the output buffered by the devices to the host
+ */
+void Stack::flush () {
+    for (mmio_region_t &region : m_devices) {
+        region.device->flush();
+    }
+}
 
 void Stack::writeByte (unsigned int sp, unsigned char data) {
-    unsigned int index = stack_pointer_to_index(sp);
-    m_stack.at(index) = data;
+    if (sp < STACK_SIZE) {
+        uintptr_t current = entry(sp);
+        if (!(current & PAGE_SLOW_WRITE)) {
+            page(current)[sp & PAGE_MASK] = data;
+            return;
+        }
+    }
+    store(sp, data, 1);
 }
 
 void Stack::writeHalf (unsigned int sp, unsigned short data) {
-    unsigned int index = stack_pointer_to_index(sp);
-    m_stack.at(index) = data & 0x00FF;
-    m_stack.at(index-1) = (data & 0xFF00) >> 8;
+    if (sp <= STACK_SIZE - 2 && (sp & PAGE_MASK) <= PAGE_SIZE - 2) {
+        uintptr_t current = entry(sp);
+        if (!(current & PAGE_SLOW_WRITE)) {
+            std::memcpy(page(current) + (sp & PAGE_MASK), &data, 2);
+            return;
+        }
+    }
+    store(sp, data, 2);
 }
 
 void Stack::writeWord (unsigned int sp, unsigned int data) {
-    unsigned int index = stack_pointer_to_index(sp);
-    m_stack.at(index) = data & 0x000000FF;
-    m_stack.at(index-1) = (data & 0x0000FF00) >> 8;
-    m_stack.at(index-2) = (data & 0x00FF0000) >> 16;
-    m_stack.at(index-3) = (data & 0xFF000000) >> 24;
+    if (sp <= STACK_SIZE - 4 && (sp & PAGE_MASK) <= PAGE_SIZE - 4) {
+        uintptr_t current = entry(sp);
+        if (!(current & PAGE_SLOW_WRITE)) {
+            std::memcpy(page(current) + (sp & PAGE_MASK), &data, 4);
+            return;
+        }
+    }
+    store(sp, data, 4);
 }
 
-unsigned int Stack::stack_pointer_to_index (unsigned int sp) {
-    return STACK_SIZE - int(sp);
+/**
+ * Throws the exception reported for an access outside of the memory
+ * @param sp    guest address of the access
+ */
+void Stack::out_of_range (unsigned int sp) {
+    throw std::out_of_range("memory access out of range: address = " + std::to_string(sp));
 }
 
 unsigned char Stack::readByte (unsigned int sp) {
-    unsigned int index = stack_pointer_to_index(sp);
-    return m_stack.at(index);
+    if (sp < STACK_SIZE) {
+        uintptr_t current = entry(sp);
+        if (!(current & PAGE_NO_READ)) {
+            return page(current)[sp & PAGE_MASK];
+        }
+    }
+    return load(sp, 1);
 }
 
 unsigned short Stack::readHalf (unsigned int sp) {
-    unsigned int index = stack_pointer_to_index(sp);
-    unsigned short data = m_stack.at(index) + (m_stack.at(index-1) << 8);
-    return data;
+    if (sp <= STACK_SIZE - 2 && (sp & PAGE_MASK) <= PAGE_SIZE - 2) {
+        uintptr_t current = entry(sp);
+        if (!(current & PAGE_NO_READ)) {
+            unsigned short data;
+            std::memcpy(&data, page(current) + (sp & PAGE_MASK), 2);
+            return data;
+        }
+    }
+    return load(sp, 2);
 }
 
 unsigned int Stack::readWord (unsigned int sp) {
-    unsigned int index = stack_pointer_to_index(sp);
-    unsigned int data = m_stack.at(index) + (m_stack.at(index-1) << 8) + (m_stack.at(index-2) << 16) + (m_stack.at(index-3) << 24);
-    return data;
+    if (sp <= STACK_SIZE - 4 && (sp & PAGE_MASK) <= PAGE_SIZE - 4) {
+        uintptr_t current = entry(sp);
+        if (!(current & PAGE_NO_READ)) {
+            unsigned int data;
+            std::memcpy(&data, page(current) + (sp & PAGE_MASK), 4);
+            return data;
+        }
+    }
+    return load(sp, 4);
+}
+
+/**
+ * Copies a block of guest memory starting at address sp
+ * @param sp        guest address of the first byte
+ * @param data      destination buffer
+ * @param length    number of bytes
+ */
+void Stack::readBlock (unsigned int sp, unsigned char *data, unsigned int length) {
+    if (length == 0) {
+        return;
+    }
+    if (length > STACK_END) {
+        out_of_range(sp);
+    }
+    check_range(sp, length);
+    read(sp, data, length);
+}
+
+/**
+ * Writes a block of guest memory starting at address sp
+ * @param sp        guest address of the first byte
+ * @param data      source buffer
+ * @param length    number of bytes
+ */
+void Stack::writeBlock (unsigned int sp, const unsigned char *data, unsigned int length) {
+    if (length == 0) {
+        return;
+    }
+    if (length > STACK_END) {
+        out_of_range(sp);
+    }
+    check_range(sp, length);
+    write(sp, data, length);
+}
+
+/**
+ * Gets host word backing the guest word for an atomic load, the page is neither
+ * allocated nor recorded as written
+ * @param sp    guest address, must be aligned to 4 bytes
+ * @return      pointer to the host word
+ */
+const unsigned int *Stack::atomicRead (unsigned int sp) {
+    check_range(sp, 4);
+    uintptr_t current = entry(sp);
+    if (current & PAGE_NO_READ) {
+        throw std::out_of_range("atomic access to device memory: address = " + std::to_string(sp));
+    }
+    return reinterpret_cast<const unsigned int *>(page(current) + (sp & PAGE_MASK));
+}
+
+/**
+ * Gets host word backing the guest word for an atomic read-modify-write,
+ * atomicWritten must follow once the word is written
+ * @param sp    guest address, must be aligned to 4 bytes
+ * @return      pointer to the host word
+ */
+unsigned int *Stack::atomicWord (unsigned int sp) {
+    check_range(sp, 4);
+    if (entry(sp) & PAGE_NO_READ) {
+        throw std::out_of_range("atomic access to device memory: address = " + std::to_string(sp));
+    }
+    return reinterpret_cast<unsigned int *>(write_page(sp) + (sp & PAGE_MASK));
+}
+
+/**
+ * Invalidates the predecoded instruction overwritten by an atomic write, only
+ * after the write, so it is predecoded again from the new value
+ * @param sp    guest address of the written word
+ */
+void Stack::atomicWritten (unsigned int sp) {
+    if (entry(sp) & PAGE_CODE) {
+        invalidate_code(sp, 4);
+    }
+}
+
+/**
+ * Starts recording the pages written from now on. The owned pages are write-protected,
+ * so their first write leaves the fast path and is recorded like the first write to an
+ * untouched page. Recording stops when the memory is cleared.
+ */
+void Stack::trackWrites () {
+    auto protect = [this] (unsigned int index) {
+        uintptr_t current = __atomic_load_n(&m_pages[index], __ATOMIC_ACQUIRE);
+        if (owned(current) && !(current & PAGE_NO_READ)) {
+            __atomic_fetch_or(&m_pages[index], uintptr_t(PAGE_NO_WRITE | PAGE_TRACKED), __ATOMIC_ACQ_REL);
+        }
+    };
+    if (m_tracking) {
+        // the other owned pages are still protected
+        for (uint32_t index : m_written) {
+            protect(index);
+        }
+    } else {
+        for (unsigned int index = 0; index < PAGE_COUNT; index++) {
+            protect(index);
+        }
+        m_tracking = true;
+    }
+    m_written.clear();
+}
+
+/**
+ * Compares the data memory with another one, devices are not compared. If both
+ * memories record their writes, only the pages written by either of them since
+ * trackWrites are compared.
+ * @param other the other memory
+ * @return      address of the first differing byte, STACK_END if there is none
+ */
+unsigned int Stack::compare (const Stack &other) const {
+    if (!m_tracking || !other.m_tracking) {
+        for (unsigned int index = 0; index < PAGE_COUNT; index++) {
+            unsigned int offset = compare_page(other, index);
+            if (offset != PAGE_SIZE) {
+                return index << PAGE_BITS | offset;
+            }
+        }
+        return STACK_END;
+    }
+    std::vector<uint32_t> written(m_written);
+    written.insert(written.end(), other.m_written.begin(), other.m_written.end());
+    std::sort(written.begin(), written.end());
+    written.erase(std::unique(written.begin(), written.end()), written.end());
+    for (uint32_t index : written) {
+        unsigned int offset = compare_page(other, index);
+        if (offset != PAGE_SIZE) {
+            return index << PAGE_BITS | offset;
+        }
+    }
+    return STACK_END;
+}
+
+/**
+ * Compares a page with the same page of another memory
+ * @param other the other memory
+ * @param index page number
+ * @return      offset of the first differing byte, PAGE_SIZE if there is none
+ */
+unsigned int Stack::compare_page (const Stack &other, unsigned int index) const {
+    uintptr_t mine = __atomic_load_n(&m_pages[index], __ATOMIC_ACQUIRE);
+    uintptr_t theirs = __atomic_load_n(&other.m_pages[index], __ATOMIC_ACQUIRE);
+    if (page(mine) == page(theirs) || ((mine | theirs) & PAGE_NO_READ)
+        || std::memcmp(page(mine), page(theirs), PAGE_SIZE) == 0) {
+        return PAGE_SIZE;
+    }
+    const unsigned char *a = page(mine);
+    const unsigned char *b = page(theirs);
+    unsigned int offset = 0;
+    while (a[offset] == b[offset]) {
+        offset++;
+    }
+    return offset;
+}
+
+/**
+ * Counts the pages allocated by writes, image pages count once they are copied
+ * @return  number of pages
+ */
+unsigned int Stack::pagesTouched () const {
+    unsigned int count = 0;
+    for (uintptr_t entry : m_pages) {
+        count += owned(entry);
+    }
+    return count;
+}
+
+/**
+ * @param index     page number
+ * @return          contents of the page if it was touched, nullptr otherwise
+ */
+const unsigned char *Stack::touchedPage (unsigned int index) const {
+    uintptr_t current = __atomic_load_n(&m_pages[index], __ATOMIC_ACQUIRE);
+    return owned(current) ? page(current) : nullptr;
+}
+
+/**
+ * Writes the touched pages and the registers of the devices into a snapshot
+ * @param out   snapshot stream
+ */
+void Stack::save (std::ostream &out) const {
+    save_value(out, pagesTouched());
+    for (unsigned int index = 0; index < PAGE_COUNT; index++) {
+        const unsigned char *data = touchedPage(index);
+        if (data != nullptr) {
+            save_value(out, index);
+            out.write(reinterpret_cast<const char *>(data), PAGE_SIZE);
+        }
+    }
+    saveDevices(out);
+}
+
+/**
+ * Replaces the contents of the memory by a snapshot taken with the same devices attached
+ * @param in    snapshot stream
+ */
+void Stack::restore (std::istream &in) {
+    clear();
+    unsigned int count = 0;
+    restore_value(in, count);
+    for (unsigned int i = 0; i < count; i++) {
+        unsigned int index = 0;
+        restore_value(in, index);
+        unsigned char *data = write_page(index << PAGE_BITS);
+        in.read(reinterpret_cast<char *>(data), PAGE_SIZE);
+        // instructions predecoded from the image may differ from the restored ones,
+        // a code page only touched by stores into its data is left as it is
+        if (m_code != nullptr && (m_pages[index] & PAGE_CODE)
+            && std::memcmp(data, m_image->page(index), PAGE_SIZE) != 0) {
+            m_code->invalidate(index << PAGE_BITS, PAGE_SIZE);
+        }
+    }
+    restoreDevices(in);
+}
+
+/**
+ * Writes the registers of the devices into a snapshot
+ * @param out   snapshot stream
+ */
+void Stack::saveDevices (std::ostream &out) const {
+    for (const mmio_region_t &region : m_devices) {
+        region.device->save(out);
+    }
+}
+
+/**
+ * Reads the registers of the devices from a snapshot taken with the same devices attached
+ * @param in    snapshot stream
+ */
+void Stack::restoreDevices (std::istream &in) {
+    for (mmio_region_t &region : m_devices) {
+        region.device->restore(in);
+    }
+}
+
+/**
+ * Maps a host buffer into the memory in place of its pages, like the pages of the program
+ * image they are read-only and copied on the first write. Until the memory is cleared
+ * the buffer must stay allocated and its changes are visible to the program.
+ * @param sp        guest address of the first page, aligned to a page
+ * @param data      the buffer, aligned to a page
+ * @param length    length of the buffer, whole pages
+ */
+void Stack::mapReadOnly (unsigned int sp, const unsigned char *data, unsigned int length) {
+    check_range(sp, length);
+    for (unsigned int offset = 0; offset < length; offset += PAGE_SIZE) {
+        unsigned int index = (sp + offset) >> PAGE_BITS;
+        if (!(m_pages[index] & PAGE_NO_READ)) {
+            release(m_pages[index]);
+            m_pages[index] = reinterpret_cast<uintptr_t>(data + offset) | PAGE_NO_WRITE;
+        }
+    }
+}
+
+/**
+ * Replaces the contents of the memory by pages of a mapped checkpoint. The pages are
+ * used in place, the memory owns the mapping until it is cleared.
+ * @param mapping   private writable mapping of the checkpoint
+ * @param length    length of the mapping in bytes
+ * @param indices   page numbers of the pages
+ * @param count     number of pages
+ * @param pages     first page inside of the mapping, the others follow it
+ */
+void Stack::mapPages (void *mapping, size_t length, const uint32_t *indices, unsigned int count, unsigned char *pages) {
+    clear();
+    m_mapping = mapping;
+    m_mapping_length = length;
+    for (unsigned int i = 0; i < count; i++) {
+        uintptr_t current = m_pages[indices[i]];
+        if (current & PAGE_NO_READ) {
+            continue;
+        }
+        m_pages[indices[i]] = reinterpret_cast<uintptr_t>(pages + i * PAGE_SIZE) | (current & PAGE_CODE);
+        // instructions predecoded from the image may differ from the mapped ones
+        if (m_code != nullptr && (current & PAGE_CODE)
+            && std::memcmp(pages + i * PAGE_SIZE, m_image->page(indices[i]), PAGE_SIZE) != 0) {
+            m_code->invalidate(indices[i] << PAGE_BITS, PAGE_SIZE);
+        }
+    }
 }
 
 Stack *Stack::getInstance () {
@@ -54,5 +691,3 @@ Stack *Stack::getInstance () {
     }
     return instance;
 }
-
-
@@ -6,20 +6,113 @@
 #define ISA_SIM_CPP_STACK_H
 
 #include <array>
+#include <cstdint>
+#include <deque>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+#include "device.h"
 
-#define STACK_SIZE 0x100000
+class ProgramImage;
+class CodeMemory;
 
+#define STACK_SIZE  0x100000
+#define STACK_END   (STACK_SIZE + 1)            // addresses 0 to STACK_SIZE are valid, the last one as in the reversed layout
+#define PAGE_BITS   12
+#define PAGE_SIZE   (1u << PAGE_BITS)
+#define PAGE_MASK   (PAGE_SIZE - 1)
+#define PAGE_COUNT  (STACK_SIZE / PAGE_SIZE + 1)    // the last page holds address STACK_SIZE
+
+// tags in the low bits of page table entries, tagged accesses leave the fast path
+#define PAGE_NO_WRITE   0x1u        // untouched page (shared zero or image page) or device
+#define PAGE_NO_READ    0x2u        // device
+#define PAGE_CODE       0x4u        // page holding valid predecoded instructions, writes invalidate them
+#define PAGE_TRACKED    0x8u        // owned page, write-protected until its first write since trackWrites
+#define PAGE_TAGS       (PAGE_NO_WRITE | PAGE_NO_READ | PAGE_CODE | PAGE_TRACKED)
+#define PAGE_SLOW_WRITE (PAGE_NO_WRITE | PAGE_CODE)
+
+/**
+ * Address range of a memory-mapped device, whole pages
+ */
+typedef struct {
+    unsigned int base;
+    unsigned int size;
+    Device *device;
+} mmio_region_t;
+
+/**
+ * Data memory of a guest, shared by all its harts. The memory is split into
+ * pages which are allocated on the first write, untouched pages read as zero,
+ * so a small program only pays for the pages it actually uses. The pages of the
+ * program image are mapped read-only from the image shared by all its instances
+ * and copied on the first write. Pages of a checkpoint are used in place from its
+ * private mapping, which the host kernel copies on write. Writes to pages holding
+ * predecoded instructions invalidate them in the code memory of the guest.
+ * Bytes are stored in guest (little-endian) order at their own address, so aligned
+ * guest words are aligned host words and can be accessed with host atomic instructions.
+ * Devices are mapped at page granularity, inside or above the data memory.
+ */
 class Stack {
 private:
-    //TODO: ask about stack size - maybe static
-    std::array<unsigned char, STACK_SIZE> m_stack;
+    std::array<uintptr_t, PAGE_COUNT> m_pages;  // page address or tagged entry
+    std::deque<mmio_region_t> m_devices;
+    std::unordered_map<unsigned int, mmio_region_t*> m_device_pages;    // pages above the data memory
+    std::shared_ptr<const ProgramImage> m_image;
+    std::unique_ptr<CodeMemory> m_code;
+    void *m_mapping;                            // mapped checkpoint holding pages, or nullptr
+    size_t m_mapping_length;
+    bool m_tracking;                            // writes are recorded, see trackWrites
+    std::vector<uint32_t> m_written;            // pages written since trackWrites
     static Stack *instance;
 
-    static unsigned int stack_pointer_to_index (unsigned int sp);
-    Stack ();
+    static void check_range (unsigned int sp, unsigned int length) {
+        if (sp > STACK_END - length) {
+            out_of_range(sp);
+        }
+    }
+    [[noreturn]] static void out_of_range (unsigned int sp);
+
+    uintptr_t entry (unsigned int sp) const {
+        return __atomic_load_n(&m_pages[sp >> PAGE_BITS], __ATOMIC_ACQUIRE);
+    }
+    static unsigned char *page (uintptr_t entry) {
+        return reinterpret_cast<unsigned char *>(entry & ~uintptr_t(PAGE_TAGS));
+    }
+    static bool owned (uintptr_t entry) {
+        return !(entry & PAGE_NO_WRITE) || (entry & PAGE_TRACKED);
+    }
+    static uintptr_t zero_entry () {
+        return reinterpret_cast<uintptr_t>(zero_page) | PAGE_NO_WRITE;
+    }
+    void release (uintptr_t entry);
+    void map_image ();
+    void invalidate_code (unsigned int sp, unsigned int length);
+    unsigned char *allocate (unsigned int index, uintptr_t expected);
+    unsigned char *write_page (unsigned int sp);
+    unsigned int compare_page (const Stack &other, unsigned int index) const;
+    void read (unsigned int sp, void *data, unsigned int length);
+    void write (unsigned int sp, const void *data, unsigned int length);
+    unsigned int load (unsigned int sp, unsigned int length);
+    void store (unsigned int sp, unsigned int data, unsigned int length);
+    mmio_region_t *find_device (unsigned int sp, unsigned int length);
+    static unsigned int device_read (mmio_region_t *region, unsigned int sp, unsigned int length);
+
+    alignas(64) static const unsigned char zero_page[PAGE_SIZE];
 
 public:
+    Stack ();
+    ~Stack ();
+    Stack (const Stack &) = delete;
+    Stack &operator= (const Stack &) = delete;
     static Stack *getInstance ();
+    void loadImage (std::shared_ptr<const ProgramImage> image);
+    CodeMemory *code () { return m_code.get(); }
+    void tagCode (unsigned int index, bool code);
+    void clear ();
+    void attach (unsigned int base, unsigned int size, Device *device);
+    void flush ();
     void writeByte (unsigned int sp, unsigned char data);
     void writeHalf (unsigned int sp, unsigned short data);
     void writeWord (unsigned int sp, unsigned int data);
@@ -27,6 +120,23 @@ public:
     unsigned char  readByte (unsigned int sp);
     unsigned short readHalf (unsigned int sp);
     unsigned int   readWord (unsigned int sp);
+
+    void readBlock (unsigned int sp, unsigned char *data, unsigned int length);
+    void writeBlock (unsigned int sp, const unsigned char *data, unsigned int length);
+
+    const unsigned int *atomicRead (unsigned int sp);
+    unsigned int *atomicWord (unsigned int sp);
+    void atomicWritten (unsigned int sp);
+    void trackWrites ();
+    unsigned int compare (const Stack &other) const;
+    unsigned int pagesTouched () const;
+    const unsigned char *touchedPage (unsigned int index) const;
+    void save (std::ostream &out) const;
+    void restore (std::istream &in);
+    void saveDevices (std::ostream &out) const;
+    void restoreDevices (std::istream &in);
+    void mapReadOnly (unsigned int sp, const unsigned char *data, unsigned int length);
+    void mapPages (void *mapping, size_t length, const uint32_t *indices, unsigned int count, unsigned char *pages);
 };
 
 
@@ -0,0 +1,88 @@
+// stack_distance.cpp
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#include <algorithm>
+#include "stack_distance.h"
+
+/**
+ * Stack distance constructor
+ * @param keys  number of keys, accessed keys must be lower
+ */
+StackDistance::StackDistance (unsigned int keys) : m_last(keys, 0), m_tree(2 * std::max(keys, 1u) + 1, 0) {
+    m_time = 0;
+}
+
+/**
+ * Forgets all accesses
+ */
+void StackDistance::clear () {
+    std::fill(m_last.begin(), m_last.end(), 0);
+    std::fill(m_tree.begin(), m_tree.end(), 0);
+    m_time = 0;
+}
+
+/**
+ * Records an access
+ * @param key   accessed key
+ * @return      number of distinct keys accessed since the last access of key,
+ *              STACK_DISTANCE_COLD if it is the first one
+ */
+unsigned int StackDistance::access (unsigned int key) {
+    if (m_time + 1 == m_tree.size()) {
+        compact();
+    }
+    unsigned int now = ++m_time;
+    unsigned int last = m_last[key];
+    unsigned int distance = STACK_DISTANCE_COLD;
+    if (last != 0) {
+        distance = count(now - 1) - count(last);
+        mark(last, -1);
+    }
+    mark(now, 1);
+    m_last[key] = now;
+    return distance;
+}
+
+/**
+ * Adds to the mark at a point of time
+ * @param time  point of time, from 1
+ * @param delta added value
+ */
+void StackDistance::mark (unsigned int time, int delta) {
+    for (; time < m_tree.size(); time += time & -time) {
+        m_tree[time] += delta;
+    }
+}
+
+/**
+ * @param time  point of time
+ * @return      number of marks up to and including time
+ */
+unsigned int StackDistance::count (unsigned int time) const {
+    int sum = 0;
+    for (; time != 0; time -= time & -time) {
+        sum += m_tree[time];
+    }
+    return (unsigned int)sum;
+}
+
+/**
+ * Renumbers the latest accesses from 1 in their order, which keeps the distances.
+ * At most half of the time axis stays in use.
+ */
+void StackDistance::compact () {
+    std::vector<unsigned int> keys;
+    for (unsigned int key = 0; key < m_last.size(); key++) {
+        if (m_last[key] != 0) {
+            keys.push_back(key);
+        }
+    }
+    std::sort(keys.begin(), keys.end(), [this] (unsigned int a, unsigned int b) { return m_last[a] < m_last[b]; });
+    std::fill(m_tree.begin(), m_tree.end(), 0);
+    m_time = 0;
+    for (unsigned int key : keys) {
+        m_last[key] = ++m_time;
+        mark(m_time, 1);
+    }
+}
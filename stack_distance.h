@@ -0,0 +1,37 @@
+// stack_distance.h
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#ifndef ISA_SIM_CPP_STACK_DISTANCE_H
+#define ISA_SIM_CPP_STACK_DISTANCE_H
+
+#include <vector>
+
+#define STACK_DISTANCE_COLD (~0u)       // first access of a key
+
+/**
+ * LRU stack distance (reuse distance) of a stream of accesses to a fixed set of
+ * keys: the number of distinct other keys accessed since the previous access of
+ * the same key. An access with distance d hits in a fully associative LRU cache
+ * of more than d entries. Instead of walking the LRU stack, the latest access of
+ * every key is marked in a Fenwick tree indexed by time, so the distance is the
+ * number of marks after the previous access, found in logarithmic time. The time
+ * axis is compacted when it runs out, which costs linear time once per as many accesses.
+ */
+class StackDistance {
+public:
+    explicit StackDistance (unsigned int keys);
+    unsigned int access (unsigned int key);
+    void clear ();
+private:
+    void mark (unsigned int time, int delta);
+    unsigned int count (unsigned int time) const;
+    void compact ();
+
+    std::vector<unsigned int> m_last;       // time of the latest access of every key, 0 if none
+    std::vector<int> m_tree;                // Fenwick tree of the marks, indexed from 1
+    unsigned int m_time;
+};
+
+
+#endif //ISA_SIM_CPP_STACK_DISTANCE_H
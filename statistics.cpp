@@ -0,0 +1,96 @@
+// statistics.cpp
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#include <iostream>
+#include <iomanip>
+#include "statistics.h"
+#include "snapshot.h"
+
+bool Statistics::s_enabled = false;
+
+/**
+ * Statistics constructor
+ */
+Statistics::Statistics () {
+    m_instructions = 0;
+    m_interrupts = 0;
+    m_invalidations = 0;
+    m_fusions.fill(0);
+}
+
+/**
+ * Enables printing of the statistics at the end of simulation
+ */
+void Statistics::enable () {
+    s_enabled = true;
+}
+
+/**
+ * @return  true if statistics should be printed
+ */
+bool Statistics::isEnabled () {
+    return s_enabled;
+}
+
+/**
+ * Adds counters of another instance to this one
+ * @param other statistics of another hart
+ */
+void Statistics::add (const Statistics &other) {
+    m_instructions += other.m_instructions;
+    m_interrupts += other.m_interrupts;
+    m_invalidations += other.m_invalidations;
+    for (unsigned long i = 0; i < FUSE_COUNT; i++) {
+        m_fusions[i] += other.m_fusions[i];
+    }
+}
+
+/**
+ * Print out the collected statistics
+ */
+void Statistics::print () {
+    unsigned long long fused = 0;
+    for (unsigned long i = FUSE_NONE + 1; i < FUSE_COUNT; i++) {
+        fused += m_fusions[i];
+    }
+
+    std::cout << "\033[1mStatistics:\033[0m\n";
+    std::cout << "Executed instructions:  " << std::dec << m_instructions << "\n";
+    std::cout << "Fused pairs:            " << fused << "\n";
+    for (unsigned long i = FUSE_NONE + 1; i < FUSE_COUNT; i++) {
+        std::cout << "  " << std::setfill(' ') << std::left << std::setw(22) << MacroFusion::name(fusion_t(i)) << std::right
+                  << m_fusions[i] << "\n";
+    }
+    // hit rate = share of executed instructions that were part of a fused pair
+    double rate = m_instructions ? 100.0 * double(2 * fused) / double(m_instructions) : 0.0;
+    std::cout << "Fusion hit rate:        " << std::fixed << std::setprecision(2) << rate << "%\n";
+    if (m_interrupts != 0) {
+        std::cout << "Interrupts taken:       " << m_interrupts << "\n";
+    }
+    if (m_invalidations != 0) {
+        std::cout << "Code invalidations:     " << m_invalidations << "\n";
+    }
+}
+
+/**
+ * Writes the counters into a snapshot
+ * @param out   snapshot stream
+ */
+void Statistics::save (std::ostream &out) const {
+    save_value(out, m_instructions);
+    save_value(out, m_interrupts);
+    save_value(out, m_invalidations);
+    save_value(out, m_fusions);
+}
+
+/**
+ * Reads the counters from a snapshot
+ * @param in    snapshot stream
+ */
+void Statistics::restore (std::istream &in) {
+    restore_value(in, m_instructions);
+    restore_value(in, m_interrupts);
+    restore_value(in, m_invalidations);
+    restore_value(in, m_fusions);
+}
@@ -0,0 +1,41 @@
+// statistics.h
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#ifndef ISA_SIM_CPP_STATISTICS_H
+#define ISA_SIM_CPP_STATISTICS_H
+
+#include <array>
+#include <istream>
+#include <ostream>
+#include "macro_fusion.h"
+
+/**
+ * Execution statistics printed at the end of simulation.
+ * Every hart counts into its own instance, they are summed up when printed.
+ */
+class Statistics {
+public:
+    Statistics ();
+    static void enable ();
+    static bool isEnabled ();
+    void countInstruction () { m_instructions++; }
+    void countFusion (fusion_t kind) { m_instructions += 2; m_fusions[kind]++; }
+    void countInterrupt () { m_interrupts++; }
+    void countInvalidations (unsigned int count) { m_invalidations += count; }
+    unsigned long long instructions () const { return m_instructions; }
+    void add (const Statistics &other);
+    void print ();
+    void save (std::ostream &out) const;
+    void restore (std::istream &in);
+private:
+    static bool s_enabled;
+
+    unsigned long long m_instructions;
+    unsigned long long m_interrupts;
+    unsigned long long m_invalidations;         // predecoded instructions invalidated by stores
+    std::array<unsigned long long, FUSE_COUNT> m_fusions;
+};
+
+
+#endif //ISA_SIM_CPP_STATISTICS_H
@@ -0,0 +1,513 @@
+// syscall_handler.cpp
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <linux/openat2.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include "syscall_handler.h"
+#include "replay_log.h"
+#include "snapshot.h"
+
+int SyscallHandler::sandbox = -1;
+
+/**
+ * Checks that a buffer of the program lies in the data memory
+ * @param address   guest address of the buffer
+ * @param length    number of bytes
+ * @return          true if the whole buffer is in the data memory
+ */
+static bool in_memory (unsigned int address, unsigned int length) {
+    return length <= STACK_END && address <= STACK_END - length;
+}
+
+/**
+ * System call handler constructor, the descriptors 0 to 2 are the standard streams of the host
+ * @param image_size    size of the program image at the start of the data memory
+ */
+SyscallHandler::SyscallHandler (unsigned int image_size) {
+    files = {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO};
+    heap_base = std::max(HEAP_BASE, (image_size + PAGE_MASK) & ~PAGE_MASK);
+    heap_end = heap_base;
+}
+
+SyscallHandler::~SyscallHandler () {
+    for (int file : files) {
+        if (file > STDERR_FILENO) {
+            close(file);
+        }
+    }
+}
+
+/**
+ * Selects the directory the programs may open files in
+ * @param path  the path to the directory
+ * @return      true if successful otherwise false
+ */
+bool SyscallHandler::setSandbox (const char *path) {
+    int fd = open(path, O_PATH | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    if (sandbox >= 0) {
+        close(sandbox);
+    }
+    sandbox = fd;
+    return true;
+}
+
+/**
+ * Executes the system call selected by a7. Results and the memory written by
+ * the calls are recorded, a replay takes them from the log and only repeats
+ * the output to the standard streams.
+ * @param reg       registers of the calling hart
+ * @param memory    data memory of the calling hart
+ * @param term      termination of the calling hart, used by exit
+ * @return          false if a7 does not hold a supported system call number
+ */
+bool SyscallHandler::call (RegisterFile *reg, Stack *memory, Termination *term) {
+    unsigned int number = reg->read(RegisterFile::x17);
+    switch (number) {
+        case SYS_EXIT:
+        case SYS_EXIT_GROUP:
+            // the buffered output is passed to the host by the termination
+            term->guestExit("Exit system call reached - exit code: " + std::to_string(int(reg->read(RegisterFile::x10))),
+                            int(reg->read(RegisterFile::x10) & 0xFFu));
+        case SYS_OPENAT:
+        case SYS_CLOSE:
+        case SYS_LSEEK:
+        case SYS_READ:
+        case SYS_WRITE:
+        case SYS_FSTAT:
+        case SYS_CLOCK_GETTIME:
+        case SYS_GETTIMEOFDAY:
+        case SYS_BRK:
+            break;
+        default:
+            return false;
+    }
+
+    std::lock_guard<std::mutex> guard(lock);
+    ReplayLog *log = ReplayLog::active();
+    int result;
+    if (log != nullptr && log->replaying()) {
+        int file = host_file(int(reg->read(RegisterFile::x10)));
+        if (number == SYS_WRITE && (file == STDOUT_FILENO || file == STDERR_FILENO)) {
+            execute(number, reg, memory);
+        }
+        log->replayMemory(memory);
+        result = int(log->replayValue(REPLAY_SYSCALL));
+    } else {
+        result = execute(number, reg, memory);
+        if (log != nullptr) {
+            log->recordValue(REPLAY_SYSCALL, (unsigned int)(result));
+        }
+    }
+    reg->write(RegisterFile::x10, (unsigned int)(result));
+    return true;
+}
+
+/**
+ * Executes a system call on the host
+ * @param number    system call number
+ * @param reg       registers of the calling hart
+ * @param memory    data memory of the calling hart
+ * @return          result of the call
+ */
+int SyscallHandler::execute (unsigned int number, RegisterFile *reg, Stack *memory) {
+    unsigned int a0 = reg->read(RegisterFile::x10);
+    unsigned int a1 = reg->read(RegisterFile::x11);
+    unsigned int a2 = reg->read(RegisterFile::x12);
+    unsigned int a3 = reg->read(RegisterFile::x13);
+    int result;
+
+    switch (number) {
+        case SYS_OPENAT:
+            result = sys_openat(memory, int(a0), a1, a2, a3);
+            break;
+        case SYS_CLOSE:
+            result = sys_close(int(a0));
+            break;
+        case SYS_LSEEK:
+            result = sys_lseek(int(a0), int(a1), int(a2));
+            break;
+        case SYS_READ:
+            result = sys_read(memory, int(a0), a1, a2);
+            break;
+        case SYS_WRITE:
+            result = sys_write(memory, int(a0), a1, a2);
+            break;
+        case SYS_FSTAT:
+            result = sys_fstat(memory, int(a0), a1);
+            break;
+        case SYS_CLOCK_GETTIME:
+            result = sys_clock_gettime(memory, int(a0), a1);
+            break;
+        case SYS_GETTIMEOFDAY:
+            result = sys_gettimeofday(memory, a0);
+            break;
+        default:
+            result = int(sys_brk(a0, reg->read(RegisterFile::x2)));
+            break;
+    }
+    return result;
+}
+
+/**
+ * Writes the result of a system call into the data memory, the bytes are recorded
+ * @param memory    data memory
+ * @param address   guest address of the first byte
+ * @param data      the bytes
+ * @param length    number of bytes
+ */
+void SyscallHandler::store (Stack *memory, unsigned int address, const void *data, unsigned int length) {
+    memory->writeBlock(address, static_cast<const unsigned char *>(data), length);
+    ReplayLog *log = ReplayLog::active();
+    if (log != nullptr) {
+        log->recordMemory(address, data, length);
+    }
+}
+
+/**
+ * Writes the program break into a snapshot, open files are not part of it
+ * @param out   snapshot stream
+ */
+void SyscallHandler::save (std::ostream &out) const {
+    save_value(out, heap_end);
+}
+
+/**
+ * Reads the program break from a snapshot
+ * @param in    snapshot stream
+ */
+void SyscallHandler::restore (std::istream &in) {
+    restore_value(in, heap_end);
+}
+
+/**
+ * Closes the files opened by the program, passes its buffered output
+ * to the host and moves the program break back to the start of the heap
+ */
+void SyscallHandler::reset () {
+    flush();
+    std::lock_guard<std::mutex> guard(lock);
+    for (int file : files) {
+        if (file > STDERR_FILENO) {
+            close(file);
+        }
+    }
+    files = {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO};
+    heap_end = heap_base;
+}
+
+/**
+ * Passes the buffered standard output and error to the host
+ */
+void SyscallHandler::flush () {
+    std::lock_guard<std::mutex> guard(lock);
+    flush_output(STDOUT_FILENO);
+    flush_output(STDERR_FILENO);
+}
+
+/**
+ * Writes the buffered output of a standard stream to the host in one system call
+ * @param fd    STDOUT_FILENO or STDERR_FILENO
+ */
+void SyscallHandler::flush_output (int fd) {
+    std::vector<char> &buffer = output[fd - STDOUT_FILENO];
+    if (buffer.empty()) {
+        return;
+    }
+    // the simulator messages written so far go first
+    std::cout.flush();
+    const char *data = buffer.data();
+    size_t length = buffer.size();
+    while (length != 0) {
+        ssize_t written = ::write(fd, data, length);
+        if (written <= 0) {
+            break;
+        }
+        data += written;
+        length -= size_t(written);
+    }
+    buffer.clear();
+}
+
+/**
+ * Gets the host descriptor of a guest descriptor
+ * @param fd    guest descriptor
+ * @return      host descriptor or -1 if the descriptor is not open
+ */
+int SyscallHandler::host_file (int fd) const {
+    if (fd < 0 || (unsigned int)(fd) >= files.size()) {
+        return -1;
+    }
+    return files[fd];
+}
+
+/**
+ * Opens a file of the sandbox. Absolute paths start at the sandbox directory,
+ * neither .. nor symbolic links lead out of it.
+ * @param memory    data memory holding the path
+ * @param dirfd     only GUEST_AT_FDCWD is supported
+ * @param path      guest address of the path
+ * @param flags     flags of the RISC-V Linux ABI
+ * @param mode      permissions of a created file
+ * @return          guest descriptor or negative error number
+ */
+int SyscallHandler::sys_openat (Stack *memory, int dirfd, unsigned int path, unsigned int flags, unsigned int mode) {
+    if (dirfd != GUEST_AT_FDCWD) {
+        return -EBADF;
+    }
+    std::string name;
+    try {
+        for (unsigned int c = memory->readByte(path); c != 0; c = memory->readByte(++path)) {
+            if (name.size() == PATH_MAX) {
+                return -ENAMETOOLONG;
+            }
+            name.push_back(char(c));
+        }
+    } catch (const std::out_of_range &e) {
+        return -EFAULT;
+    }
+    if (sandbox < 0 && !setSandbox(".")) {
+        return -EACCES;
+    }
+
+    open_how how{};
+    how.flags = (flags & GUEST_O_ACCMODE) | O_CLOEXEC;
+    how.flags |= flags & GUEST_O_CREAT ? O_CREAT : 0;
+    how.flags |= flags & GUEST_O_EXCL ? O_EXCL : 0;
+    how.flags |= flags & GUEST_O_TRUNC ? O_TRUNC : 0;
+    how.flags |= flags & GUEST_O_APPEND ? O_APPEND : 0;
+    how.mode = flags & GUEST_O_CREAT ? mode & 0777u : 0;
+    how.resolve = RESOLVE_IN_ROOT | RESOLVE_NO_MAGICLINKS;
+    int file = int(syscall(SYS_openat2, sandbox, name.c_str(), &how, sizeof(how)));
+    if (file < 0) {
+        return -errno;
+    }
+
+    // the lowest free descriptor is used
+    auto it = std::find(files.begin(), files.end(), -1);
+    if (it == files.end() && files.size() == FILES_MAX) {
+        close(file);
+        return -EMFILE;
+    }
+    if (it == files.end()) {
+        files.push_back(file);
+        return int(files.size() - 1);
+    }
+    *it = file;
+    return int(it - files.begin());
+}
+
+/**
+ * Closes a descriptor, the standard streams of the host stay open
+ * @param fd    guest descriptor
+ * @return      0 or negative error number
+ */
+int SyscallHandler::sys_close (int fd) {
+    int file = host_file(fd);
+    if (file < 0) {
+        return -EBADF;
+    }
+    files[fd] = -1;
+    if (file > STDERR_FILENO && close(file) != 0) {
+        return -errno;
+    }
+    return 0;
+}
+
+/**
+ * Moves the offset of an open file
+ * @param fd        guest descriptor
+ * @param offset    new offset relative to whence
+ * @param whence    SEEK_SET, SEEK_CUR or SEEK_END
+ * @return          new offset or negative error number
+ */
+int SyscallHandler::sys_lseek (int fd, int offset, int whence) {
+    int file = host_file(fd);
+    if (file < 0) {
+        return -EBADF;
+    }
+    if (file == STDOUT_FILENO || file == STDERR_FILENO) {
+        flush_output(file);
+    }
+    off_t position = lseek(file, offset, whence);
+    if (position < 0) {
+        return -errno;
+    }
+    return position > INT_MAX ? -EOVERFLOW : int(position);
+}
+
+/**
+ * Reads from an open file into the data memory
+ * @param memory    data memory
+ * @param fd        guest descriptor
+ * @param buffer    guest address of the buffer
+ * @param length    size of the buffer
+ * @return          number of bytes read or negative error number
+ */
+int SyscallHandler::sys_read (Stack *memory, int fd, unsigned int buffer, unsigned int length) {
+    int file = host_file(fd);
+    if (file < 0) {
+        return -EBADF;
+    }
+    if (!in_memory(buffer, length)) {
+        return -EFAULT;
+    }
+    if (file == STDIN_FILENO) {
+        // a program reading input usually printed a prompt before
+        flush_output(STDOUT_FILENO);
+        flush_output(STDERR_FILENO);
+    }
+    std::vector<unsigned char> data(length);
+    ssize_t count = ::read(file, data.data(), length);
+    if (count < 0) {
+        return -errno;
+    }
+    store(memory, buffer, data.data(), (unsigned int)(count));
+    return int(count);
+}
+
+/**
+ * Writes from the data memory to an open file, the standard output and error are buffered
+ * @param memory    data memory
+ * @param fd        guest descriptor
+ * @param buffer    guest address of the data
+ * @param length    number of bytes
+ * @return          number of bytes written or negative error number
+ */
+int SyscallHandler::sys_write (Stack *memory, int fd, unsigned int buffer, unsigned int length) {
+    int file = host_file(fd);
+    if (file < 0) {
+        return -EBADF;
+    }
+    if (!in_memory(buffer, length)) {
+        return -EFAULT;
+    }
+    if (file == STDOUT_FILENO || file == STDERR_FILENO) {
+        std::vector<char> &stream = output[file - STDOUT_FILENO];
+        if (stream.capacity() < OUTPUT_BUFFER_SIZE) {
+            stream.reserve(OUTPUT_BUFFER_SIZE);
+        }
+        size_t size = stream.size();
+        stream.resize(size + length);
+        memory->readBlock(buffer, reinterpret_cast<unsigned char *>(stream.data() + size), length);
+        if (stream.size() >= OUTPUT_BUFFER_SIZE) {
+            flush_output(file);
+        }
+        return int(length);
+    }
+    std::vector<unsigned char> data(length);
+    memory->readBlock(buffer, data.data(), length);
+    ssize_t count = ::write(file, data.data(), length);
+    return count < 0 ? -errno : int(count);
+}
+
+/**
+ * Writes the status of an open file into the data memory
+ * @param memory    data memory
+ * @param fd        guest descriptor
+ * @param buffer    guest address of the guest_stat_t structure
+ * @return          0 or negative error number
+ */
+int SyscallHandler::sys_fstat (Stack *memory, int fd, unsigned int buffer) {
+    static_assert(sizeof(guest_stat_t) == 128, "guest_stat_t must match the RISC-V layout");
+    int file = host_file(fd);
+    if (file < 0) {
+        return -EBADF;
+    }
+    if (!in_memory(buffer, sizeof(guest_stat_t))) {
+        return -EFAULT;
+    }
+    struct stat info{};
+    if (fstat(file, &info) != 0) {
+        return -errno;
+    }
+    guest_stat_t status{};
+    status.dev = info.st_dev;
+    status.ino = info.st_ino;
+    status.mode = info.st_mode;
+    status.nlink = (uint32_t)(info.st_nlink);
+    status.uid = info.st_uid;
+    status.gid = info.st_gid;
+    status.rdev = info.st_rdev;
+    status.size = info.st_size;
+    status.blksize = (int32_t)(info.st_blksize);
+    status.blocks = info.st_blocks;
+    status.atim = {info.st_atim.tv_sec, int32_t(info.st_atim.tv_nsec), 0};
+    status.mtim = {info.st_mtim.tv_sec, int32_t(info.st_mtim.tv_nsec), 0};
+    status.ctim = {info.st_ctim.tv_sec, int32_t(info.st_ctim.tv_nsec), 0};
+    store(memory, buffer, &status, sizeof(status));
+    return 0;
+}
+
+/**
+ * Writes the time of a host clock into the data memory as struct timespec
+ * with a 64-bit tv_sec and a 32-bit tv_nsec
+ * @param memory    data memory
+ * @param clock     clock id of Linux
+ * @param buffer    guest address of the structure
+ * @return          0 or negative error number
+ */
+int SyscallHandler::sys_clock_gettime (Stack *memory, int clock, unsigned int buffer) {
+    if (clock < CLOCK_REALTIME || clock > CLOCK_BOOTTIME) {
+        return -EINVAL;
+    }
+    if (!in_memory(buffer, 16)) {
+        return -EFAULT;
+    }
+    timespec now{};
+    if (clock_gettime(clock, &now) != 0) {
+        return -errno;
+    }
+    int64_t value[2] = {now.tv_sec, now.tv_nsec};
+    store(memory, buffer, value, sizeof(value));
+    return 0;
+}
+
+/**
+ * Writes the time of the host into the data memory as struct timeval
+ * with a 64-bit tv_sec and a 32-bit tv_usec, the time zone is not supported
+ * @param memory    data memory
+ * @param buffer    guest address of the structure, may be 0
+ * @return          0 or negative error number
+ */
+int SyscallHandler::sys_gettimeofday (Stack *memory, unsigned int buffer) {
+    if (buffer == 0) {
+        return 0;
+    }
+    if (!in_memory(buffer, 16)) {
+        return -EFAULT;
+    }
+    timeval now{};
+    gettimeofday(&now, nullptr);
+    int64_t value[2] = {now.tv_sec, now.tv_usec};
+    store(memory, buffer, value, sizeof(value));
+    return 0;
+}
+
+/**
+ * Moves the program break. The heap starts at HEAP_BASE or after the image
+ * and may grow up to the stack pointer, its pages are allocated on the first write.
+ * @param address   requested break, 0 queries the current one
+ * @param sp        stack pointer of the calling hart
+ * @return          the new break, or the old one if the request failed
+ */
+unsigned int SyscallHandler::sys_brk (unsigned int address, unsigned int sp) {
+    if (address >= heap_base && address <= STACK_SIZE && (sp == 0 || address <= sp)) {
+        heap_end = address;
+    }
+    return heap_end;
+}
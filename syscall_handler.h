@@ -0,0 +1,111 @@
+// syscall_handler.h
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#ifndef ISA_SIM_CPP_SYSCALL_HANDLER_H
+#define ISA_SIM_CPP_SYSCALL_HANDLER_H
+
+#include <istream>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "register_file.h"
+#include "stack.h"
+#include "termination.h"
+
+// system call numbers of the RISC-V Linux ABI, passed in a7
+#define SYS_OPENAT          56
+#define SYS_CLOSE           57
+#define SYS_LSEEK           62
+#define SYS_READ            63
+#define SYS_WRITE           64
+#define SYS_FSTAT           80
+#define SYS_EXIT            93
+#define SYS_EXIT_GROUP      94
+#define SYS_CLOCK_GETTIME   113
+#define SYS_GETTIMEOFDAY    169
+#define SYS_BRK             214
+
+// flags of openat in the RISC-V Linux ABI
+#define GUEST_O_ACCMODE     0x3u
+#define GUEST_O_CREAT       0x40u
+#define GUEST_O_EXCL        0x80u
+#define GUEST_O_TRUNC       0x200u
+#define GUEST_O_APPEND      0x400u
+
+#define GUEST_AT_FDCWD      -100
+#define HEAP_BASE           0x80000u        // lowest program break, flat binaries carry no size of .bss
+#define OUTPUT_BUFFER_SIZE  0x10000u
+#define FILES_MAX           64
+
+/**
+ * struct stat of 32-bit RISC-V newlib and Linux
+ */
+typedef struct {
+    uint64_t dev;
+    uint64_t ino;
+    uint32_t mode;
+    uint32_t nlink;
+    uint32_t uid;
+    uint32_t gid;
+    uint64_t rdev;
+    uint64_t pad1;
+    int64_t size;
+    int32_t blksize;
+    int32_t pad2;
+    int64_t blocks;
+    struct {
+        int64_t sec;
+        int32_t nsec;
+        int32_t pad;
+    } atim, mtim, ctim;
+    int32_t reserved[2];
+} guest_stat_t;
+
+/**
+ * System calls of newlib and Linux programs: a7 holds the call number, a0 to a3
+ * the arguments and a0 receives the result or a negative error number.
+ * Writes to the standard output and error are collected in buffers and passed
+ * to the host in one system call each, when the buffer is full, before the
+ * program reads the standard input and at the end of simulation.
+ * Files are opened only inside of the sandbox directory, which the program sees as its root.
+ * One handler is shared by all harts of a guest.
+ */
+class SyscallHandler {
+public:
+    explicit SyscallHandler (unsigned int image_size);
+    ~SyscallHandler ();
+    SyscallHandler (const SyscallHandler &) = delete;
+    SyscallHandler &operator= (const SyscallHandler &) = delete;
+    static bool setSandbox (const char *path);
+    bool call (RegisterFile *reg, Stack *memory, Termination *term);
+    void flush ();
+    void reset ();
+    void save (std::ostream &out) const;
+    void restore (std::istream &in);
+private:
+    int execute (unsigned int number, RegisterFile *reg, Stack *memory);
+    static void store (Stack *memory, unsigned int address, const void *data, unsigned int length);
+    int sys_openat (Stack *memory, int dirfd, unsigned int path, unsigned int flags, unsigned int mode);
+    int sys_close (int fd);
+    int sys_lseek (int fd, int offset, int whence);
+    int sys_read (Stack *memory, int fd, unsigned int buffer, unsigned int length);
+    int sys_write (Stack *memory, int fd, unsigned int buffer, unsigned int length);
+    int sys_fstat (Stack *memory, int fd, unsigned int buffer);
+    int sys_clock_gettime (Stack *memory, int clock, unsigned int buffer);
+    int sys_gettimeofday (Stack *memory, unsigned int buffer);
+    unsigned int sys_brk (unsigned int address, unsigned int sp);
+    int host_file (int fd) const;
+    void flush_output (int fd);
+
+    static int sandbox;
+    std::mutex lock;
+    std::vector<int> files;                     // host descriptors of the guest descriptors, -1 if closed
+    std::vector<char> output[2];                // buffered standard output and error
+    unsigned int heap_base;
+    unsigned int heap_end;
+};
+
+
+#endif //ISA_SIM_CPP_SYSCALL_HANDLER_H
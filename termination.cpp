@@ -4,21 +4,136 @@
 
 #include <iostream>
 #include "termination.h"
+#include "statistics.h"
+#include "hart.h"
+#include "guest_scheduler.h"
+#include "syscall_handler.h"
+#include "replay_log.h"
+#include "memory_profiler.h"
+#include "cache_analyzer.h"
+#include "loop_profiler.h"
 
+/**
+ * Stops the hart executing the current instruction. The simulation ends
+ * once the scheduler of the harts catches the reason and calls finish.
+ * @param msg       message printed at the end of simulation
+ * @param exit_code exit code of the simulator
+ */
 void Termination::terminate (const std::string &msg, int exit_code) {
-    registerFile->dump_registers();
-    if (exit_code == 0) {
+    throw halt_t{msg, exit_code, false};
+}
+
+/**
+ * Stops the hart on the request of the guest program, with an exit code of
+ * its choice (a clean exit, even when the code is nonzero)
+ * @param msg       message printed at the end of simulation
+ * @param exit_code exit code of the guest and the simulator
+ */
+void Termination::guestExit (const std::string &msg, int exit_code) {
+    throw halt_t{msg, exit_code, true};
+}
+
+/**
+ * Prints the result of simulation, dumps the register files and exits
+ * @param harts     all harts of the simulation
+ * @param halted    hart whose termination ended the simulation
+ */
+void Termination::finish (const std::vector<Hart*> &harts, unsigned int halted) {
+    const halt_t &halt = harts[halted]->halt();
+    std::string msg = harts.size() > 1 ? "Hart " + std::to_string(halted) + ": " + halt.msg : halt.msg;
+
+    // output of the program written by system calls and to the devices precedes the result
+    if (harts[0]->syscalls() != nullptr) {
+        harts[0]->syscalls()->flush();
+    }
+    harts[0]->memory()->flush();
+    if (ReplayLog::active() != nullptr) {
+        ReplayLog::active()->close();
+    }
+
+    // hart 0 is dumped into output.res, the others into output_hart<i>.res
+    harts[0]->registers()->dump_registers();
+    for (unsigned long i = 1; i < harts.size(); i++) {
+        harts[i]->registers()->dump_registers("./output_hart" + std::to_string(i) + ".res");
+    }
+
+    if (halt.exit_code == 0) {
         std::cout << "\x1B[1;32m" << msg << "\x1B[0m\r\n\r\n";
-        registerFile->print_registers();
-        exit(0);
     } else {
         std::cerr << "\x1B[1;31m" << msg << "\x1B[0m\r\n";
-        std::cerr << "\x1B[1;31mTerminated with exit code: " << std::dec << int(exit_code) << "\x1B[0m\r\n\r\n";
-        registerFile->print_registers();
-        exit(exit_code);
+        std::cerr << "\x1B[1;31mTerminated with exit code: " << std::dec << int(halt.exit_code) << "\x1B[0m\r\n\r\n";
     }
+    for (Hart *hart : harts) {
+        if (harts.size() > 1) {
+            std::cout << "\033[1mHart " << std::dec << hart->id() << "\033[0m\n";
+        }
+        hart->registers()->print_registers();
+    }
+    print_statistics(harts);
+    MemoryProfiler::finish();
+    CacheAnalyzer::finish();
+    LoopProfiler::finish();
+    exit(halt.exit_code);
+}
+
+/**
+ * Print out the execution statistics if they were requested
+ * @param harts all harts of the simulation
+ */
+void Termination::print_statistics (const std::vector<Hart*> &harts) {
+    if (!Statistics::isEnabled()) {
+        return;
+    }
+    Statistics total;
+    std::cout << "\n";
+    for (Hart *hart : harts) {
+        total.add(*hart->statistics());
+        if (harts.size() > 1) {
+            std::cout << "Hart " << std::dec << hart->id() << " instructions:  " << hart->statistics()->instructions() << "\n";
+        }
+    }
+    total.print();
 }
 
-Termination::Termination () {
-    registerFile = RegisterFile::getInstance();
+/**
+ * Prints the result of every guest, dumps their register files into
+ * output_guest<i>.res files and exits with the first non-zero exit code
+ * @param guests    all guests of the simulation
+ * @param scheduler scheduler which executed the guests
+ */
+void Termination::finishGuests (const std::vector<Guest*> &guests, const GuestScheduler &scheduler) {
+    int exit_code = 0;
+    Statistics total;
+    unsigned long long pages = 0;
+    for (unsigned long i = 0; i < guests.size(); i++) {
+        Hart *hart = guests[i]->hart();
+        const halt_t &halt = hart->halt();
+        hart->registers()->dump_registers("./output_guest" + std::to_string(i) + ".res");
+        total.add(*hart->statistics());
+        pages += guests[i]->memory()->pagesTouched();
+        // the output of a guest is printed as one block before its result
+        hart->syscalls()->flush();
+
+        if (halt.exit_code == 0) {
+            std::cout << "\x1B[1;32mGuest " << std::dec << i << ": " << halt.msg << "\x1B[0m\r\n";
+        } else {
+            std::cout << "\x1B[1;31mGuest " << std::dec << i << ": " << halt.msg
+                      << " (exit code " << halt.exit_code << ")\x1B[0m\r\n";
+            if (exit_code == 0) {
+                exit_code = halt.exit_code;
+            }
+        }
+    }
+
+    if (Statistics::isEnabled()) {
+        std::cout << "\n";
+        total.print();
+        std::cout << "Guest switches:         " << scheduler.switches() << "\n";
+        std::cout << "Stolen guests:          " << scheduler.steals() << "\n";
+        std::cout << "Touched pages:          " << pages << " (" << pages * PAGE_SIZE / 1024 << " KiB)\n";
+    }
+    MemoryProfiler::finish();
+    CacheAnalyzer::finish();
+    LoopProfiler::finish();
+    exit(exit_code);
 }
@@ -6,14 +6,31 @@
 #define ISA_SIM_CPP_TERMINATION_H
 
 
+#include <string>
+#include <vector>
 #include "register_file.h"
 
+class Hart;
+class Guest;
+class GuestScheduler;
+
+/**
+ * Reason of hart termination, thrown by Termination::terminate
+ */
+typedef struct {
+    std::string msg;
+    int exit_code;
+    bool guest_exit;        // the guest asked to exit, the exit code is its own and not a fault
+} halt_t;
+
 class Termination {
 private:
-    RegisterFile *registerFile;
+    static void print_statistics (const std::vector<Hart*> &harts);
 public:
-    Termination ();
-    void terminate (const std::string& msg, int exit_code);
+    [[noreturn]] void terminate (const std::string& msg, int exit_code);
+    [[noreturn]] void guestExit (const std::string& msg, int exit_code);
+    [[noreturn]] static void finish (const std::vector<Hart*> &harts, unsigned int halted);
+    [[noreturn]] static void finishGuests (const std::vector<Guest*> &guests, const GuestScheduler &scheduler);
 };
 
 
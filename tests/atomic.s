@@ -0,0 +1,76 @@
+# atomic.s
+# Two harts (--harts 2) increment a shared counter 1000 times each by LR.W/SC.W,
+# hart 1 then signals hart 0, which checks every AMO on one word, LR.W/SC.W
+# success and failure and an AMO rewriting an instruction.
+# a1..a6, s2..s4 = values returned by the AMOs, s5 = final word, s6 = LR.W,
+# s7 = 0 (SC.W succeeds), s8 = 1 (no reservation), s9 = 9 stored by SC.W,
+# s10 = 1 (reservation of another word), s11 = 2000, t3 = 2 (rewritten addi).
+
+        la      s0, counter
+        li      t2, 1000
+inc:
+        lr.w    t0, (s0)
+        addi    t0, t0, 1
+        sc.w    t1, t0, (s0)
+        bnez    t1, inc
+        addi    t2, t2, -1
+        bnez    t2, inc
+
+        la      t0, done
+        beqz    a0, wait
+        li      t1, 1
+        amoadd.w x0, t1, (t0)
+1:      j       1b
+wait:
+        lw      t1, 0(t0)
+        beqz    t1, wait
+
+        la      s1, word
+        li      t0, 5
+        sw      t0, 0(s1)
+        li      t1, 7
+        amoswap.w a1, t1, (s1)          # 5, word = 7
+        li      t1, 3
+        amoadd.w a2, t1, (s1)           # 7, word = 10
+        li      t1, 0xF
+        amoxor.w a3, t1, (s1)           # 10, word = 5
+        li      t1, -4
+        amoand.w a4, t1, (s1)           # 5, word = 4
+        li      t1, 0x30
+        amoor.w a5, t1, (s1)            # 4, word = 0x34
+        li      t1, -1
+        amomin.w a6, t1, (s1)           # 0x34, word = -1
+        li      t1, 2
+        amomax.w s2, t1, (s1)           # -1, word = 2
+        li      t1, -1
+        amominu.w s3, t1, (s1)          # 2, word = 2
+        amomaxu.w s4, t1, (s1)          # 2, word = 0xFFFFFFFF
+        lw      s5, 0(s1)
+
+        lr.w    s6, (s1)
+        li      t1, 9
+        sc.w    s7, t1, (s1)
+        sc.w    s8, t1, (s1)
+        lw      s9, 0(s1)
+        lr.w    t0, (s1)
+        sc.w    s10, t1, (s0)
+        lw      s11, 0(s0)
+
+        la      t0, patch
+        li      t1, 0x00200E13          # addi t3, x0, 2
+        amoswap.w x0, t1, (t0)
+        fence.i
+patch:
+        addi    t3, x0, 1
+
+        li      a7, 0
+        li      a0, 10
+        ecall
+
+        .p2align 2
+counter:
+        .word   0
+done:
+        .word   0
+word:
+        .word   0
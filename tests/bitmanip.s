@@ -0,0 +1,40 @@
+# bitmanip.s
+# Every instruction of the Zba and Zbb extensions on fixed operands.
+# s0 = 0x12345678, s1 = 0xF0F00F0F (negative), s2 = 5, t2 = 0x000080F0,
+# the results are checked in a1..a6, s3..s11, t3..t6, gp and tp.
+
+        li      s0, 0x12345678
+        li      s1, 0xF0F00F0F
+        li      s2, 5
+        li      t2, 0x80F0
+
+        sh1add  a1, s2, s0              # 0x12345682
+        sh2add  a2, s2, s0              # 0x1234568C
+        sh3add  a3, s2, s0              # 0x123456A0
+
+        andn    a4, s0, s1              # 0x02045070
+        orn     a5, s0, s1              # 0x1F3FF6F8
+        xnor    a6, s0, s1              # 0x1D3BA688
+
+        min     tp, s0, s1              # 0xF0F00F0F, signed
+        minu    s3, s0, s1              # 0x12345678
+        max     s4, s0, s1              # 0x12345678, signed
+        maxu    s5, s0, s1              # 0xF0F00F0F
+
+        rol     s6, s0, s2              # 0x468ACF02
+        ror     s7, s0, s2              # 0xC091A2B3
+        rori    t5, s0, 12              # 0x67812345
+
+        zext.h  s8, s1                  # 0x00000F0F
+        sext.b  t3, t2                  # 0xFFFFFFF0
+        sext.h  t4, t2                  # 0xFFFF80F0
+
+        clz     s9, s0                  # 3
+        ctz     s10, s0                 # 3
+        cpop    s11, s0                 # 13
+        orc.b   t6, t2                  # 0x0000FFFF
+        rev8    gp, s0                  # 0x78563412
+
+        li      a7, 0
+        li      a0, 10
+        ecall
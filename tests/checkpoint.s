@@ -0,0 +1,22 @@
+# checkpoint.s
+# Sums 1..100 into memory, takes a checkpoint by the marker ecall and then
+# adds 1000 to the sum loaded back from memory.
+# a1 = 5050 + 1000 = 6050, a2 = 5050 as stored before the checkpoint.
+
+        li      s0, 0x9000
+        li      t0, 100
+sum:
+        lw      t1, 0(s0)
+        add     t1, t1, t0
+        sw      t1, 0(s0)
+        addi    t0, t0, -1
+        bnez    t0, sum
+
+        li      a0, 0x100               # checkpoint marker
+        li      a7, 0
+        ecall
+
+        lw      a2, 0(s0)
+        addi    a1, a2, 1000
+        li      a0, 10
+        ecall
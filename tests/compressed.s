@@ -0,0 +1,38 @@
+# compressed.s
+# Mixed 16-bit and 32-bit code: sums the words of a table by a compressed loop
+# with a compressed call, stores and loads through the stack pointer.
+# a1 = 1 + 2 + ... + 8 = 36, a2 = 8 calls, a3 = 36 reloaded from the stack,
+# a4 = 8 counted down by a 32-bit branch at a halfword aligned address.
+
+        .option rvc
+        li      sp, 0x8000
+        la      s0, table
+        c.li    s1, 8
+        c.li    a4, 0
+loop:
+        c.lw    a5, 0(s0)
+        c.add   a1, a5
+        c.jal   count
+        c.addi  s0, 4
+        c.addi  s1, -1
+        c.bnez  s1, loop
+
+        c.swsp  a1, 12(sp)
+        c.lwsp  a3, 12(sp)
+        c.li    s1, 8
+down:
+        .option norvc
+        addi    a4, a4, 1
+        addi    s1, s1, -1
+        bne     s1, x0, down
+        .option rvc
+        c.li    a0, 10
+        ecall
+
+count:
+        c.addi  a2, 1
+        c.jr    ra
+
+        .balign 4
+table:
+        .word   1, 2, 3, 4, 5, 6, 7, 8
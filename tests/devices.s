@@ -0,0 +1,40 @@
+# devices.s
+# UART and block device (--disk disk.img, two sectors): reads sector 1 into
+# the memory and writes its first line to the UART, which passes it to the
+# standard output at the end. Reading sector 2 is beyond the image.
+# a1 = capacity 2, a2 = status 0, a3 = first word of sector 1 ("Hell"),
+# a4 = status 1 of the read beyond the image, a5 = line status THRE | TEMT.
+
+        li      s0, 0x10001000          # block device
+        li      s1, 0x10000000          # UART
+        li      s2, 0x9000              # buffer
+
+        lw      a1, 0x14(s0)            # capacity
+        li      t0, 1
+        sw      t0, 0x00(s0)            # sector
+        sw      s2, 0x04(s0)            # address
+        sw      t0, 0x08(s0)            # count
+        sw      t0, 0x0C(s0)            # read
+        lw      a2, 0x10(s0)            # status
+        lw      a3, 0(s2)
+
+        li      t1, 10
+        mv      t2, s2
+print:
+        lbu     t0, 0(t2)
+        sb      t0, 0(s1)               # transmit holding register
+        addi    t2, t2, 1
+        bne     t0, t1, print
+
+        li      t0, 2
+        sw      t0, 0x00(s0)
+        li      t0, 1
+        sw      t0, 0x0C(s0)
+        lw      a4, 0x10(s0)
+
+        lbu     a5, 5(s1)               # line status
+        andi    a5, a5, 0x60
+
+        li      a7, 0
+        li      a0, 10
+        ecall
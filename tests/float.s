@@ -0,0 +1,97 @@
+# float.s
+# F and D extensions: NaN boxing, the canonical NaN, fflags, static and dynamic
+# rounding modes, saturating conversions to integers and FMIN/FMAX with signed
+# zeros and NaNs. The results are moved into integer registers:
+# a1 = single read from an unboxed double, a2 = upper word of a boxed single,
+# a3/a4 = 0/0 and its flags, a5/a6/s2 = 1/3 rounded rtz/rup/dynamic rdn,
+# s3 = inexact flag, t0 = frm, s4..s8 = saturated conversions, s9 = their flags,
+# s10/s11 = FMIN/FMAX of signed zeros, t3/t4 = FMIN with a signaling NaN and
+# its flags, t5 = FMAX of two NaNs, t6/gp = 2.5 converted rne/rmm, tp = 1.5
+# converted to single, s1 = upper word of 1.0 converted to double.
+
+        la      s0, data
+
+        # an unboxed double read as a single is the canonical NaN
+        fld     f1, 8(s0)               # 1.5
+        fadd.s  f2, f1, f1
+        fmv.x.w a1, f2                  # 0x7FC00000
+        flw     f3, 0(s0)               # 1.0
+        fsd     f3, 48(s0)
+        lw      a2, 52(s0)              # 0xFFFFFFFF
+
+        # 0/0 is invalid and gives the canonical NaN
+        fsflags x0
+        fmv.w.x f4, x0
+        fdiv.s  f5, f4, f4
+        fmv.x.w a3, f5                  # 0x7FC00000
+        frflags a4                      # NV = 0x10
+
+        # 1/3 in the static rounding modes and in the dynamic one
+        fsflags x0
+        flw     f7, 4(s0)               # 3.0
+        fdiv.s  f6, f3, f7, rtz
+        fmv.x.w a5, f6                  # 0x3EAAAAAA
+        fdiv.s  f6, f3, f7, rup
+        fmv.x.w a6, f6                  # 0x3EAAAAAB
+        fsrmi   2                       # rdn
+        fdiv.s  f6, f3, f7
+        fmv.x.w s2, f6                  # 0x3EAAAAAA
+        frflags s3                      # NX = 0x01
+        frrm    t0                      # 2
+        fsrmi   0
+
+        # conversions to integers saturate
+        fsflags x0
+        flw     f8, 16(s0)              # 3e9
+        fcvt.w.s s4, f8, rtz            # 0x7FFFFFFF
+        fcvt.wu.s s5, f8, rtz           # 0xB2D05E00
+        flw     f8, 20(s0)              # 5e9
+        fcvt.wu.s s6, f8, rtz           # 0xFFFFFFFF
+        flw     f8, 24(s0)              # -3e9
+        fcvt.wu.s s7, f8, rtz           # 0
+        fcvt.w.s s8, f5, rtz            # NaN: 0x7FFFFFFF
+        frflags s9                      # NV = 0x10
+
+        # FMIN and FMAX order the zeros and return the number for one NaN
+        flw     f9, 28(s0)              # -0.0
+        fmv.w.x f10, x0                 # +0.0
+        fmin.s  f11, f10, f9
+        fmv.x.w s10, f11                # 0x80000000
+        fmax.s  f11, f9, f10
+        fmv.x.w s11, f11                # 0x00000000
+        fsflags x0
+        flw     f12, 32(s0)             # signaling NaN
+        fmin.s  f11, f12, f3
+        fmv.x.w t3, f11                 # 0x3F800000
+        frflags t4                      # NV = 0x10
+        flw     f13, 36(s0)             # quiet NaN with a payload
+        fmax.s  f11, f13, f13
+        fmv.x.w t5, f11                 # 0x7FC00000
+
+        # double precision conversions
+        fld     f14, 40(s0)             # 2.5
+        fcvt.w.d t6, f14, rne           # 2
+        fcvt.w.d gp, f14, rmm           # 3
+        fcvt.s.d f15, f1
+        fmv.x.w tp, f15                 # 0x3FC00000
+        fcvt.d.s f16, f3
+        fsd     f16, 48(s0)
+        lw      s1, 52(s0)              # 0x3FF00000
+
+        li      a7, 0
+        li      a0, 10
+        ecall
+
+        .p2align 3
+data:
+        .word   0x3F800000              # 0: 1.0
+        .word   0x40400000              # 4: 3.0
+        .word   0x00000000, 0x3FF80000  # 8: 1.5
+        .word   0x4F32D05E              # 16: 3e9
+        .word   0x4F9502F9              # 20: 5e9
+        .word   0xCF32D05E              # 24: -3e9
+        .word   0x80000000              # 28: -0.0
+        .word   0x7F800001              # 32: signaling NaN
+        .word   0x7FC12345              # 36: quiet NaN
+        .word   0x00000000, 0x40040000  # 40: 2.5
+        .word   0, 0                    # 48: buffer
@@ -0,0 +1,34 @@
+# fusion.s
+# Runs every instruction pair recognized by macro-op fusion in a loop.
+# a1 = 10 * 0x12345678, a2 = 10 * 0x5678 (low halfword),
+# a3 = 10 * word at data, a4 = 10 calls returned through auipc + jalr.
+
+        li      t0, 10
+loop:
+        lui     t1, 0x12345             # FUSE_LUI_ADDI
+        addi    t1, t1, 0x678
+        add     a1, a1, t1
+
+        slli    t2, t1, 16              # FUSE_SLLI_SRLI
+        srli    t2, t2, 16
+        add     a2, a2, t2
+
+1:      auipc   t3, %pcrel_hi(data)     # FUSE_AUIPC_LW
+        lw      t3, %pcrel_lo(1b)(t3)
+        add     a3, a3, t3
+
+2:      auipc   ra, %pcrel_hi(count)    # FUSE_AUIPC_JALR
+        jalr    ra, %pcrel_lo(2b)(ra)
+
+        addi    t0, t0, -1
+        bnez    t0, loop
+
+        li      a0, 10
+        ecall
+
+count:
+        addi    a4, a4, 1
+        ret
+
+data:
+        .word   0x00000007
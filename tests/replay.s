@@ -0,0 +1,32 @@
+# replay.s
+# Reads the time twice and writes a line, so a recorded run and its replay
+# must agree on the nanoseconds in a1 and a2 and on the output.
+# a3 = 0 if the time did not go backwards.
+
+        li      sp, 0xF0000
+        li      a0, 1                   # clock_gettime(CLOCK_MONOTONIC, 0x9000)
+        li      a1, 0x9000
+        li      a7, 113
+        ecall
+        li      a0, 1                   # write(stdout, line, 16)
+        la      a1, line
+        li      a2, 16
+        li      a7, 64
+        ecall
+        li      a0, 1                   # clock_gettime(CLOCK_MONOTONIC, 0x9010)
+        li      a1, 0x9010
+        li      a7, 113
+        ecall
+
+        li      t0, 0x9000
+        lw      a1, 8(t0)               # nanoseconds of both times
+        lw      a2, 24(t0)
+        lw      t1, 0(t0)               # low words of the seconds
+        lw      t2, 16(t0)
+        sltu    a3, t2, t1
+        li      a7, 0                   # not a system call number
+        li      a0, 10
+        ecall
+
+line:
+        .ascii  "replayed output\n"
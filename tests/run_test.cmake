@@ -0,0 +1,52 @@
+# run_test.cmake
+# Runs the simulator on a guest program in the current directory and checks
+# its exit code and output. Every line of the EXPECT file must appear in the
+# standard output or error. SAVE copies the registers dumped into RESULT
+# (output.res by default) into the given file, COMPARE fails unless they equal
+# the given file.
+# Usage: cmake -DSIM=<isa_sim_cpp> -DEXIT=<code> -DEXPECT=<file> [-DRESULT=<file>]
+#              [-DSAVE=<file>] [-DCOMPARE=<file>] -P run_test.cmake -- <options> <binary>
+
+set(args)
+set(collect FALSE)
+math(EXPR last "${CMAKE_ARGC} - 1")
+foreach(i RANGE ${last})
+    if (collect)
+        list(APPEND args "${CMAKE_ARGV${i}}")
+    elseif ("${CMAKE_ARGV${i}}" STREQUAL "--")
+        set(collect TRUE)
+    endif ()
+endforeach ()
+
+if (NOT RESULT)
+    set(RESULT output.res)
+endif ()
+
+file(REMOVE ${RESULT})
+execute_process(COMMAND ${SIM} ${args}
+                RESULT_VARIABLE code
+                OUTPUT_VARIABLE out
+                ERROR_VARIABLE err)
+set(output "${out}${err}")
+
+if (NOT "${code}" STREQUAL "${EXIT}")
+    message(FATAL_ERROR "Exit code ${code}, expected ${EXIT}\n${output}")
+endif ()
+
+file(STRINGS ${EXPECT} lines)
+foreach(line IN LISTS lines)
+    string(FIND "${output}" "${line}" found)
+    if (found EQUAL -1)
+        message(FATAL_ERROR "Missing in the output: ${line}\n${output}")
+    endif ()
+endforeach ()
+
+if (SAVE)
+    execute_process(COMMAND ${CMAKE_COMMAND} -E copy ${RESULT} ${SAVE})
+endif ()
+if (COMPARE)
+    execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files ${RESULT} ${COMPARE} RESULT_VARIABLE differ)
+    if (differ)
+        message(FATAL_ERROR "Registers differ from ${COMPARE}\n${output}")
+    endif ()
+endif ()
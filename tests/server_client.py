@@ -0,0 +1,35 @@
+#!/usr/bin/env python3
+# server_client.py
+# Starts the simulation server on a socket in the current directory, sends it
+# the requests over one connection and prints every field of every answer on
+# its own line, prefixed by the number of the request.
+# Usage: server_client.py <path_to_isa_sim_cpp> <request>...
+
+import os
+import socket
+import subprocess
+import sys
+import time
+
+SOCKET = "server.sock"
+
+if os.path.exists(SOCKET):
+    os.remove(SOCKET)
+server = subprocess.Popen([sys.argv[1], "--serve", SOCKET], stdout=subprocess.DEVNULL)
+try:
+    for _ in range(100):
+        if os.path.exists(SOCKET):
+            break
+        time.sleep(0.05)
+    client = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    client.connect(SOCKET)
+    stream = client.makefile("rw")
+    for number, request in enumerate(sys.argv[2:], 1):
+        stream.write(request + "\n")
+        stream.flush()
+        for field in stream.readline().split():
+            print("%d: %s" % (number, field))
+    client.close()
+finally:
+    server.terminate()
+    server.wait()
@@ -0,0 +1,33 @@
+# simt.s
+# Lanes diverging at data-dependent branches: every lane counts the Collatz
+# steps of its x11 into a2, lanes of an odd index take the other side of an
+# if-else and all of them add a4 = a3 + 1 after reconverging.
+# a3 = 3 * index for odd lanes, index / 2 for even ones.
+
+        li      a2, 0
+        li      t1, 1
+collatz:
+        beq     a1, t1, counted
+        andi    t0, a1, 1
+        beqz    t0, even
+        slli    t2, a1, 1
+        add     a1, a1, t2
+        addi    a1, a1, 1
+        j       next
+even:
+        srli    a1, a1, 1
+next:
+        addi    a2, a2, 1
+        j       collatz
+counted:
+        andi    t0, a0, 1
+        beqz    t0, half
+        slli    a3, a0, 1
+        add     a3, a3, a0
+        j       join
+half:
+        srli    a3, a0, 1
+join:
+        addi    a4, a3, 1
+        li      a0, 10
+        ecall
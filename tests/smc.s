@@ -0,0 +1,27 @@
+# smc.s
+# Self-modifying code: runs a loop three times, overwrites its addi with
+# addi a1, a1, 100, executes fence.i and runs the loop twice more.
+# a1 = 3 * 1 + 2 * 100 = 203, a2 = 5 iterations.
+
+        li      s0, 3
+        li      s1, 2
+again:
+        la      s2, patch
+loop:
+patch:
+        addi    a1, a1, 1
+        addi    a2, a2, 1
+        addi    s0, s0, -1
+        bnez    s0, loop
+        beqz    s1, done
+
+        li      t0, 0x06458593          # addi a1, a1, 100
+        sw      t0, 0(s2)
+        fence.i
+        mv      s0, s1
+        li      s1, 0
+        j       again
+
+done:
+        li      a0, 10
+        ecall
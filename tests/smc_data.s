@@ -0,0 +1,40 @@
+# smc_data.s
+# Stores into a page of data in the binary are not stores into the code: a
+# page of zeros is filled with data, then with a function returning 7, which
+# runs after fence.i. One addi is patched as well, its 3 entries are the only
+# invalidated ones. a1 = 1 + 100 by the patched addi, a3 = 7.
+
+        la      s0, buffer
+        li      t0, 1024
+        mv      t1, s0
+fill:
+        sw      t0, 0(t1)
+        addi    t1, t1, 4
+        addi    t0, t0, -1
+        bnez    t0, fill
+
+        li      t0, 0x00700693          # addi a3, x0, 7
+        sw      t0, 0(s0)
+        li      t0, 0x00008067          # jalr x0, 0(ra)
+        sw      t0, 4(s0)
+        fence.i
+        jalr    ra, 0(s0)
+
+        li      s1, 2
+loop:
+patch:
+        addi    a1, a1, 1
+        addi    s1, s1, -1
+        beqz    s1, done
+        la      t0, patch
+        li      t1, 0x06458593          # addi a1, a1, 100
+        sw      t1, 0(t0)
+        fence.i
+        j       loop
+done:
+        li      a0, 10
+        ecall
+
+        .p2align 12
+buffer:
+        .zero   4096
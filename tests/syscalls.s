@@ -0,0 +1,72 @@
+# syscalls.s
+# Writes a line to the standard output, writes it into a file of the sandbox,
+# reads it back and writes the copy to the standard output, then moves the
+# program break and exits with code 3 by the exit system call.
+# s1 = bytes read back (21), s2 = 0x1000 added to the break, s3 = 0 from clock_gettime.
+
+        li      sp, 0xF0000
+        li      a0, 1                   # write(stdout, line, 21)
+        la      a1, line
+        li      a2, 21
+        li      a7, 64
+        ecall
+
+        li      a0, -100                # openat(AT_FDCWD, name, O_RDWR | O_CREAT | O_TRUNC, 0644)
+        la      a1, name
+        li      a2, 0x242
+        li      a3, 0644
+        li      a7, 56
+        ecall
+        mv      s0, a0
+
+        la      a1, line                # write(fd, line, 21)
+        li      a2, 21
+        li      a7, 64
+        ecall
+
+        mv      a0, s0                  # lseek(fd, 0, SEEK_SET)
+        li      a1, 0
+        li      a2, 0
+        li      a7, 62
+        ecall
+
+        mv      a0, s0                  # read(fd, buffer, 64)
+        li      a1, 0x9000
+        li      a2, 64
+        li      a7, 63
+        ecall
+        mv      s1, a0
+
+        mv      a0, s0                  # close(fd)
+        li      a7, 57
+        ecall
+
+        li      a0, 1                   # write(stdout, buffer, s1)
+        li      a1, 0x9000
+        mv      a2, s1
+        li      a7, 64
+        ecall
+
+        li      a0, 0                   # brk(0), then brk(break + 0x1000)
+        li      a7, 214
+        ecall
+        mv      s2, a0
+        li      t0, 0x1000
+        add     a0, a0, t0
+        ecall
+        sub     s2, a0, s2
+
+        li      a0, 1                   # clock_gettime(CLOCK_MONOTONIC, 0x9100)
+        li      a1, 0x9100
+        li      a7, 113
+        ecall
+        mv      s3, a0
+
+        li      a0, 3                   # exit(3)
+        li      a7, 93
+        ecall
+
+line:
+        .ascii  "hello from the guest\n"
+name:
+        .asciz  "syscalls.tmp"
@@ -0,0 +1,59 @@
+# timer.s
+# CLINT timer interrupt taken through a vectored mtvec while the hart waits in
+# wfi. mtimecmp is set to 500, the handler at entry 7 of the vector table
+# counts the interrupt, moves mtimecmp away and returns behind the wfi.
+# a1 = mcause 0x80000007, a2 = 1 interrupt, a3 = 1 if mtime reached 500,
+# a4 = 0 if mepc is the instruction after wfi. wfi skips the time up to the
+# deadline, so the program executes only a few dozen instructions.
+
+        li      sp, 0x8000
+        la      t0, vectors
+        ori     t0, t0, 1               # vectored mode
+        csrw    mtvec, t0
+
+        li      s0, 0x02004000          # mtimecmp of hart 0
+        li      t0, -1
+        sw      t0, 0(s0)
+        sw      x0, 4(s0)
+        li      t0, 500
+        sw      t0, 0(s0)
+
+        li      t0, 0x80                # MTIE
+        csrw    mie, t0
+        csrsi   mstatus, 0x8            # MIE
+sleep:
+        wfi
+after:
+        beqz    a2, sleep
+
+        csrr    t0, time
+        sltiu   a3, t0, 500
+        xori    a3, a3, 1
+        la      t0, after
+        sub     a4, s1, t0
+        li      a7, 0
+        li      a0, 10
+        ecall
+
+timer:
+        csrr    a1, mcause
+        csrr    s1, mepc
+        addi    a2, a2, 1
+        li      t0, -1
+        sw      t0, 4(s0)               # mtimecmp far in the future
+        mret
+
+        .p2align 6
+vectors:
+        j       bad                     # exceptions
+        .rept   6
+        j       bad
+        .endr
+        j       timer                   # 7: machine timer interrupt
+        .rept   8
+        j       bad
+        .endr
+bad:
+        li      a0, 17
+        li      a1, 1
+        ecall
@@ -0,0 +1,59 @@
+# vector.s
+# V extension: VLMAX of vsetvli for the VLEN, masked and tail elements left
+# undisturbed and VMULHU of 32-bit elements.
+# a1 = VLMAX of e32, a2 = VLMAX of e8, a3 = vl for an AVL of 3, a4 = vlenb,
+# s2..s5 = 1 + 10 and 3 + 30 added into elements 0 and 2 of 100s under the
+# mask 0b0101 with vl = 3, s6..s9 = VMULHU by 0xFFFFFFFF, s10 = active mask bits.
+
+        la      s0, data
+        vsetvli a1, x0, e32, m1, tu, mu
+        vsetvli a2, x0, e8, m1, tu, mu
+        li      t0, 3
+        vsetvli a3, t0, e32, m1, tu, mu
+        csrr    a4, vlenb
+
+        li      t0, 4
+        vsetvli x0, t0, e32, m1, tu, mu
+        vle32.v v1, (s0)
+        addi    t1, s0, 16
+        vle32.v v2, (t1)
+        li      t1, 100
+        vmv.v.x v3, t1
+        li      t1, 5
+        vmv.s.x v0, t1
+        vcpop.m s10, v0
+
+        li      t0, 3
+        vsetvli x0, t0, e32, m1, tu, mu
+        vadd.vv v3, v1, v2, v0.t
+
+        li      t0, 4
+        vsetvli x0, t0, e32, m1, tu, mu
+        addi    t1, s0, 48
+        vse32.v v3, (t1)
+        lw      s2, 48(s0)              # 11
+        lw      s3, 52(s0)              # 100, masked
+        lw      s4, 56(s0)              # 33
+        lw      s5, 60(s0)              # 100, tail
+
+        addi    t1, s0, 32
+        vle32.v v4, (t1)
+        li      t1, -1
+        vmulhu.vx v5, v4, t1
+        addi    t1, s0, 48
+        vse32.v v5, (t1)
+        lw      s6, 48(s0)              # 0xFFFFFFFE
+        lw      s7, 52(s0)              # 0x7FFFFFFF
+        lw      s8, 56(s0)              # 2
+        lw      s9, 60(s0)              # 0x12345677
+
+        li      a7, 0
+        li      a0, 10
+        ecall
+
+        .p2align 2
+data:
+        .word   1, 2, 3, 4              # 0
+        .word   10, 20, 30, 40          # 16
+        .word   0xFFFFFFFF, 0x80000000, 3, 0x12345678   # 32
+        .word   0, 0, 0, 0              # 48: buffer
@@ -0,0 +1,7 @@
+# zext_invalid.s
+# The encoding of ZEXT.H with rs2 != x0 is not ZEXT.H and must not run as one.
+
+        li      a1, 0x12345
+        .word   0x08004033 | (12 << 7) | (11 << 15) | (1 << 20)    # zext.h a2, a1 with rs2 = x1
+        li      a0, 10
+        ecall
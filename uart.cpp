@@ -0,0 +1,168 @@
+// uart.cpp
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#include <iostream>
+#include <poll.h>
+#include <unistd.h>
+#include "uart.h"
+#include "snapshot.h"
+
+/**
+ * UART constructor
+ */
+Uart::Uart () {
+    output.reserve(UART_BUFFER_SIZE);
+    for (unsigned char &reg : registers) {
+        reg = 0;
+    }
+    input_eof = false;
+}
+
+/**
+ * Loads from the UART, every byte of the access reads one register
+ * @param offset    offset from the base address
+ * @param length    number of bytes
+ * @return          value read
+ */
+unsigned int Uart::read (unsigned int offset, unsigned int length) {
+    std::lock_guard<std::mutex> guard(lock);
+    unsigned int data = 0;
+    for (unsigned int i = 0; i < length; i++) {
+        data |= (unsigned int)(read_register(offset + i)) << (8 * i);
+    }
+    return data;
+}
+
+/**
+ * Stores to the UART, every byte of the access writes one register
+ * @param offset    offset from the base address
+ * @param data      value to be written
+ * @param length    number of bytes
+ */
+void Uart::write (unsigned int offset, unsigned int data, unsigned int length) {
+    std::lock_guard<std::mutex> guard(lock);
+    for (unsigned int i = 0; i < length; i++) {
+        write_register(offset + i, (unsigned char)(data >> (8 * i)));
+    }
+}
+
+/**
+ * Writes the buffered output to the host
+ */
+void Uart::flush () {
+    std::lock_guard<std::mutex> guard(lock);
+    flush_output();
+}
+
+/**
+ * Writes the registers into a snapshot
+ * @param out   snapshot stream
+ */
+void Uart::save (std::ostream &out) const {
+    save_value(out, registers);
+}
+
+/**
+ * Reads the registers from a snapshot
+ * @param in    snapshot stream
+ */
+void Uart::restore (std::istream &in) {
+    std::lock_guard<std::mutex> guard(lock);
+    restore_value(in, registers);
+}
+
+/**
+ * Writes the buffered output to the host standard output in one system call
+ */
+void Uart::flush_output () {
+    if (output.empty()) {
+        return;
+    }
+    // the simulator messages written so far go first
+    std::cout.flush();
+    const char *data = output.data();
+    size_t length = output.size();
+    while (length != 0) {
+        ssize_t written = ::write(STDOUT_FILENO, data, length);
+        if (written <= 0) {
+            break;
+        }
+        data += written;
+        length -= size_t(written);
+    }
+    output.clear();
+}
+
+/**
+ * Checks without blocking whether the host standard input has a character
+ * @return  true if a character can be read
+ */
+bool Uart::input_ready () {
+    if (input_eof) {
+        return false;
+    }
+    pollfd fd{STDIN_FILENO, POLLIN, 0};
+    return poll(&fd, 1, 0) > 0 && (fd.revents & POLLIN);
+}
+
+/**
+ * Reads a register, registers beyond the eighth one read as zero
+ * @param reg   register number
+ * @return      value of the register
+ */
+unsigned char Uart::read_register (unsigned int reg) {
+    switch (reg) {
+        case UART_RBR: {
+            // a program reading input usually printed a prompt before
+            flush_output();
+            unsigned char c = 0;
+            if (input_ready() && ::read(STDIN_FILENO, &c, 1) != 1) {
+                input_eof = true;
+                c = 0;
+            }
+            return c;
+        }
+        case UART_IIR:
+            // no interrupt pending
+            return 0x01;
+        case UART_LSR:
+            if (!input_ready()) {
+                return UART_LSR_THRE | UART_LSR_TEMT;
+            }
+            return UART_LSR_THRE | UART_LSR_TEMT | UART_LSR_DR;
+        case UART_MSR:
+            return 0;
+        case UART_IER:
+        case UART_LCR:
+        case UART_MCR:
+        case UART_SCR:
+            return registers[reg];
+        default:
+            return 0;
+    }
+}
+
+/**
+ * Writes a register, writes to read-only registers are ignored
+ * @param reg   register number
+ * @param data  value to be written
+ */
+void Uart::write_register (unsigned int reg, unsigned char data) {
+    switch (reg) {
+        case UART_RBR:
+            output.push_back(char(data));
+            if (output.size() >= UART_BUFFER_SIZE) {
+                flush_output();
+            }
+            break;
+        case UART_IER:
+        case UART_LCR:
+        case UART_MCR:
+        case UART_SCR:
+            registers[reg] = data;
+            break;
+        default:
+            break;
+    }
+}
@@ -0,0 +1,56 @@
+// uart.h
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#ifndef ISA_SIM_CPP_UART_H
+#define ISA_SIM_CPP_UART_H
+
+#include <mutex>
+#include <vector>
+#include "device.h"
+
+#define UART_BASE           0x10000000u
+#define UART_SIZE           0x1000u
+#define UART_BUFFER_SIZE    0x10000u
+
+// 16550 registers
+#define UART_RBR    0       // receive buffer (read), transmit holding register (write)
+#define UART_IER    1
+#define UART_IIR    2
+#define UART_LCR    3
+#define UART_MCR    4
+#define UART_LSR    5
+#define UART_MSR    6
+#define UART_SCR    7
+
+#define UART_LSR_DR     0x01u   // data ready
+#define UART_LSR_THRE   0x20u   // transmit holding register empty
+#define UART_LSR_TEMT   0x40u   // transmitter empty
+
+/**
+ * 16550 compatible UART connected to the standard input and output of the host.
+ * Transmitted characters are collected in a buffer and written to the host in
+ * large batches: when the buffer is full, before reading input and at the end of simulation.
+ */
+class Uart : public Device {
+public:
+    Uart ();
+    unsigned int read (unsigned int offset, unsigned int length) override;
+    void write (unsigned int offset, unsigned int data, unsigned int length) override;
+    void flush () override;
+    void save (std::ostream &out) const override;
+    void restore (std::istream &in) override;
+private:
+    unsigned char read_register (unsigned int reg);
+    void write_register (unsigned int reg, unsigned char data);
+    bool input_ready ();
+    void flush_output ();
+
+    std::mutex lock;
+    std::vector<char> output;
+    unsigned char registers[8];
+    bool input_eof;
+};
+
+
+#endif //ISA_SIM_CPP_UART_H
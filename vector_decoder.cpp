@@ -0,0 +1,621 @@
+// vector_decoder.cpp
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include "vector_decoder.h"
+#include "hart.h"
+
+// Width of the host SIMD registers used by the element-wise kernels. The kernels
+// are written with GCC vector extensions, so they compile to SSE2 on baseline
+// x86-64 and to AVX2/AVX-512 when the host supports it (-march=native).
+#if defined(__AVX512F__) && defined(__AVX512BW__)
+#define SIMD_BYTES 64
+#elif defined(__AVX2__)
+#define SIMD_BYTES 32
+#else
+#define SIMD_BYTES 16
+#endif
+
+/**
+ * Second source operand of the element-wise kernels
+ */
+
+// vs1 register group (OPIVV, OPMVV)
+struct VectorOperand {
+    const unsigned char *data;
+    template <typename T>
+    T at (unsigned int i) const { return reinterpret_cast<const T *>(data)[i]; }
+    template <typename V, typename T>
+    V load (unsigned int i) const { V v; std::memcpy(&v, data + i * sizeof(T), sizeof(V)); return v; }
+};
+
+// rs1 register or immediate broadcast to all elements (OPIVX, OPIVI, OPMVX)
+struct ScalarOperand {
+    unsigned int value;
+    template <typename T>
+    T at (unsigned int) const { return T(value); }
+    template <typename V, typename T>
+    V load (unsigned int) const { return V{} + T(value); }
+};
+
+/**
+ * Element-wise kernels
+ */
+
+// vd[i] = op(vs2[i], src[i]) for active elements
+template <typename T, typename Src, typename Op>
+static void binary_kernel (VectorRegisterFile *vreg, v_inst_t d, const Src &src, Op op) {
+    T *vd = reinterpret_cast<T *>(vreg->data(d.f.vd));
+    const T *vs2 = reinterpret_cast<const T *>(vreg->data(d.f.vs2));
+    unsigned int vl = vreg->vl();
+    unsigned int i = 0;
+
+    if (d.f.vm) {
+        typedef T simd_t __attribute__((vector_size(SIMD_BYTES)));
+        const unsigned int lanes = SIMD_BYTES / sizeof(T);
+        for (; i + lanes <= vl; i += lanes) {
+            simd_t a;
+            std::memcpy(&a, vs2 + i, SIMD_BYTES);
+            simd_t r = op(a, src.template load<simd_t, T>(i));
+            std::memcpy(vd + i, &r, SIMD_BYTES);
+        }
+        for (; i < vl; i++) {
+            vd[i] = op(vs2[i], src.template at<T>(i));
+        }
+    } else {
+        for (; i < vl; i++) {
+            if (vreg->maskBit(0, i)) {
+                vd[i] = op(vs2[i], src.template at<T>(i));
+            }
+        }
+    }
+}
+
+// vd.mask[i] = cmp(vs2[i], src[i]) for active elements
+template <typename T, typename Src, typename Cmp>
+static void compare_kernel (VectorRegisterFile *vreg, v_inst_t d, const Src &src, Cmp cmp) {
+    const T *vs2 = reinterpret_cast<const T *>(vreg->data(d.f.vs2));
+    unsigned int vl = vreg->vl();
+    for (unsigned int i = 0; i < vl; i++) {
+        if (d.f.vm || vreg->maskBit(0, i)) {
+            vreg->setMaskBit(d.f.vd, i, cmp(vs2[i], src.template at<T>(i)));
+        }
+    }
+}
+
+// vd[0] = op(vs1[0], vs2[active elements])
+template <typename T, typename Op>
+static void reduction_kernel (VectorRegisterFile *vreg, v_inst_t d, Op op) {
+    const T *vs2 = reinterpret_cast<const T *>(vreg->data(d.f.vs2));
+    unsigned int vl = vreg->vl();
+    if (vl == 0) {
+        return;
+    }
+    T acc = reinterpret_cast<const T *>(vreg->data(d.f.vs1))[0];
+    for (unsigned int i = 0; i < vl; i++) {
+        if (d.f.vm || vreg->maskBit(0, i)) {
+            acc = op(acc, vs2[i]);
+        }
+    }
+    reinterpret_cast<T *>(vreg->data(d.f.vd))[0] = acc;
+}
+
+// vmerge (masked) and vmv.v (unmasked)
+template <typename T, typename Src>
+static void merge_kernel (VectorRegisterFile *vreg, v_inst_t d, const Src &src) {
+    T *vd = reinterpret_cast<T *>(vreg->data(d.f.vd));
+    const T *vs2 = reinterpret_cast<const T *>(vreg->data(d.f.vs2));
+    unsigned int vl = vreg->vl();
+    for (unsigned int i = 0; i < vl; i++) {
+        vd[i] = (d.f.vm || vreg->maskBit(0, i)) ? src.template at<T>(i) : vs2[i];
+    }
+}
+
+// upper half of the 2*SEW-bit product, U and V select signedness of the operands;
+// unsigned products of 32-bit elements do not fit into int64_t, they are computed unsigned
+template <typename U, typename V, typename T, typename Src>
+static void mul_high_kernel (VectorRegisterFile *vreg, v_inst_t d, const Src &src) {
+    typedef std::conditional_t<std::is_unsigned<U>::value && std::is_unsigned<V>::value, uint64_t, int64_t> P;
+    T *vd = reinterpret_cast<T *>(vreg->data(d.f.vd));
+    const T *vs2 = reinterpret_cast<const T *>(vreg->data(d.f.vs2));
+    unsigned int vl = vreg->vl();
+    for (unsigned int i = 0; i < vl; i++) {
+        if (d.f.vm || vreg->maskBit(0, i)) {
+            P product = P(U(vs2[i])) * P(V(src.template at<T>(i)));
+            vd[i] = T(uint64_t(product) >> (sizeof(T) * 8));
+        }
+    }
+}
+
+/**
+ * Operations shared by the kernels, written for both scalars and host SIMD vectors
+ */
+static auto op_min = [](auto a, auto b) { return a < b ? a : b; };
+static auto op_max = [](auto a, auto b) { return a > b ? a : b; };
+static auto op_mul = [](auto a, auto b) {
+    // scalar operands are promoted to int, multiply as unsigned to avoid overflow
+    if constexpr (std::is_integral<decltype(a)>::value) {
+        return decltype(a)(uint32_t(a) * uint32_t(b));
+    } else {
+        return a * b;
+    }
+};
+
+/**
+ * VectorDecoder base constructor
+ * @param hart  hart whose instructions are decoded
+ */
+VectorDecoder::VectorDecoder (Hart &hart) : InstructionDecoder(hart) {
+    vreg = hart.vectorRegisters();
+}
+
+/**
+ * Terminates if vtype is invalid (vill set)
+ */
+void VectorDecoder::check_vtype () {
+    if (vreg->vtype() & VTYPE_VILL) {
+        term->terminate("Vector instruction executed with invalid vtype\n", 1);
+    }
+}
+
+/**
+ * Gets element width in bytes of vector memory access
+ * @param width funct3 of the instruction
+ * @return      element width or 0 if not supported
+ */
+static unsigned int element_bytes (unsigned int width) {
+    switch (width) {
+        case 0b000:
+            return 1;
+        case 0b101:
+            return 2;
+        case 0b110:
+            return 4;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * Function decoding vector load instructions
+ * @param pc    program counter
+ * @param inst  raw instruction
+ * @return      new program counter
+ */
+unsigned int VectorLoadDecoder::decode (unsigned int pc, unsigned int inst) {
+    v_inst_t decoder{};
+    decoder.inst = inst;
+
+    check_vtype();
+    unsigned int eew = element_bytes(decoder.f.funct3);
+    unsigned int mop = decoder.f.funct6 & 0b11u;
+    unsigned int vl = vreg->vl();
+    unsigned char *vd = vreg->data(decoder.f.vd);
+    rs1 = reg->read(RegisterFile::Register(decoder.f.vs1));
+
+    if (eew == 0 || (decoder.f.funct6 >> 2u) != 0) {
+        term->terminate("Unsupported vector load: segment, 64-bit or wide elements\n", 1);
+    }
+
+    if (mop == 0b00 && decoder.f.vs2 == 0b01011) {
+        // VLM.V: mask load of ceil(vl / 8) bytes
+        stack->readBlock(rs1, vd, (vl + 7) / 8);
+    } else if (mop == 0b00 && decoder.f.vs2 == 0) {
+        // VLE8.V, VLE16.V, VLE32.V
+        if (decoder.f.vm) {
+            // unmasked unit-stride load is one bulk copy
+            stack->readBlock(rs1, vd, vl * eew);
+        } else {
+            for (unsigned int i = 0; i < vl; i++) {
+                if (vreg->maskBit(0, i)) {
+                    stack->readBlock(rs1 + i * eew, vd + i * eew, eew);
+                }
+            }
+        }
+    } else if (mop == 0b10) {
+        // VLSE8.V, VLSE16.V, VLSE32.V
+        rs2 = reg->read(RegisterFile::Register(decoder.f.vs2));
+        for (unsigned int i = 0; i < vl; i++) {
+            if (decoder.f.vm || vreg->maskBit(0, i)) {
+                stack->readBlock(rs1 + i * rs2, vd + i * eew, eew);
+            }
+        }
+    } else {
+        term->terminate("Unsupported vector load addressing mode: " + std::to_string(mop) + "\n", 1);
+    }
+    return pc+4;
+}
+
+/**
+ * Function decoding vector store instructions
+ * @param pc    program counter
+ * @param inst  raw instruction
+ * @return      new program counter
+ */
+unsigned int VectorStoreDecoder::decode (unsigned int pc, unsigned int inst) {
+    v_inst_t decoder{};
+    decoder.inst = inst;
+
+    check_vtype();
+    unsigned int eew = element_bytes(decoder.f.funct3);
+    unsigned int mop = decoder.f.funct6 & 0b11u;
+    unsigned int vl = vreg->vl();
+    // vd field holds vs3, the register to be stored
+    const unsigned char *vs3 = vreg->data(decoder.f.vd);
+    rs1 = reg->read(RegisterFile::Register(decoder.f.vs1));
+
+    if (eew == 0 || (decoder.f.funct6 >> 2u) != 0) {
+        term->terminate("Unsupported vector store: segment, 64-bit or wide elements\n", 1);
+    }
+
+    if (mop == 0b00 && decoder.f.vs2 == 0b01011) {
+        // VSM.V
+        stack->writeBlock(rs1, vs3, (vl + 7) / 8);
+    } else if (mop == 0b00 && decoder.f.vs2 == 0) {
+        // VSE8.V, VSE16.V, VSE32.V
+        if (decoder.f.vm) {
+            // unmasked unit-stride store is one bulk copy
+            stack->writeBlock(rs1, vs3, vl * eew);
+        } else {
+            for (unsigned int i = 0; i < vl; i++) {
+                if (vreg->maskBit(0, i)) {
+                    stack->writeBlock(rs1 + i * eew, vs3 + i * eew, eew);
+                }
+            }
+        }
+    } else if (mop == 0b10) {
+        // VSSE8.V, VSSE16.V, VSSE32.V
+        rs2 = reg->read(RegisterFile::Register(decoder.f.vs2));
+        for (unsigned int i = 0; i < vl; i++) {
+            if (decoder.f.vm || vreg->maskBit(0, i)) {
+                stack->writeBlock(rs1 + i * rs2, vs3 + i * eew, eew);
+            }
+        }
+    } else {
+        term->terminate("Unsupported vector store addressing mode: " + std::to_string(mop) + "\n", 1);
+    }
+    return pc+4;
+}
+
+/**
+ * Function decoding vector arithmetic instructions
+ * @param pc    program counter
+ * @param inst  raw instruction
+ * @return      new program counter
+ */
+unsigned int VectorArithDecoder::decode (unsigned int pc, unsigned int inst) {
+    v_inst_t decoder{};
+    decoder.inst = inst;
+
+    if (decoder.f.funct3 == 0b111) {
+        // VSETVLI, VSETIVLI, VSETVL
+        return config_decode(pc, decoder);
+    }
+
+    check_vtype();
+
+    bool integer = decoder.f.funct3 == 0b000 || decoder.f.funct3 == 0b011 || decoder.f.funct3 == 0b100;
+    bool multiply = decoder.f.funct3 == 0b010 || decoder.f.funct3 == 0b110;
+    if (!integer && !multiply) {
+        term->terminate("Vector floating-point instructions are not supported\n", 1);
+    }
+
+    switch (vreg->sew()) {
+        case 8:
+            integer ? int_decode<uint8_t>(decoder) : mul_decode<uint8_t>(decoder);
+            break;
+        case 16:
+            integer ? int_decode<uint16_t>(decoder) : mul_decode<uint16_t>(decoder);
+            break;
+        default:
+            integer ? int_decode<uint32_t>(decoder) : mul_decode<uint32_t>(decoder);
+            break;
+    }
+    return pc+4;
+}
+
+/**
+ * Function decoding vector configuration instructions
+ * @param pc        program counter
+ * @param decoder   decoder union
+ * @return          new program counter
+ */
+unsigned int VectorArithDecoder::config_decode (unsigned int pc, v_inst_t decoder) {
+    unsigned int vtype;
+    unsigned int avl;
+    bool keep_vl = false;
+    RegisterFile::Register rd = RegisterFile::Register(decoder.f.vd);
+    RegisterFile::Register rs1_num = RegisterFile::Register(decoder.f.vs1);
+
+    if (!(decoder.inst >> 31u)) {
+        // VSETVLI
+        vtype = (decoder.inst >> 20u) & 0x7FFu;
+    } else if ((decoder.inst >> 30u) == 0b11) {
+        // VSETIVLI
+        vtype = (decoder.inst >> 20u) & 0x3FFu;
+    } else {
+        // VSETVL
+        vtype = reg->read(RegisterFile::Register(decoder.f.vs2));
+    }
+
+    if ((decoder.inst >> 30u) == 0b11) {
+        avl = decoder.f.vs1;
+    } else if (rs1_num != RegisterFile::x0) {
+        avl = reg->read(rs1_num);
+    } else {
+        // rs1 = x0 sets vl to VLMAX, or keeps vl if rd = x0 as well
+        avl = 0xFFFFFFFFu;
+        keep_vl = rd == RegisterFile::x0;
+    }
+
+    reg->write(rd, vreg->setVtype(vtype, avl, keep_vl));
+    return pc+4;
+}
+
+/**
+ * Function decoding vector integer instructions (OPIVV, OPIVX and OPIVI)
+ * @param decoder   decoder union
+ */
+template <typename T>
+void VectorArithDecoder::int_decode (v_inst_t decoder) {
+    typedef typename std::make_signed<T>::type S;
+    const T shift_mask = sizeof(T) * 8 - 1;
+    VectorOperand vv{vreg->data(decoder.f.vs1)};
+    // OPIVI sign-extends the 5-bit immediate
+    ScalarOperand vx{decoder.f.funct3 == 0b100 ? reg->read(RegisterFile::Register(decoder.f.vs1))
+                                               : (unsigned int)(int(decoder.f.vs1 << 27u) >> 27)};
+
+    auto shift_left = [shift_mask](auto a, auto b) { return a << (b & shift_mask); };
+    auto shift_right = [shift_mask](auto a, auto b) { return a >> (b & shift_mask); };
+
+#define VECTOR_BINARY(type, op) \
+    decoder.f.funct3 == 0b000 ? binary_kernel<type>(vreg, decoder, vv, op) : binary_kernel<type>(vreg, decoder, vx, op)
+#define VECTOR_COMPARE(type, op) \
+    decoder.f.funct3 == 0b000 ? compare_kernel<type>(vreg, decoder, vv, op) : compare_kernel<type>(vreg, decoder, vx, op)
+
+    switch (decoder.f.funct6) {
+        case 0b000000:
+            // VADD
+            VECTOR_BINARY(T, [](auto a, auto b) { return a + b; });
+            break;
+        case 0b000010:
+            // VSUB
+            VECTOR_BINARY(T, [](auto a, auto b) { return a - b; });
+            break;
+        case 0b000011:
+            // VRSUB
+            VECTOR_BINARY(T, [](auto a, auto b) { return b - a; });
+            break;
+        case 0b000100:
+            // VMINU
+            VECTOR_BINARY(T, op_min);
+            break;
+        case 0b000101:
+            // VMIN
+            VECTOR_BINARY(S, op_min);
+            break;
+        case 0b000110:
+            // VMAXU
+            VECTOR_BINARY(T, op_max);
+            break;
+        case 0b000111:
+            // VMAX
+            VECTOR_BINARY(S, op_max);
+            break;
+        case 0b001001:
+            // VAND
+            VECTOR_BINARY(T, [](auto a, auto b) { return a & b; });
+            break;
+        case 0b001010:
+            // VOR
+            VECTOR_BINARY(T, [](auto a, auto b) { return a | b; });
+            break;
+        case 0b001011:
+            // VXOR
+            VECTOR_BINARY(T, [](auto a, auto b) { return a ^ b; });
+            break;
+        case 0b010111:
+            // VMERGE, VMV.V
+            decoder.f.funct3 == 0b000 ? merge_kernel<T>(vreg, decoder, vv) : merge_kernel<T>(vreg, decoder, vx);
+            break;
+        case 0b011000:
+            // VMSEQ
+            VECTOR_COMPARE(T, [](auto a, auto b) { return a == b; });
+            break;
+        case 0b011001:
+            // VMSNE
+            VECTOR_COMPARE(T, [](auto a, auto b) { return a != b; });
+            break;
+        case 0b011010:
+            // VMSLTU
+            VECTOR_COMPARE(T, [](auto a, auto b) { return a < b; });
+            break;
+        case 0b011011:
+            // VMSLT
+            VECTOR_COMPARE(S, [](auto a, auto b) { return a < b; });
+            break;
+        case 0b011100:
+            // VMSLEU
+            VECTOR_COMPARE(T, [](auto a, auto b) { return a <= b; });
+            break;
+        case 0b011101:
+            // VMSLE
+            VECTOR_COMPARE(S, [](auto a, auto b) { return a <= b; });
+            break;
+        case 0b011110:
+            // VMSGTU
+            VECTOR_COMPARE(T, [](auto a, auto b) { return a > b; });
+            break;
+        case 0b011111:
+            // VMSGT
+            VECTOR_COMPARE(S, [](auto a, auto b) { return a > b; });
+            break;
+        case 0b100101:
+            // VSLL
+            VECTOR_BINARY(T, shift_left);
+            break;
+        case 0b101000:
+            // VSRL
+            VECTOR_BINARY(T, shift_right);
+            break;
+        case 0b101001:
+            // VSRA
+            VECTOR_BINARY(S, shift_right);
+            break;
+        default:
+            term->terminate("Unsupported vector integer instruction: funct6="
+                            + std::to_string(decoder.f.funct6) + "\n", 1);
+    }
+#undef VECTOR_BINARY
+#undef VECTOR_COMPARE
+}
+
+/**
+ * Function decoding vector multiply, reduction, mask and move instructions (OPMVV and OPMVX)
+ * @param decoder   decoder union
+ */
+template <typename T>
+void VectorArithDecoder::mul_decode (v_inst_t decoder) {
+    typedef typename std::make_signed<T>::type S;
+    bool vv = decoder.f.funct3 == 0b010;
+    VectorOperand vs1{vreg->data(decoder.f.vs1)};
+    ScalarOperand rs1_op{reg->read(RegisterFile::Register(decoder.f.vs1))};
+
+    if (vv && decoder.f.funct6 < 0b001000) {
+        // reductions
+        switch (decoder.f.funct6) {
+            case 0b000000:
+                // VREDSUM
+                reduction_kernel<T>(vreg, decoder, [](T a, T b) { return T(a + b); });
+                break;
+            case 0b000001:
+                // VREDAND
+                reduction_kernel<T>(vreg, decoder, [](T a, T b) { return T(a & b); });
+                break;
+            case 0b000010:
+                // VREDOR
+                reduction_kernel<T>(vreg, decoder, [](T a, T b) { return T(a | b); });
+                break;
+            case 0b000011:
+                // VREDXOR
+                reduction_kernel<T>(vreg, decoder, [](T a, T b) { return T(a ^ b); });
+                break;
+            case 0b000100:
+                // VREDMINU
+                reduction_kernel<T>(vreg, decoder, [](T a, T b) { return a < b ? a : b; });
+                break;
+            case 0b000101:
+                // VREDMIN
+                reduction_kernel<S>(vreg, decoder, [](S a, S b) { return a < b ? a : b; });
+                break;
+            case 0b000110:
+                // VREDMAXU
+                reduction_kernel<T>(vreg, decoder, [](T a, T b) { return a > b ? a : b; });
+                break;
+            default:
+                // VREDMAX
+                reduction_kernel<S>(vreg, decoder, [](S a, S b) { return a > b ? a : b; });
+                break;
+        }
+        return;
+    }
+
+    switch (decoder.f.funct6) {
+        case 0b010000:
+            if (vv && decoder.f.vs1 == 0b00000) {
+                // VMV.X.S
+                reg->write(RegisterFile::Register(decoder.f.vd),
+                           (unsigned int)(int(S(reinterpret_cast<T *>(vreg->data(decoder.f.vs2))[0]))));
+            } else if (vv && decoder.f.vs1 == 0b10000) {
+                // VCPOP.M
+                unsigned int count = 0;
+                for (unsigned int i = 0; i < vreg->vl(); i++) {
+                    count += (decoder.f.vm || vreg->maskBit(0, i)) && vreg->maskBit(decoder.f.vs2, i);
+                }
+                reg->write(RegisterFile::Register(decoder.f.vd), count);
+            } else if (!vv && decoder.f.vs2 == 0 && vreg->vl() > 0) {
+                // VMV.S.X
+                reinterpret_cast<T *>(vreg->data(decoder.f.vd))[0] = T(rs1_op.value);
+            }
+            break;
+        case 0b011000:
+        case 0b011001:
+        case 0b011010:
+        case 0b011011:
+        case 0b011100:
+        case 0b011101:
+        case 0b011110:
+        case 0b011111:
+            mask_decode(decoder);
+            break;
+        case 0b100100:
+            // VMULHU
+            vv ? mul_high_kernel<T, T, T>(vreg, decoder, vs1) : mul_high_kernel<T, T, T>(vreg, decoder, rs1_op);
+            break;
+        case 0b100101:
+            // VMUL
+            vv ? binary_kernel<T>(vreg, decoder, vs1, op_mul) : binary_kernel<T>(vreg, decoder, rs1_op, op_mul);
+            break;
+        case 0b100110:
+            // VMULHSU
+            vv ? mul_high_kernel<S, T, T>(vreg, decoder, vs1) : mul_high_kernel<S, T, T>(vreg, decoder, rs1_op);
+            break;
+        case 0b100111:
+            // VMULH
+            vv ? mul_high_kernel<S, S, T>(vreg, decoder, vs1) : mul_high_kernel<S, S, T>(vreg, decoder, rs1_op);
+            break;
+        default:
+            term->terminate("Unsupported vector instruction: funct6="
+                            + std::to_string(decoder.f.funct6) + "\n", 1);
+    }
+}
+
+/**
+ * Function decoding vector mask logical instructions
+ * @param decoder   decoder union
+ */
+void VectorArithDecoder::mask_decode (v_inst_t decoder) {
+    for (unsigned int i = 0; i < vreg->vl(); i++) {
+        bool a = vreg->maskBit(decoder.f.vs2, i);
+        bool b = vreg->maskBit(decoder.f.vs1, i);
+        bool r;
+        switch (decoder.f.funct6 & 0b111u) {
+            case 0b000:
+                // VMANDN
+                r = a && !b;
+                break;
+            case 0b001:
+                // VMAND
+                r = a && b;
+                break;
+            case 0b010:
+                // VMOR
+                r = a || b;
+                break;
+            case 0b011:
+                // VMXOR
+                r = a != b;
+                break;
+            case 0b100:
+                // VMORN
+                r = a || !b;
+                break;
+            case 0b101:
+                // VMNAND
+                r = !(a && b);
+                break;
+            case 0b110:
+                // VMNOR
+                r = !(a || b);
+                break;
+            default:
+                // VMXNOR
+                r = a == b;
+                break;
+        }
+        vreg->setMaskBit(decoder.f.vd, i, r);
+    }
+}
@@ -0,0 +1,60 @@
+// vector_decoder.h
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#ifndef ISA_SIM_CPP_VECTOR_DECODER_H
+#define ISA_SIM_CPP_VECTOR_DECODER_H
+
+#include "instruction_decoder.h"
+#include "vector_register_file.h"
+
+/**
+ * Vector (subset of V extension) instruction decoders
+ */
+
+/**
+ * Base of the vector instruction decoders
+ */
+class VectorDecoder : public InstructionDecoder {
+protected:
+    VectorRegisterFile *vreg;
+    void check_vtype ();
+public:
+    explicit VectorDecoder (Hart &hart);
+};
+
+/**
+ * Vector load instruction decoder
+ */
+class VectorLoadDecoder : public VectorDecoder {
+public:
+    using VectorDecoder::VectorDecoder;
+    unsigned int decode (unsigned int pc, unsigned int inst) override;
+};
+
+/**
+ * Vector store instruction decoder
+ */
+class VectorStoreDecoder : public VectorDecoder {
+public:
+    using VectorDecoder::VectorDecoder;
+    unsigned int decode (unsigned int pc, unsigned int inst) override;
+};
+
+/**
+ * Vector configuration, integer arithmetic, compare, mask and reduction instruction decoder
+ */
+class VectorArithDecoder : public VectorDecoder {
+private:
+    unsigned int config_decode (unsigned int pc, v_inst_t decoder);
+    template <typename T>
+    void int_decode (v_inst_t decoder);
+    template <typename T>
+    void mul_decode (v_inst_t decoder);
+    void mask_decode (v_inst_t decoder);
+public:
+    using VectorDecoder::VectorDecoder;
+    unsigned int decode (unsigned int pc, unsigned int inst) override;
+};
+
+#endif //ISA_SIM_CPP_VECTOR_DECODER_H
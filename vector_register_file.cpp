@@ -0,0 +1,126 @@
+// vector_register_file.cpp
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#include <new>
+#include <cstring>
+#include "vector_register_file.h"
+#include "snapshot.h"
+
+unsigned int VectorRegisterFile::s_vlen = VLEN_DEFAULT;
+
+/**
+ * Vector register file constructor
+ */
+VectorRegisterFile::VectorRegisterFile () {
+    m_vlenb = s_vlen / 8;
+    // 7 spare registers so that a misaligned group (e.g. v31 with LMUL=8),
+    // which is a reserved encoding, never reaches outside of the allocation
+    m_data = new (std::align_val_t(64)) unsigned char[(32 + 7) * m_vlenb];
+    clear();
+}
+
+/**
+ * Zeroes all registers and makes vtype invalid
+ */
+void VectorRegisterFile::clear () {
+    std::memset(m_data, 0, (32 + 7) * m_vlenb);
+    m_vl = 0;
+    m_vtype = VTYPE_VILL;
+    m_sew = 8;
+    m_lmul = 1;
+}
+
+/**
+ * Sets the vector register length, must be called before the first hart is created
+ * @param vlen  length of vector register in bits
+ * @return      false if vlen is not a power of two between VLEN_MIN and VLEN_MAX
+ */
+bool VectorRegisterFile::setVlen (unsigned int vlen) {
+    if (vlen < VLEN_MIN || vlen > VLEN_MAX || (vlen & (vlen - 1))) {
+        return false;
+    }
+    s_vlen = vlen;
+    return true;
+}
+
+/**
+ * Writes one bit of mask register
+ * @param reg   register number
+ * @param i     element index
+ * @param value mask bit
+ */
+void VectorRegisterFile::setMaskBit (unsigned int reg, unsigned int i, bool value) {
+    unsigned char bit = 1u << (i % 8);
+    if (value) {
+        data(reg)[i / 8] |= bit;
+    } else {
+        data(reg)[i / 8] &= ~bit;
+    }
+}
+
+/**
+ * Computes the maximum vector length for the vector type
+ * @param vtype vector type
+ * @return      VLMAX or 0 if the vector type is not supported
+ */
+unsigned int VectorRegisterFile::vlmax (unsigned int vtype) {
+    unsigned int vsew = (vtype >> 3u) & 0x7u;
+    unsigned int vlmul = vtype & 0x7u;
+    // only SEW of 8, 16 and 32 bits and no reserved bits are supported
+    if (vsew > 2 || vlmul == 0b100 || (vtype >> 8u)) {
+        return 0;
+    }
+    unsigned int elements = m_vlenb * 8 / (8u << vsew);
+    // vlmul 0-3 = LMUL 1,2,4,8 and 5-7 = LMUL 1/8,1/4,1/2
+    return vlmul < 4 ? elements << vlmul : elements >> (8 - vlmul);
+}
+
+/**
+ * Sets the vector type and vector length as done by vsetvl{i}
+ * @param vtype     new vector type
+ * @param avl       application vector length
+ * @param keep_vl   keep the current vl (rd = rs1 = x0)
+ * @return          new vector length
+ */
+unsigned int VectorRegisterFile::setVtype (unsigned int vtype, unsigned int avl, bool keep_vl) {
+    unsigned int max = vlmax(vtype);
+    if (max == 0) {
+        m_vtype = VTYPE_VILL;
+        m_vl = 0;
+        return 0;
+    }
+    m_vtype = vtype;
+    m_sew = 8u << ((vtype >> 3u) & 0x7u);
+    m_lmul = (vtype & 0x4u) ? 1 : 1u << (vtype & 0x3u);
+    if (!keep_vl) {
+        m_vl = avl < max ? avl : max;
+    } else if (m_vl > max) {
+        m_vl = max;
+    }
+    return m_vl;
+}
+
+/**
+ * Writes the registers, vl and vtype into a snapshot
+ * @param out   snapshot stream
+ */
+void VectorRegisterFile::save (std::ostream &out) const {
+    out.write(reinterpret_cast<const char *>(m_data), 32 * m_vlenb);
+    save_value(out, m_vl);
+    save_value(out, m_vtype);
+    save_value(out, m_sew);
+    save_value(out, m_lmul);
+}
+
+/**
+ * Reads the registers, vl and vtype from a snapshot taken with the same VLEN
+ * @param in    snapshot stream
+ */
+void VectorRegisterFile::restore (std::istream &in) {
+    in.read(reinterpret_cast<char *>(m_data), 32 * m_vlenb);
+    restore_value(in, m_vl);
+    restore_value(in, m_vtype);
+    restore_value(in, m_sew);
+    restore_value(in, m_lmul);
+}
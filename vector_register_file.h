@@ -0,0 +1,52 @@
+// vector_register_file.h
+// Matej Majtan (s184457) & Søren Tønnesen (s180381)
+// 02-12-2019
+
+#ifndef ISA_SIM_CPP_VECTOR_REGISTER_FILE_H
+#define ISA_SIM_CPP_VECTOR_REGISTER_FILE_H
+
+#include <istream>
+#include <ostream>
+
+#define VLEN_DEFAULT    128
+#define VLEN_MIN        64
+#define VLEN_MAX        4096
+#define VTYPE_VILL      0x80000000u
+
+/**
+ * Vector register file (subset of V extension) with the vl and vtype registers.
+ * All 32 registers are stored in one 64-byte aligned block, so register groups
+ * (LMUL > 1) are contiguous and elements can be processed by host SIMD directly.
+ */
+class VectorRegisterFile {
+public:
+    VectorRegisterFile();
+    static bool setVlen (unsigned int vlen);
+    static unsigned int vlen () { return s_vlen; }
+    void clear ();
+
+    unsigned char *data (unsigned int reg) { return m_data + reg * m_vlenb; }
+    bool maskBit (unsigned int reg, unsigned int i) { return (data(reg)[i / 8] >> (i % 8)) & 1u; }
+    void setMaskBit (unsigned int reg, unsigned int i, bool value);
+
+    unsigned int vlenb () { return m_vlenb; }
+    unsigned int vl () { return m_vl; }
+    unsigned int vtype () { return m_vtype; }
+    unsigned int sew () { return m_sew; }
+    unsigned int lmul () { return m_lmul; }
+    unsigned int setVtype (unsigned int vtype, unsigned int avl, bool keep_vl);
+    unsigned int vlmax (unsigned int vtype);
+    void save (std::ostream &out) const;
+    void restore (std::istream &in);
+private:
+    static unsigned int s_vlen;
+
+    unsigned char *m_data;
+    unsigned int m_vlenb;
+    unsigned int m_vl;
+    unsigned int m_vtype;
+    unsigned int m_sew;     // element width in bits
+    unsigned int m_lmul;    // registers in group (1 for fractional LMUL)
+};
+
+#endif //ISA_SIM_CPP_VECTOR_REGISTER_FILE_H